@@ -0,0 +1,81 @@
+#include "softphone.h"
+#include "config.h"
+#include "logger.h"
+#include "call_volume_port.h"
+#include "command_line.h"
+#include "startup_profile.h"
+#include "event_loop_watchdog.h"
+#include <QCoreApplication>
+#include <QTimer>
+#include <QDebug>
+#include <atomic>
+#include <csignal>
+#include <memory>
+
+//headless SIP engine: the models and the SIP client without the QML UI
+
+namespace {
+std::atomic<bool> quitRequested{false};
+
+void onQuitSignal(int)
+{
+    quitRequested = true;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    StartupProfile::instance().start();
+    if ((2 < argc) && (0 == qstrcmp("--volume-benchmark", argv[1]))) {
+        CallVolumePort::benchmark(QString::fromLocal8Bit(argv[2]).toInt());
+        return EXIT_SUCCESS;
+    }
+    WatchedApplication<QCoreApplication> app(argc, argv);
+
+    QCoreApplication::setOrganizationName(ORG_NAME);
+    QCoreApplication::setApplicationName(APP_NAME);
+    QCoreApplication::setApplicationVersion(APP_VERSION);
+
+    qSetMessagePattern("%{appname} [%{threadid}] [%{type}] %{message} (%{file}:%{line})");
+    Logger::installLogHandler();
+
+    //the account and the media settings are the ones saved by the desktop application
+    std::unique_ptr<Softphone> softphone;
+    {
+        const StartupProfile::Phase phase("softphone");
+        softphone.reset(new Softphone());
+    }
+    if (!softphone->start()) {
+        return EXIT_FAILURE;
+    }
+    CommandLineOptions options;
+    options.headless = true;
+    //the null device when no file is given, the calls send silence
+    options.nullAudio = true;
+    options.parse(argc, argv);
+    CommandLineServices services;
+    if (!services.start(softphone.get(), options)) {
+        return EXIT_FAILURE;
+    }
+
+    //SIGINT and SIGTERM hang up and unregister through the normal shutdown
+    std::signal(SIGINT, &onQuitSignal);
+    std::signal(SIGTERM, &onQuitSignal);
+    QTimer quitTimer;
+    QObject::connect(&quitTimer, &QTimer::timeout, &app, [&softphone]() {
+        if (quitRequested) {
+            qInfo() << "Quit requested";
+            softphone->hangupAll();
+            QCoreApplication::quit();
+        }
+    });
+    quitTimer.start(200);
+
+    QTimer::singleShot(0, []() {
+        StartupProfile::instance().milestone("eventLoop");
+    });
+    qInfo() << "*** Engine started ***";
+    const auto rc = QCoreApplication::exec();
+    services.finish(softphone.get(), options);
+    return rc;
+}
@@ -50,7 +50,7 @@ Page {
         model: softphone.callHistoryModel
         section {
             criteria: ViewSection.FullString
-            property: "callDate"
+            property: "callDay"
             delegate: Column {
                 width: parent.width
                 Label {
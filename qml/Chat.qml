@@ -33,7 +33,7 @@ Page {
         spacing: 0
         clip: true
         model: softphone.messagesModel
-        section.property: "dateRole"
+        section.property: "dayRole"
         section.criteria: ViewSection.FullString
         section.labelPositioning: ViewSection.InlineLabels
         section.delegate: Label {
@@ -85,6 +85,31 @@ Page {
         clip: true
     }
 
+    Column {
+        id: levelMeters
+        anchors {
+            top: callDurationLabel.bottom
+            topMargin: 5
+            horizontalCenter: parent.horizontalCenter
+        }
+        width: callDurationLabel.width / 2
+        spacing: 3
+        visible: softphone.confirmedCall
+        LevelMeter {
+            width: parent.width
+            level: softphone.microphoneLevel
+            peak: softphone.microphonePeak
+            toolTipText: qsTr("Microphone Level")
+        }
+        LevelMeter {
+            width: parent.width
+            level: softphone.speakersLevel
+            peak: softphone.speakersPeak
+            color: Theme.blueButtonColor
+            toolTipText: qsTr("Speakers Level")
+        }
+    }
+
     LabelToolTip {
         id: extLabel
 
@@ -198,6 +198,20 @@ Page {
                 editText: softphone.settings.recPath
                 onEditTextChanged: softphone.settings.recPath = editText
             }
+            Switch {
+                text: qsTr("Record Each Party On Its Own Channel")
+                checked: softphone.settings.stereoRecording
+                onCheckedChanged: softphone.settings.stereoRecording = checked
+            }
+            LabelSlider {
+                text: qsTr("Keep Last Seconds Of Each Call (0 = Off)")
+                width: callOutputSrc.width
+                from: 0
+                to: 120
+                stepSize: 10
+                value: softphone.settings.flightRecorderSeconds
+                onValueChanged: softphone.settings.flightRecorderSeconds = value
+            }
             CustomTableView {
                 codecsModel: softphone.audioCodecs
                 text: qsTr("Audio Codecs Priority")
@@ -208,6 +222,34 @@ Page {
                 text: qsTr("Restore Default Audio Codec Priorities")
                 onClicked: softphone.audioCodecs.restoreAudioCodecDefaultPriorities()
             }
+            LabelComboBox {
+                width: callOutputSrc.width
+                text: qsTr("Media Profile (Applied On Restart)")
+                model: ["Default", "Low Latency", "Low CPU"]
+                textRole: ""
+                currentIndex: softphone.settings.mediaProfile
+                onCurrentIndexChanged: softphone.settings.mediaProfile = currentIndex
+            }
+            LabelComboBox {
+                width: callOutputSrc.width
+                text: qsTr("Media Thread Scheduling (Applied On Restart)")
+                model: ["Default", "Real-Time FIFO", "Real-Time Round Robin"]
+                textRole: ""
+                currentIndex: softphone.settings.threadScheduling
+                onCurrentIndexChanged: softphone.settings.threadScheduling = currentIndex
+            }
+            LabelTextField {
+                text: qsTr("Audio Thread CPUs (Applied On Restart)")
+                width: callOutputSrc.width
+                editText: softphone.settings.audioThreadCpus
+                onEditingFinished: softphone.settings.audioThreadCpus = editText
+            }
+            LabelTextField {
+                text: qsTr("SIP And Network Thread CPUs (Applied On Restart)")
+                width: callOutputSrc.width
+                editText: softphone.settings.workerThreadCpus
+                onEditingFinished: softphone.settings.workerThreadCpus = editText
+            }
             // video settings
             LabelComboBox {
                 id: videoDevs
@@ -239,6 +281,24 @@ Page {
                 checked: softphone.settings.allowContactAndViaRewrite
                 onCheckedChanged: softphone.settings.allowContactAndViaRewrite = checked
             }
+            // diagnostics
+            Switch {
+                text: qsTr("Capture SIP Packets")
+                checked: softphone.settings.packetCapture
+                onCheckedChanged: softphone.settings.packetCapture = checked
+            }
+            Switch {
+                visible: softphone.settings.packetCapture
+                text: qsTr("Capture RTP Headers")
+                checked: softphone.settings.captureRtp
+                onCheckedChanged: softphone.settings.captureRtp = checked
+            }
+            LabelTextField {
+                text: qsTr("Network Impairment")
+                width: callOutputSrc.width
+                editText: softphone.settings.networkImpairment
+                onEditingFinished: softphone.settings.networkImpairment = editText
+            }
             Item {
                 height: Theme.windowMargin / 2
                 width: parent.width
@@ -132,8 +132,7 @@ Item {
         toolTip: qsTr("New Chat")
         onClicked: {
             //show contacts
-            bar.currentButtonIndex = 3
-            tabView.replace("qrc:/qml/Contacts.qml")
+            bar.showPage(bar.contactsIndex, bar.chatIndex)
             softphone.dialpadStatus = Softphone.NEW_CHAT
         }
     }
@@ -0,0 +1,48 @@
+import QtQuick
+import QtQuick.Controls
+import ".."
+
+//RMS bar with a peak tick on a -60 to 0 dBFS scale, levels are linear in [0, 1]
+Item {
+    id: control
+
+    property real level: 0
+    property real peak: 0
+    property color color: Theme.greenButtonColor
+    property string toolTipText: ""
+
+    function toScale(value) {
+        if (0.001 >= value) {
+            return 0
+        }
+        return Math.min(1, 1 + 20 * Math.log10(value) / 60)
+    }
+
+    implicitHeight: 4
+    Rectangle {
+        anchors.fill: parent
+        color: Theme.sepColor
+        opacity: 0.3
+        radius: height / 2
+    }
+    Rectangle {
+        height: parent.height
+        width: parent.width * control.toScale(control.level)
+        color: control.color
+        radius: height / 2
+    }
+    Rectangle {
+        x: Math.max(0, parent.width * control.toScale(control.peak) - width)
+        width: 2
+        height: parent.height
+        //clipping
+        color: (0.999 <= control.peak) ? Theme.errorColor : control.color
+    }
+    HoverHandler {
+        id: meterHover
+    }
+    ToolTip {
+        visible: meterHover.hovered && ("" !== control.toolTipText)
+        text: control.toolTipText
+    }
+}
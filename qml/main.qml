@@ -1,5 +1,6 @@
 import QtQuick
 import QtQuick.Controls
+import QtQuick.Layouts
 import QtQuick.Window
 import QtMultimedia
 import Qt.labs.platform
@@ -47,6 +48,12 @@ ApplicationWindow {
         appWin.showMinimized()
     }
 
+    Shortcut {
+        sequence: "Ctrl+Shift+D"
+        enabled: softphone.activeCall && (0 < softphone.settings.flightRecorderSeconds)
+        onActivated: softphone.dumpFlightRecorder()
+    }
+
     Timer {
         id: callDurationTimer
 
@@ -124,28 +131,54 @@ ApplicationWindow {
         color: Theme.backgroundColor
     }
 
-    ActiveCalls {
+    //only needed with several calls
+    Loader {
         id: activeCallDrawer
-        width: 0.75 * appWin.width
-        height: appWin.height - bar.height - Theme.windowMargin
+        active: 1 < softphone.activeCallModel.callCount
+        sourceComponent: ActiveCalls {
+            width: 0.75 * appWin.width
+            height: appWin.height - bar.height - Theme.windowMargin
+        }
     }
     CustomIconButton {
-        visible: 1 < softphone.activeCallModel.callCount
+        visible: null !== activeCallDrawer.item
         source: "qrc:/img/open-drawer.svg"
         toolTip: qsTr("Show Active Call(s)")
-        onClicked: activeCallDrawer.open()
-        width: activeCallDrawer.dragMargin
-        height: activeCallDrawer.height
+        onClicked: activeCallDrawer.item.open()
+        width: (null !== activeCallDrawer.item) ? activeCallDrawer.item.dragMargin : 0
+        height: appWin.height - bar.height - Theme.windowMargin
     }
 
-    StackView {
+    //each page is created the first time it is shown and kept afterwards
+    StackLayout {
         id: tabView
         anchors {
             top: parent.top
             bottom: bar.top
         }
         width: parent.width
-        initialItem: "qrc:/qml/Dialpad.qml"
+        currentIndex: bar.currentPageIndex
+
+        Repeater {
+            id: pageLoaders
+            model: bar.pages
+            Loader {
+                function load() {
+                    if (!active) {
+                        softphone.beginPageLoad()
+                        active = true
+                        softphone.endPageLoad(modelData)
+                    }
+                }
+                active: false
+                source: modelData
+                Component.onCompleted: {
+                    if (bar.currentPageIndex === index) {
+                        load()
+                    }
+                }
+            }
+        }
     }
 
     Connections {
@@ -163,7 +196,7 @@ ApplicationWindow {
             const isAccept = (1 === callCount) || isConf
             const leftText = isAccept ? qsTr("Accept") : qsTr("Hold & Accept")
             const leftAction = isAccept ? softphone.answer : softphone.holdAndAnswer
-            const comp = Qt.createComponent("qrc:/qml/dialog/IncomingCallDialog.qml")
+            const comp = Qt.createComponent("dialog/IncomingCallDialog.qml")
             const dlg = comp.createObject(appWin, {
                                               "callId": callId,
                                               "text": dlgText,
@@ -204,7 +237,7 @@ ApplicationWindow {
         }
 
         active: "" !== softphone.dialogMessage
-        source: "qrc:/qml/dialog/MessageDialog.qml"
+        source: "dialog/MessageDialog.qml"
     }
     Loader {
         id: editContactDlg
@@ -214,26 +247,34 @@ ApplicationWindow {
             editContactDlg.item.visible = true
         }
         active: false
-        source: "qrc:/qml/dialog/EditContactDialog.qml"
+        source: "dialog/EditContactDialog.qml"
     }
 
     TabBar {
         id: bar
 
         property int currentButtonIndex: 2
+        property int currentPageIndex: 2
         readonly property var names: [qsTr("Recents"), qsTr("Contacts"), qsTr("Keypad"), qsTr("Chat"), qsTr("Settings")]
         readonly property var icons: ["qrc:/img/clock.svg", "qrc:/img/address-book.svg", "qrc:/img/dialpad.svg", "qrc:/img/chat.svg", "qrc:/img/settings.svg"]
-        readonly property var pages: ["qrc:/qml/CallHistory.qml", "qrc:/qml/Contacts.qml", "qrc:/qml/Dialpad.qml", "qrc:/qml/Chat.qml", "qrc:/qml/Settings.qml"]
+        readonly property var pages: ["CallHistory.qml", "Contacts.qml", "Dialpad.qml", "Chat.qml", "Settings.qml"]
 
+        readonly property int contactsIndex: 1
         readonly property int dialpadIndex: 2
         readonly property int chatIndex: 3
         readonly property int settingsIndex: 4
 
         function showTab(idx) {
-            if (idx !== bar.currentButtonIndex) {
-                bar.currentButtonIndex = idx
-                tabView.replace(bar.pages[idx])
+            bar.showPage(idx, idx)
+        }
+        //the page can differ from the selected button, e.g. the contacts for a new chat
+        function showPage(pageIdx, buttonIdx) {
+            bar.currentButtonIndex = buttonIdx
+            const loader = pageLoaders.itemAt(pageIdx)
+            if (null !== loader) {
+                loader.load()
             }
+            bar.currentPageIndex = pageIdx
         }
 
         onCurrentButtonIndexChanged: bar.currentIndex = bar.currentButtonIndex
@@ -308,6 +349,6 @@ ApplicationWindow {
     Loader {
         id: busyDlg
         active: softphone.showBusy
-        source: "qrc:/qml/dialog/BusyDialog.qml"
+        source: "dialog/BusyDialog.qml"
     }
 }
@@ -0,0 +1,246 @@
+#include "audio_kernels.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AUDIO_KERNELS_SSE2
+#if defined(__AVX2__) || defined(__GNUC__)
+#include <immintrin.h>
+#define AUDIO_KERNELS_AVX2
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define AUDIO_KERNELS_NEON
+#endif
+
+namespace {
+inline int16_t saturate(int32_t value)
+{
+    return static_cast<int16_t>(std::clamp<int32_t>(value, INT16_MIN, INT16_MAX));
+}
+
+using AudioKernels::GAIN_SHIFT;
+using AudioKernels::Level;
+
+constexpr int32_t GAIN_ROUNDING = 1 << (GAIN_SHIFT - 1);
+
+//gain, clip and measure the samples left over by the vector loops
+void applyGainScalar(int16_t *samples, size_t count, int32_t gain, Level &level)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const auto value = saturate((samples[i] * gain + GAIN_ROUNDING) >> GAIN_SHIFT);
+        samples[i] = value;
+        const int32_t magnitude = std::min<int32_t>(std::abs(static_cast<int32_t>(value)), INT16_MAX);
+        level.peak = std::max(level.peak, magnitude);
+        level.sumSquares += static_cast<uint64_t>(magnitude * magnitude);
+    }
+}
+
+#if defined(AUDIO_KERNELS_SSE2)
+size_t applyGainSse2(int16_t *samples, size_t count, int32_t gain, Level &level)
+{
+    const auto factor = _mm_set1_epi16(static_cast<int16_t>(gain));
+    const auto rounding = _mm_set1_epi32(GAIN_ROUNDING);
+    const auto zero = _mm_setzero_si128();
+    auto peak = zero;
+    auto sum = zero;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto *ptr = reinterpret_cast<__m128i*>(samples + i);
+        const auto in = _mm_loadu_si128(ptr);
+        //32-bit products from the low and high halves
+        const auto productLow = _mm_mullo_epi16(in, factor);
+        const auto productHigh = _mm_mulhi_epi16(in, factor);
+        const auto low = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(productLow, productHigh), rounding), GAIN_SHIFT);
+        const auto high = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(productLow, productHigh), rounding), GAIN_SHIFT);
+        const auto out = _mm_packs_epi32(low, high);
+        _mm_storeu_si128(ptr, out);
+        //saturating negation keeps the magnitude below 2^15, a pair of squares fits in int32
+        const auto magnitude = _mm_max_epi16(out, _mm_subs_epi16(zero, out));
+        peak = _mm_max_epi16(peak, magnitude);
+        const auto squares = _mm_madd_epi16(magnitude, magnitude);
+        sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(squares, zero));
+        sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(squares, zero));
+    }
+    alignas(16) int16_t peaks[8];
+    alignas(16) uint64_t sums[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(peaks), peak);
+    _mm_store_si128(reinterpret_cast<__m128i*>(sums), sum);
+    level.peak = std::max<int32_t>(level.peak, *std::max_element(peaks, peaks + 8));
+    level.sumSquares += sums[0] + sums[1];
+    return i;
+}
+#endif
+
+#if defined(AUDIO_KERNELS_AVX2)
+#if defined(__AVX2__)
+#define AUDIO_KERNELS_AVX2_TARGET
+bool hasAvx2()
+{
+    return true;
+}
+#else
+//compiled for AVX2 regardless of the build flags, only called when the CPU has it
+#define AUDIO_KERNELS_AVX2_TARGET __attribute__((target("avx2")))
+bool hasAvx2()
+{
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+AUDIO_KERNELS_AVX2_TARGET
+size_t applyGainAvx2(int16_t *samples, size_t count, int32_t gain, Level &level)
+{
+    const auto factor = _mm256_set1_epi16(static_cast<int16_t>(gain));
+    const auto rounding = _mm256_set1_epi32(GAIN_ROUNDING);
+    const auto zero = _mm256_setzero_si256();
+    auto peak = zero;
+    auto sum = zero;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        auto *ptr = reinterpret_cast<__m256i*>(samples + i);
+        const auto in = _mm256_loadu_si256(ptr);
+        //unpack and pack work within 128-bit lanes, the sample order is kept
+        const auto productLow = _mm256_mullo_epi16(in, factor);
+        const auto productHigh = _mm256_mulhi_epi16(in, factor);
+        const auto low = _mm256_srai_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(productLow, productHigh), rounding),
+                                           GAIN_SHIFT);
+        const auto high = _mm256_srai_epi32(_mm256_add_epi32(_mm256_unpackhi_epi16(productLow, productHigh), rounding),
+                                            GAIN_SHIFT);
+        const auto out = _mm256_packs_epi32(low, high);
+        _mm256_storeu_si256(ptr, out);
+        const auto magnitude = _mm256_max_epi16(out, _mm256_subs_epi16(zero, out));
+        peak = _mm256_max_epi16(peak, magnitude);
+        const auto squares = _mm256_madd_epi16(magnitude, magnitude);
+        sum = _mm256_add_epi64(sum, _mm256_unpacklo_epi32(squares, zero));
+        sum = _mm256_add_epi64(sum, _mm256_unpackhi_epi32(squares, zero));
+    }
+    alignas(32) int16_t peaks[16];
+    alignas(32) uint64_t sums[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(peaks), peak);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(sums), sum);
+    level.peak = std::max<int32_t>(level.peak, *std::max_element(peaks, peaks + 16));
+    level.sumSquares += sums[0] + sums[1] + sums[2] + sums[3];
+    return i;
+}
+#endif
+
+#if defined(AUDIO_KERNELS_NEON)
+size_t applyGainNeon(int16_t *samples, size_t count, int32_t gain, Level &level)
+{
+    const auto factor = vdup_n_s16(static_cast<int16_t>(gain));
+    auto peak = vdupq_n_s16(0);
+    auto sum = vdupq_n_u64(0);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const auto in = vld1q_s16(samples + i);
+        //rounding, saturating narrow of the 32-bit products
+        const auto low = vqrshrn_n_s32(vmull_s16(vget_low_s16(in), factor), GAIN_SHIFT);
+        const auto high = vqrshrn_n_s32(vmull_s16(vget_high_s16(in), factor), GAIN_SHIFT);
+        const auto out = vcombine_s16(low, high);
+        vst1q_s16(samples + i, out);
+        const auto magnitude = vqabsq_s16(out);
+        peak = vmaxq_s16(peak, magnitude);
+        const auto magnitudeLow = vget_low_s16(magnitude);
+        const auto magnitudeHigh = vget_high_s16(magnitude);
+        sum = vpadalq_u32(sum, vreinterpretq_u32_s32(vmull_s16(magnitudeLow, magnitudeLow)));
+        sum = vpadalq_u32(sum, vreinterpretq_u32_s32(vmull_s16(magnitudeHigh, magnitudeHigh)));
+    }
+    int16_t peaks[8];
+    vst1q_s16(peaks, peak);
+    level.peak = std::max<int32_t>(level.peak, *std::max_element(peaks, peaks + 8));
+    level.sumSquares += vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1);
+    return i;
+}
+#endif
+}
+
+namespace AudioKernels {
+
+void accumulate(int32_t *acc, const int16_t *in, size_t count)
+{
+    size_t i = 0;
+#if defined(AUDIO_KERNELS_SSE2)
+    for (; i + 8 <= count; i += 8) {
+        const auto samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        //sign extend by unpacking into the high half and shifting back
+        const auto low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+        const auto high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+        auto *dst = reinterpret_cast<__m128i*>(acc + i);
+        _mm_storeu_si128(dst, _mm_add_epi32(_mm_loadu_si128(dst), low));
+        _mm_storeu_si128(dst + 1, _mm_add_epi32(_mm_loadu_si128(dst + 1), high));
+    }
+#elif defined(AUDIO_KERNELS_NEON)
+    for (; i + 8 <= count; i += 8) {
+        const auto samples = vld1q_s16(in + i);
+        vst1q_s32(acc + i, vaddw_s16(vld1q_s32(acc + i), vget_low_s16(samples)));
+        vst1q_s32(acc + i + 4, vaddw_s16(vld1q_s32(acc + i + 4), vget_high_s16(samples)));
+    }
+#endif
+    for (; i < count; ++i) {
+        acc[i] += in[i];
+    }
+}
+
+void mixMinus(int16_t *out, const int32_t *acc, const int16_t *own, size_t count)
+{
+    size_t i = 0;
+#if defined(AUDIO_KERNELS_SSE2)
+    const auto zero = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+        auto low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+        auto high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i + 4));
+        if (nullptr != own) {
+            const auto samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(own + i));
+            low = _mm_sub_epi32(low, _mm_srai_epi32(_mm_unpacklo_epi16(zero, samples), 16));
+            high = _mm_sub_epi32(high, _mm_srai_epi32(_mm_unpackhi_epi16(zero, samples), 16));
+        }
+        //packs saturates to int16
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(low, high));
+    }
+#elif defined(AUDIO_KERNELS_NEON)
+    for (; i + 8 <= count; i += 8) {
+        auto low = vld1q_s32(acc + i);
+        auto high = vld1q_s32(acc + i + 4);
+        if (nullptr != own) {
+            const auto samples = vld1q_s16(own + i);
+            low = vsubw_s16(low, vget_low_s16(samples));
+            high = vsubw_s16(high, vget_high_s16(samples));
+        }
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = saturate(acc[i] - ((nullptr != own) ? own[i] : 0));
+    }
+}
+
+Level applyGain(int16_t *samples, size_t count, int32_t gain)
+{
+    Level level;
+    size_t i = 0;
+#if defined(AUDIO_KERNELS_AVX2)
+    static const bool avx2 = hasAvx2();
+    if (avx2) {
+        i = applyGainAvx2(samples, count, gain, level);
+    }
+#endif
+#if defined(AUDIO_KERNELS_SSE2)
+    i += applyGainSse2(samples + i, count - i, gain, level);
+#elif defined(AUDIO_KERNELS_NEON)
+    i = applyGainNeon(samples, count, gain, level);
+#endif
+    applyGainScalar(samples + i, count - i, gain, level);
+    return level;
+}
+
+int32_t fixedGain(float gain)
+{
+    if (!(0 < gain)) {
+        return 0;
+    }
+    return static_cast<int32_t>(std::min(std::lround(gain * GAIN_UNITY), static_cast<long>(INT16_MAX)));
+}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Sample loops run by the media thread for every frame.
+ * SSE2 on x86-64 (AVX2 when the CPU has it), NEON on ARM64, plain C++ elsewhere.
+ */
+namespace AudioKernels {
+
+//Q12 fixed point gain, the maximum gain is just below 8
+constexpr int GAIN_SHIFT = 12;
+constexpr int32_t GAIN_UNITY = 1 << GAIN_SHIFT;
+
+struct Level {
+    int32_t peak = 0;//absolute value, -32768 counts as 32767
+    uint64_t sumSquares = 0;
+};
+
+//acc[i] += in[i]
+void accumulate(int32_t *acc, const int16_t *in, size_t count);
+//out[i] = saturate(acc[i] - own[i]), own may be null
+void mixMinus(int16_t *out, const int32_t *acc, const int16_t *own, size_t count);
+//samples[i] = saturate(round(samples[i] * gain / GAIN_UNITY)), gain in [0, INT16_MAX]
+//returns the level after the gain, clipped samples included
+Level applyGain(int16_t *samples, size_t count, int32_t gain);
+//float gain to Q12, clamped to the supported range
+int32_t fixedGain(float gain);
+
+}
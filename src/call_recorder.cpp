@@ -0,0 +1,266 @@
+#include "call_recorder.h"
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <opus/opus.h>
+
+pj_status_t CallRecorder::create(const QString &filePath, bool splitChannels)
+{
+    if (nullptr != _pool) {
+        return PJ_EEXISTS;
+    }
+
+    //record with the bridge format, no resampling
+    pjsua_conf_port_info bridgeInfo{};
+    auto status = pjsua_conf_get_port_info(0, &bridgeInfo);
+    if (PJ_SUCCESS != status) {
+        return status;
+    }
+    _splitChannels = splitChannels;
+    _clockRate = bridgeInfo.clock_rate;
+    _samplesPerFrame = bridgeInfo.samples_per_frame;
+    //each direction is mono in split mode
+    const auto portChannels = _splitChannels ? 1U : bridgeInfo.channel_count;
+    _channelCount = _splitChannels ? 2U : bridgeInfo.channel_count;
+    if (!isSupportedClockRate(_clockRate) || (1 > _channelCount) || (2 < _channelCount) ||
+            (_splitChannels && (1 != bridgeInfo.channel_count))) {
+        qCritical() << "Unsupported recording format" << _clockRate << "Hz," << bridgeInfo.channel_count << "channel(s)";
+        return PJMEDIA_EBADFMT;
+    }
+
+    int error = OPUS_OK;
+    _encoder = opus_encoder_create(static_cast<opus_int32>(_clockRate), static_cast<int>(_channelCount),
+                                   OPUS_APPLICATION_VOIP, &error);
+    if (OPUS_OK != error) {
+        qCritical() << "Cannot create Opus encoder" << opus_strerror(error);
+        _encoder = nullptr;
+        return PJMEDIA_CODEC_EFAILED;
+    }
+    opus_encoder_ctl(_encoder, OPUS_SET_BITRATE(BITRATE_BPS * static_cast<int>(_channelCount)));
+    opus_encoder_ctl(_encoder, OPUS_SET_COMPLEXITY(ENCODER_COMPLEXITY));
+    opus_encoder_ctl(_encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+    if (_splitChannels) {
+        //the channels are unrelated talkers, do not let the encoder merge them
+        opus_encoder_ctl(_encoder, OPUS_SET_FORCE_CHANNELS(2));
+    }
+    opus_int32 lookahead = 0;
+    opus_encoder_ctl(_encoder, OPUS_GET_LOOKAHEAD(&lookahead));
+    if (!_writer.open(filePath, _clockRate, _channelCount,
+                      static_cast<int>(lookahead * 48000 / static_cast<opus_int32>(_clockRate)))) {
+        release();
+        return PJ_EINVAL;
+    }
+
+    _pool = pjsua_pool_create("recorder", POOL_SIZE, POOL_SIZE);
+    if (nullptr == _pool) {
+        release();
+        return PJ_ENOMEM;
+    }
+
+    //everything the media thread touches is allocated before the ports join the bridge
+    const int portCount = _splitChannels ? CHANNEL_COUNT : 1;
+    _frameSize = _clockRate * ENCODER_FRAME_MS / 1000 * portChannels;
+    for (int ch = 0; ch < portCount; ++ch) {
+        _ring[ch] = std::make_unique<Ring>(_clockRate * RING_DURATION_MS / 1000 * portChannels);
+        _firstTimestamp[ch] = NO_TIMESTAMP;
+        _channelInput[ch].resize(_frameSize);
+    }
+    _silence.assign(_samplesPerFrame, 0);
+    _encoderInput.resize(_frameSize * static_cast<size_t>(portCount));
+    _packet.resize(MAX_PACKET_SIZE);
+    _aligned = !_splitChannels;
+    _stopping = false;
+    _encoderThread = std::thread(&CallRecorder::encodeLoop, this);
+
+    for (int ch = 0; ch < portCount; ++ch) {
+        status = addPort(static_cast<Channel>(ch), portChannels);
+        if (PJ_SUCCESS != status) {
+            release();
+            return status;
+        }
+    }
+    qDebug() << "Created recorder" << filePath << _clockRate << "Hz," << _channelCount << "channel(s)"
+             << (_splitChannels ? "split" : "mixed");
+    return PJ_SUCCESS;
+}
+
+void CallRecorder::release()
+{
+    for (auto &confPort: _confPort) {
+        if (PJSUA_INVALID_ID != confPort) {
+            pjsua_conf_remove_port(confPort);
+            confPort = PJSUA_INVALID_ID;
+        }
+    }
+    if (_encoderThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _wakeUp.notify_one();
+        _encoderThread.join();
+    }
+    if (nullptr != _encoder) {
+        opus_encoder_destroy(_encoder);
+        _encoder = nullptr;
+    }
+    _writer.close();
+    for (auto &ring: _ring) {
+        if (ring && (0 < ring->dropped())) {
+            qWarning() << "Recorder dropped" << ring->dropped() << "samples";
+        }
+        ring.reset();
+    }
+    if (nullptr != _pool) {
+        pj_pool_release(_pool);
+        _pool = nullptr;
+    }
+    _port.fill(nullptr);
+}
+
+bool CallRecorder::isSupportedClockRate(unsigned clockRate)
+{
+    switch (clockRate) {
+    case 8000:
+    case 12000:
+    case 16000:
+    case 24000:
+    case 48000:
+        return true;
+    default:
+        return false;
+    }
+}
+
+pj_status_t CallRecorder::addPort(Channel channel, unsigned channelCount)
+{
+    auto *port = PJ_POOL_ZALLOC_T(_pool, RecorderPort);
+    port->recorder = this;
+    port->channel = channel;
+    pj_str_t name = pj_str(const_cast<char*>(LOCAL == channel ? "recorder" : "recorderRemote"));
+    pjmedia_port_info_init(&port->base.info, &name, PJMEDIA_SIGNATURE('B', 'C', 'R', 'C'),
+                           _clockRate, channelCount, BITS_PER_SAMPLE, _samplesPerFrame);
+    port->base.put_frame = &CallRecorder::putFrame;
+    port->base.get_frame = &CallRecorder::getFrame;
+    _port[channel] = port;
+    return pjsua_conf_add_port(_pool, &port->base, &_confPort[channel]);
+}
+
+pj_status_t CallRecorder::putFrame(pjmedia_port *port, pjmedia_frame *frame)
+{
+    //runs on the media thread: copy only, never block
+    const auto *recPort = reinterpret_cast<RecorderPort*>(port);
+    auto *recorder = recPort->recorder;
+    auto &firstTimestamp = recorder->_firstTimestamp[recPort->channel];
+    if (NO_TIMESTAMP == firstTimestamp.load(std::memory_order_relaxed)) {
+        //published to the encoder by the release store of the push below
+        firstTimestamp.store(static_cast<qint64>(frame->timestamp.u64), std::memory_order_relaxed);
+    }
+    auto &ring = *recorder->_ring[recPort->channel];
+    if ((PJMEDIA_FRAME_TYPE_AUDIO == frame->type) && (0 < frame->size)) {
+        ring.push(static_cast<const pj_int16_t*>(frame->buf), frame->size / sizeof(pj_int16_t));
+    } else {
+        //keep the recording timeline continuous
+        ring.push(recorder->_silence.data(), recorder->_silence.size());
+    }
+    return PJ_SUCCESS;
+}
+
+pj_status_t CallRecorder::getFrame(pjmedia_port *port, pjmedia_frame *frame)
+{
+    Q_UNUSED(port)
+    frame->type = PJMEDIA_FRAME_TYPE_NONE;
+    frame->size = 0;
+    return PJ_SUCCESS;
+}
+
+void CallRecorder::encodeLoop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stopping) {
+        lock.unlock();
+        while (encodeAvailable(false)) {}
+        lock.lock();
+        //wake up every few frames, the rings absorb the difference
+        _wakeUp.wait_for(lock, std::chrono::milliseconds(5 * ENCODER_FRAME_MS),
+                         [this] { return _stopping; });
+    }
+    lock.unlock();
+    while (encodeAvailable(true)) {}
+}
+
+bool CallRecorder::alignChannels()
+{
+    //the ports are connected one after the other, possibly in different bridge ticks
+    auto &local = *_ring[LOCAL];
+    auto &remote = *_ring[REMOTE];
+    if ((0 == local.available()) || (0 == remote.available())) {
+        return false;
+    }
+    const auto localStart = _firstTimestamp[LOCAL].load(std::memory_order_relaxed);
+    const auto remoteStart = _firstTimestamp[REMOTE].load(std::memory_order_relaxed);
+    auto &earlier = (localStart < remoteStart) ? local : remote;
+    auto skip = static_cast<size_t>(std::abs(localStart - remoteStart));
+    auto &scratch = _channelInput[LOCAL];
+    while (0 < skip) {
+        const auto count = earlier.pop(scratch.data(), std::min(skip, scratch.size()));
+        if (0 == count) {
+            break;
+        }
+        skip -= count;
+    }
+    qDebug() << "Recorder channels aligned, skipped" << std::abs(localStart - remoteStart) << "samples";
+    return true;
+}
+
+bool CallRecorder::encodeAvailable(bool drain)
+{
+    //the last partial frame is padded with silence when draining
+    if (!_splitChannels) {
+        const auto available = _ring[LOCAL]->available();
+        if ((0 == available) || (!drain && (_frameSize > available))) {
+            return false;
+        }
+        const auto count = _ring[LOCAL]->pop(_encoderInput.data(), _frameSize);
+        std::fill(_encoderInput.begin() + static_cast<std::ptrdiff_t>(count), _encoderInput.end(), 0);
+        encodeFrame(_encoderInput.data());
+        return true;
+    }
+
+    if (!_aligned) {
+        _aligned = alignChannels();
+        if (!_aligned) {
+            return false;
+        }
+    }
+    const auto available = std::min(_ring[LOCAL]->available(), _ring[REMOTE]->available());
+    if ((0 == available) || (!drain && (_frameSize > available))) {
+        return false;
+    }
+    for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
+        auto &input = _channelInput[ch];
+        const auto count = _ring[ch]->pop(input.data(), std::min(available, _frameSize));
+        std::fill(input.begin() + static_cast<std::ptrdiff_t>(count), input.end(), 0);
+    }
+    const auto *local = _channelInput[LOCAL].data();
+    const auto *remote = _channelInput[REMOTE].data();
+    for (size_t i = 0; i < _frameSize; ++i) {
+        _encoderInput[2 * i] = local[i];
+        _encoderInput[2 * i + 1] = remote[i];
+    }
+    encodeFrame(_encoderInput.data());
+    return true;
+}
+
+void CallRecorder::encodeFrame(const pj_int16_t *samples)
+{
+    const int frameSize = static_cast<int>(_encoderInput.size() / _channelCount);
+    const auto size = opus_encode(_encoder, samples, frameSize,
+                                  _packet.data(), static_cast<opus_int32>(_packet.size()));
+    if (0 > size) {
+        qWarning() << "Cannot encode recorder frame" << opus_strerror(size);
+        return;
+    }
+    _writer.writePacket(_packet.data(), size, frameSize);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "pjsua.h"
+#include "ogg_opus_writer.h"
+#include "spsc_ring_buffer.h"
+#include <QString>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct OpusEncoder;
+
+/**
+ * Records a call into an Ogg Opus file.
+ * The conference bridge hands the frames to custom ports which only copy
+ * them into lock-free rings, encoding and disk I/O run on a separate thread
+ * so the media clock never waits on the file system.
+ * In split mode the local microphone and the remote party are tapped by two
+ * ports before any mixing and stored as the left and right channels.
+ */
+class CallRecorder
+{
+public:
+    enum Channel { LOCAL = 0, REMOTE = 1, CHANNEL_COUNT };
+
+    CallRecorder() = default;
+    ~CallRecorder() {
+        release();
+    }
+
+    pj_status_t create(const QString &filePath, bool splitChannels);
+    bool splitChannels() const { return _splitChannels; }
+    //in mixed mode only the LOCAL port exists
+    pjsua_conf_port_id confPort(Channel channel = LOCAL) const { return _confPort[channel]; }
+    void release();
+
+    static bool isSupportedClockRate(unsigned clockRate);
+
+private:
+    Q_DISABLE_COPY_MOVE(CallRecorder)
+
+    enum { POOL_SIZE = 1024, BITS_PER_SAMPLE = 16, RING_DURATION_MS = 2000,
+           ENCODER_FRAME_MS = 20, BITRATE_BPS = 24000, ENCODER_COMPLEXITY = 5,
+           MAX_PACKET_SIZE = 1500 };
+    enum { NO_TIMESTAMP = -1 };
+
+    using Ring = SpscRingBuffer<pj_int16_t>;
+
+    struct RecorderPort {
+        pjmedia_port base;
+        CallRecorder *recorder;
+        int channel;
+    };
+
+    pj_status_t addPort(Channel channel, unsigned channelCount);
+    static pj_status_t putFrame(pjmedia_port *port, pjmedia_frame *frame);
+    static pj_status_t getFrame(pjmedia_port *port, pjmedia_frame *frame);
+    void encodeLoop();
+    bool alignChannels();
+    bool encodeAvailable(bool drain);
+    void encodeFrame(const pj_int16_t *samples);
+
+    bool _splitChannels = false;
+    unsigned _clockRate = 0;
+    unsigned _channelCount = 0;//encoded channels
+    unsigned _samplesPerFrame = 0;//bridge frame, all channels of one port
+    pj_pool_t *_pool = nullptr;
+    std::array<RecorderPort*, CHANNEL_COUNT> _port{};
+    std::array<pjsua_conf_port_id, CHANNEL_COUNT> _confPort{ PJSUA_INVALID_ID, PJSUA_INVALID_ID };
+
+    //shared with the media thread
+    std::array<std::unique_ptr<Ring>, CHANNEL_COUNT> _ring;
+    std::array<std::atomic<qint64>, CHANNEL_COUNT> _firstTimestamp{};
+    std::vector<pj_int16_t> _silence;//pushed when the bridge has no audio for us
+
+    //owned by the encoder thread
+    OpusEncoder *_encoder = nullptr;
+    OggOpusWriter _writer;
+    bool _aligned = false;
+    size_t _frameSize = 0;//samples popped from each ring per encoded frame
+    std::array<std::vector<pj_int16_t>, CHANNEL_COUNT> _channelInput;
+    std::vector<pj_int16_t> _encoderInput;//interleaved
+    std::vector<unsigned char> _packet;
+
+    std::thread _encoderThread;
+    std::mutex _mutex;
+    std::condition_variable _wakeUp;
+    bool _stopping = false;
+};
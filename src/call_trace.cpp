@@ -0,0 +1,233 @@
+#include "call_trace.h"
+#include "monotonic_clock.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDebug>
+#include <algorithm>
+
+CallTracer& CallTracer::instance()
+{
+    static CallTracer tracer;
+    return tracer;
+}
+
+CallTracer::CallTracer() : _originNs(monotonicNs())
+{
+}
+
+void CallTracer::beginSetup()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _setupEvents.clear();
+}
+
+void CallTracer::addSetupSpan(const char *name, qint64 beginNs)
+{
+    const auto endNs = monotonicNs();
+    std::lock_guard<std::mutex> lock(_mutex);
+    _setupEvents.push_back({ name, beginNs, endNs - beginNs });
+}
+
+void CallTracer::attachSetup(pjsua_call_id callId)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &events = trace(callId).events;
+    //the messages sent from pjsua_call_make_call may already be there
+    events.insert(events.begin(), _setupEvents.begin(), _setupEvents.end());
+    _setupEvents.clear();
+}
+
+void CallTracer::addSpan(pjsua_call_id callId, const char *name, qint64 beginNs)
+{
+    const auto endNs = monotonicNs();
+    std::lock_guard<std::mutex> lock(_mutex);
+    trace(callId).events.push_back({ name, beginNs, endNs - beginNs });
+}
+
+void CallTracer::addInstant(pjsua_call_id callId, const char *name)
+{
+    const auto timeNs = monotonicNs();
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &callTrace = trace(callId);
+    callTrace.events.push_back({ name, timeNs });
+    if ((0 == callTrace.mediaNs) && (0 == qstrcmp("media active", name))) {
+        callTrace.mediaNs = timeNs;
+    }
+}
+
+void CallTracer::addMessage(pjsua_call_id callId, bool received, const pjsip_msg *msg)
+{
+    const auto timeNs = monotonicNs();
+    if (nullptr == msg) {
+        return;
+    }
+    QByteArray name(received ? "rx " : "tx ");
+    int statusCode = 0;
+    bool isInvite = false;
+    if (PJSIP_REQUEST_MSG == msg->type) {
+        name.append(msg->line.req.method.name.ptr, static_cast<int>(msg->line.req.method.name.slen));
+        isInvite = (PJSIP_INVITE_METHOD == msg->line.req.method.id);
+    } else {
+        statusCode = msg->line.status.code;
+        name.append(QByteArray::number(statusCode));
+        const auto *cseq = PJSIP_MSG_CSEQ_HDR(msg);
+        if (nullptr != cseq) {
+            name.append(' ').append(cseq->method.name.ptr, static_cast<int>(cseq->method.name.slen));
+            isInvite = (PJSIP_INVITE_METHOD == cseq->method.id);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &callTrace = trace(callId);
+    callTrace.events.push_back({ name, timeNs });
+    if (!isInvite) {
+        return;
+    }
+    if (0 == statusCode) {
+        if (0 == callTrace.inviteNs) {
+            //re-INVITEs come later
+            callTrace.inviteNs = timeNs;
+            callTrace.outgoing = !received;
+        }
+    } else if (received == callTrace.outgoing) {
+        //responses to the initial INVITE
+        if ((PJSIP_SC_TRYING == statusCode) && (0 == callTrace.tryingNs)) {
+            callTrace.tryingNs = timeNs;
+        } else if ((PJSIP_SC_RINGING <= statusCode) && (PJSIP_SC_OK > statusCode) && (0 == callTrace.ringingNs)) {
+            callTrace.ringingNs = timeNs;
+        } else if ((PJSIP_SC_OK <= statusCode) && (PJSIP_SC_MULTIPLE_CHOICES > statusCode) && (0 == callTrace.answerNs)) {
+            callTrace.answerNs = timeNs;
+        }
+    }
+}
+
+void CallTracer::finishCall(pjsua_call_id callId, int statusCode)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const auto it = _traces.find(callId);
+    if (it == _traces.end()) {
+        return;
+    }
+    auto callTrace = std::move(it->second);
+    _traces.erase(it);
+    callTrace.statusCode = statusCode;
+    callTrace.events.push_back({ "disconnected", monotonicNs() });
+
+    for (const auto &event: callTrace.events) {
+        if (0 <= event.durationNs) {
+            histogram(event.name).record(event.durationNs / 1000);
+        }
+    }
+    if (callTrace.outgoing) {
+        //the PBX side of the call setup
+        addSample("inviteToTrying", callTrace.inviteNs, callTrace.tryingNs);
+        addSample("inviteToRinging", callTrace.inviteNs, callTrace.ringingNs);
+        addSample("inviteToAnswer", callTrace.inviteNs, callTrace.answerNs);
+        addSample("answerToMedia", callTrace.answerNs, callTrace.mediaNs);
+        addSample("setupToMedia", callTrace.events.front().beginNs, callTrace.mediaNs);
+        if ((0 != callTrace.answerNs) && (0 != callTrace.mediaNs)) {
+            qInfo() << "Call" << callId << "setup: INVITE to 200" << (callTrace.answerNs - callTrace.inviteNs) / 1e6
+                    << "ms, 200 to media" << (callTrace.mediaNs - callTrace.answerNs) / 1e6 << "ms";
+        }
+    }
+
+    _finished.push_back(std::move(callTrace));
+    if (static_cast<size_t>(MAX_FINISHED_TRACES) < _finished.size()) {
+        _finished.pop_front();
+    }
+}
+
+bool CallTracer::writeChromeTrace(const QString &filePath) const
+{
+    const auto pid = static_cast<qint64>(QCoreApplication::applicationPid());
+    QJsonArray events;
+    events.append(QJsonObject{{"name", "process_name"}, {"ph", "M"}, {"pid", pid},
+                              {"args", QJsonObject{{"name", QCoreApplication::applicationName()}}}});
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const auto appendTrace = [this, pid, &events](const Trace &callTrace) {
+            const auto tid = static_cast<qint64>(callTrace.sequence);
+            const auto trackName = QString("call %1 %2%3").arg(callTrace.callId)
+                    .arg(callTrace.outgoing ? "out" : "in")
+                    .arg(0 != callTrace.statusCode ? QString(" (%1)").arg(callTrace.statusCode) : QString());
+            events.append(QJsonObject{{"name", "thread_name"}, {"ph", "M"}, {"pid", pid}, {"tid", tid},
+                                      {"args", QJsonObject{{"name", trackName}}}});
+            for (const auto &event: callTrace.events) {
+                //microseconds, the fraction keeps the nanoseconds
+                QJsonObject object{{"name", QString::fromLatin1(event.name)}, {"cat", "call"},
+                                   {"pid", pid}, {"tid", tid}, {"ts", (event.beginNs - _originNs) / 1000.0}};
+                if (0 <= event.durationNs) {
+                    object["ph"] = "X";
+                    object["dur"] = event.durationNs / 1000.0;
+                } else {
+                    object["ph"] = "i";
+                    object["s"] = "t";
+                }
+                events.append(object);
+            }
+        };
+        for (const auto &callTrace: _finished) {
+            appendTrace(callTrace);
+        }
+        for (const auto &callTrace: _traces) {
+            appendTrace(callTrace.second);
+        }
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Cannot write call trace" << filePath;
+        return false;
+    }
+    const QJsonObject root{{"traceEvents", events}, {"displayTimeUnit", "ns"}};
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    qInfo() << "Call trace written to" << filePath;
+    return true;
+}
+
+QVariantMap CallTracer::setupStats() const
+{
+    QVariantMap stats;
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto &[stage, histogram]: _histograms) {
+        stats[QString::fromLatin1(stage)] = QVariantMap{
+            {"count", histogram->count()},
+            {"p50Ms", histogram->percentile(50) * 1000},
+            {"p90Ms", histogram->percentile(90) * 1000},
+            {"p99Ms", histogram->percentile(99) * 1000},
+            {"maxMs", histogram->max() * 1000}
+        };
+    }
+    return stats;
+}
+
+CallTracer::Trace& CallTracer::trace(pjsua_call_id callId)
+{
+    auto &callTrace = _traces[callId];
+    if (0 == callTrace.sequence) {
+        callTrace.sequence = _nextSequence++;
+        callTrace.callId = callId;
+    }
+    return callTrace;
+}
+
+HdrHistogram& CallTracer::histogram(const QByteArray &stage)
+{
+    auto &histogram = _histograms[stage];
+    if (nullptr == histogram) {
+        histogram = &Metrics::instance().histogram("bcphone_call_setup_seconds",
+                                                   "Duration of the call setup stages",
+                                                   "stage=\"" + stage + '"');
+    }
+    return *histogram;
+}
+
+void CallTracer::addSample(const char *stage, qint64 fromNs, qint64 toNs)
+{
+    if ((0 != fromNs) && (0 != toNs) && (fromNs <= toNs)) {
+        histogram(stage).record((toNs - fromNs) / 1000);
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "pjsua.h"
+#include "metrics.h"
+#include <QByteArray>
+#include <QString>
+#include <QVariantMap>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Call setup tracing: spans of the local work (URI build, sound device open,
+ * ring tone, ...) and the times the SIP messages of each call were sent or
+ * received, on a monotonic nanosecond clock. The timestamps are taken on the
+ * thread that does the work, pjsua threads included, not when the GUI thread
+ * gets the queued event. Finished calls feed the bcphone_call_setup_seconds
+ * histograms of the spans and of the outgoing calls (INVITE to 100, 18x and
+ * 200, 200 to media); the last ones are kept for the export into Chrome
+ * trace-event JSON, viewable in Perfetto or chrome://tracing with one track
+ * per call.
+ */
+class CallTracer
+{
+public:
+    static CallTracer& instance();
+
+    //spans of a call made on this thread before its call ID is known
+    void beginSetup();
+    void addSetupSpan(const char *name, qint64 beginNs);
+    void attachSetup(pjsua_call_id callId);
+
+    void addSpan(pjsua_call_id callId, const char *name, qint64 beginNs);
+    void addInstant(pjsua_call_id callId, const char *name);
+    void addMessage(pjsua_call_id callId, bool received, const pjsip_msg *msg);
+    void finishCall(pjsua_call_id callId, int statusCode);
+
+    bool writeChromeTrace(const QString &filePath) const;
+    //count and percentiles in ms of each setup stage
+    QVariantMap setupStats() const;
+
+private:
+    CallTracer();
+    Q_DISABLE_COPY_MOVE(CallTracer)
+
+    enum { MAX_FINISHED_TRACES = 256 };
+
+    struct Event {
+        QByteArray name;
+        qint64 beginNs = 0;
+        qint64 durationNs = -1;//instant event
+    };
+    struct Trace {
+        quint64 sequence = 0;//call IDs are reused, the sequence names the track
+        pjsua_call_id callId = PJSUA_INVALID_ID;
+        bool outgoing = false;
+        int statusCode = 0;
+        std::vector<Event> events;
+        //first occurrence, 0 when missing
+        qint64 inviteNs = 0;
+        qint64 tryingNs = 0;
+        qint64 ringingNs = 0;
+        qint64 answerNs = 0;
+        qint64 mediaNs = 0;
+    };
+
+    Trace& trace(pjsua_call_id callId);
+    HdrHistogram& histogram(const QByteArray &stage);
+    void addSample(const char *stage, qint64 fromNs, qint64 toNs);
+
+    mutable std::mutex _mutex;
+    qint64 _originNs = 0;
+    quint64 _nextSequence = 1;
+    std::vector<Event> _setupEvents;
+    std::unordered_map<pjsua_call_id, Trace> _traces;
+    std::deque<Trace> _finished;
+    std::map<QByteArray, HdrHistogram*> _histograms;//owned by Metrics
+};
@@ -0,0 +1,149 @@
+#include "call_volume_port.h"
+#include "audio_kernels.h"
+#include "media_threads.h"
+#include <QElapsedTimer>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+void CallVolume::clearLevels()
+{
+    microphonePeak.store(0, std::memory_order_relaxed);
+    microphoneRms.store(0, std::memory_order_relaxed);
+    speakersPeak.store(0, std::memory_order_relaxed);
+    speakersRms.store(0, std::memory_order_relaxed);
+}
+
+pjmedia_port* CallVolumePort::create(pjmedia_port *streamPort, bool destroyStream, CallVolume *volume)
+{
+    const auto *format = pjmedia_format_get_audio_format_detail(&streamPort->info.fmt, PJ_TRUE);
+    if ((nullptr == format) || (BITS_PER_SAMPLE != format->bits_per_sample)) {
+        qWarning() << "Unsupported stream format for volume control";
+        return nullptr;
+    }
+    auto *pool = pjsua_pool_create("callVolume", POOL_SIZE, POOL_SIZE);
+    if (nullptr == pool) {
+        return nullptr;
+    }
+    auto *port = PJ_POOL_ZALLOC_T(pool, Port);
+    port->pool = pool;
+    port->stream = streamPort;
+    port->destroyStream = destroyStream;
+    port->volume = volume;
+    port->bufferSamples = PJMEDIA_PIA_SPF(&streamPort->info);
+    port->buffer = static_cast<pj_int16_t*>(pj_pool_alloc(pool, port->bufferSamples * sizeof(pj_int16_t)));
+
+    pj_str_t name = pj_str(const_cast<char*>("callVolume"));
+    pjmedia_port_info_init(&port->base.info, &name, PJMEDIA_SIGNATURE('B', 'C', 'V', 'L'),
+                           format->clock_rate, format->channel_count, BITS_PER_SAMPLE, port->bufferSamples);
+    port->base.put_frame = &CallVolumePort::putFrame;
+    port->base.get_frame = &CallVolumePort::getFrame;
+    port->base.on_destroy = &CallVolumePort::onDestroy;
+    volume->clearLevels();
+    return &port->base;
+}
+
+pj_status_t CallVolumePort::putFrame(pjmedia_port *port, pjmedia_frame *frame)
+{
+    auto *volumePort = reinterpret_cast<Port*>(port);
+    auto *volume = volumePort->volume;
+    MediaThreads::frameTick(frame->timestamp.u64, PJMEDIA_PIA_SPF(&port->info), PJMEDIA_PIA_SRATE(&port->info));
+    const auto count = static_cast<unsigned>(frame->size / sizeof(pj_int16_t));
+    if ((PJMEDIA_FRAME_TYPE_AUDIO != frame->type) || (0 == count) || (volumePort->bufferSamples < count)) {
+        volume->microphonePeak.store(0, std::memory_order_relaxed);
+        volume->microphoneRms.store(0, std::memory_order_relaxed);
+        return pjmedia_port_put_frame(volumePort->stream, frame);
+    }
+    //towards the call: microphone gain
+    std::copy_n(static_cast<const pj_int16_t*>(frame->buf), count, volumePort->buffer);
+    process(volumePort->buffer, count, volume->microphoneGain, volume->microphonePeak, volume->microphoneRms);
+    pjmedia_frame scaled = *frame;
+    scaled.buf = volumePort->buffer;
+    return pjmedia_port_put_frame(volumePort->stream, &scaled);
+}
+
+pj_status_t CallVolumePort::getFrame(pjmedia_port *port, pjmedia_frame *frame)
+{
+    auto *volumePort = reinterpret_cast<Port*>(port);
+    auto *volume = volumePort->volume;
+    const auto status = pjmedia_port_get_frame(volumePort->stream, frame);
+    const auto count = static_cast<unsigned>(frame->size / sizeof(pj_int16_t));
+    if ((PJ_SUCCESS != status) || (PJMEDIA_FRAME_TYPE_AUDIO != frame->type) || (0 == count)) {
+        volume->speakersPeak.store(0, std::memory_order_relaxed);
+        volume->speakersRms.store(0, std::memory_order_relaxed);
+        return status;
+    }
+    //from the call: speakers gain, in place in the buffer of the bridge
+    process(static_cast<pj_int16_t*>(frame->buf), count, volume->speakersGain,
+            volume->speakersPeak, volume->speakersRms);
+    return PJ_SUCCESS;
+}
+
+pj_status_t CallVolumePort::onDestroy(pjmedia_port *port)
+{
+    auto *volumePort = reinterpret_cast<Port*>(port);
+    if (volumePort->destroyStream) {
+        pjmedia_port_destroy(volumePort->stream);
+    }
+    volumePort->volume->clearLevels();
+    pj_pool_release(volumePort->pool);
+    return PJ_SUCCESS;
+}
+
+void CallVolumePort::process(pj_int16_t *samples, unsigned count, const std::atomic<float> &gain,
+                             std::atomic<float> &peak, std::atomic<float> &rms)
+{
+    const auto fixedGain = AudioKernels::fixedGain(gain.load(std::memory_order_relaxed));
+    const auto level = AudioKernels::applyGain(samples, count, fixedGain);
+    peak.store(static_cast<float>(level.peak) / FULL_SCALE, std::memory_order_relaxed);
+    rms.store(static_cast<float>(std::sqrt(static_cast<double>(level.sumSquares) / count) / FULL_SCALE),
+              std::memory_order_relaxed);
+}
+
+void CallVolumePort::benchmark(int frames)
+{
+    enum { CLOCK_RATE = 48000, FRAME_MS = 20, BRIDGE_NORMAL_LEVEL = 128 };
+    constexpr float gain = 1.5f;
+    const unsigned samplesPerFrame = CLOCK_RATE * FRAME_MS / 1000;
+    frames = std::max(1, frames);
+
+    //speech-like level with some clipping once the gain is applied
+    std::vector<pj_int16_t> source(samplesPerFrame);
+    for (unsigned i = 0; i < samplesPerFrame; ++i) {
+        source[i] = static_cast<pj_int16_t>(24000 * std::sin(2 * M_PI * 440 * i / CLOCK_RATE));
+    }
+    std::vector<pj_int16_t> samples(samplesPerFrame);
+    quint64 sink = 0;
+
+    //what the bridge does for an adjusted port: scalar gain and clip, then the average level
+    const int adjustLevel = static_cast<int>(gain * BRIDGE_NORMAL_LEVEL);
+    QElapsedTimer timer;
+    timer.start();
+    for (int frame = 0; frame < frames; ++frame) {
+        std::copy(source.begin(), source.end(), samples.begin());
+        for (auto &sample: samples) {
+            const pj_int32_t value = (static_cast<pj_int32_t>(sample) * adjustLevel) >> 7;
+            sample = static_cast<pj_int16_t>(std::clamp<pj_int32_t>(value, INT16_MIN, INT16_MAX));
+        }
+        sink += pjmedia_calc_avg_signal(samples.data(), samplesPerFrame);
+    }
+    const auto bridgeNs = timer.nsecsElapsed();
+
+    //the same with the kernel, which also gives the peak and the RMS
+    const auto fixedGain = AudioKernels::fixedGain(gain);
+    timer.restart();
+    for (int frame = 0; frame < frames; ++frame) {
+        std::copy(source.begin(), source.end(), samples.begin());
+        const auto level = AudioKernels::applyGain(samples.data(), samplesPerFrame, fixedGain);
+        sink += static_cast<quint64>(level.peak) + level.sumSquares;
+    }
+    const auto kernelNs = timer.nsecsElapsed();
+
+    const double bridgePerFrame = static_cast<double>(bridgeNs) / frames;
+    const double kernelPerFrame = static_cast<double>(kernelNs) / frames;
+    qInfo() << "Volume benchmark:" << frames << "frames of" << samplesPerFrame << "samples,"
+            << "bridge level adjustment" << bridgePerFrame << "ns/frame, kernel" << kernelPerFrame
+            << "ns/frame, speedup" << ((0 < kernelPerFrame) ? bridgePerFrame / kernelPerFrame : 0)
+            << "(checksum" << sink << ")";
+}
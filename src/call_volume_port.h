@@ -0,0 +1,60 @@
+#pragma once
+
+#include "pjsua.h"
+#include <atomic>
+
+/**
+ * Gains and level meters of one call slot. The gains are written by the GUI
+ * thread, the levels by the conference thread and read by the GUI at frame
+ * rate, all relaxed atomics so neither side ever waits for the other.
+ * Kept by the SIP client for its whole lifetime, the meters stay readable
+ * while the media streams come and go.
+ */
+struct CallVolume {
+    std::atomic<float> microphoneGain{1};
+    std::atomic<float> speakersGain{1};
+    //last frame after the gain, full scale is 1
+    std::atomic<float> microphonePeak{0};
+    std::atomic<float> microphoneRms{0};
+    std::atomic<float> speakersPeak{0};
+    std::atomic<float> speakersRms{0};
+
+    void clearLevels();
+};
+
+/**
+ * Wraps the media port of a call stream, the conference bridge is connected
+ * to the wrapper instead. Frames from the call get the speakers gain, frames
+ * sent to the call the microphone gain, both are clipped and measured in the
+ * same vectorized pass. This replaces the bridge level adjustment.
+ */
+class CallVolumePort
+{
+public:
+    //the wrapper destroys the stream port with itself when destroyStream is set
+    static pjmedia_port* create(pjmedia_port *streamPort, bool destroyStream, CallVolume *volume);
+
+    //gain and level of 20 ms frames: kernel against the bridge scalar loop
+    static void benchmark(int frames);
+
+private:
+    CallVolumePort() = delete;
+
+    enum { POOL_SIZE = 512, BITS_PER_SAMPLE = 16, FULL_SCALE = 32768 };
+
+    struct Port {
+        pjmedia_port base;
+        pj_pool_t *pool;
+        pjmedia_port *stream;
+        bool destroyStream;
+        CallVolume *volume;
+        pj_int16_t *buffer;//microphone frames, the bridge buffer may be shared
+        unsigned bufferSamples;
+    };
+
+    static pj_status_t putFrame(pjmedia_port *port, pjmedia_frame *frame);
+    static pj_status_t getFrame(pjmedia_port *port, pjmedia_frame *frame);
+    static pj_status_t onDestroy(pjmedia_port *port);
+    static void process(pj_int16_t *samples, unsigned count, const std::atomic<float> &gain,
+                        std::atomic<float> &peak, std::atomic<float> &rms);
+};
@@ -0,0 +1,529 @@
+#include "campaign.h"
+#include "sip_client.h"
+#include <QThread>
+#include <QFile>
+#include <QTextStream>
+#include <QDateTime>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+CampaignConfig CampaignConfig::parse(const QString &spec)
+{
+    CampaignConfig config;
+    const auto items = spec.split(',', Qt::SkipEmptyParts);
+    for (const auto &item: items) {
+        const auto keyValue = item.split('=');
+        if (2 != keyValue.size()) {
+            qWarning() << "Ignoring campaign item" << item;
+            continue;
+        }
+        const auto key = keyValue.at(0).trimmed().toLower();
+        const auto value = keyValue.at(1).trimmed();
+        if ("concurrency" == key) {
+            config.concurrency = std::max(1, value.toInt());
+        } else if ("cps" == key) {
+            config.callsPerSecond = std::max(0.01, value.toDouble());
+        } else if ("predictive" == key) {
+            config.predictive = (0 != value.toInt());
+        } else if ("maxratio" == key) {
+            config.maxRatio = std::max(1.0, value.toDouble());
+        } else if ("ring" == key) {
+            config.ringTimeoutSec = std::max(1, value.toInt());
+        } else if ("talk" == key) {
+            config.talkTimeSec = std::max(0, value.toInt());
+        } else if ("attempts" == key) {
+            config.maxAttempts = std::max(1, value.toInt());
+        } else if ("busyretry" == key) {
+            config.busyRetrySec = std::max(0, value.toInt());
+        } else if ("noanswerretry" == key) {
+            config.noAnswerRetrySec = std::max(0, value.toInt());
+        } else if ("account" == key) {
+            config.accountId = value.toInt();
+        } else {
+            qWarning() << "Unknown campaign parameter" << key;
+        }
+    }
+    return config;
+}
+
+QString CampaignConfig::toString() const
+{
+    return QString("concurrency=%1,cps=%2,predictive=%3,maxratio=%4,ring=%5,talk=%6,"
+                   "attempts=%7,busyretry=%8,noanswerretry=%9,account=%10")
+            .arg(concurrency).arg(callsPerSecond).arg(predictive ? 1 : 0).arg(maxRatio)
+            .arg(ringTimeoutSec).arg(talkTimeSec).arg(maxAttempts).arg(busyRetrySec)
+            .arg(noAnswerRetrySec).arg(accountId);
+}
+
+Campaign::Campaign(SipClient *sipClient, CallHistoryModel *callHistoryModel, QObject *parent)
+    : QObject(parent), _sipClient(sipClient), _callHistoryModel(callHistoryModel)
+{
+    _tickTimer.setInterval(TICK_MS);
+    _tickTimer.setTimerType(Qt::PreciseTimer);
+    connect(&_tickTimer, &QTimer::timeout, this, &Campaign::dial);
+    _flushTimer.setInterval(RESULT_FLUSH_MS);
+    _flushTimer.setSingleShot(true);
+    connect(&_flushTimer, &QTimer::timeout, this, &Campaign::flushResults);
+    if (nullptr != _sipClient) {
+        connect(_sipClient, &SipClient::campaignCallConfirmed, this, &Campaign::onCallConfirmed);
+        connect(_sipClient, &SipClient::campaignCallEnded, this, &Campaign::onCallEnded);
+    }
+    _writer = std::thread(&Campaign::writer, this);
+}
+
+Campaign::~Campaign()
+{
+    if (nullptr != _loader) {
+        _loader->wait();
+        delete _loader;
+    }
+    flushResults();
+    {
+        //the writer drains the queue before leaving
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+    }
+    _wakeup.notify_all();
+    _writer.join();
+}
+
+bool Campaign::start(const QString &filePath, const CampaignConfig &config)
+{
+    if (_running || (nullptr != _loader)) {
+        qWarning() << "Campaign already running";
+        return false;
+    }
+    if (nullptr == _sipClient) {
+        qCritical() << "SIP client not started";
+        return false;
+    }
+    _config = config;
+    _filePath = filePath;
+    _running = true;
+    _loaded = false;
+    _entries.clear();
+    _pending.clear();
+    _retries = {};
+    _connected = 0;
+    _answerRate = 1;
+    _dialed = _answered = _busy = _noAnswer = _failed = _done = 0;
+    _dialTimeTotalUs = _dialTimeMaxUs = 0;
+    qInfo() << "Starting campaign" << filePath << _config.toString();
+
+    //a list of thousands of numbers is read away from the UI thread
+    auto entries = std::make_shared<QVector<Entry>>();
+    _loader = QThread::create([filePath, entries]() {
+        *entries = loadList(filePath);
+    });
+    connect(_loader, &QThread::finished, this, [this, entries]() {
+        _loader->deleteLater();
+        _loader = nullptr;
+        onListLoaded(*entries);
+    });
+    _loader->start();
+    emit progressChanged();
+    return true;
+}
+
+void Campaign::stop()
+{
+    if (!_running) {
+        return;
+    }
+    qInfo() << "Stopping campaign" << _filePath;
+    _running = false;
+    _pending.clear();
+    _retries = {};
+    for (auto &[callId, attempt]: _attempts) {
+        if (!attempt.hungUp) {
+            attempt.hungUp = true;
+            _sipClient->hangup(callId);
+        }
+    }
+    finishIfDone();
+}
+
+QVariantMap Campaign::progress() const
+{
+    QVariantMap progress;
+    progress["running"] = _running;
+    progress["file"] = _filePath;
+    progress["config"] = _config.toString();
+    progress["entries"] = _entries.size();
+    progress["done"] = _done;
+    progress["pending"] = static_cast<int>(_pending.size());
+    progress["retries"] = static_cast<int>(_retries.size());
+    progress["ringing"] = static_cast<int>(_attempts.size()) - _connected;
+    progress["connected"] = _connected;
+    progress["dialed"] = _dialed;
+    progress["answered"] = _answered;
+    progress["busy"] = _busy;
+    progress["noAnswer"] = _noAnswer;
+    progress["failed"] = _failed;
+    progress["answerRate"] = _answerRate;
+    //time spent in placing the calls, should not grow with the list
+    progress["dialTimeAvgMs"] = (0 < _dialed) ? _dialTimeTotalUs / 1000.0 / _dialed : 0.0;
+    progress["dialTimeMaxMs"] = _dialTimeMaxUs / 1000.0;
+    return progress;
+}
+
+QVector<Campaign::Entry> Campaign::loadList(const QString &filePath)
+{
+    QVector<Entry> entries;
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qCritical() << "Cannot open campaign list" << filePath;
+        return entries;
+    }
+    QTextStream in(&file);
+    QString line;
+    while (in.readLineInto(&line)) {
+        if (line.trimmed().isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+        const auto fields = parseCsvLine(line);
+        Entry entry;
+        entry.number = fields.at(0).trimmed();
+        entry.name = (1 < fields.size()) ? fields.at(1).trimmed() : QString();
+        if (std::none_of(entry.number.cbegin(), entry.number.cend(),
+                         [](QChar c) { return c.isDigit(); })) {
+            //header or a malformed line
+            continue;
+        }
+        entries.append(entry);
+    }
+    qInfo() << "Loaded" << entries.size() << "numbers from" << filePath;
+    return entries;
+}
+
+QStringList Campaign::parseCsvLine(const QString &line)
+{
+    QStringList fields;
+    QString field;
+    bool quoted = false;
+    for (int i = 0; i < line.size(); ++i) {
+        const auto c = line.at(i);
+        if (quoted) {
+            if ('"' != c) {
+                field += c;
+            } else if ((i + 1 < line.size()) && ('"' == line.at(i + 1))) {
+                //doubled quote
+                field += c;
+                ++i;
+            } else {
+                quoted = false;
+            }
+        } else if ('"' == c) {
+            //spaces before the opening quote are not part of the field
+            if (field.trimmed().isEmpty()) {
+                field.clear();
+            }
+            quoted = true;
+        } else if (',' == c) {
+            fields.append(field);
+            field.clear();
+        } else {
+            field += c;
+        }
+    }
+    fields.append(field);
+    return fields;
+}
+
+QString Campaign::formatCsvLine(const QStringList &fields)
+{
+    QStringList quotedFields;
+    quotedFields.reserve(fields.size());
+    for (const auto &field: fields) {
+        if (std::any_of(field.cbegin(), field.cend(), [](QChar c) {
+                        return (',' == c) || ('"' == c) || ('\n' == c) || ('\r' == c); })) {
+            quotedFields.append('"' + QString(field).replace('"', "\"\"") + '"');
+        } else {
+            quotedFields.append(field);
+        }
+    }
+    return quotedFields.join(',');
+}
+
+void Campaign::onListLoaded(const QVector<Entry> &entries)
+{
+    _loaded = true;
+    if (!_running) {
+        //stopped while loading
+        emit finished();
+        return;
+    }
+    _entries = entries;
+    for (int i = 0; i < _entries.size(); ++i) {
+        _pending.push_back(i);
+    }
+    _clock.start();
+    _lastTickMs = _lastProgressMs = 0;
+    //the first call goes out at once
+    _tokens = 1;
+    _tickTimer.start();
+    finishIfDone();
+}
+
+void Campaign::dial()
+{
+    const auto nowMs = _clock.elapsed();
+    hangupExpired(nowMs);
+
+    //token bucket, at most one second of burst
+    _tokens = std::min(_tokens + _config.callsPerSecond * (nowMs - _lastTickMs) / 1000.0,
+                       std::max(1.0, _config.callsPerSecond));
+    _lastTickMs = nowMs;
+
+    while (!_retries.empty() && (_retries.top().dueMs <= nowMs)) {
+        _pending.push_back(_retries.top().entry);
+        _retries.pop();
+    }
+
+    //predictive: enough ringing calls to fill the free lines at the current answer rate
+    const double ratio = _config.predictive ?
+                std::clamp(1.0 / std::max(_answerRate, 1e-3), 1.0, _config.maxRatio) : 1.0;
+    const int freeLines = std::max(0, _config.concurrency - _connected);
+    const int ringing = static_cast<int>(_attempts.size()) - _connected;
+    int wanted = static_cast<int>(std::ceil(freeLines * ratio)) - ringing;
+    //dialing ahead is bounded by the calls PJSUA can hold
+    wanted = std::min(wanted, static_cast<int>(pjsua_call_get_max_count() - pjsua_call_get_count()));
+
+    while ((0 < wanted) && (1 <= _tokens) && !_pending.empty() && _running) {
+        const int index = _pending.front();
+        _pending.pop_front();
+        auto &entry = _entries[index];
+        ++entry.attempts;
+        ++_dialed;
+        _tokens -= 1;
+
+        QElapsedTimer dialTime;
+        dialTime.start();
+        bool temporary = false;
+        const auto callId = _sipClient->makeCampaignCall(entry.number, _config.accountId, temporary);
+        const auto dialTimeUs = dialTime.nsecsElapsed() / 1000;
+        _dialTimeTotalUs += dialTimeUs;
+        _dialTimeMaxUs = std::max(_dialTimeMaxUs, dialTimeUs);
+
+        if ((PJSUA_INVALID_ID == callId) && temporary) {
+            //not dialed: the number keeps its place and the next tick tries again
+            --entry.attempts;
+            --_dialed;
+            _tokens += 1;
+            _pending.push_front(index);
+            break;
+        }
+        if (PJSUA_INVALID_ID == callId) {
+            //invalid number or no account: not dialed again
+            ++_failed;
+            ++_done;
+            addResult(entry, Result::Failed, 0);
+            continue;
+        }
+        Attempt attempt;
+        attempt.entry = index;
+        attempt.startMs = nowMs;
+        _attempts[callId] = attempt;
+        --wanted;
+    }
+
+    if (PROGRESS_INTERVAL_MS <= nowMs - _lastProgressMs) {
+        _lastProgressMs = nowMs;
+        emit progressChanged();
+    }
+    finishIfDone();
+}
+
+void Campaign::hangupExpired(qint64 nowMs)
+{
+    const qint64 ringTimeoutMs = 1000LL * _config.ringTimeoutSec;
+    const qint64 talkTimeMs = 1000LL * _config.talkTimeSec;
+    for (auto &[callId, attempt]: _attempts) {
+        if (attempt.hungUp) {
+            continue;
+        }
+        const bool ringExpired = (0 > attempt.answerMs) && (ringTimeoutMs <= nowMs - attempt.startMs);
+        const bool talkExpired = (0 <= attempt.answerMs) && (0 < talkTimeMs) &&
+                (talkTimeMs <= nowMs - attempt.answerMs);
+        if (ringExpired || talkExpired) {
+            attempt.hungUp = true;
+            _sipClient->hangup(callId);
+        }
+    }
+}
+
+void Campaign::onCallConfirmed(int callId)
+{
+    const auto it = _attempts.find(callId);
+    if ((it == _attempts.end()) || (0 <= it->second.answerMs)) {
+        return;
+    }
+    it->second.answerMs = _clock.elapsed();
+    ++_connected;
+}
+
+void Campaign::onCallEnded(int callId, int statusCode)
+{
+    const auto it = _attempts.find(callId);
+    if (it == _attempts.end()) {
+        return;
+    }
+    const auto attempt = it->second;
+    _attempts.erase(it);
+    if (0 <= attempt.answerMs) {
+        --_connected;
+    }
+
+    const auto result = classify(statusCode, attempt);
+    const auto &entry = _entries.at(attempt.entry);
+    addResult(entry, result, statusCode);
+    if (_running) {
+        //calls hung up by stop say nothing about the answer rate
+        _answerRate += ANSWER_RATE_WEIGHT * (((Result::Answered == result) ? 1.0 : 0.0) - _answerRate);
+    }
+
+    int retrySec = -1;
+    switch (result) {
+    case Result::Answered:
+        ++_answered;
+        break;
+    case Result::Busy:
+        ++_busy;
+        retrySec = _config.busyRetrySec;
+        break;
+    case Result::NoAnswer:
+        ++_noAnswer;
+        retrySec = _config.noAnswerRetrySec;
+        break;
+    case Result::Failed:
+        ++_failed;
+        break;
+    }
+    if (_running && (0 <= retrySec) && (entry.attempts < _config.maxAttempts)) {
+        _retries.push({ _clock.elapsed() + 1000LL * retrySec, attempt.entry });
+    } else {
+        ++_done;
+    }
+    finishIfDone();
+}
+
+Campaign::Result Campaign::classify(int statusCode, const Attempt &attempt)
+{
+    if (0 <= attempt.answerMs) {
+        return Result::Answered;
+    }
+    switch (statusCode) {
+    case PJSIP_SC_BUSY_HERE:
+    case PJSIP_SC_BUSY_EVERYWHERE:
+        return Result::Busy;
+    case PJSIP_SC_REQUEST_TIMEOUT:
+    case PJSIP_SC_TEMPORARILY_UNAVAILABLE:
+    case PJSIP_SC_REQUEST_TERMINATED:
+        return Result::NoAnswer;
+    default:;
+    }
+    //cancelled by the ring timeout
+    return attempt.hungUp ? Result::NoAnswer : Result::Failed;
+}
+
+QString Campaign::toString(Result result)
+{
+    switch (result) {
+    case Result::Answered:
+        return "answered";
+    case Result::Busy:
+        return "busy";
+    case Result::NoAnswer:
+        return "no answer";
+    case Result::Failed:
+        return "failed";
+    }
+    return "unknown";
+}
+
+void Campaign::addResult(const Entry &entry, Result result, int statusCode)
+{
+    CallHistoryModel::CallHistoryInfo info(entry.name, entry.number);
+    info.callStatus = (Result::Answered == result) ? CallHistoryModel::CallStatus::OUTGOING :
+                                                     CallHistoryModel::CallStatus::REJECTED;
+    info.confirmed = (Result::Answered == result);
+    _historyBatch.append(info);
+    _resultBatch.append(formatCsvLine({ info.dateTime.toString(Qt::ISODateWithMs), entry.number, entry.name,
+                                        QString::number(entry.attempts), toString(result),
+                                        QString::number(statusCode) }));
+
+    //one save of the history per batch, not per call
+    if (RESULT_BATCH_SIZE <= _historyBatch.size()) {
+        flushResults();
+    } else if (!_flushTimer.isActive()) {
+        _flushTimer.start();
+    }
+}
+
+void Campaign::flushResults()
+{
+    _flushTimer.stop();
+    if (_historyBatch.isEmpty()) {
+        return;
+    }
+    if (nullptr != _callHistoryModel) {
+        _callHistoryModel->addCalls(_historyBatch);
+    }
+    _historyBatch.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _resultBatches.push_back({ _filePath + ".results.csv", _resultBatch });
+    }
+    _wakeup.notify_all();
+    _resultBatch.clear();
+}
+
+void Campaign::writer()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+        _wakeup.wait(lock, [this]() { return _quit || !_resultBatches.empty(); });
+        if (_resultBatches.empty()) {
+            return;
+        }
+        const auto batch = std::move(_resultBatches.front());
+        _resultBatches.pop_front();
+        lock.unlock();
+        writeResults(batch.filePath, batch.lines);
+        lock.lock();
+    }
+}
+
+void Campaign::writeResults(const QString &filePath, const QStringList &lines)
+{
+    QFile file(filePath);
+    const bool isNew = !file.exists();
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        qWarning() << "Cannot write campaign results" << filePath;
+        return;
+    }
+    QTextStream out(&file);
+    if (isNew) {
+        out << "time,number,name,attempt,result,status\n";
+    }
+    for (const auto &line: lines) {
+        out << line << '\n';
+    }
+}
+
+void Campaign::finishIfDone()
+{
+    if (!_loaded || !_attempts.empty() || (_running && (!_pending.empty() || !_retries.empty()))) {
+        return;
+    }
+    _tickTimer.stop();
+    _running = false;
+    flushResults();
+    qInfo() << "Campaign finished:" << _dialed << "calls," << _answered << "answered,"
+            << _busy << "busy," << _noAnswer << "not answered," << _failed << "failed";
+    emit progressChanged();
+    emit finished();
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "pjsua.h"
+#include "models/call_history_model.h"
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QVariantMap>
+#include <QStringList>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class SipClient;
+class QThread;
+
+/**
+ * Dialing parameters of a campaign, parsed from a spec like
+ * "concurrency=10,cps=2,predictive=1,maxratio=3,ring=30,attempts=3,busyretry=300,noanswerretry=900"
+ * concurrency is the number of answered calls handled at the same time and
+ * cps paces the new attempts. A progressive campaign dials one number per free
+ * line, a predictive one dials ahead by the inverse of the recent answer rate,
+ * up to maxratio numbers per free line. Times are in seconds, talk=0 leaves the
+ * answered calls to the remote party. account=-1 uses the account of the settings.
+ */
+struct CampaignConfig {
+    int concurrency = 1;
+    double callsPerSecond = 1;
+    bool predictive = false;
+    double maxRatio = 3;
+    int ringTimeoutSec = 30;
+    int talkTimeSec = 0;
+    int maxAttempts = 3;
+    int busyRetrySec = 300;
+    int noAnswerRetrySec = 900;
+    int accountId = PJSUA_INVALID_ID;
+
+    static CampaignConfig parse(const QString &spec);
+    QString toString() const;
+};
+
+/**
+ * Outbound campaign over a list of numbers, one "number[,name]" per line of a
+ * CSV file, fields may be quoted ("Doe, John"). The list is read on a worker thread; the dialing runs on a timer of
+ * the thread of the SIP client and does constant work per attempt whatever the
+ * size of the list: numbers wait in a queue, retries in a heap ordered by due
+ * time. Busy and unanswered numbers are dialed again after their retry delay,
+ * up to the attempt limit. The result of every attempt goes to the call history
+ * and to "<list>.results.csv" in batches, the file is appended on a writer thread.
+ */
+class Campaign : public QObject
+{
+    Q_OBJECT
+public:
+    enum class Result { Answered, Busy, NoAnswer, Failed };
+
+    Campaign(SipClient *sipClient, CallHistoryModel *callHistoryModel, QObject *parent = nullptr);
+    ~Campaign();
+
+    //dialing starts once the list is loaded
+    bool start(const QString &filePath, const CampaignConfig &config);
+    //hangs up the attempts in progress, finished is emitted once they ended
+    void stop();
+    bool isRunning() const { return _running; }
+    QVariantMap progress() const;
+
+    //one line of CSV, quoted fields with doubled quotes inside, no line breaks in a field
+    static QStringList parseCsvLine(const QString &line);
+    //the fields with a comma, a quote or a line break are quoted
+    static QString formatCsvLine(const QStringList &fields);
+
+signals:
+    void progressChanged();
+    void finished();
+
+private:
+    Q_DISABLE_COPY_MOVE(Campaign)
+
+    enum { TICK_MS = 20, PROGRESS_INTERVAL_MS = 1000, RESULT_BATCH_SIZE = 50,
+           RESULT_FLUSH_MS = 2000 };
+    static constexpr double ANSWER_RATE_WEIGHT = 0.05;
+
+    struct Entry {
+        QString number;
+        QString name;
+        int attempts = 0;
+    };
+    struct Attempt {
+        int entry = -1;
+        qint64 startMs = 0;
+        qint64 answerMs = -1;//not answered yet
+        bool hungUp = false;//by the ring or the talk timeout
+    };
+    struct Retry {
+        qint64 dueMs = 0;
+        int entry = -1;
+        bool operator>(const Retry &other) const { return dueMs > other.dueMs; }
+    };
+
+    static QVector<Entry> loadList(const QString &filePath);
+    void onListLoaded(const QVector<Entry> &entries);
+    void dial();
+    void hangupExpired(qint64 nowMs);
+    void onCallConfirmed(int callId);
+    void onCallEnded(int callId, int statusCode);
+    static Result classify(int statusCode, const Attempt &attempt);
+    static QString toString(Result result);
+    void addResult(const Entry &entry, Result result, int statusCode);
+    void flushResults();
+    void writer();
+    static void writeResults(const QString &filePath, const QStringList &lines);
+    void finishIfDone();
+
+    QPointer<SipClient> _sipClient;
+    QPointer<CallHistoryModel> _callHistoryModel;
+    CampaignConfig _config;
+    QString _filePath;
+    QThread *_loader = nullptr;
+    bool _running = false;
+    bool _loaded = false;
+
+    QVector<Entry> _entries;
+    std::deque<int> _pending;//entry indices, in list order
+    std::priority_queue<Retry, std::vector<Retry>, std::greater<Retry>> _retries;
+    std::unordered_map<pjsua_call_id, Attempt> _attempts;
+    int _connected = 0;
+
+    QTimer _tickTimer;
+    QElapsedTimer _clock;
+    qint64 _lastTickMs = 0;
+    qint64 _lastProgressMs = 0;
+    double _tokens = 0;
+    double _answerRate = 1;//moving average, dialing starts at the progressive ratio
+
+    int _dialed = 0;
+    int _answered = 0;
+    int _busy = 0;
+    int _noAnswer = 0;
+    int _failed = 0;
+    int _done = 0;//entries without further attempts
+    qint64 _dialTimeTotalUs = 0;
+    qint64 _dialTimeMaxUs = 0;
+
+    QVector<CallHistoryModel::CallHistoryInfo> _historyBatch;
+    QStringList _resultBatch;
+    QTimer _flushTimer;
+
+    struct ResultBatch {
+        QString filePath;
+        QStringList lines;
+    };
+    std::thread _writer;
+    std::mutex _mutex;
+    std::condition_variable _wakeup;
+    std::deque<ResultBatch> _resultBatches;
+    bool _quit = false;
+};
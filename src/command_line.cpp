@@ -0,0 +1,138 @@
+#include "command_line.h"
+#include "softphone.h"
+#include "metrics_server.h"
+#include "control_server.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QDebug>
+
+void CommandLineOptions::parse(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (0 == qstrcmp("--headless", argv[i])) {
+            headless = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            break;
+        }
+        const auto value = QString::fromLocal8Bit(argv[i + 1]);
+        if (0 == qstrcmp("--control-socket", argv[i])) {
+            controlSocket = value;
+        } else if (0 == qstrcmp("--metrics-port", argv[i])) {
+            metricsPort = value.toInt();
+        } else if (0 == qstrcmp("--metrics-file", argv[i])) {
+            metricsFile = value;
+        } else if (0 == qstrcmp("--stall-threshold", argv[i])) {
+            //ms, blocked event loop reports
+            stallThresholdMs = value.toInt();
+        } else if (0 == qstrcmp("--play", argv[i])) {
+            playFile = value;
+        } else if (0 == qstrcmp("--record", argv[i])) {
+            recordDir = value;
+        } else if (0 == qstrcmp("--accounts", argv[i])) {
+            accountsFile = value;
+        } else if (0 == qstrcmp("--call-trace", argv[i])) {
+            callTraceFile = value;
+        } else if (0 == qstrcmp("--latency-probe", argv[i])) {
+            //e.g. --latency-probe "codec=opus/48000,ptime=20;codec=PCMU,jb=40/20/100/300"
+            latencyProbe = value;
+        } else if (0 == qstrcmp("--media-benchmark", argv[i])) {
+            //markers per profile, the results go to latency_probe.csv
+            mediaBenchmarkMarkers = value.toInt();
+        } else if (0 == qstrcmp("--call", argv[i])) {
+            call = value;
+        } else if (0 == qstrcmp("--campaign", argv[i])) {
+            campaign = value;
+        } else if (0 == qstrcmp("--campaign-config", argv[i])) {
+            campaignConfig = value;
+        } else {
+            continue;
+        }
+        ++i;
+    }
+}
+
+CommandLineServices::CommandLineServices() = default;
+
+CommandLineServices::~CommandLineServices() = default;
+
+bool CommandLineServices::start(Softphone *softphone, const CommandLineOptions &options)
+{
+    _watchdog = std::make_unique<EventLoopWatchdog>(options.stallThresholdMs);
+    _metricsServer = std::make_unique<MetricsServer>();
+    if ((0 < options.metricsPort) && !_metricsServer->listen(static_cast<quint16>(options.metricsPort))) {
+        return false;
+    }
+    if (!options.metricsFile.isEmpty()) {
+        _metricsServer->writeSnapshots(options.metricsFile);
+    }
+
+    if (options.nullAudio || !options.playFile.isEmpty() || !options.recordDir.isEmpty()) {
+        softphone->setFileAudio(options.playFile, options.recordDir);
+    }
+    if (!options.accountsFile.isEmpty() && !addAccounts(softphone, options.accountsFile)) {
+        return false;
+    }
+
+    //JSON-RPC control, always on in headless mode, one socket per instance by default
+    if (options.headless || !options.controlSocket.isEmpty()) {
+        auto controlSocket = options.controlSocket;
+        if (controlSocket.isEmpty()) {
+            controlSocket = QString("%1-%2").arg(QFileInfo(QCoreApplication::applicationFilePath()).baseName())
+                    .arg(QCoreApplication::applicationPid());
+        }
+        _controlServer = std::make_unique<ControlServer>(softphone);
+        if (!_controlServer->listen(controlSocket)) {
+            return false;
+        }
+    }
+
+    if (!options.latencyProbe.isEmpty()) {
+        softphone->runLatencyProbe(options.latencyProbe);
+    }
+    if (0 < options.mediaBenchmarkMarkers) {
+        softphone->runMediaBenchmark(options.mediaBenchmarkMarkers);
+    }
+    if (!options.call.isEmpty()) {
+        softphone->makeCall(options.call);
+    }
+    if (!options.campaign.isEmpty()) {
+        softphone->startCampaign(options.campaign, options.campaignConfig);
+    }
+    return true;
+}
+
+void CommandLineServices::finish(Softphone *softphone, const CommandLineOptions &options)
+{
+    if (!options.callTraceFile.isEmpty()) {
+        softphone->writeCallTrace(options.callTraceFile);
+    }
+}
+
+//JSON array of account objects with the keys of SipAccountConfig, e.g. the members of a hunt group
+bool CommandLineServices::addAccounts(Softphone *softphone, const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical() << "Cannot open accounts file" << filePath;
+        return false;
+    }
+    QJsonParseError error{};
+    const auto document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (!document.isArray()) {
+        qCritical() << "Invalid accounts file" << filePath << ":" << error.errorString();
+        return false;
+    }
+    int count = 0;
+    for (const auto &account: document.array()) {
+        if (PJSUA_INVALID_ID != softphone->addAccount(account.toObject().toVariantMap())) {
+            ++count;
+        }
+    }
+    qInfo() << "Added" << count << "of" << document.array().size() << "accounts";
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "event_loop_watchdog.h"
+#include <QString>
+#include <memory>
+
+class Softphone;
+class MetricsServer;
+class ControlServer;
+
+/**
+ * Options of the application and of the headless engine, parsed the same way
+ * by both. An option missing its value is ignored.
+ */
+struct CommandLineOptions {
+    bool headless = false;//no QML engine, controlled through the control socket only
+    bool nullAudio = false;//no sound devices, the calls send silence unless a file is played
+    QString controlSocket;//<program>-<pid> by default
+    int metricsPort = 0;//Prometheus text on localhost
+    QString metricsFile;
+    int stallThresholdMs = EventLoopWatchdog::DEFAULT_THRESHOLD_MS;
+    QString playFile;//mono 16 bit WAV, looped into every call
+    QString recordDir;//one WAV file per call
+    QString accountsFile;
+    QString callTraceFile;//Chrome trace-event JSON of the last calls, written on exit
+    QString latencyProbe;
+    int mediaBenchmarkMarkers = 0;
+    QString call;
+    QString campaign;//CSV list of numbers, the results are written next to it
+    QString campaignConfig;//see CampaignConfig
+
+    void parse(int argc, char *argv[]);
+};
+
+/**
+ * What the options start once the Softphone runs. The stall watchdog and the
+ * metrics come first, so the probe, the benchmark, the calls and the campaign
+ * started last are already observed. Lives until the event loop returns.
+ */
+class CommandLineServices
+{
+public:
+    CommandLineServices();
+    ~CommandLineServices();
+
+    bool start(Softphone *softphone, const CommandLineOptions &options);
+    //after the event loop
+    void finish(Softphone *softphone, const CommandLineOptions &options);
+
+private:
+    Q_DISABLE_COPY_MOVE(CommandLineServices)
+
+    static bool addAccounts(Softphone *softphone, const QString &filePath);
+
+    std::unique_ptr<EventLoopWatchdog> _watchdog;
+    std::unique_ptr<MetricsServer> _metricsServer;
+    std::unique_ptr<ControlServer> _controlServer;
+};
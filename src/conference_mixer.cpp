@@ -0,0 +1,273 @@
+#include "conference_mixer.h"
+#include "audio_kernels.h"
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+pj_status_t ConferenceMixer::create()
+{
+    if (nullptr != _pool) {
+        return PJ_EEXISTS;
+    }
+
+    //mix with the bridge format, the legs never resample
+    pjsua_conf_port_info bridgeInfo{};
+    auto status = pjsua_conf_get_port_info(0, &bridgeInfo);
+    if (PJ_SUCCESS != status) {
+        return status;
+    }
+    _clockRate = bridgeInfo.clock_rate;
+    _samplesPerFrame = bridgeInfo.samples_per_frame;
+
+    _pool = pjsua_pool_create("mixer", POOL_SIZE, POOL_SIZE);
+    if (nullptr == _pool) {
+        return PJ_ENOMEM;
+    }
+    pj_str_t name = pj_str(const_cast<char*>("mixerLeg"));
+    _freeLegs.clear();
+    for (int i = MAX_LEGS - 1; i >= 0; --i) {
+        auto &leg = _legs[i];
+        pj_bzero(&leg.base, sizeof(leg.base));
+        pjmedia_port_info_init(&leg.base.info, &name, PJMEDIA_SIGNATURE('B', 'C', 'M', 'X'),
+                               _clockRate, bridgeInfo.channel_count, BITS_PER_SAMPLE, _samplesPerFrame);
+        leg.base.put_frame = &ConferenceMixer::putFrame;
+        leg.base.get_frame = &ConferenceMixer::getFrame;
+        leg.mixer = this;
+        leg.input.assign(_samplesPerFrame, 0);
+        leg.output.assign(_samplesPerFrame, 0);
+        if (LOCAL_LEG != i) {
+            _freeLegs.push_back(&leg);
+        }
+    }
+    _sum.assign(_samplesPerFrame, 0);
+    _activeCount = 0;
+    _frames = 0;
+    _totalNs = 0;
+    _maxNs = 0;
+
+    auto &local = _legs[LOCAL_LEG];
+    status = activateLeg(local, PJSUA_INVALID_ID);
+    if (PJ_SUCCESS == status) {
+        status = pjsua_conf_connect(0, local.confPort);
+    }
+    if (PJ_SUCCESS == status) {
+        status = pjsua_conf_connect(local.confPort, 0);
+    }
+    if (PJ_SUCCESS != status) {
+        release();
+        return status;
+    }
+    _localConfPort = local.confPort;
+    qDebug() << "Created conference mixer" << _clockRate << "Hz," << _samplesPerFrame << "samples per frame";
+    return PJ_SUCCESS;
+}
+
+void ConferenceMixer::release()
+{
+    if (nullptr == _pool) {
+        return;
+    }
+    for (auto &leg: _legs) {
+        if (0 <= leg.activeIndex) {
+            deactivateLeg(leg);
+        }
+    }
+    _localConfPort = PJSUA_INVALID_ID;
+    _freeLegs.clear();
+    pj_pool_release(_pool);
+    _pool = nullptr;
+}
+
+pj_status_t ConferenceMixer::addCall(pjsua_call_id callId, pjsua_conf_port_id callPort)
+{
+    if (contains(callId)) {
+        return attachCall(callId, callPort);
+    }
+    if (_freeLegs.empty()) {
+        return PJ_ETOOMANY;
+    }
+    auto *leg = _freeLegs.back();
+    auto status = activateLeg(*leg, callId);
+    if (PJ_SUCCESS != status) {
+        return status;
+    }
+    _freeLegs.pop_back();
+    status = attachCall(callId, callPort);
+    if (PJ_SUCCESS != status) {
+        removeCall(callId);
+    }
+    return status;
+}
+
+pj_status_t ConferenceMixer::attachCall(pjsua_call_id callId, pjsua_conf_port_id callPort)
+{
+    const auto *leg = findLeg(callId);
+    if (nullptr == leg) {
+        return PJ_ENOTFOUND;
+    }
+    //the call only talks to its leg, never to the sound device or the other calls
+    pjsua_conf_disconnect(callPort, 0);
+    pjsua_conf_disconnect(0, callPort);
+    auto status = pjsua_conf_connect(callPort, leg->confPort);
+    if (PJ_SUCCESS == status) {
+        status = pjsua_conf_connect(leg->confPort, callPort);
+    }
+    return status;
+}
+
+void ConferenceMixer::removeCall(pjsua_call_id callId)
+{
+    auto *leg = findLeg(callId);
+    if (nullptr != leg) {
+        deactivateLeg(*leg);
+        _freeLegs.push_back(leg);
+    }
+}
+
+bool ConferenceMixer::contains(pjsua_call_id callId) const
+{
+    return nullptr != findLeg(callId);
+}
+
+int ConferenceMixer::callCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return (0 < _activeCount) ? _activeCount - 1 : 0;
+}
+
+std::vector<pjsua_call_id> ConferenceMixer::calls() const
+{
+    std::vector<pjsua_call_id> ids;
+    for (const auto &leg: _legs) {
+        if ((0 <= leg.activeIndex) && (PJSUA_INVALID_ID != leg.callId)) {
+            ids.push_back(leg.callId);
+        }
+    }
+    return ids;
+}
+
+ConferenceMixer::Stats ConferenceMixer::stats() const
+{
+    Stats stats;
+    stats.frames = _frames.load(std::memory_order_relaxed);
+    stats.totalNs = _totalNs.load(std::memory_order_relaxed);
+    stats.maxNs = _maxNs.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(_mutex);
+    stats.participants = _activeCount;
+    return stats;
+}
+
+pj_status_t ConferenceMixer::activateLeg(Leg &leg, pjsua_call_id callId)
+{
+    const auto status = pjsua_conf_add_port(_pool, &leg.base, &leg.confPort);
+    if (PJ_SUCCESS != status) {
+        leg.confPort = PJSUA_INVALID_ID;
+        return status;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    leg.callId = callId;
+    leg.hasInput = false;
+    std::fill(leg.output.begin(), leg.output.end(), 0);
+    leg.servedRound = 0;
+    leg.activeIndex = _activeCount;
+    _active[static_cast<size_t>(_activeCount++)] = &leg;
+    return PJ_SUCCESS;
+}
+
+void ConferenceMixer::deactivateLeg(Leg &leg)
+{
+    //never call into the bridge with the mixer lock held
+    if (PJSUA_INVALID_ID != leg.confPort) {
+        pjsua_conf_remove_port(leg.confPort);
+        leg.confPort = PJSUA_INVALID_ID;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto *last = _active[static_cast<size_t>(--_activeCount)];
+    _active[static_cast<size_t>(leg.activeIndex)] = last;
+    last->activeIndex = leg.activeIndex;
+    leg.activeIndex = -1;
+    leg.callId = PJSUA_INVALID_ID;
+}
+
+ConferenceMixer::Leg* ConferenceMixer::findLeg(pjsua_call_id callId)
+{
+    return const_cast<Leg*>(static_cast<const ConferenceMixer*>(this)->findLeg(callId));
+}
+
+const ConferenceMixer::Leg* ConferenceMixer::findLeg(pjsua_call_id callId) const
+{
+    if (PJSUA_INVALID_ID == callId) {
+        return nullptr;
+    }
+    const auto it = std::find_if(_legs.begin(), _legs.end(), [callId](const Leg &leg) {
+        return (0 <= leg.activeIndex) && (callId == leg.callId);
+    });
+    return (it != _legs.end()) ? &*it : nullptr;
+}
+
+pj_status_t ConferenceMixer::putFrame(pjmedia_port *port, pjmedia_frame *frame)
+{
+    auto *leg = reinterpret_cast<Leg*>(port);
+    auto *mixer = leg->mixer;
+    std::lock_guard<std::mutex> lock(mixer->_mutex);
+    const auto frameBytes = mixer->_samplesPerFrame * sizeof(pj_int16_t);
+    if ((PJMEDIA_FRAME_TYPE_AUDIO == frame->type) && (frameBytes == frame->size)) {
+        std::memcpy(leg->input.data(), frame->buf, frameBytes);
+        leg->hasInput = true;
+    } else {
+        leg->hasInput = false;
+    }
+    return PJ_SUCCESS;
+}
+
+pj_status_t ConferenceMixer::getFrame(pjmedia_port *port, pjmedia_frame *frame)
+{
+    auto *leg = reinterpret_cast<Leg*>(port);
+    auto *mixer = leg->mixer;
+    auto *samples = static_cast<pj_int16_t*>(frame->buf);
+    frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+    frame->size = mixer->_samplesPerFrame * sizeof(pj_int16_t);
+
+    std::lock_guard<std::mutex> lock(mixer->_mutex);
+    if (0 > leg->activeIndex) {
+        //removed, the bridge may still read it once
+        std::fill_n(samples, mixer->_samplesPerFrame, 0);
+        return PJ_SUCCESS;
+    }
+    //the bridge reads every port before writing any: a second read of a leg starts a new frame
+    if (leg->servedRound == mixer->_round) {
+        mixer->mix();
+    }
+    leg->servedRound = mixer->_round;
+    std::copy(leg->output.begin(), leg->output.end(), samples);
+    return PJ_SUCCESS;
+}
+
+void ConferenceMixer::mix()
+{
+    const auto start = std::chrono::steady_clock::now();
+    std::fill(_sum.begin(), _sum.end(), 0);
+    for (int i = 0; i < _activeCount; ++i) {
+        const auto *leg = _active[static_cast<size_t>(i)];
+        if (leg->hasInput) {
+            AudioKernels::accumulate(_sum.data(), leg->input.data(), _samplesPerFrame);
+        }
+    }
+    for (int i = 0; i < _activeCount; ++i) {
+        auto *leg = _active[static_cast<size_t>(i)];
+        AudioKernels::mixMinus(leg->output.data(), _sum.data(), leg->hasInput ? leg->input.data() : nullptr,
+                               _samplesPerFrame);
+        //a leg that stops sending must not repeat its last frame
+        leg->hasInput = false;
+    }
+    ++_round;
+
+    const auto ns = static_cast<quint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                             std::chrono::steady_clock::now() - start).count());
+    _frames.fetch_add(1, std::memory_order_relaxed);
+    _totalNs.fetch_add(ns, std::memory_order_relaxed);
+    if (ns > _maxNs.load(std::memory_order_relaxed)) {
+        _maxNs.store(ns, std::memory_order_relaxed);
+    }
+}
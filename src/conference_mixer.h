@@ -0,0 +1,89 @@
+#pragma once
+
+#include "pjsua.h"
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/**
+ * Single mixing node for multi-party calls.
+ * Every participant (the local sound device and each call) is connected to
+ * its own leg port only, so the bridge holds two connections per party
+ * instead of a full mesh. Once per frame the inputs of all legs are summed,
+ * each leg then returns the sum minus its own input (mix-minus).
+ * The legs are allocated upfront, adding or removing a party is O(1).
+ */
+class ConferenceMixer
+{
+public:
+    struct Stats {
+        quint64 frames = 0;
+        quint64 totalNs = 0;
+        quint64 maxNs = 0;
+        int participants = 0;
+    };
+
+    ConferenceMixer() = default;
+    ~ConferenceMixer() {
+        release();
+    }
+
+    //the local leg is connected to the sound device
+    pj_status_t create();
+    pjsua_conf_port_id localPort() const { return _localConfPort; }
+    void release();
+
+    pj_status_t addCall(pjsua_call_id callId, pjsua_conf_port_id callPort);
+    //the call got a new conference port after a media update
+    pj_status_t attachCall(pjsua_call_id callId, pjsua_conf_port_id callPort);
+    void removeCall(pjsua_call_id callId);
+    bool contains(pjsua_call_id callId) const;
+    int callCount() const;
+    std::vector<pjsua_call_id> calls() const;
+
+    Stats stats() const;
+
+private:
+    Q_DISABLE_COPY_MOVE(ConferenceMixer)
+
+    enum { POOL_SIZE = 1024, BITS_PER_SAMPLE = 16, MAX_LEGS = PJSUA_MAX_CALLS + 1, LOCAL_LEG = 0 };
+
+    struct Leg {
+        pjmedia_port base;
+        ConferenceMixer *mixer = nullptr;
+        pjsua_call_id callId = PJSUA_INVALID_ID;
+        pjsua_conf_port_id confPort = PJSUA_INVALID_ID;
+        int activeIndex = -1;//position in _active, -1 when free
+        quint64 servedRound = 0;
+        bool hasInput = false;
+        std::vector<pj_int16_t> input;
+        std::vector<pj_int16_t> output;//sum minus input, computed by mix()
+    };
+
+    pj_status_t activateLeg(Leg &leg, pjsua_call_id callId);
+    void deactivateLeg(Leg &leg);
+    Leg* findLeg(pjsua_call_id callId);
+    const Leg* findLeg(pjsua_call_id callId) const;
+    static pj_status_t putFrame(pjmedia_port *port, pjmedia_frame *frame);
+    static pj_status_t getFrame(pjmedia_port *port, pjmedia_frame *frame);
+    void mix();
+
+    unsigned _clockRate = 0;
+    unsigned _samplesPerFrame = 0;
+    pj_pool_t *_pool = nullptr;
+    pjsua_conf_port_id _localConfPort = PJSUA_INVALID_ID;
+    std::array<Leg, MAX_LEGS> _legs;
+    std::vector<Leg*> _freeLegs;//GUI thread only
+
+    //held by the conference thread for a frame, by the GUI thread to add or remove a leg
+    mutable std::mutex _mutex;
+    std::array<Leg*, MAX_LEGS> _active{};
+    int _activeCount = 0;
+    std::vector<pj_int32_t> _sum;
+    quint64 _round = 1;
+
+    std::atomic<quint64> _frames{0};
+    std::atomic<quint64> _totalNs{0};
+    std::atomic<quint64> _maxNs{0};
+};
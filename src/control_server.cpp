@@ -0,0 +1,467 @@
+#include "control_server.h"
+#include "softphone.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMetaEnum>
+#include <QDebug>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+const QString JSON_RPC_VERSION = QStringLiteral("2.0");
+const QString DEFAULT_EVENTS[] = {"callState", "registration", "presence", "message", "error", "campaign"};
+const QString ALL_EVENTS[] = {"callState", "registration", "presence", "message", "error", "campaign", "stats"};
+
+bool intParam(const QJsonObject &params, const char *key, int &value)
+{
+    const auto param = params.value(key);
+    if (!param.isDouble()) {
+        return false;
+    }
+    value = param.toInt();
+    return true;
+}
+
+bool stringParam(const QJsonObject &params, const char *key, QString &value)
+{
+    const auto param = params.value(key);
+    if (!param.isString()) {
+        return false;
+    }
+    value = param.toString();
+    return true;
+}
+
+//optional, the account of the settings when missing
+bool accountParam(const QJsonObject &params, int &value)
+{
+    value = PJSUA_INVALID_ID;
+    return !params.contains("accountId") || intParam(params, "accountId", value);
+}
+
+bool boolParam(const QJsonObject &params, const char *key, bool &value)
+{
+    const auto param = params.value(key);
+    if (!param.isBool()) {
+        return false;
+    }
+    value = param.toBool();
+    return true;
+}
+
+QJsonArray toJsonArray(const QVector<int> &values)
+{
+    QJsonArray array;
+    for (const auto value: values) {
+        array.append(value);
+    }
+    return array;
+}
+}
+
+ControlServer::ControlServer(Softphone *softphone, QObject *parent)
+    : QObject(parent), _softphone(softphone), _server(new QLocalServer(this))
+{
+    registerMethods();
+    connect(_server, &QLocalServer::newConnection, this, &ControlServer::onNewConnection);
+
+    _statsTimer.setInterval(STATS_INTERVAL_MS);
+    connect(&_statsTimer, &QTimer::timeout, this, &ControlServer::sendStats);
+
+    connect(softphone, &Softphone::callStateChanged, this,
+            [this](int callId, const QString &state, const QString &userId, int accountId) {
+        QJsonObject params{{"callId", callId}, {"state", state}, {"accountId", accountId}};
+        if (!userId.isEmpty()) {
+            params["userId"] = userId;
+        }
+        notify("callState", params);
+    });
+    connect(softphone, &Softphone::accountRegistrationChanged, this,
+            [this](int accountId, bool registered, const QString &text) {
+        notify("registration", {{"accountId", accountId}, {"registered", registered}, {"text", text}});
+    });
+    connect(softphone, &Softphone::messageReceived, this,
+            [this](int accountId, const QString &from, const QString &text) {
+        notify("message", {{"accountId", accountId}, {"from", from}, {"text", text}});
+    });
+    connect(softphone, &Softphone::buddyStatusChanged, this, [this](int buddyId, const QString &status) {
+        notify("presence", {{"buddyId", buddyId}, {"status", status}});
+    });
+    connect(softphone, &Softphone::dialogMessageChanged, this, [this]() {
+        if (_softphone->dialogError() && !_softphone->dialogMessage().isEmpty()) {
+            notify("error", {{"message", _softphone->dialogMessage()}});
+        }
+    });
+    connect(softphone, &Softphone::campaignProgressChanged, this, [this]() {
+        notify("campaign", QJsonObject::fromVariantMap(_softphone->campaignProgress()));
+    });
+}
+
+ControlServer::~ControlServer()
+{
+    _server->close();
+}
+
+bool ControlServer::listen(const QString &name)
+{
+    //left behind by a crashed instance
+    QLocalServer::removeServer(name);
+    _server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (!_server->listen(name)) {
+        qCritical() << "Cannot listen on control socket" << name << ":" << _server->errorString();
+        return false;
+    }
+    qInfo() << "Control socket" << _server->fullServerName();
+    return true;
+}
+
+QString ControlServer::fullServerName() const
+{
+    return _server->fullServerName();
+}
+
+void ControlServer::registerMethods()
+{
+    _methods["makeCall"] = [this](const QJsonObject &params, QJsonValue &result) {
+        QString userId;
+        int accountId = PJSUA_INVALID_ID;
+        if (!stringParam(params, "userId", userId) || !accountParam(params, accountId)) {
+            return false;
+        }
+        result = _softphone->makeCall(userId, accountId);
+        return true;
+    };
+    _methods["answer"] = [this](const QJsonObject &params, QJsonValue &result) {
+        int callId = 0;
+        if (!intParam(params, "callId", callId)) {
+            return false;
+        }
+        result = _softphone->answer(callId);
+        return true;
+    };
+    _methods["hangup"] = [this](const QJsonObject &params, QJsonValue &result) {
+        int callId = 0;
+        if (!intParam(params, "callId", callId)) {
+            return false;
+        }
+        result = _softphone->hangup(callId);
+        return true;
+    };
+    _methods["hangupAll"] = [this](const QJsonObject &, QJsonValue &result) {
+        _softphone->hangupAll();
+        result = true;
+        return true;
+    };
+    _methods["sendDtmf"] = [this](const QJsonObject &params, QJsonValue &result) {
+        QString dtmf;
+        if (!stringParam(params, "dtmf", dtmf)) {
+            return false;
+        }
+        result = _softphone->sendDtmf(dtmf);
+        return true;
+    };
+    _methods["sendText"] = [this](const QJsonObject &params, QJsonValue &result) {
+        QString userId;
+        QString text;
+        int accountId = PJSUA_INVALID_ID;
+        if (!stringParam(params, "userId", userId) || !stringParam(params, "text", text) ||
+                !accountParam(params, accountId)) {
+            return false;
+        }
+        result = _softphone->sendText(userId, text, accountId);
+        return true;
+    };
+    _methods["swap"] = [this](const QJsonObject &params, QJsonValue &result) {
+        int callId = 0;
+        if (!intParam(params, "callId", callId)) {
+            return false;
+        }
+        result = _softphone->swap(callId);
+        return true;
+    };
+    _methods["merge"] = [this](const QJsonObject &params, QJsonValue &result) {
+        int callId = 0;
+        if (!intParam(params, "callId", callId)) {
+            return false;
+        }
+        result = _softphone->merge(callId);
+        return true;
+    };
+    _methods["hold"] = [this](const QJsonObject &params, QJsonValue &result) {
+        int callId = 0;
+        bool value = true;
+        if (!intParam(params, "callId", callId) || (params.contains("hold") && !boolParam(params, "hold", value))) {
+            return false;
+        }
+        result = _softphone->hold(value, callId);
+        return true;
+    };
+    _methods["mute"] = [this](const QJsonObject &params, QJsonValue &result) {
+        int callId = 0;
+        bool value = true;
+        if (!intParam(params, "callId", callId) || (params.contains("mute") && !boolParam(params, "mute", value))) {
+            return false;
+        }
+        result = _softphone->mute(value, callId);
+        return true;
+    };
+    _methods["registerAccount"] = [this](const QJsonObject &, QJsonValue &result) {
+        result = _softphone->registerAccount();
+        return true;
+    };
+    _methods["unregisterAccount"] = [this](const QJsonObject &, QJsonValue &result) {
+        result = _softphone->unregisterAccount();
+        return true;
+    };
+    _methods["addAccount"] = [this](const QJsonObject &params, QJsonValue &result) {
+        if (params.value("sipServer").toString().isEmpty() || params.value("userName").toString().isEmpty()) {
+            return false;
+        }
+        //the new account ID, -1 on failure
+        result = _softphone->addAccount(params.toVariantMap());
+        return true;
+    };
+    _methods["removeAccount"] = [this](const QJsonObject &params, QJsonValue &result) {
+        int accountId = 0;
+        if (!intParam(params, "accountId", accountId)) {
+            return false;
+        }
+        result = _softphone->removeAccount(accountId);
+        return true;
+    };
+    _methods["accounts"] = [this](const QJsonObject &, QJsonValue &result) {
+        result = QJsonArray::fromVariantList(_softphone->accounts());
+        return true;
+    };
+    _methods["startCampaign"] = [this](const QJsonObject &params, QJsonValue &result) {
+        QString filePath;
+        QString spec;
+        if (!stringParam(params, "file", filePath) || (params.contains("config") && !stringParam(params, "config", spec))) {
+            return false;
+        }
+        result = _softphone->startCampaign(filePath, spec);
+        return true;
+    };
+    _methods["stopCampaign"] = [this](const QJsonObject &, QJsonValue &result) {
+        _softphone->stopCampaign();
+        result = true;
+        return true;
+    };
+    _methods["campaignStatus"] = [this](const QJsonObject &, QJsonValue &result) {
+        result = QJsonObject::fromVariantMap(_softphone->campaignProgress());
+        return true;
+    };
+    _methods["callStats"] = [this](const QJsonObject &params, QJsonValue &result) {
+        int callId = 0;
+        if (!intParam(params, "callId", callId)) {
+            return false;
+        }
+        result = QJsonObject::fromVariantMap(_softphone->callStats(callId));
+        return true;
+    };
+    _methods["writeCallTrace"] = [this](const QJsonObject &params, QJsonValue &result) {
+        QString filePath;
+        if (!stringParam(params, "file", filePath)) {
+            return false;
+        }
+        result = _softphone->writeCallTrace(filePath);
+        return true;
+    };
+    _methods["callSetupStats"] = [this](const QJsonObject &, QJsonValue &result) {
+        result = QJsonObject::fromVariantMap(_softphone->callSetupStats());
+        return true;
+    };
+    _methods["startupReport"] = [this](const QJsonObject &, QJsonValue &result) {
+        result = QJsonObject::fromVariantMap(_softphone->startupReport());
+        return true;
+    };
+    _methods["status"] = [this](const QJsonObject &, QJsonValue &result) {
+        const auto *calls = _softphone->activeCallModel();
+        const auto status = QMetaEnum::fromType<Softphone::SipRegistrationStatus>()
+                .valueToKey(static_cast<int>(_softphone->sipRegistrationStatus()));
+        result = QJsonObject{{"registration", status},
+                             {"registrationText", _softphone->sipRegistrationText()},
+                             {"accounts", QJsonArray::fromVariantList(_softphone->accounts())},
+                             {"calls", toJsonArray(calls->confirmedCallsId(true))},
+                             {"confirmedCalls", toJsonArray(calls->confirmedCallsId())}};
+        return true;
+    };
+}
+
+void ControlServer::onNewConnection()
+{
+    while (_server->hasPendingConnections()) {
+        auto *socket = _server->nextPendingConnection();
+        Client client;
+        for (const auto &event: DEFAULT_EVENTS) {
+            client.events.insert(event);
+        }
+        _clients.insert(socket, client);
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            onReadyRead(socket);
+        });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            _clients.remove(socket);
+            if (!hasSubscribers("stats")) {
+                _statsTimer.stop();
+            }
+            socket->deleteLater();
+        });
+        qDebug() << "Control client connected," << _clients.size() << "clients";
+    }
+}
+
+void ControlServer::onReadyRead(QLocalSocket *socket)
+{
+    auto it = _clients.find(socket);
+    if (it == _clients.end()) {
+        return;
+    }
+    it->buffer.append(socket->readAll());
+    int end = 0;
+    while (0 <= (end = it->buffer.indexOf('\n'))) {
+        const auto message = it->buffer.left(end).trimmed();
+        it->buffer.remove(0, end + 1);
+        if (!message.isEmpty()) {
+            processMessage(socket, message);
+            //the client may be gone after a reply
+            it = _clients.find(socket);
+            if (it == _clients.end()) {
+                return;
+            }
+        }
+    }
+    if (MAX_LINE_SIZE < it->buffer.size()) {
+        qWarning() << "Control message too long, closing the connection";
+        it->buffer.clear();
+        socket->disconnectFromServer();
+    }
+}
+
+void ControlServer::processMessage(QLocalSocket *socket, const QByteArray &message)
+{
+    QJsonParseError parseError{};
+    const auto document = QJsonDocument::fromJson(message, &parseError);
+    if (QJsonParseError::NoError != parseError.error) {
+        sendError(socket, QJsonValue(QJsonValue::Null), PARSE_ERROR, parseError.errorString());
+        return;
+    }
+    const auto request = document.object();
+    const auto id = request.value("id");
+    const auto method = request.value("method").toString();
+    const auto params = request.value("params");
+    if (!document.isObject() || (JSON_RPC_VERSION != request.value("jsonrpc").toString()) ||
+            method.isEmpty() || (!params.isUndefined() && !params.isObject())) {
+        sendError(socket, id.isUndefined() ? QJsonValue(QJsonValue::Null) : id, INVALID_REQUEST,
+                  "Invalid request");
+        return;
+    }
+    //no reply to notifications
+    const bool reply = !id.isUndefined();
+
+    if (("subscribe" == method) || ("unsubscribe" == method)) {
+        const auto events = params.toObject().value("events");
+        if (!events.isArray()) {
+            if (reply) {
+                sendError(socket, id, INVALID_PARAMS, "Expected an array of events");
+            }
+            return;
+        }
+        auto &subscribed = _clients[socket].events;
+        for (const auto &event: events.toArray()) {
+            const auto name = event.toString();
+            if (std::find(std::begin(ALL_EVENTS), std::end(ALL_EVENTS), name) == std::end(ALL_EVENTS)) {
+                continue;
+            }
+            if ("subscribe" == method) {
+                subscribed.insert(name);
+            } else {
+                subscribed.remove(name);
+            }
+        }
+        if (hasSubscribers("stats")) {
+            if (!_statsTimer.isActive()) {
+                _statsTimer.start();
+            }
+        } else {
+            _statsTimer.stop();
+        }
+        if (reply) {
+            sendResponse(socket, id, QJsonArray::fromStringList(subscribed.values()));
+        }
+        return;
+    }
+
+    const auto handler = _methods.constFind(method);
+    if ((handler == _methods.constEnd()) || _softphone.isNull()) {
+        if (reply) {
+            sendError(socket, id, METHOD_NOT_FOUND, "Method not found: " + method);
+        }
+        return;
+    }
+    QJsonValue result;
+    if (!(*handler)(params.toObject(), result)) {
+        if (reply) {
+            sendError(socket, id, INVALID_PARAMS, "Invalid parameters for " + method);
+        }
+        return;
+    }
+    if (reply) {
+        sendResponse(socket, id, result);
+    }
+}
+
+void ControlServer::sendResponse(QLocalSocket *socket, const QJsonValue &id, const QJsonValue &result)
+{
+    const QJsonObject response{{"jsonrpc", JSON_RPC_VERSION}, {"id", id}, {"result", result}};
+    socket->write(QJsonDocument(response).toJson(QJsonDocument::Compact) + '\n');
+}
+
+void ControlServer::sendError(QLocalSocket *socket, const QJsonValue &id, int code, const QString &message)
+{
+    const QJsonObject error{{"code", code}, {"message", message}};
+    const QJsonObject response{{"jsonrpc", JSON_RPC_VERSION}, {"id", id}, {"error", error}};
+    socket->write(QJsonDocument(response).toJson(QJsonDocument::Compact) + '\n');
+}
+
+void ControlServer::notify(const QString &event, const QJsonObject &params)
+{
+    if (!hasSubscribers(event)) {
+        return;
+    }
+    const QJsonObject notification{{"jsonrpc", JSON_RPC_VERSION}, {"method", event}, {"params", params}};
+    const auto line = QJsonDocument(notification).toJson(QJsonDocument::Compact) + '\n';
+    for (auto it = _clients.cbegin(); it != _clients.cend(); ++it) {
+        if (it->events.contains(event)) {
+            it.key()->write(line);
+        }
+    }
+}
+
+bool ControlServer::hasSubscribers(const QString &event) const
+{
+    for (const auto &client: _clients) {
+        if (client.events.contains(event)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ControlServer::sendStats()
+{
+    if (_softphone.isNull()) {
+        return;
+    }
+    const auto callIds = _softphone->activeCallModel()->confirmedCallsId();
+    for (const auto callId: callIds) {
+        auto stats = QJsonObject::fromVariantMap(_softphone->callStats(callId));
+        if (stats.isEmpty()) {
+            continue;
+        }
+        stats["callId"] = callId;
+        notify("stats", stats);
+    }
+}
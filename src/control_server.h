@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+#include <QHash>
+#include <QSet>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QTimer>
+#include <functional>
+
+class QLocalServer;
+class QLocalSocket;
+class Softphone;
+
+/**
+ * JSON-RPC 2.0 control of the softphone over a local socket (a Unix-domain
+ * socket, a named pipe on Windows), one JSON message per line.
+ * Requests take their parameters by name, e.g.
+ *   {"jsonrpc":"2.0","id":1,"method":"makeCall","params":{"userId":"1234"}}
+ * Events are sent as notifications to the clients subscribed to them:
+ * callState, registration, presence, message, error, campaign (progress of
+ * the dialing campaign) and stats (every second for the confirmed calls). Calls, messages and registrations carry the ID
+ * of their account, requests without one use the account of the settings.
+ */
+class ControlServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ControlServer(Softphone *softphone, QObject *parent = nullptr);
+    ~ControlServer();
+
+    //a relative name is placed in the temporary directory
+    bool listen(const QString &name);
+    QString fullServerName() const;
+
+private:
+    Q_DISABLE_COPY_MOVE(ControlServer)
+
+    enum { PARSE_ERROR = -32700, INVALID_REQUEST = -32600, METHOD_NOT_FOUND = -32601,
+           INVALID_PARAMS = -32602, STATS_INTERVAL_MS = 1000, MAX_LINE_SIZE = 64 * 1024 };
+
+    struct Client {
+        QByteArray buffer;
+        QSet<QString> events;
+    };
+    //fills the result, false for invalid parameters
+    using Method = std::function<bool(const QJsonObject &params, QJsonValue &result)>;
+
+    void registerMethods();
+    void onNewConnection();
+    void onReadyRead(QLocalSocket *socket);
+    void processMessage(QLocalSocket *socket, const QByteArray &message);
+    static void sendResponse(QLocalSocket *socket, const QJsonValue &id, const QJsonValue &result);
+    static void sendError(QLocalSocket *socket, const QJsonValue &id, int code, const QString &message);
+    void notify(const QString &event, const QJsonObject &params);
+    bool hasSubscribers(const QString &event) const;
+    void sendStats();
+
+    QPointer<Softphone> _softphone;
+    QLocalServer *_server = nullptr;
+    QHash<QLocalSocket*, Client> _clients;
+    QHash<QString, Method> _methods;
+    QTimer _statsTimer;
+};
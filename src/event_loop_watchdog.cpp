@@ -0,0 +1,149 @@
+#include "event_loop_watchdog.h"
+#include "metrics.h"
+#include "monotonic_clock.h"
+#include <QCoreApplication>
+#include <QEvent>
+#include <QMetaEnum>
+#include <QDebug>
+#include <chrono>
+
+namespace {
+//innermost Scope of the watched thread
+std::atomic<const char*> currentScope{nullptr};
+//what the watched thread dispatches, the meta object strings are static,
+//the monitor thread can read them anytime
+std::atomic<const char*> currentClassName{nullptr};
+std::atomic<int> currentEventType{0};
+//set on the thread of the watchdog while it runs
+thread_local bool isWatchedThread = false;
+}
+
+EventLoopWatchdog::Scope::Scope(const char *name)
+    : _previous(currentScope.exchange(name, std::memory_order_relaxed))
+{
+}
+
+EventLoopWatchdog::Scope::~Scope()
+{
+    currentScope.store(_previous, std::memory_order_relaxed);
+}
+
+EventLoopWatchdog::Dispatching::Dispatching(QObject *receiver, QEvent *event) : _watched(isWatchedThread)
+{
+    if (_watched) {
+        _previousClassName = currentClassName.exchange(receiver->metaObject()->className(),
+                                                       std::memory_order_relaxed);
+        _previousEventType = currentEventType.exchange(event->type(), std::memory_order_relaxed);
+    }
+}
+
+EventLoopWatchdog::Dispatching::~Dispatching()
+{
+    //null once back in the event loop, a stall outside any event is not blamed on the last one
+    if (_watched) {
+        currentClassName.store(_previousClassName, std::memory_order_relaxed);
+        currentEventType.store(_previousEventType, std::memory_order_relaxed);
+    }
+}
+
+EventLoopWatchdog::EventLoopWatchdog(int thresholdMs, QObject *parent) : QObject(parent),
+    //below two heartbeats every timer jitter would be a stall
+    _thresholdNs(1000000LL * qMax<int>(thresholdMs, 2 * HEARTBEAT_MS)),
+    _lag(&Metrics::instance().histogram("bcphone_event_loop_lag_seconds",
+                                        "Delay of the heartbeat timer of the GUI thread")),
+    _stallDuration(&Metrics::instance().histogram("bcphone_event_loop_stall_seconds",
+                                                  "Duration of the stalls of the GUI thread")),
+    _stalls(&Metrics::instance().counter("bcphone_event_loop_stalls_total",
+                                         "Stalls of the GUI thread over the threshold"))
+{
+    //the events are reported by WatchedApplication
+    isWatchedThread = true;
+
+    _lastBeatNs = monotonicNs();
+    _heartbeat.setInterval(HEARTBEAT_MS);
+    _heartbeat.setTimerType(Qt::PreciseTimer);
+    connect(&_heartbeat, &QTimer::timeout, this, &EventLoopWatchdog::onHeartbeat);
+    _heartbeat.start();
+
+    _monitor = std::thread(&EventLoopWatchdog::monitor, this);
+    qInfo() << "Event loop watchdog started, threshold" << _thresholdNs / 1000000 << "ms";
+}
+
+EventLoopWatchdog::~EventLoopWatchdog()
+{
+    {
+        std::lock_guard<std::mutex> lock(_monitorMutex);
+        _quit = true;
+    }
+    _monitorWakeup.notify_one();
+    _monitor.join();
+    isWatchedThread = false;
+}
+
+void EventLoopWatchdog::onHeartbeat()
+{
+    const auto timeNs = monotonicNs();
+    const auto previousBeatNs = _lastBeatNs.exchange(timeNs, std::memory_order_relaxed);
+    const auto gapNs = timeNs - previousBeatNs;
+    _lag->record((gapNs - 1000000LL * HEARTBEAT_MS) / 1000);
+    if (gapNs < _thresholdNs) {
+        return;
+    }
+    _stalls->add();
+    _stallDuration->record(gapNs / 1000);
+
+    QString where;
+    {
+        std::lock_guard<std::mutex> lock(_stallMutex);
+        if (previousBeatNs == _stallBeatNs) {
+            where = "in " + toString(_stallDispatch);
+        }
+    }
+    //the dispatch is only known when the stall lasted long enough for the monitor to see it
+    qWarning() << "Event loop stalled for" << gapNs / 1000000 << "ms" << where;
+}
+
+void EventLoopWatchdog::monitor()
+{
+    const auto period = std::chrono::nanoseconds(_thresholdNs / 4);
+    std::unique_lock<std::mutex> lock(_monitorMutex);
+    while (!_monitorWakeup.wait_for(lock, period, [this]() { return _quit; })) {
+        const auto lastBeatNs = _lastBeatNs.load(std::memory_order_relaxed);
+        const auto blockedNs = monotonicNs() - lastBeatNs;
+        if ((blockedNs < _thresholdNs) || (lastBeatNs == _stallBeatNs)) {
+            //once per stall, the monitor is the only writer
+            continue;
+        }
+        //taken while the thread is still blocked in it
+        const auto dispatch = currentDispatch();
+        {
+            std::lock_guard<std::mutex> stallLock(_stallMutex);
+            _stallDispatch = dispatch;
+            _stallBeatNs = lastBeatNs;
+        }
+        qWarning() << "Event loop blocked for" << blockedNs / 1000000 << "ms in" << toString(dispatch);
+    }
+}
+
+EventLoopWatchdog::Dispatch EventLoopWatchdog::currentDispatch() const
+{
+    Dispatch dispatch;
+    dispatch.className = currentClassName.load(std::memory_order_relaxed);
+    dispatch.eventType = currentEventType.load(std::memory_order_relaxed);
+    dispatch.scope = currentScope.load(std::memory_order_relaxed);
+    return dispatch;
+}
+
+QString EventLoopWatchdog::toString(const Dispatch &dispatch)
+{
+    QString text("no event");
+    if (nullptr != dispatch.className) {
+        const auto eventType = QMetaEnum::fromType<QEvent::Type>().valueToKey(dispatch.eventType);
+        text = QString::fromLatin1(dispatch.className) + ' ' +
+                (nullptr != eventType ? QString::fromLatin1(eventType) : QString::number(dispatch.eventType));
+    }
+    if (nullptr != dispatch.scope) {
+        text += QString(" [%1]").arg(dispatch.scope);
+    }
+    return text;
+}
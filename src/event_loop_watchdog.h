@@ -0,0 +1,107 @@
+#pragma once
+
+#include <QCoreApplication>
+#include <QObject>
+#include <QTimer>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+class Counter;
+class HdrHistogram;
+
+/**
+ * Stall detection of the event loop of the GUI thread, where all the SIP
+ * events are processed. A heartbeat timer of the watched thread measures the
+ * lag of the loop; a monitor thread notices when the heartbeat stops and
+ * reports, while the thread is still blocked, what it is dispatching: the
+ * class of the receiver and the type of the event, as seen by the notify() of
+ * WatchedApplication, plus the innermost Scope (e.g. the slot processing a
+ * SIP event or a settings save). QML bindings are not named one by one, a
+ * stall in QML shows the class of the QML type receiving the event
+ * (e.g. CallHistory_QMLTYPE_12). Stalls over the
+ * threshold are logged and counted in bcphone_event_loop_stalls_total and
+ * bcphone_event_loop_stall_seconds, the lag goes to bcphone_event_loop_lag_seconds.
+ */
+class EventLoopWatchdog : public QObject
+{
+    Q_OBJECT
+public:
+    enum { DEFAULT_THRESHOLD_MS = 200 };
+
+    //names the work of the GUI thread for the stall reports, the name must be static (a literal or Q_FUNC_INFO)
+    class Scope {
+    public:
+        explicit Scope(const char *name);
+        ~Scope();
+    private:
+        Q_DISABLE_COPY_MOVE(Scope)
+        const char *_previous = nullptr;
+    };
+
+    //the event being delivered, restores the outer one when the delivery returns
+    class Dispatching {
+    public:
+        Dispatching(QObject *receiver, QEvent *event);
+        ~Dispatching();
+    private:
+        Q_DISABLE_COPY_MOVE(Dispatching)
+        bool _watched = false;
+        const char *_previousClassName = nullptr;
+        int _previousEventType = 0;
+    };
+
+    //must be created on the watched thread, after the application
+    explicit EventLoopWatchdog(int thresholdMs = DEFAULT_THRESHOLD_MS, QObject *parent = nullptr);
+    ~EventLoopWatchdog();
+
+private:
+    Q_DISABLE_COPY_MOVE(EventLoopWatchdog)
+
+    enum { HEARTBEAT_MS = 50 };
+
+    struct Dispatch {
+        const char *className = nullptr;
+        int eventType = 0;
+        const char *scope = nullptr;
+    };
+
+    void onHeartbeat();
+    void monitor();
+    Dispatch currentDispatch() const;
+    static QString toString(const Dispatch &dispatch);
+
+    const qint64 _thresholdNs;
+    QTimer _heartbeat;
+    std::atomic<qint64> _lastBeatNs{0};
+    //reported by the monitor while the stall lasts, read once it ended
+    std::mutex _stallMutex;
+    Dispatch _stallDispatch;
+    qint64 _stallBeatNs = 0;//heartbeat before the reported stall
+
+    std::thread _monitor;
+    std::mutex _monitorMutex;
+    std::condition_variable _monitorWakeup;
+    bool _quit = false;
+
+    HdrHistogram *_lag = nullptr;
+    HdrHistogram *_stallDuration = nullptr;
+    Counter *_stalls = nullptr;
+};
+
+/**
+ * Application of the watched thread, QCoreApplication or QApplication: tells
+ * the watchdog which receiver and event are dispatched, until they return.
+ */
+template<typename Application>
+class WatchedApplication : public Application
+{
+public:
+    WatchedApplication(int &argc, char **argv) : Application(argc, argv) {}
+
+    bool notify(QObject *receiver, QEvent *event) override {
+        const EventLoopWatchdog::Dispatching dispatching(receiver, event);
+        return Application::notify(receiver, event);
+    }
+};
@@ -0,0 +1,92 @@
+#include "file_audio.h"
+#include <QDateTime>
+#include <QDir>
+#include <QDebug>
+#include <string>
+
+pj_status_t FileAudio::connectCall(pjsua_call_id callId, pjsua_conf_port_id confPort)
+{
+    if (PJSUA_INVALID_ID == confPort) {
+        return PJ_EINVAL;
+    }
+    if (!_playFile.isEmpty()) {
+        //created with the first call, PJSUA must be running
+        auto status = createPlayer();
+        if (PJ_SUCCESS != status) {
+            return status;
+        }
+        status = pjsua_conf_connect(pjsua_player_get_conf_port(_playerId), confPort);
+        if (PJ_SUCCESS != status) {
+            return status;
+        }
+    }
+    if (_recordDir.isEmpty() || (0 != _recorderIds.count(callId))) {
+        return PJ_SUCCESS;
+    }
+    if (!QDir().mkpath(_recordDir)) {
+        qWarning() << "Cannot create record directory" << _recordDir;
+        return PJ_ENOTFOUND;
+    }
+    const auto fileName = QString("%1/call_%2_%3.wav").arg(_recordDir).arg(callId)
+            .arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss-zzz"));
+    const std::string fileNameStr = QDir::toNativeSeparators(fileName).toStdString();
+    pj_str_t name = pj_str(const_cast<char*>(fileNameStr.c_str()));
+    pjsua_recorder_id recorderId = PJSUA_INVALID_ID;
+    auto status = pjsua_recorder_create(&name, 0, nullptr, -1, 0, &recorderId);
+    if (PJ_SUCCESS != status) {
+        return status;
+    }
+    status = pjsua_conf_connect(confPort, pjsua_recorder_get_conf_port(recorderId));
+    if (PJ_SUCCESS != status) {
+        pjsua_recorder_destroy(recorderId);
+        return status;
+    }
+    _recorderIds[callId] = recorderId;
+    qInfo() << "Recording call" << callId << "to" << fileName;
+    return PJ_SUCCESS;
+}
+
+void FileAudio::releaseCall(pjsua_call_id callId)
+{
+    //the bridge already disconnected the ports of the call
+    const auto it = _recorderIds.find(callId);
+    if (it == _recorderIds.end()) {
+        return;
+    }
+    pjsua_recorder_destroy(it->second);
+    _recorderIds.erase(it);
+}
+
+void FileAudio::release()
+{
+    if (PJSUA_STATE_RUNNING != pjsua_get_state()) {
+        _recorderIds.clear();
+        _playerId = PJSUA_INVALID_ID;
+        return;
+    }
+    for (const auto &recorder: _recorderIds) {
+        pjsua_recorder_destroy(recorder.second);
+    }
+    _recorderIds.clear();
+    if (PJSUA_INVALID_ID != _playerId) {
+        pjsua_player_destroy(_playerId);
+        _playerId = PJSUA_INVALID_ID;
+    }
+}
+
+pj_status_t FileAudio::createPlayer()
+{
+    if (PJSUA_INVALID_ID != _playerId) {
+        return PJ_SUCCESS;
+    }
+    //loops until released
+    const std::string fileNameStr = QDir::toNativeSeparators(_playFile).toStdString();
+    pj_str_t name = pj_str(const_cast<char*>(fileNameStr.c_str()));
+    const auto status = pjsua_player_create(&name, 0, &_playerId);
+    if (PJ_SUCCESS != status) {
+        _playerId = PJSUA_INVALID_ID;
+        return status;
+    }
+    qInfo() << "Playing" << _playFile << "to the calls";
+    return PJ_SUCCESS;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "pjsua.h"
+#include <QString>
+#include <unordered_map>
+
+/**
+ * Audio of a headless engine: PJSUA runs on the null sound device, which
+ * only clocks the conference bridge, and calls are connected to WAV files
+ * instead of a microphone and speakers. Every call hears the same looping
+ * player, the received audio of each call can be written to its own file.
+ * An empty play file sends silence, an empty record directory records nothing.
+ */
+class FileAudio
+{
+public:
+    FileAudio(const QString &playFile, const QString &recordDir)
+        : _playFile(playFile), _recordDir(recordDir) {}
+    ~FileAudio() {
+        release();
+    }
+
+    const QString& playFile() const { return _playFile; }
+    const QString& recordDir() const { return _recordDir; }
+
+    //instead of the sound device slot
+    pj_status_t connectCall(pjsua_call_id callId, pjsua_conf_port_id confPort);
+    void releaseCall(pjsua_call_id callId);
+    void release();
+
+private:
+    Q_DISABLE_COPY_MOVE(FileAudio)
+
+    pj_status_t createPlayer();
+
+    QString _playFile;
+    QString _recordDir;
+    pjsua_player_id _playerId = PJSUA_INVALID_ID;
+    std::unordered_map<pjsua_call_id, pjsua_recorder_id> _recorderIds;
+};
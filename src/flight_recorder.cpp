@@ -0,0 +1,224 @@
+#include "flight_recorder.h"
+#include <QDateTime>
+#include <QFile>
+#include <QTextStream>
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+pj_status_t FlightRecorder::create(int durationSec)
+{
+    if (nullptr != _pool) {
+        return PJ_EEXISTS;
+    }
+    if (0 >= durationSec) {
+        return PJ_EINVAL;
+    }
+
+    //each direction is recorded as mono at the bridge clock rate
+    pjsua_conf_port_info bridgeInfo{};
+    auto status = pjsua_conf_get_port_info(0, &bridgeInfo);
+    if (PJ_SUCCESS != status) {
+        return status;
+    }
+    if (1 != bridgeInfo.channel_count) {
+        qCritical() << "Flight recorder needs a mono bridge";
+        return PJMEDIA_EBADFMT;
+    }
+    _clockRate = bridgeInfo.clock_rate;
+    _samplesPerFrame = bridgeInfo.samples_per_frame;
+
+    for (auto &history: _history) {
+        history.samples.assign(static_cast<size_t>(durationSec) * _clockRate, 0);
+        history.written = 0;
+        history.endTimestamp = 0;
+    }
+    _rtcpSamples.assign(static_cast<size_t>(durationSec / RTCP_SAMPLE_PERIOD_S + 1), RtcpSample{});
+    _rtcpWritten = 0;
+
+    _pool = pjsua_pool_create("flightRec", POOL_SIZE, POOL_SIZE);
+    if (nullptr == _pool) {
+        release();
+        return PJ_ENOMEM;
+    }
+    for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
+        status = addPort(static_cast<Channel>(ch));
+        if (PJ_SUCCESS != status) {
+            release();
+            return status;
+        }
+    }
+    qDebug() << "Created flight recorder" << durationSec << "s at" << _clockRate << "Hz";
+    return PJ_SUCCESS;
+}
+
+void FlightRecorder::release()
+{
+    for (auto &confPort: _confPort) {
+        if (PJSUA_INVALID_ID != confPort) {
+            pjsua_conf_remove_port(confPort);
+            confPort = PJSUA_INVALID_ID;
+        }
+    }
+    if (nullptr != _pool) {
+        pj_pool_release(_pool);
+        _pool = nullptr;
+    }
+    for (auto &history: _history) {
+        history.samples.clear();
+        history.samples.shrink_to_fit();
+    }
+    _rtcpSamples.clear();
+}
+
+void FlightRecorder::addRtcpSample(const pjmedia_rtcp_stat &stat)
+{
+    if (_rtcpSamples.empty()) {
+        return;
+    }
+    auto &sample = _rtcpSamples[_rtcpWritten % _rtcpSamples.size()];
+    sample.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    sample.rxPackets = stat.rx.pkt;
+    sample.rxLoss = stat.rx.loss;
+    sample.rxJitterUs = stat.rx.jitter.last;
+    sample.txLoss = stat.tx.loss;
+    sample.rttUs = stat.rtt.last;
+    ++_rtcpWritten;
+}
+
+bool FlightRecorder::dump(const QString &basePath)
+{
+    if (nullptr == _pool) {
+        return false;
+    }
+
+    //snapshot the common time span of both directions
+    std::vector<pj_int16_t> interleaved;
+    {
+        std::lock_guard<std::mutex> lock(_historyMutex);
+        pj_uint64_t start = 0;
+        pj_uint64_t end = UINT64_MAX;
+        for (const auto &history: _history) {
+            const auto count = std::min<pj_uint64_t>(history.written, history.samples.size());
+            start = std::max(start, history.endTimestamp - count);
+            end = std::min(end, history.endTimestamp);
+        }
+        if (end > start) {
+            const auto length = static_cast<size_t>(end - start);
+            interleaved.resize(CHANNEL_COUNT * length);
+            for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
+                const auto &history = _history[ch];
+                const auto capacity = history.samples.size();
+                auto index = history.written - (history.endTimestamp - start);
+                for (size_t i = 0; i < length; ++i, ++index) {
+                    interleaved[CHANNEL_COUNT * i + ch] = history.samples[index % capacity];
+                }
+            }
+        }
+    }
+
+    if (!writeWav(basePath + ".wav", _clockRate, interleaved)) {
+        return false;
+    }
+
+    QFile csv(basePath + ".csv");
+    if (!csv.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qCritical() << "Cannot open" << csv.fileName() << csv.errorString();
+        return false;
+    }
+    QTextStream out(&csv);
+    out << "timestamp_ms,rx_packets,rx_loss,rx_jitter_us,tx_loss,rtt_us\n";
+    const auto count = std::min(_rtcpWritten, _rtcpSamples.size());
+    for (size_t i = _rtcpWritten - count; i < _rtcpWritten; ++i) {
+        const auto &sample = _rtcpSamples[i % _rtcpSamples.size()];
+        out << sample.timestampMs << ',' << sample.rxPackets << ',' << sample.rxLoss << ','
+            << sample.rxJitterUs << ',' << sample.txLoss << ',' << sample.rttUs << '\n';
+    }
+    qInfo() << "Flight recorder dumped" << interleaved.size() / CHANNEL_COUNT << "samples and"
+            << count << "RTCP samples to" << basePath;
+    return true;
+}
+
+pj_status_t FlightRecorder::addPort(Channel channel)
+{
+    auto *port = PJ_POOL_ZALLOC_T(_pool, TapPort);
+    port->recorder = this;
+    port->channel = channel;
+    pj_str_t name = pj_str(const_cast<char*>(LOCAL == channel ? "flightRecLocal" : "flightRecRemote"));
+    pjmedia_port_info_init(&port->base.info, &name, PJMEDIA_SIGNATURE('B', 'C', 'F', 'R'),
+                           _clockRate, 1, BITS_PER_SAMPLE, _samplesPerFrame);
+    port->base.put_frame = &FlightRecorder::putFrame;
+    port->base.get_frame = &FlightRecorder::getFrame;
+    return pjsua_conf_add_port(_pool, &port->base, &_confPort[channel]);
+}
+
+pj_status_t FlightRecorder::putFrame(pjmedia_port *port, pjmedia_frame *frame)
+{
+    //runs on the media thread, only copies into the preallocated history
+    const auto *tapPort = reinterpret_cast<TapPort*>(port);
+    auto *recorder = tapPort->recorder;
+    const auto frameSamples = recorder->_samplesPerFrame;
+    const bool hasAudio = (PJMEDIA_FRAME_TYPE_AUDIO == frame->type) &&
+            (frameSamples * sizeof(pj_int16_t) <= frame->size);
+    const auto *samples = static_cast<const pj_int16_t*>(frame->buf);
+
+    std::lock_guard<std::mutex> lock(recorder->_historyMutex);
+    auto &history = recorder->_history[tapPort->channel];
+    const auto capacity = history.samples.size();
+    auto start = static_cast<size_t>(history.written % capacity);
+    for (unsigned i = 0; i < frameSamples;) {
+        const auto count = std::min<size_t>(frameSamples - i, capacity - start);
+        if (hasAudio) {
+            std::copy_n(samples + i, count, &history.samples[start]);
+        } else {
+            std::fill_n(&history.samples[start], count, 0);
+        }
+        i += static_cast<unsigned>(count);
+        start = 0;
+    }
+    history.written += frameSamples;
+    history.endTimestamp = frame->timestamp.u64 + frameSamples;
+    return PJ_SUCCESS;
+}
+
+pj_status_t FlightRecorder::getFrame(pjmedia_port *port, pjmedia_frame *frame)
+{
+    Q_UNUSED(port)
+    frame->type = PJMEDIA_FRAME_TYPE_NONE;
+    frame->size = 0;
+    return PJ_SUCCESS;
+}
+
+bool FlightRecorder::writeWav(const QString &filePath, unsigned clockRate,
+                              const std::vector<pj_int16_t> &interleaved)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCritical() << "Cannot open" << filePath << file.errorString();
+        return false;
+    }
+    const auto dataSize = static_cast<quint32>(interleaved.size() * sizeof(pj_int16_t));
+    const quint16 blockAlign = CHANNEL_COUNT * sizeof(pj_int16_t);
+    std::array<char, 44> header{};
+    memcpy(header.data(), "RIFF", 4);
+    qToLittleEndian<quint32>(36 + dataSize, header.data() + 4);
+    memcpy(header.data() + 8, "WAVEfmt ", 8);
+    qToLittleEndian<quint32>(16, header.data() + 16);
+    qToLittleEndian<quint16>(1, header.data() + 20);//PCM
+    qToLittleEndian<quint16>(CHANNEL_COUNT, header.data() + 22);
+    qToLittleEndian<quint32>(clockRate, header.data() + 24);
+    qToLittleEndian<quint32>(clockRate * blockAlign, header.data() + 28);
+    qToLittleEndian<quint16>(blockAlign, header.data() + 32);
+    qToLittleEndian<quint16>(BITS_PER_SAMPLE, header.data() + 34);
+    memcpy(header.data() + 36, "data", 4);
+    qToLittleEndian<quint32>(dataSize, header.data() + 40);
+
+    //samples are little endian on all supported platforms
+    if ((file.write(header.data(), header.size()) != static_cast<qint64>(header.size())) ||
+            (file.write(reinterpret_cast<const char*>(interleaved.data()), dataSize) != static_cast<qint64>(dataSize))) {
+        qCritical() << "Cannot write" << filePath << file.errorString();
+        return false;
+    }
+    return true;
+}
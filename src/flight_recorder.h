@@ -0,0 +1,78 @@
+#pragma once
+
+#include "pjsua.h"
+#include <QString>
+#include <array>
+#include <mutex>
+#include <vector>
+
+/**
+ * Keeps the last seconds of a call in memory: both audio directions, each
+ * on its own conference port tapped before mixing, plus periodic RTCP
+ * statistics. All buffers are allocated upfront, nothing touches the disk
+ * until dump() is called.
+ */
+class FlightRecorder
+{
+public:
+    enum Channel { LOCAL = 0, REMOTE = 1, CHANNEL_COUNT };
+
+    struct RtcpSample {
+        qint64 timestampMs = 0;
+        unsigned rxPackets = 0;
+        unsigned rxLoss = 0;
+        unsigned rxJitterUs = 0;
+        unsigned txLoss = 0;
+        unsigned rttUs = 0;
+    };
+
+    FlightRecorder() = default;
+    ~FlightRecorder() {
+        release();
+    }
+
+    pj_status_t create(int durationSec);
+    pjsua_conf_port_id confPort(Channel channel) const { return _confPort[channel]; }
+    void release();
+
+    //GUI thread only
+    void addRtcpSample(const pjmedia_rtcp_stat &stat);
+    //writes <basePath>.wav (left local, right remote) and <basePath>.csv
+    bool dump(const QString &basePath);
+
+private:
+    Q_DISABLE_COPY_MOVE(FlightRecorder)
+
+    enum { POOL_SIZE = 1024, BITS_PER_SAMPLE = 16, RTCP_SAMPLE_PERIOD_S = 1 };
+
+    struct TapPort {
+        pjmedia_port base;
+        FlightRecorder *recorder;
+        int channel;
+    };
+
+    //one circular buffer per direction, older samples are overwritten
+    struct History {
+        std::vector<pj_int16_t> samples;
+        pj_uint64_t written = 0;
+        pj_uint64_t endTimestamp = 0;//bridge timestamp after the last frame
+    };
+
+    pj_status_t addPort(Channel channel);
+    static pj_status_t putFrame(pjmedia_port *port, pjmedia_frame *frame);
+    static pj_status_t getFrame(pjmedia_port *port, pjmedia_frame *frame);
+    static bool writeWav(const QString &filePath, unsigned clockRate,
+                         const std::vector<pj_int16_t> &interleaved);
+
+    unsigned _clockRate = 0;
+    unsigned _samplesPerFrame = 0;
+    pj_pool_t *_pool = nullptr;
+    std::array<pjsua_conf_port_id, CHANNEL_COUNT> _confPort{ PJSUA_INVALID_ID, PJSUA_INVALID_ID };
+
+    //held by the media thread only for a frame copy, by dump() for a snapshot copy
+    std::mutex _historyMutex;
+    std::array<History, CHANNEL_COUNT> _history;
+
+    std::vector<RtcpSample> _rtcpSamples;
+    size_t _rtcpWritten = 0;
+};
@@ -0,0 +1,302 @@
+#include "latency_probe.h"
+#include "media_threads.h"
+#include <QStringList>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#ifdef Q_OS_WIN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+QList<LatencyProbeConfig> LatencyProbeConfig::parseList(const QString &spec)
+{
+    QList<LatencyProbeConfig> configs;
+    const auto runs = spec.split(';', Qt::SkipEmptyParts);
+    for (const auto &run: runs) {
+        LatencyProbeConfig config;
+        const auto items = run.split(',', Qt::SkipEmptyParts);
+        for (const auto &item: items) {
+            const auto keyValue = item.split('=');
+            if (2 != keyValue.size()) {
+                qWarning() << "Ignoring latency probe item" << item;
+                continue;
+            }
+            const auto key = keyValue.at(0).trimmed().toLower();
+            const auto value = keyValue.at(1).trimmed();
+            if ("codec" == key) {
+                config.codec = value;
+            } else if ("ptime" == key) {
+                config.ptimeMs = value.toInt();
+            } else if ("jb" == key) {
+                const auto values = value.split('/');
+                config.jbInitMs = values.value(0, "-1").toInt();
+                config.jbMinPreMs = values.value(1, "-1").toInt();
+                config.jbMaxPreMs = values.value(2, "-1").toInt();
+                config.jbMaxMs = values.value(3, "-1").toInt();
+            } else if ("count" == key) {
+                config.markerCount = std::max(1, value.toInt());
+            } else {
+                qWarning() << "Unknown latency probe parameter" << key;
+            }
+        }
+        configs.append(config);
+    }
+    if (configs.isEmpty()) {
+        //defaults only
+        configs.append(LatencyProbeConfig());
+    }
+    return configs;
+}
+
+QString LatencyProbeConfig::toString() const
+{
+    return QString("codec=%1,ptime=%2,jb=%3/%4/%5/%6,count=%7")
+            .arg(codec.isEmpty() ? "default" : codec).arg(ptimeMs)
+            .arg(jbInitMs).arg(jbMinPreMs).arg(jbMaxPreMs).arg(jbMaxMs).arg(markerCount);
+}
+
+pj_status_t LatencyProbe::create(int markerCount)
+{
+    if (nullptr != _pool) {
+        return PJ_EEXISTS;
+    }
+
+    pjsua_conf_port_info bridgeInfo{};
+    auto status = pjsua_conf_get_port_info(0, &bridgeInfo);
+    if (PJ_SUCCESS != status) {
+        return status;
+    }
+    if (1 != bridgeInfo.channel_count) {
+        qCritical() << "Latency probe needs a mono bridge";
+        return PJMEDIA_EBADFMT;
+    }
+    _clockRate = bridgeInfo.clock_rate;
+    _samplesPerFrame = bridgeInfo.samples_per_frame;
+    _markerCount = std::max(1, markerCount);
+
+    //linear chirp, short attack so the onset is sharp, longer release
+    const auto chirpSamples = _clockRate * CHIRP_MS / 1000;
+    const auto attack = _clockRate / 1000;
+    const auto release = 5 * attack;
+    _chirp.resize(chirpSamples);
+    double phase = 0;
+    for (size_t i = 0; i < _chirp.size(); ++i) {
+        const double t = static_cast<double>(i) / _chirp.size();
+        const double frequency = CHIRP_START_HZ + (CHIRP_END_HZ - CHIRP_START_HZ) * t;
+        phase += 2 * M_PI * frequency / _clockRate;
+        double envelope = 1;
+        if (i < attack) {
+            envelope = static_cast<double>(i + 1) / attack;
+        } else if (i + release > _chirp.size()) {
+            envelope = static_cast<double>(_chirp.size() - i) / release;
+        }
+        _chirp[i] = static_cast<pj_int16_t>(CHIRP_AMPLITUDE * envelope * std::sin(phase));
+    }
+
+    _clockValid = false;
+    _started = false;
+    _chirpActive = false;
+    _chirpPos = 0;
+    _emitted = 0;
+    _oldest = 0;
+    _heardAny = false;
+    _markerTimestamps.assign(static_cast<size_t>(_markerCount), 0);
+    _latencies.assign(static_cast<size_t>(_markerCount), 0);
+    _resolved = 0;
+
+    _pool = pjsua_pool_create("latencyProbe", POOL_SIZE, POOL_SIZE);
+    if (nullptr == _pool) {
+        return PJ_ENOMEM;
+    }
+    ProbePort *port = nullptr;
+    status = addPort(&port, "probeGenerator", &_generatorConfPort);
+    if (PJ_SUCCESS == status) {
+        status = addPort(&port, "probeDetector", &_detectorConfPort);
+    }
+    if (PJ_SUCCESS != status) {
+        release();
+        return status;
+    }
+    qDebug() << "Created latency probe" << _clockRate << "Hz," << _markerCount << "markers";
+    return PJ_SUCCESS;
+}
+
+void LatencyProbe::release()
+{
+    for (auto *confPort: {&_generatorConfPort, &_detectorConfPort}) {
+        if (PJSUA_INVALID_ID != *confPort) {
+            pjsua_conf_remove_port(*confPort);
+            *confPort = PJSUA_INVALID_ID;
+        }
+    }
+    if (nullptr != _pool) {
+        pj_pool_release(_pool);
+        _pool = nullptr;
+    }
+}
+
+LatencyProbe::Result LatencyProbe::result() const
+{
+    Result result;
+    result.markers = _markerCount;
+    const auto resolved = std::min(_resolved.load(std::memory_order_acquire), _markerCount);
+    std::vector<double> latenciesMs;
+    latenciesMs.reserve(static_cast<size_t>(resolved));
+    for (int i = 0; i < resolved; ++i) {
+        if (0 < _latencies[i]) {
+            latenciesMs.push_back(1000.0 * static_cast<double>(_latencies[i]) / _clockRate);
+        }
+    }
+    result.detected = static_cast<int>(latenciesMs.size());
+    result.lost = _markerCount - result.detected;
+    if (latenciesMs.empty()) {
+        return result;
+    }
+    std::sort(latenciesMs.begin(), latenciesMs.end());
+    //nearest rank
+    auto percentile = [&latenciesMs](int p) {
+        const auto rank = static_cast<size_t>(std::ceil(p / 100.0 * latenciesMs.size()));
+        return latenciesMs[std::max<size_t>(rank, 1) - 1];
+    };
+    result.minMs = latenciesMs.front();
+    result.p50Ms = percentile(50);
+    result.p90Ms = percentile(90);
+    result.p99Ms = percentile(99);
+    result.maxMs = latenciesMs.back();
+    return result;
+}
+
+pj_status_t LatencyProbe::addPort(ProbePort **port, const char *name, pjsua_conf_port_id *confPort)
+{
+    *port = PJ_POOL_ZALLOC_T(_pool, ProbePort);
+    (*port)->probe = this;
+    pj_str_t portName = pj_str(const_cast<char*>(name));
+    pjmedia_port_info_init(&(*port)->base.info, &portName, PJMEDIA_SIGNATURE('B', 'C', 'L', 'P'),
+                           _clockRate, 1, BITS_PER_SAMPLE, _samplesPerFrame);
+    (*port)->base.put_frame = &LatencyProbe::putFrame;
+    (*port)->base.get_frame = &LatencyProbe::getFrame;
+    return pjsua_conf_add_port(_pool, &(*port)->base, confPort);
+}
+
+pj_status_t LatencyProbe::putFrame(pjmedia_port *port, pjmedia_frame *frame)
+{
+    auto *probe = reinterpret_cast<ProbePort*>(port)->probe;
+    MediaThreads::frameTick(frame->timestamp.u64, probe->_samplesPerFrame, probe->_clockRate);
+    //the bridge reads all ports before writing them, this is the timestamp of the next read
+    probe->_clock = frame->timestamp.u64 + probe->_samplesPerFrame;
+    probe->_clockValid = true;
+    if ((PJMEDIA_FRAME_TYPE_AUDIO == frame->type) && (0 < frame->size)) {
+        probe->detect(static_cast<const pj_int16_t*>(frame->buf), frame->size / sizeof(pj_int16_t),
+                      frame->timestamp.u64);
+    } else {
+        probe->expireMarkers(frame->timestamp.u64);
+    }
+    return PJ_SUCCESS;
+}
+
+pj_status_t LatencyProbe::getFrame(pjmedia_port *port, pjmedia_frame *frame)
+{
+    auto *probe = reinterpret_cast<ProbePort*>(port)->probe;
+    frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+    frame->size = probe->_samplesPerFrame * sizeof(pj_int16_t);
+    auto *samples = static_cast<pj_int16_t*>(frame->buf);
+    if (probe->_clockValid) {
+        probe->generate(samples, probe->_clock);
+    } else {
+        //no timestamp on reads, wait for the detector to see the bridge clock
+        std::fill_n(samples, probe->_samplesPerFrame, 0);
+    }
+    return PJ_SUCCESS;
+}
+
+void LatencyProbe::generate(pj_int16_t *samples, pj_uint64_t timestamp)
+{
+    if (!_started) {
+        //let the jitter buffer settle before the first marker
+        _started = true;
+        _nextMarker = timestamp + _clockRate * WARMUP_MS / 1000;
+    }
+    if (!_chirpActive && (_emitted < _markerCount) && (timestamp >= _nextMarker)) {
+        //markers start on a frame boundary, the bridge timestamp is the emission time
+        _markerTimestamps[static_cast<size_t>(_emitted)] = timestamp;
+        ++_emitted;
+        _nextMarker = timestamp + _clockRate * MARKER_PERIOD_MS / 1000;
+        _chirpActive = true;
+        _chirpPos = 0;
+    }
+    size_t i = 0;
+    if (_chirpActive) {
+        const auto count = std::min<size_t>(_samplesPerFrame, _chirp.size() - _chirpPos);
+        std::copy_n(_chirp.data() + _chirpPos, count, samples);
+        _chirpPos += count;
+        _chirpActive = _chirpPos < _chirp.size();
+        i = count;
+    }
+    std::fill(samples + i, samples + _samplesPerFrame, 0);
+}
+
+void LatencyProbe::detect(const pj_int16_t *samples, size_t count, pj_uint64_t timestamp)
+{
+    expireMarkers(timestamp);
+    const pj_uint64_t holdOff = _clockRate * MARKER_PERIOD_MS / 2000;
+    for (size_t i = 0; i < count; ++i) {
+        if (ONSET_THRESHOLD > std::abs(static_cast<int>(samples[i]))) {
+            continue;
+        }
+        //loud after a long enough silence: the start of a marker
+        const auto sampleTimestamp = timestamp + i;
+        if (!_heardAny || (holdOff <= sampleTimestamp - _lastLoud)) {
+            resolve(sampleTimestamp);
+        }
+        _heardAny = true;
+        _lastLoud = sampleTimestamp;
+    }
+}
+
+void LatencyProbe::expireMarkers(pj_uint64_t timestamp)
+{
+    const pj_uint64_t maxLatency = _clockRate * MAX_LATENCY_MS / 1000;
+    while ((_oldest < _emitted) && (_markerTimestamps[static_cast<size_t>(_oldest)] + maxLatency < timestamp)) {
+        _latencies[static_cast<size_t>(_oldest)] = 0;
+        ++_oldest;
+        _resolved.store(_oldest, std::memory_order_release);
+    }
+}
+
+void LatencyProbe::resolve(pj_uint64_t onset)
+{
+    expireMarkers(onset);
+    if ((_oldest >= _emitted) || (_markerTimestamps[static_cast<size_t>(_oldest)] > onset)) {
+        //not caused by a marker
+        return;
+    }
+    _latencies[static_cast<size_t>(_oldest)] = onset - _markerTimestamps[static_cast<size_t>(_oldest)];
+    ++_oldest;
+    _resolved.store(_oldest, std::memory_order_release);
+}
+
+qint64 LatencyProbe::processCpuTimeUs()
+{
+#ifdef Q_OS_WIN
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    auto toUs = [](const FILETIME &time) {
+        return ((static_cast<qint64>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 10;
+    };
+    return toUs(kernel) + toUs(user);
+#else
+    rusage usage{};
+    if (0 != getrusage(RUSAGE_SELF, &usage)) {
+        return 0;
+    }
+    auto toUs = [](const timeval &time) {
+        return static_cast<qint64>(time.tv_sec) * 1000000 + time.tv_usec;
+    };
+    return toUs(usage.ru_utime) + toUs(usage.ru_stime);
+#endif
+}
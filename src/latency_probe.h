@@ -0,0 +1,118 @@
+#pragma once
+
+#include "pjsua.h"
+#include <QList>
+#include <QString>
+#include <atomic>
+#include <vector>
+
+/**
+ * One latency probe run, parsed from a spec like
+ * "codec=opus/48000,ptime=40,jb=60/20/200/500,count=50"
+ * jb gives the jitter buffer init/min prefetch/max prefetch/max in ms,
+ * unset values (-1) keep the pjsua defaults. Runs are separated by ';'.
+ */
+struct LatencyProbeConfig {
+    QString codec;
+    int ptimeMs = 0;
+    int jbInitMs = -1;
+    int jbMinPreMs = -1;
+    int jbMaxPreMs = -1;
+    int jbMaxMs = -1;
+    int markerCount = 50;
+
+    static QList<LatencyProbeConfig> parseList(const QString &spec);
+    QString toString() const;
+};
+
+/**
+ * Mouth-to-ear latency measurement over a loopback call.
+ * The generator port feeds a short chirp into one leg every half second,
+ * the detector port listens on the other leg for the chirp onset. Both ports
+ * run on the conference thread and use the bridge timestamps, so the latency
+ * is counted in samples of the media clock and covers packetization, codec,
+ * network and jitter buffer.
+ */
+class LatencyProbe
+{
+public:
+    struct Result {
+        int markers = 0;
+        int detected = 0;
+        int lost = 0;
+        double minMs = 0;
+        double p50Ms = 0;
+        double p90Ms = 0;
+        double p99Ms = 0;
+        double maxMs = 0;
+    };
+
+    LatencyProbe() = default;
+    ~LatencyProbe() {
+        release();
+    }
+
+    pj_status_t create(int markerCount);
+    pjsua_conf_port_id generatorPort() const { return _generatorConfPort; }
+    pjsua_conf_port_id detectorPort() const { return _detectorConfPort; }
+    void release();
+
+    //every marker was either detected or given up on
+    bool finished() const {
+        return _resolved.load(std::memory_order_acquire) >= _markerCount;
+    }
+    Result result() const;
+
+    //CPU time used by the whole process so far
+    static qint64 processCpuTimeUs();
+
+    //upper bound for a run, warm-up included
+    static int durationMs(int markerCount) {
+        return WARMUP_MS + markerCount * MARKER_PERIOD_MS + MAX_LATENCY_MS;
+    }
+
+private:
+    Q_DISABLE_COPY_MOVE(LatencyProbe)
+
+    enum { POOL_SIZE = 1024, BITS_PER_SAMPLE = 16, MARKER_PERIOD_MS = 500, CHIRP_MS = 40,
+           CHIRP_START_HZ = 500, CHIRP_END_HZ = 3000, CHIRP_AMPLITUDE = 16000,
+           ONSET_THRESHOLD = 4000, MAX_LATENCY_MS = 450, WARMUP_MS = 1000 };
+
+    struct ProbePort {
+        pjmedia_port base;
+        LatencyProbe *probe;
+    };
+
+    pj_status_t addPort(ProbePort **port, const char *name, pjsua_conf_port_id *confPort);
+    static pj_status_t putFrame(pjmedia_port *port, pjmedia_frame *frame);
+    static pj_status_t getFrame(pjmedia_port *port, pjmedia_frame *frame);
+    void generate(pj_int16_t *samples, pj_uint64_t timestamp);
+    void detect(const pj_int16_t *samples, size_t count, pj_uint64_t timestamp);
+    void expireMarkers(pj_uint64_t timestamp);
+    void resolve(pj_uint64_t onset);
+
+    unsigned _clockRate = 0;
+    unsigned _samplesPerFrame = 0;
+    int _markerCount = 0;
+    pj_pool_t *_pool = nullptr;
+    pjsua_conf_port_id _generatorConfPort = PJSUA_INVALID_ID;
+    pjsua_conf_port_id _detectorConfPort = PJSUA_INVALID_ID;
+    std::vector<pj_int16_t> _chirp;
+
+    //owned by the conference thread
+    pj_uint64_t _clock = 0;
+    bool _clockValid = false;
+    bool _started = false;
+    pj_uint64_t _nextMarker = 0;
+    size_t _chirpPos = 0;
+    bool _chirpActive = false;
+    std::vector<pj_uint64_t> _markerTimestamps;
+    int _emitted = 0;
+    int _oldest = 0;//first unresolved marker
+    pj_uint64_t _lastLoud = 0;
+    bool _heardAny = false;
+
+    //latencies are published by the release store of _resolved
+    std::vector<pj_uint64_t> _latencies;//samples, 0 for a lost marker
+    std::atomic<int> _resolved{0};
+};
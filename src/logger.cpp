@@ -1,5 +1,6 @@
 #include "logger.h"
 #include "settings.h"
+#include "metrics.h"
 #include <QDir>
 #include <QFile>
 #include <QDateTime>
@@ -158,6 +159,9 @@ void logToFile(const QString &message, bool isCheckFileSize)
     QFile file(_logFilePath);
 
     if (!file.open(QFile::Append)) {
+        static auto &dropped = Metrics::instance().counter("bcphone_log_dropped_total",
+                                                           "Log messages not written to the log file");
+        dropped.add();
         return;
     }
 
@@ -181,6 +185,18 @@ void loggingHandler(QtMsgType type,
                                const QMessageLogContext &context,
                                const QString &msg)
 {
+    static Counter *const messages[] = {
+        &Metrics::instance().counter("bcphone_log_messages_total", "Log messages by level", "level=\"debug\""),
+        &Metrics::instance().counter("bcphone_log_messages_total", "Log messages by level", "level=\"warning\""),
+        &Metrics::instance().counter("bcphone_log_messages_total", "Log messages by level", "level=\"critical\""),
+        &Metrics::instance().counter("bcphone_log_messages_total", "Log messages by level", "level=\"fatal\""),
+        &Metrics::instance().counter("bcphone_log_messages_total", "Log messages by level", "level=\"info\"")
+    };
+    //QtMsgType order
+    if ((QtDebugMsg <= type) && (QtInfoMsg >= type)) {
+        messages[type]->add();
+    }
+
     const QString typeString = convertTypeToString(type);
     const QString where = getWhere(context);
     const QString message = getMessage(typeString,
@@ -1,40 +1,89 @@
 #include "softphone.h"
 #include "config.h"
 #include "logger.h"
+#include "call_volume_port.h"
+#include "command_line.h"
+#include "startup_profile.h"
+#include "event_loop_watchdog.h"
 #include <QApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
+#include <QQmlExtensionPlugin>
+#include <QQuickWindow>
+#include <QTimer>
 #include <memory>
 #include <QDebug>
 
+//the UI, see qml/CMakeLists.txt
+Q_IMPORT_QML_PLUGIN(BCPhonePlugin)
+
 //TODO: QML debugging
 //#include <QQmlDebuggingEnabler>
 //QQmlDebuggingEnabler enabler;
 
 int main(int argc, char *argv[])
 {
+    StartupProfile::instance().start();
     if (1 < argc) {
         if (0 == qstrcmp("clear", argv[1])) {
-            //calling with "clear" as argument means that the app is uninstalled
+            //calling with "clear" as argument means that the app is uninstalled,
+            //the settings store and its writer thread are created after the application
+            QCoreApplication app(argc, argv);
+            QCoreApplication::setOrganizationName(ORG_NAME);
+            QCoreApplication::setApplicationName(APP_NAME);
             Settings::uninstallClear();
             return EXIT_SUCCESS;
         }
+        if ((2 < argc) && (0 == qstrcmp("--volume-benchmark", argv[1]))) {
+            //number of frames, no SIP stack needed
+            CallVolumePort::benchmark(QString::fromLocal8Bit(argv[2]).toInt());
+            return EXIT_SUCCESS;
+        }
     }
+    CommandLineOptions options;
+    options.parse(argc, argv);
+
     //main application
-    QApplication app(argc, argv);
+    std::unique_ptr<QCoreApplication> app;
+    {
+        const StartupProfile::Phase phase("application");
+        if (options.headless) {
+            app = std::make_unique<WatchedApplication<QCoreApplication>>(argc, argv);
+        } else {
+            app = std::make_unique<WatchedApplication<QApplication>>(argc, argv);
+        }
+    }
 
-    QGuiApplication::setOrganizationName(ORG_NAME);
-    QGuiApplication::setApplicationName(APP_NAME);
-    QGuiApplication::setApplicationVersion(APP_VERSION);
+    QCoreApplication::setOrganizationName(ORG_NAME);
+    QCoreApplication::setApplicationName(APP_NAME);
+    QCoreApplication::setApplicationVersion(APP_VERSION);
 
     qSetMessagePattern("%{appname} [%{threadid}] [%{type}] %{message} (%{file}:%{line})");
     Logger::installLogHandler();
 
     //must be instantiated before QML engine
-    std::unique_ptr<Softphone> softphone(new Softphone());
+    std::unique_ptr<Softphone> softphone;
+    {
+        const StartupProfile::Phase phase("softphone");
+        softphone.reset(new Softphone());
+    }
     if (!softphone->start()) {
         return EXIT_FAILURE;
     }
+    //the QML engine load is watched too
+    CommandLineServices services;
+    if (!services.start(softphone.get(), options)) {
+        return EXIT_FAILURE;
+    }
+    QTimer::singleShot(0, []() {
+        StartupProfile::instance().milestone("eventLoop");
+    });
+    if (options.headless) {
+        qDebug() << "*** Headless application started ***";
+        const auto rc = QCoreApplication::exec();
+        services.finish(softphone.get(), options);
+        return rc;
+    }
 
     QQmlApplicationEngine engine;
     //set properties
@@ -47,12 +96,24 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
-    engine.load(QUrl(QStringLiteral("qrc:/qml/main.qml")));
+    {
+        const StartupProfile::Phase phase("qml");
+        engine.load(QUrl(QStringLiteral("qrc:/BCPhone/main.qml")));
+    }
     QList<QObject*> rootObj = engine.rootObjects();
     if (!rootObj.isEmpty() && (nullptr != rootObj[0])) {
         softphone->setMainForm(rootObj[0]);
+        auto *window = qobject_cast<QQuickWindow*>(rootObj[0]);
+        if (nullptr != window) {
+            //on the render thread, when the first frame is on screen
+            QObject::connect(window, &QQuickWindow::frameSwapped, window, []() {
+                StartupProfile::instance().milestone("firstFrame");
+            }, static_cast<Qt::ConnectionType>(Qt::DirectConnection | Qt::SingleShotConnection));
+        }
     }
 
     QGuiApplication::setQuitOnLastWindowClosed(false);
-    return QGuiApplication::exec();
+    const auto rc = QGuiApplication::exec();
+    services.finish(softphone.get(), options);
+    return rc;
 }
@@ -0,0 +1,63 @@
+#include "media_profile.h"
+#include <QDebug>
+#include <array>
+
+namespace {
+const std::array<MediaProfile, MediaProfile::PROFILE_COUNT> profiles{{
+    //name, clock, ptime, rec/play latency, jb init/min/max pre/max, threads, quality
+    { "default", 0, 0, 0, 0, -1, -1, -1, -1, 0, 0 },
+    //short frames and device buffers, small jitter buffer, one more media thread
+    { "low-latency", 16000, 10, 40, 40, 30, 10, 60, 200, 2, 0 },
+    //narrowband bridge, fewer and longer frames, cheaper resampling
+    { "low-cpu", 8000, 40, 160, 200, -1, -1, -1, -1, 1, 3 }
+}};
+}
+
+const MediaProfile& MediaProfile::get(int id)
+{
+    if ((0 > id) || (PROFILE_COUNT <= id)) {
+        qWarning() << "Unknown media profile" << id;
+        id = Default;
+    }
+    return profiles[static_cast<size_t>(id)];
+}
+
+void MediaProfile::apply(pjsua_media_config &cfg) const
+{
+    if (0 < clockRate) {
+        cfg.clock_rate = clockRate;
+        cfg.snd_clock_rate = clockRate;
+    }
+    if (0 < framePtimeMs) {
+        cfg.audio_frame_ptime = framePtimeMs;
+    }
+    if (0 < sndRecLatencyMs) {
+        cfg.snd_rec_latency = sndRecLatencyMs;
+    }
+    if (0 < sndPlayLatencyMs) {
+        cfg.snd_play_latency = sndPlayLatencyMs;
+    }
+    if (0 <= jbInitMs) {
+        cfg.jb_init = jbInitMs;
+    }
+    if (0 <= jbMinPreMs) {
+        cfg.jb_min_pre = jbMinPreMs;
+    }
+    if (0 <= jbMaxPreMs) {
+        cfg.jb_max_pre = jbMaxPreMs;
+    }
+    if (0 <= jbMaxMs) {
+        cfg.jb_max = jbMaxMs;
+    }
+    if (0 < threadCount) {
+        cfg.thread_cnt = threadCount;
+    }
+    if (0 < quality) {
+        cfg.quality = quality;
+    }
+    qInfo() << "Media profile" << name << ": clock rate" << cfg.clock_rate << "Hz, frame" << cfg.audio_frame_ptime
+            << "ms, sound latency (rec, play)" << cfg.snd_rec_latency << cfg.snd_play_latency
+            << "ms, jitter buffer (init, min pre, max pre, max)" << cfg.jb_init << cfg.jb_min_pre
+            << cfg.jb_max_pre << cfg.jb_max << "ms, media threads" << cfg.thread_cnt
+            << ", quality" << cfg.quality;
+}
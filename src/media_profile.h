@@ -0,0 +1,27 @@
+#pragma once
+
+#include "pjsua.h"
+
+/**
+ * Media engine tuning applied to pjsua_media_config when PJSUA starts.
+ * Zero (or -1 for the jitter buffer) keeps the PJSIP default.
+ */
+struct MediaProfile {
+    enum Id { Default, LowLatency, LowCpu, PROFILE_COUNT };
+
+    const char *name;
+    unsigned clockRate;
+    unsigned framePtimeMs;
+    unsigned sndRecLatencyMs;
+    unsigned sndPlayLatencyMs;
+    int jbInitMs;
+    int jbMinPreMs;
+    int jbMaxPreMs;
+    int jbMaxMs;
+    unsigned threadCount;
+    unsigned quality;//resampler and echo canceller quality, 1 (fastest) to 10
+
+    //unknown ids fall back to the default profile
+    static const MediaProfile& get(int id);
+    void apply(pjsua_media_config &cfg) const;
+};
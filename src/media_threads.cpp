@@ -0,0 +1,271 @@
+#include "media_threads.h"
+#include <QStringList>
+#include <QDebug>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#ifdef Q_OS_WIN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+constexpr int MAX_THREADS = 32;
+constexpr quint64 MISS_FACTOR_PERCENT = 150;
+
+struct ThreadSlot {
+    std::atomic<bool> ready{false};
+    char name[PJ_MAX_OBJ_NAME] = {};
+    MediaThreads::Role role = MediaThreads::Role::Audio;
+    bool pinned = false;
+    bool realtime = false;
+    std::atomic<quint64> frames{0};
+    std::atomic<quint64> misses{0};
+    std::atomic<quint64> totalGapNs{0};
+    std::atomic<quint64> maxGapNs{0};
+    //owned by the thread
+    bool ticked = false;
+    pj_uint64_t lastTimestamp = 0;
+    std::chrono::steady_clock::time_point lastTick;
+};
+
+std::mutex configMutex;
+MediaThreads::Config configValue;
+std::atomic<unsigned> generation{1};
+std::array<ThreadSlot, MAX_THREADS> threadSlots;
+std::atomic<int> slotCount{0};
+
+thread_local unsigned currentGeneration = 0;
+thread_local ThreadSlot *currentSlot = nullptr;
+
+const char* roleName(MediaThreads::Role role)
+{
+    return (MediaThreads::Role::Audio == role) ? "audio" : "worker";
+}
+}
+
+QList<int> MediaThreads::parseCpus(const QString &spec)
+{
+    QList<int> cpus;
+    const auto items = spec.split(',', Qt::SkipEmptyParts);
+    for (const auto &item: items) {
+        const auto range = item.split('-');
+        bool firstOk = false;
+        bool lastOk = false;
+        const int first = range.value(0).trimmed().toInt(&firstOk);
+        const int last = (2 == range.size()) ? range.value(1).trimmed().toInt(&lastOk) : first;
+        if (!firstOk || ((2 == range.size()) && !lastOk) || (2 < range.size()) || (0 > first) || (first > last)) {
+            qWarning() << "Ignoring CPU list item" << item;
+            continue;
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            if (!cpus.contains(cpu)) {
+                cpus.append(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+void MediaThreads::configure(const Config &config)
+{
+    {
+        std::lock_guard<std::mutex> lock(configMutex);
+        configValue = config;
+    }
+    //the threads of the previous PJSUA instance are gone
+    const auto count = std::min(slotCount.load(), MAX_THREADS);
+    for (int i = 0; i < count; ++i) {
+        auto &slot = threadSlots[static_cast<size_t>(i)];
+        slot.ready.store(false, std::memory_order_relaxed);
+        slot.frames.store(0, std::memory_order_relaxed);
+        slot.misses.store(0, std::memory_order_relaxed);
+        slot.totalGapNs.store(0, std::memory_order_relaxed);
+        slot.maxGapNs.store(0, std::memory_order_relaxed);
+        slot.ticked = false;
+    }
+    slotCount.store(0);
+    generation.fetch_add(1, std::memory_order_release);
+    qInfo() << "Media threads: audio CPUs" << config.audioCpus << ", worker CPUs" << config.workerCpus
+            << ", scheduling" << config.scheduling;
+}
+
+MediaThreads::Config MediaThreads::config()
+{
+    std::lock_guard<std::mutex> lock(configMutex);
+    return configValue;
+}
+
+void MediaThreads::tuneCurrentThread(Role role)
+{
+    const auto current = generation.load(std::memory_order_acquire);
+    if (currentGeneration == current) {
+        return;
+    }
+    currentGeneration = current;
+    currentSlot = nullptr;
+
+    const auto threadConfig = config();
+    const auto &cpus = (Role::Audio == role) ? threadConfig.audioCpus : threadConfig.workerCpus;
+    const bool pinned = !cpus.isEmpty() && pinCurrentThread(cpus);
+    const bool realtime = (Default != threadConfig.scheduling) &&
+            raiseCurrentThreadPriority(role, threadConfig.scheduling);
+
+    const auto index = slotCount.fetch_add(1);
+    if (MAX_THREADS <= index) {
+        qWarning() << "Too many media threads, not reported";
+        return;
+    }
+    auto &slot = threadSlots[static_cast<size_t>(index)];
+    const char *name = (PJ_FALSE != pj_thread_is_registered()) ? pj_thread_get_name(pj_thread_this()) : "unknown";
+    std::strncpy(slot.name, name, sizeof(slot.name) - 1);
+    slot.role = role;
+    slot.pinned = pinned;
+    slot.realtime = realtime;
+    slot.ready.store(true, std::memory_order_release);
+    currentSlot = &slot;
+    qInfo() << "Media thread" << slot.name << "(" << roleName(role) << "): pinned" << pinned
+            << ", real-time" << realtime;
+}
+
+void MediaThreads::frameTick(pj_uint64_t timestamp, unsigned samplesPerFrame, unsigned clockRate)
+{
+    tuneCurrentThread(Role::Audio);
+    auto *slot = currentSlot;
+    if ((nullptr == slot) || (0 == clockRate)) {
+        return;
+    }
+    //every port of the bridge sees the same timestamp during a tick
+    if (slot->ticked && (timestamp == slot->lastTimestamp)) {
+        return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (slot->ticked) {
+        const auto gapNs = static_cast<quint64>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(now - slot->lastTick).count());
+        const quint64 periodNs = 1000000000ull * samplesPerFrame / clockRate;
+        slot->frames.fetch_add(1, std::memory_order_relaxed);
+        slot->totalGapNs.fetch_add(gapNs, std::memory_order_relaxed);
+        if (100 * gapNs > MISS_FACTOR_PERCENT * periodNs) {
+            slot->misses.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (gapNs > slot->maxGapNs.load(std::memory_order_relaxed)) {
+            slot->maxGapNs.store(gapNs, std::memory_order_relaxed);
+        }
+    }
+    slot->ticked = true;
+    slot->lastTimestamp = timestamp;
+    slot->lastTick = now;
+}
+
+QList<MediaThreads::ThreadReport> MediaThreads::report()
+{
+    QList<ThreadReport> reports;
+    const auto count = std::min(slotCount.load(), MAX_THREADS);
+    for (int i = 0; i < count; ++i) {
+        const auto &slot = threadSlots[static_cast<size_t>(i)];
+        if (!slot.ready.load(std::memory_order_acquire)) {
+            continue;
+        }
+        ThreadReport report;
+        report.name = QString::fromLatin1(slot.name);
+        report.role = slot.role;
+        report.pinned = slot.pinned;
+        report.realtime = slot.realtime;
+        report.frames = slot.frames.load(std::memory_order_relaxed);
+        report.misses = slot.misses.load(std::memory_order_relaxed);
+        if (0 < report.frames) {
+            report.meanGapMs = slot.totalGapNs.load(std::memory_order_relaxed) / 1e6 / report.frames;
+        }
+        report.maxGapMs = slot.maxGapNs.load(std::memory_order_relaxed) / 1e6;
+        reports.append(report);
+    }
+    return reports;
+}
+
+QString MediaThreads::toString(const ThreadReport &report)
+{
+    auto text = report.name + " (" + roleName(report.role) + ")";
+    if (report.pinned) {
+        text += ", pinned";
+    }
+    if (report.realtime) {
+        text += ", real-time";
+    }
+    if (0 < report.frames) {
+        text += QString(": %1 frames, %2 deadline misses (%3%), gap mean %4 ms, max %5 ms")
+                .arg(report.frames).arg(report.misses).arg(100.0 * report.misses / report.frames, 0, 'f', 2)
+                .arg(report.meanGapMs, 0, 'f', 2).arg(report.maxGapMs, 0, 'f', 2);
+    }
+    return text;
+}
+
+bool MediaThreads::pinCurrentThread(const QList<int> &cpus)
+{
+#if defined(Q_OS_LINUX)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const auto cpu: cpus) {
+        if (CPU_SETSIZE > cpu) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    const auto rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (0 != rc) {
+        qWarning() << "Cannot pin thread to CPUs" << cpus << ":" << std::strerror(rc);
+        return false;
+    }
+    return true;
+#elif defined(Q_OS_WIN)
+    DWORD_PTR mask = 0;
+    for (const auto cpu: cpus) {
+        if (static_cast<int>(8 * sizeof(mask)) > cpu) {
+            mask |= static_cast<DWORD_PTR>(1) << cpu;
+        }
+    }
+    if (0 == SetThreadAffinityMask(GetCurrentThread(), mask)) {
+        qWarning() << "Cannot pin thread to CPUs" << cpus << ": error" << GetLastError();
+        return false;
+    }
+    return true;
+#else
+    //macOS only takes affinity tags as hints
+    Q_UNUSED(cpus)
+    qWarning() << "CPU pinning is not supported on this platform";
+    return false;
+#endif
+}
+
+bool MediaThreads::raiseCurrentThreadPriority(Role role, int scheduling)
+{
+#if defined(Q_OS_WIN)
+    //no FIFO or round robin choice, both map to the highest priorities of the process class
+    Q_UNUSED(scheduling)
+    const int priority = (Role::Audio == role) ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_HIGHEST;
+    if (!SetThreadPriority(GetCurrentThread(), priority)) {
+        qWarning() << "Cannot raise thread priority: error" << GetLastError();
+        return false;
+    }
+    return true;
+#else
+    const int policy = (RoundRobin == scheduling) ? SCHED_RR : SCHED_FIFO;
+    const int minPriority = sched_get_priority_min(policy);
+    const int maxPriority = sched_get_priority_max(policy);
+    //audio above the workers, both well below the top levels kept for the system
+    sched_param param{};
+    param.sched_priority = minPriority + (maxPriority - minPriority) * ((Role::Audio == role) ? 3 : 2) / 4;
+    const auto rc = pthread_setschedparam(pthread_self(), policy, &param);
+    if (0 != rc) {
+        //EPERM without CAP_SYS_NICE or an rtprio limit on Linux
+        qWarning() << "Cannot set real-time scheduling" << policy << param.sched_priority << ":" << std::strerror(rc);
+        return false;
+    }
+    return true;
+#endif
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "pjsua.h"
+#include <QList>
+#include <QString>
+
+/**
+ * CPU affinity and scheduling of the threads that carry the calls.
+ * PJSIP and the audio backends create their threads themselves, so each
+ * thread tunes itself the first time it runs our code: the conference
+ * (sound device or clock) thread from the call volume ports, the media
+ * ioqueue threads from the transport adapters and the SIP worker threads
+ * when they start. The audio threads also time the conference ticks and
+ * count deadline misses, a tick later than 1.5 frames after the previous one.
+ */
+class MediaThreads
+{
+public:
+    enum class Role { Audio, Worker };
+    enum Scheduling { Default, Fifo, RoundRobin };
+
+    struct Config {
+        QList<int> audioCpus;//empty keeps the OS choice
+        QList<int> workerCpus;
+        int scheduling = Default;
+
+        bool isEnabled() const {
+            return !audioCpus.isEmpty() || !workerCpus.isEmpty() || (Default != scheduling);
+        }
+    };
+
+    struct ThreadReport {
+        QString name;
+        Role role = Role::Audio;
+        bool pinned = false;
+        bool realtime = false;
+        quint64 frames = 0;
+        quint64 misses = 0;
+        double meanGapMs = 0;
+        double maxGapMs = 0;
+    };
+
+    //"0,2" or "2-3", invalid items are skipped
+    static QList<int> parseCpus(const QString &spec);
+
+    //before PJSUA starts its threads, forgets the threads seen so far
+    static void configure(const Config &config);
+    static Config config();
+
+    //once per thread and configuration, cheap afterwards
+    static void tuneCurrentThread(Role role);
+    //audio threads, called for every frame with the bridge timestamp
+    static void frameTick(pj_uint64_t timestamp, unsigned samplesPerFrame, unsigned clockRate);
+
+    static QList<ThreadReport> report();
+    static QString toString(const ThreadReport &report);
+
+private:
+    MediaThreads() = delete;
+
+    static bool pinCurrentThread(const QList<int> &cpus);
+    static bool raiseCurrentThreadPriority(Role role, int scheduling);
+};
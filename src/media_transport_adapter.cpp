@@ -0,0 +1,167 @@
+#include "media_transport_adapter.h"
+#include "media_threads.h"
+
+pjmedia_transport_op MediaTransportAdapter::_op = {
+    &MediaTransportAdapter::getInfo,
+    nullptr,//attach, superseded by attach2
+    &MediaTransportAdapter::detach,
+    &MediaTransportAdapter::sendRtpOp,
+    &MediaTransportAdapter::sendRtcpOp,
+    &MediaTransportAdapter::sendRtcp2Op,
+    &MediaTransportAdapter::mediaCreate,
+    &MediaTransportAdapter::encodeSdp,
+    &MediaTransportAdapter::mediaStart,
+    &MediaTransportAdapter::mediaStop,
+    &MediaTransportAdapter::simulateLost,
+    &MediaTransportAdapter::destroy,
+    &MediaTransportAdapter::attach2
+};
+
+MediaTransportAdapter::MediaTransportAdapter(const char *name, pjmedia_transport *slave, bool ownsSlave) :
+    _slave(slave), _ownsSlave(ownsSlave)
+{
+    pj_ansi_snprintf(_transport.base.name, sizeof(_transport.base.name), "%s", name);
+    _transport.base.type = PJMEDIA_TRANSPORT_TYPE_USER;
+    _transport.base.op = &_op;
+    _transport.adapter = this;
+}
+
+MediaTransportAdapter::~MediaTransportAdapter()
+{
+    if (_ownsSlave && (nullptr != _slave)) {
+        pjmedia_transport_close(_slave);
+    }
+}
+
+void MediaTransportAdapter::deliverRtp(pjmedia_tp_cb_param *param)
+{
+    if (nullptr != _streamRtpCb2) {
+        pjmedia_tp_cb_param streamParam = *param;
+        streamParam.user_data = _streamUserData;
+        _streamRtpCb2(&streamParam);
+    } else if (nullptr != _streamRtpCb) {
+        _streamRtpCb(_streamUserData, param->pkt, param->size);
+    }
+}
+
+void MediaTransportAdapter::deliverRtcp(void *pkt, pj_ssize_t size)
+{
+    if (nullptr != _streamRtcpCb) {
+        _streamRtcpCb(_streamUserData, pkt, size);
+    }
+}
+
+pj_status_t MediaTransportAdapter::getInfo(pjmedia_transport *tp, pjmedia_transport_info *info)
+{
+    return pjmedia_transport_get_info(self(tp)->_slave, info);
+}
+
+void MediaTransportAdapter::detach(pjmedia_transport *tp, void *userData)
+{
+    Q_UNUSED(userData)
+    auto *adapter = self(tp);
+    if (nullptr != adapter->_streamUserData) {
+        adapter->onDetach();
+        pjmedia_transport_detach(adapter->_slave, adapter);
+        adapter->_streamUserData = nullptr;
+        adapter->_streamRtpCb = nullptr;
+        adapter->_streamRtpCb2 = nullptr;
+        adapter->_streamRtcpCb = nullptr;
+    }
+}
+
+pj_status_t MediaTransportAdapter::sendRtpOp(pjmedia_transport *tp, const void *pkt, pj_size_t size)
+{
+    return self(tp)->sendRtp(pkt, size);
+}
+
+pj_status_t MediaTransportAdapter::sendRtcpOp(pjmedia_transport *tp, const void *pkt, pj_size_t size)
+{
+    return self(tp)->sendRtcp(pkt, size);
+}
+
+pj_status_t MediaTransportAdapter::sendRtcp2Op(pjmedia_transport *tp, const pj_sockaddr_t *addr, unsigned addrLen,
+                                               const void *pkt, pj_size_t size)
+{
+    return pjmedia_transport_send_rtcp2(self(tp)->_slave, addr, addrLen, pkt, size);
+}
+
+pj_status_t MediaTransportAdapter::mediaCreate(pjmedia_transport *tp, pj_pool_t *sdpPool, unsigned options,
+                                               const pjmedia_sdp_session *remoteSdp, unsigned mediaIndex)
+{
+    return pjmedia_transport_media_create(self(tp)->_slave, sdpPool, options, remoteSdp, mediaIndex);
+}
+
+pj_status_t MediaTransportAdapter::encodeSdp(pjmedia_transport *tp, pj_pool_t *sdpPool,
+                                             pjmedia_sdp_session *localSdp,
+                                             const pjmedia_sdp_session *remoteSdp, unsigned mediaIndex)
+{
+    return pjmedia_transport_encode_sdp(self(tp)->_slave, sdpPool, localSdp, remoteSdp, mediaIndex);
+}
+
+pj_status_t MediaTransportAdapter::mediaStart(pjmedia_transport *tp, pj_pool_t *tmpPool,
+                                              const pjmedia_sdp_session *localSdp,
+                                              const pjmedia_sdp_session *remoteSdp, unsigned mediaIndex)
+{
+    return pjmedia_transport_media_start(self(tp)->_slave, tmpPool, localSdp, remoteSdp, mediaIndex);
+}
+
+pj_status_t MediaTransportAdapter::mediaStop(pjmedia_transport *tp)
+{
+    return pjmedia_transport_media_stop(self(tp)->_slave);
+}
+
+pj_status_t MediaTransportAdapter::simulateLost(pjmedia_transport *tp, pjmedia_dir dir, unsigned pctLost)
+{
+    return pjmedia_transport_simulate_lost(self(tp)->_slave, dir, pctLost);
+}
+
+pj_status_t MediaTransportAdapter::destroy(pjmedia_transport *tp)
+{
+    delete self(tp);
+    return PJ_SUCCESS;
+}
+
+pj_status_t MediaTransportAdapter::attach2(pjmedia_transport *tp, pjmedia_transport_attach_param *param)
+{
+    //keep the stream callbacks and get the packets first
+    auto *adapter = self(tp);
+    adapter->_streamUserData = param->user_data;
+    adapter->_streamRtpCb = param->rtp_cb;
+    adapter->_streamRtpCb2 = param->rtp_cb2;
+    adapter->_streamRtcpCb = param->rtcp_cb;
+    pj_sockaddr_cp(&adapter->_remoteRtp, &param->rem_addr);
+    pj_sockaddr_cp(&adapter->_remoteRtcp, &param->rem_rtcp);
+
+    param->user_data = adapter;
+    param->rtp_cb = nullptr;
+    param->rtp_cb2 = &MediaTransportAdapter::onRtp;
+    param->rtcp_cb = &MediaTransportAdapter::onRtcp;
+    const auto status = pjmedia_transport_attach2(adapter->_slave, param);
+    if (PJ_SUCCESS != status) {
+        adapter->_streamUserData = nullptr;
+        adapter->_streamRtpCb = nullptr;
+        adapter->_streamRtpCb2 = nullptr;
+        adapter->_streamRtcpCb = nullptr;
+        return status;
+    }
+
+    pjmedia_transport_info info{};
+    pjmedia_transport_info_init(&info);
+    if (PJ_SUCCESS == pjmedia_transport_get_info(adapter->_slave, &info)) {
+        pj_sockaddr_cp(&adapter->_localRtp, &info.sock_info.rtp_addr_name);
+        pj_sockaddr_cp(&adapter->_localRtcp, &info.sock_info.rtcp_addr_name);
+    }
+    return PJ_SUCCESS;
+}
+
+void MediaTransportAdapter::onRtp(pjmedia_tp_cb_param *param)
+{
+    MediaThreads::tuneCurrentThread(MediaThreads::Role::Worker);
+    static_cast<MediaTransportAdapter*>(param->user_data)->receiveRtp(param);
+}
+
+void MediaTransportAdapter::onRtcp(void *userData, void *pkt, pj_ssize_t size)
+{
+    static_cast<MediaTransportAdapter*>(userData)->receiveRtcp(pkt, size);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "pjsua.h"
+#include <QtGlobal>
+
+/**
+ * Base class for media transports stacked on top of the pjsua transport.
+ * Every operation is forwarded to the slave transport, subclasses override
+ * the packet hooks to observe or alter RTP/RTCP in both directions.
+ * Instances delete themselves when pjsua destroys the transport.
+ */
+class MediaTransportAdapter
+{
+public:
+    pjmedia_transport* transport() { return &_transport.base; }
+
+protected:
+    MediaTransportAdapter(const char *name, pjmedia_transport *slave, bool ownsSlave);
+    virtual ~MediaTransportAdapter();
+
+    //outgoing packets, called from the media (encoder) threads
+    virtual pj_status_t sendRtp(const void *pkt, pj_size_t size) {
+        return pjmedia_transport_send_rtp(_slave, pkt, size);
+    }
+    virtual pj_status_t sendRtcp(const void *pkt, pj_size_t size) {
+        return pjmedia_transport_send_rtcp(_slave, pkt, size);
+    }
+    //incoming packets, called from the ioqueue threads
+    virtual void receiveRtp(pjmedia_tp_cb_param *param) {
+        deliverRtp(param);
+    }
+    virtual void receiveRtcp(void *pkt, pj_ssize_t size) {
+        deliverRtcp(pkt, size);
+    }
+
+    //the stream is going away, no packet may be delivered to it afterwards
+    virtual void onDetach() {}
+
+    void deliverRtp(pjmedia_tp_cb_param *param);
+    void deliverRtcp(void *pkt, pj_ssize_t size);
+
+    pjmedia_transport* slave() const { return _slave; }
+    const pj_sockaddr& remoteRtp() const { return _remoteRtp; }
+    const pj_sockaddr& remoteRtcp() const { return _remoteRtcp; }
+    const pj_sockaddr& localRtp() const { return _localRtp; }
+    const pj_sockaddr& localRtcp() const { return _localRtcp; }
+
+private:
+    Q_DISABLE_COPY_MOVE(MediaTransportAdapter)
+
+    struct Transport {
+        pjmedia_transport base;
+        MediaTransportAdapter *adapter;
+    };
+
+    static MediaTransportAdapter* self(pjmedia_transport *tp) {
+        return reinterpret_cast<Transport*>(tp)->adapter;
+    }
+
+    static pj_status_t getInfo(pjmedia_transport *tp, pjmedia_transport_info *info);
+    static void detach(pjmedia_transport *tp, void *userData);
+    static pj_status_t sendRtpOp(pjmedia_transport *tp, const void *pkt, pj_size_t size);
+    static pj_status_t sendRtcpOp(pjmedia_transport *tp, const void *pkt, pj_size_t size);
+    static pj_status_t sendRtcp2Op(pjmedia_transport *tp, const pj_sockaddr_t *addr, unsigned addrLen,
+                                   const void *pkt, pj_size_t size);
+    static pj_status_t mediaCreate(pjmedia_transport *tp, pj_pool_t *sdpPool, unsigned options,
+                                   const pjmedia_sdp_session *remoteSdp, unsigned mediaIndex);
+    static pj_status_t encodeSdp(pjmedia_transport *tp, pj_pool_t *sdpPool, pjmedia_sdp_session *localSdp,
+                                 const pjmedia_sdp_session *remoteSdp, unsigned mediaIndex);
+    static pj_status_t mediaStart(pjmedia_transport *tp, pj_pool_t *tmpPool, const pjmedia_sdp_session *localSdp,
+                                  const pjmedia_sdp_session *remoteSdp, unsigned mediaIndex);
+    static pj_status_t mediaStop(pjmedia_transport *tp);
+    static pj_status_t simulateLost(pjmedia_transport *tp, pjmedia_dir dir, unsigned pctLost);
+    static pj_status_t destroy(pjmedia_transport *tp);
+    static pj_status_t attach2(pjmedia_transport *tp, pjmedia_transport_attach_param *param);
+    static void onRtp(pjmedia_tp_cb_param *param);
+    static void onRtcp(void *userData, void *pkt, pj_ssize_t size);
+
+    static pjmedia_transport_op _op;
+
+    Transport _transport{};
+    pjmedia_transport *_slave = nullptr;
+    bool _ownsSlave = false;
+
+    //stream attached to this transport
+    void *_streamUserData = nullptr;
+    void (*_streamRtpCb)(void *userData, void *pkt, pj_ssize_t size) = nullptr;
+    void (*_streamRtpCb2)(pjmedia_tp_cb_param *param) = nullptr;
+    void (*_streamRtcpCb)(void *userData, void *pkt, pj_ssize_t size) = nullptr;
+
+    pj_sockaddr _remoteRtp{};
+    pj_sockaddr _remoteRtcp{};
+    pj_sockaddr _localRtp{};
+    pj_sockaddr _localRtcp{};
+};
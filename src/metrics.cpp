@@ -0,0 +1,186 @@
+#include "metrics.h"
+#include <QSaveFile>
+#include <QtAlgorithms>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+//bucket bounds of the exposition, in seconds
+constexpr double EXPORTED_BOUNDS[] = {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1,
+                                      0.25, 0.5, 1, 2.5, 5, 10, 30, 60};
+
+QByteArray seriesName(const QByteArray &name, const QByteArray &labels, const QByteArray &extraLabel = QByteArray())
+{
+    QByteArray allLabels = labels;
+    if (!extraLabel.isEmpty()) {
+        if (!allLabels.isEmpty()) {
+            allLabels.append(',');
+        }
+        allLabels.append(extraLabel);
+    }
+    return allLabels.isEmpty() ? name : name + '{' + allLabels + '}';
+}
+
+void appendHeader(QByteArray &text, const QByteArray &name, const QByteArray &help, const char *type)
+{
+    text.append("# HELP ").append(name).append(' ').append(help).append('\n');
+    text.append("# TYPE ").append(name).append(' ').append(type).append('\n');
+}
+}
+
+void HdrHistogram::record(qint64 value)
+{
+    const auto unsignedValue = static_cast<quint64>(std::max<qint64>(0, value));
+    _buckets[static_cast<size_t>(bucketIndex(unsignedValue))].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(unsignedValue, std::memory_order_relaxed);
+    auto max = _max.load(std::memory_order_relaxed);
+    while ((max < unsignedValue) &&
+           !_max.compare_exchange_weak(max, unsignedValue, std::memory_order_relaxed)) {}
+}
+
+double HdrHistogram::percentile(double percentile) const
+{
+    //the buckets are read one by one, concurrent records may be half counted
+    quint64 total = 0;
+    for (const auto &bucket: _buckets) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (0 == total) {
+        return 0;
+    }
+    const auto rank = std::max<quint64>(1, static_cast<quint64>(std::ceil(percentile / 100.0 * total)));
+    quint64 cumulated = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        cumulated += _buckets[static_cast<size_t>(i)].load(std::memory_order_relaxed);
+        if (cumulated >= rank) {
+            //highest value of the bucket
+            const auto highest = (BUCKET_COUNT - 1 > i) ? bucketLowest(i + 1) - 1 : bucketLowest(i);
+            return std::min<double>(highest, _max.load(std::memory_order_relaxed)) / _scale;
+        }
+    }
+    return max();
+}
+
+quint64 HdrHistogram::countAtMost(double bound) const
+{
+    const double limit = bound * _scale;
+    quint64 count = 0;
+    //only the buckets entirely below the bound, the last one has no upper bound
+    for (int i = 0; (BUCKET_COUNT - 1 > i) && (bucketLowest(i + 1) - 1 <= limit); ++i) {
+        count += _buckets[static_cast<size_t>(i)].load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+int HdrHistogram::bucketIndex(quint64 value)
+{
+    if (2 * SUB_BUCKET_COUNT > value) {
+        return static_cast<int>(value);
+    }
+    //the leading bits select the sub-bucket, the position of the leading one the power of two
+    const int highestBit = 63 - static_cast<int>(qCountLeadingZeroBits(value));
+    const int shift = highestBit - SUB_BUCKET_BITS;
+    const int index = shift * SUB_BUCKET_COUNT + static_cast<int>(value >> shift);
+    return std::min(index, BUCKET_COUNT - 1);
+}
+
+quint64 HdrHistogram::bucketLowest(int index)
+{
+    if (2 * SUB_BUCKET_COUNT > index) {
+        return static_cast<quint64>(index);
+    }
+    const int shift = index / SUB_BUCKET_COUNT - 1;
+    return static_cast<quint64>(index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT) << shift;
+}
+
+Metrics& Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+Counter& Metrics::counter(const char *name, const char *help, const QByteArray &labels)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &family = _counters[name];
+    family.help = help;
+    auto &counter = family.series[labels];
+    if (!counter) {
+        counter = std::make_unique<Counter>();
+    }
+    return *counter;
+}
+
+Gauge& Metrics::gauge(const char *name, const char *help, const QByteArray &labels)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &family = _gauges[name];
+    family.help = help;
+    auto &gauge = family.series[labels];
+    if (!gauge) {
+        gauge = std::make_unique<Gauge>();
+    }
+    return *gauge;
+}
+
+HdrHistogram& Metrics::histogram(const char *name, const char *help, const QByteArray &labels, double scale)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &family = _histograms[name];
+    family.help = help;
+    auto &histogram = family.series[labels];
+    if (!histogram) {
+        histogram = std::make_unique<HdrHistogram>(scale);
+    }
+    return *histogram;
+}
+
+QByteArray Metrics::prometheusText() const
+{
+    QByteArray text;
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto &[name, family]: _counters) {
+        appendHeader(text, name, family.help, "counter");
+        for (const auto &[labels, counter]: family.series) {
+            text.append(seriesName(name, labels)).append(' ')
+                    .append(QByteArray::number(counter->value())).append('\n');
+        }
+    }
+    for (const auto &[name, family]: _gauges) {
+        appendHeader(text, name, family.help, "gauge");
+        for (const auto &[labels, gauge]: family.series) {
+            text.append(seriesName(name, labels)).append(' ')
+                    .append(QByteArray::number(gauge->value(), 'g', 10)).append('\n');
+        }
+    }
+    for (const auto &[name, family]: _histograms) {
+        appendHeader(text, name, family.help, "histogram");
+        const QByteArray bucketName = name + "_bucket";
+        for (const auto &[labels, histogram]: family.series) {
+            for (const auto bound: EXPORTED_BOUNDS) {
+                const auto le = "le=\"" + QByteArray::number(bound, 'g', 6) + '"';
+                text.append(seriesName(bucketName, labels, le)).append(' ')
+                        .append(QByteArray::number(histogram->countAtMost(bound))).append('\n');
+            }
+            const auto count = QByteArray::number(histogram->count());
+            text.append(seriesName(bucketName, labels, "le=\"+Inf\"")).append(' ').append(count).append('\n');
+            text.append(seriesName(name + "_sum", labels)).append(' ')
+                    .append(QByteArray::number(histogram->sum(), 'g', 10)).append('\n');
+            text.append(seriesName(name + "_count", labels)).append(' ').append(count).append('\n');
+        }
+    }
+    return text;
+}
+
+bool Metrics::writeSnapshot(const QString &filePath) const
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write metrics to" << filePath;
+        return false;
+    }
+    file.write(prometheusText());
+    return file.commit();
+}
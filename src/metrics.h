@@ -0,0 +1,115 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+/**
+ * Monotonic counter, safe to increment from any thread.
+ */
+class Counter
+{
+public:
+    void add(quint64 value = 1) { _value.fetch_add(value, std::memory_order_relaxed); }
+    quint64 value() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> _value{0};
+};
+
+/**
+ * Value that goes up and down, safe to update from any thread.
+ */
+class Gauge
+{
+public:
+    void set(double value) { _value.store(value, std::memory_order_relaxed); }
+    void add(double value) {
+        auto current = _value.load(std::memory_order_relaxed);
+        while (!_value.compare_exchange_weak(current, current + value, std::memory_order_relaxed)) {}
+    }
+    double value() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> _value{0};
+};
+
+/**
+ * High dynamic range histogram of integer values (e.g. microseconds): values
+ * below 64 are exact, above they fall into 32 linear sub-buckets per power
+ * of two, about 3% precision up to 2^40. Recording is a few relaxed atomic
+ * increments, no lock and no allocation, so it can be done from the pjsua
+ * and media threads. The scale converts the values to the exported unit.
+ */
+class HdrHistogram
+{
+public:
+    explicit HdrHistogram(double scale = 1) : _scale(scale) {}
+
+    void record(qint64 value);
+    quint64 count() const { return _count.load(std::memory_order_relaxed); }
+    //in the exported unit
+    double sum() const { return _sum.load(std::memory_order_relaxed) / _scale; }
+    double max() const { return _max.load(std::memory_order_relaxed) / _scale; }
+    double percentile(double percentile) const;
+    //values at most the given bound, in the exported unit
+    quint64 countAtMost(double bound) const;
+
+    enum { SUB_BUCKET_BITS = 5, SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS, MAX_VALUE_BITS = 40,
+           BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT };
+    //the bucket of a value and the lowest value of a bucket, the last bucket takes all larger values
+    static int bucketIndex(quint64 value);
+    static quint64 bucketLowest(int index);
+
+private:
+    Q_DISABLE_COPY_MOVE(HdrHistogram)
+
+    const double _scale;
+    std::array<std::atomic<quint64>, BUCKET_COUNT> _buckets{};
+    std::atomic<quint64> _count{0};
+    std::atomic<quint64> _sum{0};
+    std::atomic<quint64> _max{0};
+};
+
+/**
+ * Process-wide registry of the metrics, exported in the Prometheus text
+ * format. Registering takes a lock and is meant to be done once, e.g. into
+ * a function-local static reference; the returned metric lives as long as
+ * the process and is updated without locking. The same name and labels
+ * always return the same metric.
+ */
+class Metrics
+{
+public:
+    static Metrics& instance();
+
+    //labels in the exposition syntax, e.g. "direction=\"outgoing\""
+    Counter& counter(const char *name, const char *help, const QByteArray &labels = QByteArray());
+    Gauge& gauge(const char *name, const char *help, const QByteArray &labels = QByteArray());
+    //the scale is the number of recorded units per exported unit, e.g. 1e6 for microseconds exported in seconds
+    HdrHistogram& histogram(const char *name, const char *help, const QByteArray &labels = QByteArray(),
+                            double scale = 1e6);
+
+    QByteArray prometheusText() const;
+    //written to a temporary file and renamed, a scraper never reads half a snapshot
+    bool writeSnapshot(const QString &filePath) const;
+
+private:
+    Metrics() = default;
+    Q_DISABLE_COPY_MOVE(Metrics)
+
+    template<typename T>
+    struct Family {
+        QByteArray help;
+        std::map<QByteArray, std::unique_ptr<T>> series;//by labels
+    };
+
+    mutable std::mutex _mutex;
+    std::map<QByteArray, Family<Counter>> _counters;
+    std::map<QByteArray, Family<Gauge>> _gauges;
+    std::map<QByteArray, Family<HdrHistogram>> _histograms;
+};
@@ -0,0 +1,87 @@
+#include "metrics_server.h"
+#include "metrics.h"
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QDebug>
+
+MetricsServer::MetricsServer(QObject *parent) : QObject(parent),
+    _server(new QTcpServer(this))
+{
+    connect(_server, &QTcpServer::newConnection, this, &MetricsServer::onNewConnection);
+
+    _snapshotTimer.setInterval(SNAPSHOT_INTERVAL_MS);
+    connect(&_snapshotTimer, &QTimer::timeout, this, &MetricsServer::writeSnapshot);
+}
+
+MetricsServer::~MetricsServer()
+{
+    if (!_snapshotPath.isEmpty()) {
+        writeSnapshot();
+    }
+    _server->close();
+}
+
+bool MetricsServer::listen(quint16 port)
+{
+    //no authentication: never exposed outside the host
+    if (!_server->listen(QHostAddress::LocalHost, port)) {
+        qCritical() << "Cannot export metrics on port" << port << ":" << _server->errorString();
+        return false;
+    }
+    qInfo() << "Metrics exported on" << QString("http://127.0.0.1:%1/metrics").arg(_server->serverPort());
+    return true;
+}
+
+void MetricsServer::writeSnapshots(const QString &filePath)
+{
+    _snapshotPath = filePath;
+    writeSnapshot();
+    _snapshotTimer.start();
+}
+
+void MetricsServer::onNewConnection()
+{
+    while (_server->hasPendingConnections()) {
+        auto *socket = _server->nextPendingConnection();
+        _requests.insert(socket, QByteArray());
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            onReadyRead(socket);
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            _requests.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void MetricsServer::onReadyRead(QTcpSocket *socket)
+{
+    auto it = _requests.find(socket);
+    if (it == _requests.end()) {
+        return;
+    }
+    it->append(socket->readAll());
+    if (!it->contains("\r\n\r\n")) {
+        if (MAX_REQUEST_SIZE < it->size()) {
+            socket->abort();
+        }
+        return;
+    }
+    const bool isGet = it->startsWith("GET ");
+    _requests.erase(it);
+
+    const QByteArray body = isGet ? Metrics::instance().prometheusText() : QByteArray("Method Not Allowed\n");
+    QByteArray response = isGet ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 405 Method Not Allowed\r\n";
+    response.append("Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n");
+    response.append("Content-Length: ").append(QByteArray::number(body.size())).append("\r\n");
+    response.append("Connection: close\r\n\r\n");
+    response.append(body);
+    socket->write(response);
+    socket->disconnectFromHost();
+}
+
+void MetricsServer::writeSnapshot()
+{
+    Metrics::instance().writeSnapshot(_snapshotPath);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+
+class QTcpServer;
+class QTcpSocket;
+
+/**
+ * Exports the Metrics registry in the Prometheus text format: over HTTP on
+ * a localhost port (any path, e.g. http://127.0.0.1:9464/metrics) and/or as
+ * a file snapshot rewritten periodically, e.g. for the textfile collector of
+ * the node exporter.
+ */
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MetricsServer(QObject *parent = nullptr);
+    ~MetricsServer();
+
+    bool listen(quint16 port);
+    void writeSnapshots(const QString &filePath);
+
+private:
+    Q_DISABLE_COPY_MOVE(MetricsServer)
+
+    enum { SNAPSHOT_INTERVAL_MS = 15000, MAX_REQUEST_SIZE = 8 * 1024 };
+
+    void onNewConnection();
+    void onReadyRead(QTcpSocket *socket);
+    void writeSnapshot();
+
+    QTcpServer *_server = nullptr;
+    QHash<QTcpSocket*, QByteArray> _requests;
+    QString _snapshotPath;
+    QTimer _snapshotTimer;
+};
@@ -69,6 +69,7 @@ void ActiveCallModel::addCall(int callId, const QString &userName, const QString
         info.callStartTime = QDateTime::currentDateTime();
         info.callState = CallState::PENDING;
         _callInfo[callId] = info;
+        ++_stateCount[static_cast<size_t>(info.callState)];
         _callOrder.append(callId);
         emit callCountChanged();
     } else {
@@ -81,9 +82,11 @@ void ActiveCallModel::addCall(int callId, const QString &userName, const QString
 
 void ActiveCallModel::setCallState(int callId, ActiveCallModel::CallState callState)
 {
-    if (_callInfo.contains(callId)) {
+    auto it = _callInfo.find(callId);
+    if (it != _callInfo.end()) {
         emit layoutAboutToBeChanged();
-        _callInfo[callId].callState = callState;
+        updateStateCount(it->callState, callState);
+        it->callState = callState;
         emit layoutChanged();
     } else {
         qWarning() << "Cannot set call state" << callId;
@@ -93,8 +96,10 @@ void ActiveCallModel::setCallState(int callId, ActiveCallModel::CallState callSt
 void ActiveCallModel::removeCall(int callId)
 {
     emit layoutAboutToBeChanged();
-    if (_callInfo.contains(callId)) {
-        _callInfo.remove(callId);
+    auto it = _callInfo.find(callId);
+    if (it != _callInfo.end()) {
+        --_stateCount[static_cast<size_t>(it->callState)];
+        _callInfo.erase(it);
         _callOrder.removeAll(callId);
         emit callCountChanged();
     } else {
@@ -115,6 +120,14 @@ void ActiveCallModel::removeCall(int callId)
 QVector<int> ActiveCallModel::confirmedCallsId(bool includePending) const
 {
     QVector<int> ids;
+    int count = stateCount(CallState::CONFIRMED);
+    if (includePending) {
+        count += stateCount(CallState::PENDING);
+    }
+    if (0 == count) {
+        return ids;
+    }
+    ids.reserve(count);
     for (auto it = _callInfo.constBegin(); it != _callInfo.constEnd(); ++it) {
         const auto &info = it.value();
         bool cond =  (CallState::CONFIRMED == info.callState);
@@ -4,6 +4,7 @@
 #include <QHash>
 #include <QDateTime>
 #include <QAbstractListModel>
+#include <array>
 
 class ActiveCallModel : public QAbstractListModel
 {
@@ -32,7 +33,10 @@ public:
     void removeCall(int callId);
 
     QVector<int> confirmedCallsId(bool includePending = false) const;
-    bool isConference() const { return 1 < confirmedCallsId().size(); }
+    bool isConference() const { return 1 < stateCount(CallState::CONFIRMED); }
+    int stateCount(CallState callState) const {
+        return _stateCount.at(static_cast<size_t>(callState));
+    }
 
     bool isEmpty() const { return _callInfo.isEmpty(); }
     int callCount() const { return _callInfo.size(); }
@@ -58,11 +62,17 @@ private:
         bool incoming = true;
         CallState callState = CallState::UNKNOWN;
     };
+    enum { CALL_STATE_COUNT = static_cast<int>(CallState::ON_HOLD) + 1 };
     bool isCurrentCall(int callId) const;
+    void updateStateCount(CallState oldState, CallState newState) {
+        --_stateCount[static_cast<size_t>(oldState)];
+        ++_stateCount[static_cast<size_t>(newState)];
+    }
     bool isValidIndex(int index) const {
             return ((index >= 0) && (index < _callOrder.count()));
         }
     QHash<int, CallInfo> _callInfo;//key is the call ID
     QVector<int> _callOrder;
+    std::array<int, CALL_STATE_COUNT> _stateCount{};//number of calls in each state
     int _currentCallId = PJSUA_INVALID_ID;
 };
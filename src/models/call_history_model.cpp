@@ -6,6 +6,7 @@
 CallHistoryModel::CallHistoryModel(QObject *parent) : QAbstractListModel(parent)
 {
     _history = Settings::callHistoryInfo();
+    formatDateTimes();
 }
 
 int CallHistoryModel::rowCount(const QModelIndex& /*parent*/) const
@@ -32,14 +33,17 @@ QVariant CallHistoryModel::data(const QModelIndex &index, int role) const
         out = history.phoneNumber;
         break;
     case CallDate:
-        out = history.dateTime.toString("MMMM d, yyyy");
+        out = history.dateText;
         break;
     case CallTime:
-        out = history.dateTime.toString("hh:mm:ss");
+        out = history.timeText;
         break;
     case CallStatusRole:
         out = callStatusToString(history.callStatus);
         break;
+    case CallDay:
+        out = history.dayText;
+        break;
     default:
         qCritical() << "unknown role" << role;
     }
@@ -54,7 +58,8 @@ QHash<int,QByteArray> CallHistoryModel::roleNames() const
         { PhoneNumber, "phoneNumber" },
         { CallDate, "callDate" },
         { CallTime, "callTime" },
-        { CallStatusRole, "callStatus" }
+        { CallStatusRole, "callStatus" },
+        { CallDay, "callDay" }
     };
     return roles;
 }
@@ -63,6 +68,7 @@ void CallHistoryModel::clear()
 {
     emit layoutAboutToBeChanged();
     _history.clear();
+    _liveCallRow.clear();
     emit layoutChanged();
     Settings::saveCallHistoryInfo(_history);
 }
@@ -73,6 +79,7 @@ void CallHistoryModel::deleteContact(int index)
         emit layoutAboutToBeChanged();
         _history.removeAt(index);
         sortHistory();
+        updateCallIndex();
         emit layoutChanged();
         Settings::saveCallHistoryInfo(_history);
     }
@@ -118,7 +125,53 @@ void CallHistoryModel::addContact(int callId, const QString &user,
         _history.removeLast();
     }
 
+    //rows of the calls in progress move down by one
+    for (auto it = _liveCallRow.begin(); it != _liveCallRow.end();) {
+        if (it.value() < _history.size()) {
+            ++it.value();
+            ++it;
+        } else {
+            it = _liveCallRow.erase(it);
+        }
+    }
     _history.push_front(item);
+    if (PJSUA_INVALID_ID != callId) {
+        _liveCallRow[callId] = 0;
+    }
+    emit layoutChanged();
+    Settings::saveCallHistoryInfo(_history);
+}
+
+void CallHistoryModel::addCalls(const QVector<CallHistoryInfo> &calls)
+{
+    if (calls.isEmpty()) {
+        return;
+    }
+    qDebug() << "addCalls" << calls.size();
+    emit layoutAboutToBeChanged();
+    //only the newest ones fit
+    const int count = std::min<int>(calls.size(), MAX_HISTORY_SIZE);
+    QVector<CallHistoryInfo> history;
+    history.reserve(std::min<int>(count + _history.size(), MAX_HISTORY_SIZE));
+    for (int i = calls.size() - 1; i >= calls.size() - count; --i) {
+        history.append(calls.at(i));
+    }
+    for (const auto &it: std::as_const(_history)) {
+        if (MAX_HISTORY_SIZE <= history.size()) {
+            break;
+        }
+        history.append(it);
+    }
+    _history = std::move(history);
+    //rows of the calls in progress move down by the batch size
+    for (auto it = _liveCallRow.begin(); it != _liveCallRow.end();) {
+        it.value() += count;
+        if (it.value() < _history.size()) {
+            ++it;
+        } else {
+            it = _liveCallRow.erase(it);
+        }
+    }
     emit layoutChanged();
     Settings::saveCallHistoryInfo(_history);
 }
@@ -163,7 +216,24 @@ void CallHistoryModel::updateCallStatus(int callId, CallHistoryModel::CallStatus
 void CallHistoryModel::onContactsReady()
 {
     emit layoutAboutToBeChanged();
+    //the call IDs are not saved, the reloaded rows of the calls in progress are found by number and time
+    QVector<CallHistoryInfo> liveCalls;
+    for (auto it = _liveCallRow.cbegin(); it != _liveCallRow.cend(); ++it) {
+        if (isValidIndex(it.value())) {
+            liveCalls.append(_history.at(it.value()));
+        }
+    }
     _history = Settings::callHistoryInfo();
+    for (const auto &call: std::as_const(liveCalls)) {
+        for (auto &it: _history) {
+            if ((PJSUA_INVALID_ID == it.callId) && (call.phoneNumber == it.phoneNumber) &&
+                    (call.dateTime.toSecsSinceEpoch() == it.dateTime.toSecsSinceEpoch())) {
+                it.callId = call.callId;
+                break;
+            }
+        }
+    }
+    formatDateTimes();
     qDebug() << "onContactsReady" << _history.size();
     if (nullptr != _contactsModel) {
         for (auto &it: _history) {
@@ -176,9 +246,19 @@ void CallHistoryModel::onContactsReady()
         }
     }
     sortHistory();
+    updateCallIndex();
     emit layoutChanged();
 }
 
+void CallHistoryModel::refreshDateTimeText()
+{
+    //needed only when the locale, the time zone or the day changes
+    formatDateTimes();
+    if (!_history.isEmpty()) {
+        emit dataChanged(index(0), index(_history.size() - 1), { CallDate, CallTime, CallDay });
+    }
+}
+
 QString CallHistoryModel::formatUserName(const QString &firstName, const QString &lastName)
 {
     QString userName = firstName;
@@ -212,12 +292,30 @@ void CallHistoryModel::sortHistory()
     });
 }
 
-int CallHistoryModel::calId2index(int callId)
+void CallHistoryModel::formatDateTimes()
+{
+    const auto today = QDate::currentDate();
+    for (auto &it: _history) {
+        it.formatDateTime(today);
+    }
+}
+
+void CallHistoryModel::updateCallIndex()
 {
-    for (int i = 0; i < _history.size(); ++i) {
-        if (callId == _history.at(i).callId) {
-            return i;
+    //rows were removed or reordered: find again the most recent row of each call in progress
+    for (auto it = _liveCallRow.begin(); it != _liveCallRow.end();) {
+        int row = models::INVALID_CONTACT_INDEX;
+        for (int i = 0; i < _history.size(); ++i) {
+            if (it.key() == _history.at(i).callId) {
+                row = i;
+                break;
+            }
+        }
+        if (models::INVALID_CONTACT_INDEX != row) {
+            it.value() = row;
+            ++it;
+        } else {
+            it = _liveCallRow.erase(it);
         }
     }
-    return models::INVALID_CONTACT_INDEX;
 }
@@ -5,6 +5,7 @@
 #include "pjsua.h"
 #include <QAbstractListModel>
 #include <QVector>
+#include <QHash>
 #include <QDateTime>
 #include <QQmlEngine>
 
@@ -26,7 +27,8 @@ public:
         PhoneNumber,
         CallDate,
         CallTime,
-        CallStatusRole
+        CallStatusRole,
+        CallDay
     };
     struct CallHistoryInfo {
 	int contactId = models::INVALID_CONTACT_ID;
@@ -36,15 +38,27 @@ public:
         CallStatus callStatus = CallStatus::UNKNOWN;
         bool confirmed = false;
         int callId = PJSUA_INVALID_ID;
+        //formatted once per row with the current locale
+        QString dateText;
+        QString timeText;
+        QString dayText;//section (day bucket) header
         CallHistoryInfo() = default;
         CallHistoryInfo(const QString &user, const QString &phone) :
             userName(user), phoneNumber(phone) {
             dateTime = QDateTime::currentDateTime();
+            formatDateTime();
         }
         void clear() {
 	    contactId = models::INVALID_CONTACT_ID;
             userName = phoneNumber = "";
             dateTime = QDateTime();
+            dateText = timeText = dayText = "";
+        }
+        void formatDateTime(const QDate &today = QDate::currentDate()) {
+            const QLocale locale;
+            dateText = locale.toString(dateTime.date(), QLocale::LongFormat);
+            timeText = locale.toString(dateTime.time(), "hh:mm:ss");
+            dayText = models::dayHeader(dateTime.date(), today);
         }
     };
 
@@ -75,9 +89,13 @@ public:
     void onContactAdded(int contactIndex);
     void addContact(int callId, const QString &user, const QString &phone,
                     CallStatus callStatus);
+    //finished calls, oldest first: one layout change and one save for the whole batch
+    void addCalls(const QVector<CallHistoryInfo> &calls);
     void updateContact(int callId, const QString &user, const QString &phone);
     void updateCallStatus(int callId, CallStatus callStatus, bool confirmed);
+    void removeCall(int callId) { _liveCallRow.remove(callId); }
     void onContactsReady();
+    void refreshDateTimeText();
 
     static QString formatUserName(const QString &firstName, const QString &lastName);
 
@@ -88,7 +106,12 @@ private:
     }
     static QString callStatusToString(CallStatus callStatus);
     void sortHistory();
-    int calId2index(int callId);
+    void formatDateTimes();
+    int calId2index(int callId) const {
+        return _liveCallRow.value(callId, models::INVALID_CONTACT_INDEX);
+    }
+    void updateCallIndex();
     QVector<CallHistoryInfo> _history;
+    QHash<int, int> _liveCallRow;//call ID -> history row, only for calls in progress
     ContactsModel *_contactsModel = nullptr;
 };
@@ -24,10 +24,10 @@ QVariant MessagesModel::data(const QModelIndex &index, int role) const
 		out = msg.id;
 		break;
 	case DateRole:
-		out = msg.timestamp.toString("yyyy-MM-dd");
+		out = msg.dateText;
 		break;
 	case TimeRole:
-		out = msg.timestamp.toString("HH:mm:ss");
+		out = msg.timeText;
 		break;
 	case StatusRole:
 		out = static_cast<int>(msg.status);
@@ -101,6 +101,9 @@ QVariant MessagesModel::data(const QModelIndex &index, int role) const
 	case DstAuth:
 		out = msg.dstAdditionalInfo.auth;
 		break;
+	case DayRole:
+		out = msg.dayText;
+		break;
 	case Qt::DisplayRole:
 		out = msg.srcAdditionalInfo.extension + msg.dstAdditionalInfo.extension;
 		break;
@@ -134,7 +137,8 @@ QHash<int,QByteArray> MessagesModel::roleNames() const
 		{ DstOriginalAuth, "dstOriginalAuth" },
 		{ DstLabel, "dstLabel" },
 		{ DstExtension, "dstExtension" },
-		{ DstAuth, "dstAuth" }
+		{ DstAuth, "dstAuth" },
+		{ DayRole, "dayRole" }
 	};
 	return roles;
 }
@@ -153,9 +157,23 @@ void MessagesModel::append(const Message &msg)
 {
 	emit layoutAboutToBeChanged();
 	_messages << msg;
+	_messages.last().filterKey = makeFilterKey(msg);
+	formatTimestamp(_messages.last());
 	emit layoutChanged();
 }
 
+void MessagesModel::refreshDateTimeText()
+{
+	// needed only when the locale, the time zone or the day changes
+	const auto today = QDate::currentDate();
+	for (auto &msg: _messages) {
+		formatTimestamp(msg, today);
+	}
+	if (!_messages.isEmpty()) {
+		emit dataChanged(index(0), index(_messages.size() - 1), { DateRole, TimeRole, DayRole });
+	}
+}
+
 void MessagesModel::updateChatList()
 {
 	QStringList conversationList;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "model_constants.h"
 #include <QAbstractListModel>
 #include <QList>
 #include <QQmlEngine>
@@ -34,7 +35,8 @@ class MessagesModel : public QAbstractListModel
 		DstOriginalAuth,
 		DstLabel,
 		DstExtension,
-		DstAuth
+		DstAuth,
+		DayRole
 	};
 
 	enum class Status { SUCCESS, BLOCKED };
@@ -69,6 +71,10 @@ class MessagesModel : public QAbstractListModel
 		AdditionalInfo srcAdditionalInfo;
 		AdditionalInfo dstOriginalAdditionalInfo;
 		AdditionalInfo dstAdditionalInfo;
+		QString filterKey;// case-folded src and dst extensions, filled in by append()
+		QString dateText;// formatted once with the current locale
+		QString timeText;
+		QString dayText;// section (day bucket) header
 	};
 
 	explicit MessagesModel(QObject *parent = nullptr);
@@ -87,11 +93,25 @@ class MessagesModel : public QAbstractListModel
 		emit layoutChanged();
 	}
 	void updateChatList();
+	void refreshDateTimeText();
+	const QString& filterKey(int row) const {
+		static const QString emptyKey;
+		return isValidIndex(row) ? _messages.at(row).filterKey : emptyKey;
+	}
+	static QString makeFilterKey(const Message &msg) {
+		return (msg.srcAdditionalInfo.extension + msg.dstAdditionalInfo.extension).toCaseFolded();
+	}
 
     private:
 	bool isValidIndex(int index) const {
 		return ((index >= 0) && (index < _messages.count()));
 	}
+	static void formatTimestamp(Message &msg, const QDate &today = QDate::currentDate()) {
+		const QLocale locale;
+		msg.dateText = locale.toString(msg.timestamp.date(), QLocale::ShortFormat);
+		msg.timeText = locale.toString(msg.timestamp.time(), "HH:mm:ss");
+		msg.dayText = models::dayHeader(msg.timestamp.date(), today);
+	}
 	QList<Message> _messages;
 	ChatList *_chatList{nullptr};
 };
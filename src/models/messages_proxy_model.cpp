@@ -4,6 +4,15 @@
 MessagesProxyModel::MessagesProxyModel(QObject *parent) : QSortFilterProxyModel(parent),
 	  _messagesModel(new MessagesModel(this))
 {
+	// source rows are about to be reordered or replaced, previous results no longer apply;
+	// connected first, so the results are dropped before the proxy filters the new rows
+	connect(_messagesModel, &QAbstractItemModel::layoutAboutToBeChanged, this, [this]() {
+		resetAcceptedRows();
+	});
+	connect(_messagesModel, &QAbstractItemModel::modelAboutToBeReset, this, [this]() {
+		resetAcceptedRows();
+	});
+
 	setSourceModel(_messagesModel);
 	setFilterRole(Qt::DisplayRole);  // Set the role to use for filtering (e.g., DisplayRole)
 	setFilterCaseSensitivity(Qt::CaseInsensitive);  // Set the case sensitivity of the filter
@@ -11,12 +20,45 @@ MessagesProxyModel::MessagesProxyModel(QObject *parent) : QSortFilterProxyModel(
 
 bool MessagesProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
 {
-	QModelIndex index = sourceModel()->index(sourceRow, 0, sourceParent);
-	QString itemData = sourceModel()->data(index).toString();
+	Q_UNUSED(sourceParent)
+	updateMatcher();
 
-	// Filter based on a search string
-	const auto searchString = filterRegularExpression().pattern();
-	return itemData.contains(searchString, Qt::CaseSensitive);
+	// a row rejected by a shorter query cannot match a longer one containing it,
+	// otherwise match against the precomputed case-folded key of the source model
+	bool accepted = !_refine || _prevAcceptedRows.testBit(sourceRow);
+	if (accepted && !_filterPattern.isEmpty()) {
+		const auto &key = _messagesModel->filterKey(sourceRow);
+		accepted = -1 != _matcher.indexIn(QStringView(key));
+	}
+	if (sourceRow < _acceptedRows.size()) {
+		_acceptedRows.setBit(sourceRow, accepted);
+		if (!_evaluatedRows.testBit(sourceRow)) {
+			_evaluatedRows.setBit(sourceRow);
+			++_evaluatedCount;
+		}
+	}
+	return accepted;
+}
+
+void MessagesProxyModel::updateMatcher() const
+{
+	const auto rowCount = _messagesModel->rowCount();
+	const auto rawPattern = filterRegularExpression().pattern();
+	if ((rawPattern == _rawPattern) && (_acceptedRows.size() == rowCount)) {
+		return;
+	}
+	const auto pattern = rawPattern.toCaseFolded();
+	// refine only when the new query extends the previous one and that one saw every row
+	_refine = !_filterPattern.isEmpty() && pattern.contains(_filterPattern) &&
+		(_acceptedRows.size() == rowCount) && (_evaluatedCount == rowCount);
+	_prevAcceptedRows = _refine ? _acceptedRows : QBitArray();
+	_acceptedRows = QBitArray(rowCount);
+	_evaluatedRows = QBitArray(rowCount);
+	_evaluatedCount = 0;
+	_rawPattern = rawPattern;
+	_filterPattern = pattern;
+	_matcher.setPattern(_filterPattern);
+	_matcher.setCaseSensitivity(Qt::CaseSensitive);
 }
 
 void MessagesProxyModel::appendOutgoing(const QString& srcExtension,
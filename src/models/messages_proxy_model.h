@@ -1,6 +1,8 @@
 #pragma once
 
 #include <QSortFilterProxyModel>
+#include <QStringMatcher>
+#include <QBitArray>
 
 class MessagesModel;
 
@@ -14,5 +16,23 @@ class MessagesProxyModel : public QSortFilterProxyModel
     protected:
 	bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
     private:
+	void updateMatcher() const;
+	void resetAcceptedRows() {
+		_acceptedRows.clear();
+		_evaluatedRows.clear();
+		_evaluatedCount = 0;
+		_prevAcceptedRows.clear();
+		_refine = false;
+	}
 	MessagesModel* _messagesModel{nullptr};
+	// filter state derived from the current search string, rebuilt lazily
+	mutable QString _rawPattern;
+	mutable QString _filterPattern;
+	mutable QStringMatcher _matcher;
+	// rows accepted by the previous search string, used when the query only grows
+	mutable QBitArray _acceptedRows;
+	mutable QBitArray _evaluatedRows;
+	mutable int _evaluatedCount{0};
+	mutable QBitArray _prevAcceptedRows;
+	mutable bool _refine{false};
 };
@@ -1,5 +1,21 @@
 #pragma once
 
+#include <QCoreApplication>
+#include <QDate>
+#include <QLocale>
+
 namespace models {
 enum { INVALID_CONTACT_ID = -1, INVALID_CONTACT_INDEX = -1 };
+
+//section (day bucket) header of the lists, relative to today
+inline QString dayHeader(const QDate &date, const QDate &today)
+{
+    if (today == date) {
+        return QCoreApplication::translate("models", "Today");
+    }
+    if (today.addDays(-1) == date) {
+        return QCoreApplication::translate("models", "Yesterday");
+    }
+    return QLocale().toString(date, QLocale::LongFormat);
+}
 } // namespace models
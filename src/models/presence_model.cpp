@@ -3,6 +3,12 @@
 #include "sip_client.h"
 #include "settings.h"
 
+PresenceModel::PresenceModel(QObject *parent) : QAbstractListModel(parent)
+{
+    _loadTimer.setInterval(LOAD_INTERVAL_MS);
+    connect(&_loadTimer, &QTimer::timeout, this, &PresenceModel::loadBatch);
+}
+
 int PresenceModel::rowCount(const QModelIndex& /*parent*/) const
 {
     return _presenceInfo.size();
@@ -115,10 +121,21 @@ void PresenceModel::load()
 	return;
     }
 
-    emit layoutAboutToBeChanged();
+    beginResetModel();
     _presenceInfo.clear();
-    for (int index = 0; index < _contactsModel->rowCount(); ++index) {
-	const auto& userId{_contactsModel->phoneNumber(index)};
+    endResetModel();
+    _loadIndex = 0;
+    loadBatch();
+    _loadTimer.start();
+}
+
+void PresenceModel::loadBatch()
+{
+    const auto contactCount = _contactsModel->rowCount();
+    const auto endIndex = qMin(_loadIndex + static_cast<int>(LOAD_BATCH_SIZE), contactCount);
+    emit layoutAboutToBeChanged();
+    for (; _loadIndex < endIndex; ++_loadIndex) {
+	const auto& userId{_contactsModel->phoneNumber(_loadIndex)};
         const auto buddyId = _sipClient->addBuddy(userId);
         if (PJSUA_INVALID_ID == buddyId) {
             continue;
@@ -126,15 +143,13 @@ void PresenceModel::load()
         PresenceInfo info;
         info.id = buddyId;
         info.phoneNumber = userId;
-        if (nullptr != _contactsModel) {
-            const auto index = _contactsModel->indexFromPhoneNumber(userId);
-	    if (models::INVALID_CONTACT_INDEX != index) {
-                info.userName = CallHistoryModel::formatUserName(_contactsModel->firstName(index),
-                                                                 _contactsModel->lastName(index));
-            }
-        }
+        info.userName = CallHistoryModel::formatUserName(_contactsModel->firstName(_loadIndex),
+                                                         _contactsModel->lastName(_loadIndex));
         _presenceInfo << info;
     }
-    qDebug() << "Loaded" << _presenceInfo.count() << "buddies";
     emit layoutChanged();
+    if (contactCount <= _loadIndex) {
+        _loadTimer.stop();
+        qDebug() << "Loaded" << _presenceInfo.count() << "buddies";
+    }
 }
@@ -6,6 +6,7 @@
 #include <QQmlEngine>
 #include <QAbstractListModel>
 #include <QList>
+#include <QTimer>
 
 class SipClient;
 class ContactsModel;
@@ -30,7 +31,7 @@ public:
 	int contactId{models::INVALID_CONTACT_INDEX};
     };
 
-    explicit PresenceModel(QObject *parent = nullptr) : QAbstractListModel(parent) {}
+    explicit PresenceModel(QObject *parent = nullptr);
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QHash<int,QByteArray> roleNames() const override;
@@ -38,6 +39,7 @@ public:
     Q_INVOKABLE void addBuddy(const QString &userId);
     Q_INVOKABLE void removeBuddy(int index);
     void updateStatus(pjsua_buddy_id id, const QString &status);
+    //subscribes to the contacts a batch at a time, the registration is not delayed by a SUBSCRIBE burst
     void load();
 
     void setSipClient(SipClient *sipClient) { _sipClient = sipClient; }
@@ -48,10 +50,14 @@ signals:
     void errorMessage(const QString& msg);
 
 private:
+    enum { LOAD_BATCH_SIZE = 10, LOAD_INTERVAL_MS = 100 };
+    void loadBatch();
     bool isValidIndex(int index) const {
         return ((index >= 0) && (index < _presenceInfo.count()));
     }
     QList<PresenceInfo> _presenceInfo;
     SipClient *_sipClient = nullptr;
     ContactsModel *_contactsModel = nullptr;
+    QTimer _loadTimer;
+    int _loadIndex = 0;//next contact to subscribe to
 };
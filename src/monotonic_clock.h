@@ -0,0 +1,12 @@
+#pragma once
+
+#include <QtGlobal>
+#include <chrono>
+
+//nanoseconds of the steady clock, the one time base of the call tracer,
+//the startup profile, the event loop watchdog and the media measurements
+inline qint64 monotonicNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
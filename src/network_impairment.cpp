@@ -0,0 +1,263 @@
+#include "network_impairment.h"
+#include <QStringList>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+std::mutex callProfileMutex;
+ImpairmentProfile callProfileValue;
+}
+
+ImpairmentProfile ImpairmentProfile::parse(const QString &spec)
+{
+    ImpairmentProfile profile;
+    const auto items = spec.split(',', Qt::SkipEmptyParts);
+    for (const auto &item: items) {
+        const auto keyValue = item.split('=');
+        if (2 != keyValue.size()) {
+            qWarning() << "Ignoring impairment item" << item;
+            continue;
+        }
+        const auto key = keyValue.at(0).trimmed().toLower();
+        const auto value = keyValue.at(1).trimmed();
+        if ("loss" == key) {
+            profile.lossPercent = value.toDouble();
+        } else if ("burst" == key) {
+            const auto probabilities = value.split('/');
+            profile.burstEnterPercent = probabilities.value(0).toDouble();
+            profile.burstExitPercent = probabilities.value(1, "100").toDouble();
+        } else if ("burstloss" == key) {
+            profile.burstLossPercent = value.toDouble();
+        } else if ("jitter" == key) {
+            profile.jitterMs = value.toInt();
+        } else if ("reorder" == key) {
+            profile.reorderPercent = value.toDouble();
+        } else if ("dup" == key) {
+            profile.duplicatePercent = value.toDouble();
+        } else if ("rate" == key) {
+            profile.rateKbps = value.toInt();
+        } else if ("dir" == key) {
+            profile.rx = ("rx" == value) || ("both" == value);
+            profile.tx = ("tx" == value) || ("both" == value);
+        } else if ("seed" == key) {
+            profile.seed = value.toUInt();
+        } else {
+            qWarning() << "Unknown impairment parameter" << key;
+        }
+    }
+    return profile;
+}
+
+QString ImpairmentProfile::toString() const
+{
+    return QString("loss=%1,burst=%2/%3,burstloss=%4,jitter=%5,reorder=%6,dup=%7,rate=%8,dir=%9")
+            .arg(lossPercent).arg(burstEnterPercent).arg(burstExitPercent).arg(burstLossPercent)
+            .arg(jitterMs).arg(reorderPercent).arg(duplicatePercent).arg(rateKbps)
+            .arg((rx && tx) ? "both" : (rx ? "rx" : "tx"));
+}
+
+pjmedia_transport* ImpairmentTransport::create(const ImpairmentProfile &profile, pjmedia_transport *slave,
+                                               bool ownsSlave)
+{
+    return (new ImpairmentTransport(profile, slave, ownsSlave))->transport();
+}
+
+void ImpairmentTransport::setCallProfile(const ImpairmentProfile &profile)
+{
+    std::lock_guard<std::mutex> lock(callProfileMutex);
+    callProfileValue = profile;
+}
+
+ImpairmentProfile ImpairmentTransport::callProfile()
+{
+    std::lock_guard<std::mutex> lock(callProfileMutex);
+    return callProfileValue;
+}
+
+ImpairmentTransport::ImpairmentTransport(const ImpairmentProfile &profile, pjmedia_transport *slave,
+                                         bool ownsSlave) :
+    MediaTransportAdapter("impairment", slave, ownsSlave),
+    _profile(profile),
+    _random(0 != profile.seed ? profile.seed : std::random_device{}())
+{
+    _scheduler = std::thread(&ImpairmentTransport::scheduleLoop, this);
+    qInfo() << "Network impairment" << _profile.toString();
+}
+
+ImpairmentTransport::~ImpairmentTransport()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wakeUp.notify_one();
+    _scheduler.join();
+    qInfo() << "Network impairment dropped" << _dropped[RX] << "received and" << _dropped[TX] << "sent packets";
+}
+
+pj_status_t ImpairmentTransport::sendRtp(const void *pkt, pj_size_t size)
+{
+    if (_profile.tx && impair(TX, false, pkt, size, nullptr)) {
+        return PJ_SUCCESS;
+    }
+    return MediaTransportAdapter::sendRtp(pkt, size);
+}
+
+pj_status_t ImpairmentTransport::sendRtcp(const void *pkt, pj_size_t size)
+{
+    if (_profile.tx && impair(TX, true, pkt, size, nullptr)) {
+        return PJ_SUCCESS;
+    }
+    return MediaTransportAdapter::sendRtcp(pkt, size);
+}
+
+void ImpairmentTransport::receiveRtp(pjmedia_tp_cb_param *param)
+{
+    if (_profile.rx && (0 < param->size) &&
+            impair(RX, false, param->pkt, static_cast<size_t>(param->size), param->src_addr)) {
+        return;
+    }
+    deliverRtp(param);
+}
+
+void ImpairmentTransport::receiveRtcp(void *pkt, pj_ssize_t size)
+{
+    if (_profile.rx && (0 < size) && impair(RX, true, pkt, static_cast<size_t>(size), nullptr)) {
+        return;
+    }
+    deliverRtcp(pkt, size);
+}
+
+void ImpairmentTransport::onDetach()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _detached = true;
+        _pending.clear();
+    }
+    //wait for a delivery in progress
+    std::lock_guard<std::mutex> lock(_deliveryMutex);
+}
+
+bool ImpairmentTransport::impair(Direction direction, bool rtcp, const void *pkt, size_t size,
+                                 const pj_sockaddr *src)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto &state = _state[direction];
+    if (isLost(state)) {
+        ++_dropped[direction];
+        return true;
+    }
+
+    const auto now = Clock::now();
+    auto due = now;
+    if (0 < _profile.rateKbps) {
+        //serialize on a link of the given rate, tail drop when the queue grows too long
+        const auto start = std::max(now, state.linkFree);
+        if (std::chrono::milliseconds(MAX_QUEUE_DELAY_MS) < start - now) {
+            ++_dropped[direction];
+            return true;
+        }
+        state.linkFree = start + std::chrono::microseconds(size * 8 * 1000 / static_cast<size_t>(_profile.rateKbps));
+        due = state.linkFree;
+    }
+    if (0 < _profile.jitterMs) {
+        due += std::chrono::microseconds(std::uniform_int_distribution<int>(0, 1000 * _profile.jitterMs)(_random));
+    }
+    if (chance(_profile.reorderPercent)) {
+        //later packets overtake this one
+        due += std::chrono::milliseconds(REORDER_DELAY_MS);
+    } else {
+        due = std::max(due, state.lastDue);
+        state.lastDue = due;
+    }
+    const int copies = chance(_profile.duplicatePercent) ? 2 : 1;
+    if ((due <= now) && (1 == copies)) {
+        return false;
+    }
+    if (_detached) {
+        return true;
+    }
+
+    for (int i = 0; i < copies; ++i) {
+        Packet packet;
+        packet.due = due;
+        packet.sequence = _sequence++;
+        packet.direction = direction;
+        packet.rtcp = rtcp;
+        packet.data.assign(static_cast<const char*>(pkt), static_cast<const char*>(pkt) + size);
+        if (nullptr != src) {
+            pj_sockaddr_cp(&packet.src, src);
+            packet.hasSrc = true;
+        }
+        _pending.push_back(std::move(packet));
+        std::push_heap(_pending.begin(), _pending.end(), Later());
+    }
+    lock.unlock();
+    _wakeUp.notify_one();
+    return true;
+}
+
+bool ImpairmentTransport::isLost(DirectionState &state)
+{
+    if (0 < _profile.burstEnterPercent) {
+        state.burst = state.burst ? !chance(_profile.burstExitPercent) : chance(_profile.burstEnterPercent);
+        if (state.burst && chance(_profile.burstLossPercent)) {
+            return true;
+        }
+    }
+    return chance(_profile.lossPercent);
+}
+
+void ImpairmentTransport::scheduleLoop()
+{
+    //the packets are handed to pjmedia from this thread
+    pj_thread_desc threadDesc{};
+    pj_thread_t *thread = nullptr;
+    pj_thread_register("impairment", threadDesc, &thread);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stopping) {
+        if (_pending.empty()) {
+            _wakeUp.wait(lock);
+            continue;
+        }
+        const auto due = _pending.front().due;
+        if (Clock::now() < due) {
+            _wakeUp.wait_until(lock, due);
+            continue;
+        }
+        std::pop_heap(_pending.begin(), _pending.end(), Later());
+        auto packet = std::move(_pending.back());
+        _pending.pop_back();
+        lock.unlock();
+        dispatch(packet);
+        lock.lock();
+    }
+}
+
+void ImpairmentTransport::dispatch(Packet &packet)
+{
+    std::lock_guard<std::mutex> lock(_deliveryMutex);
+    const auto size = packet.data.size();
+    if (TX == packet.direction) {
+        if (packet.rtcp) {
+            MediaTransportAdapter::sendRtcp(packet.data.data(), size);
+        } else {
+            MediaTransportAdapter::sendRtp(packet.data.data(), size);
+        }
+        return;
+    }
+    if (_detached) {
+        return;
+    }
+    if (packet.rtcp) {
+        deliverRtcp(packet.data.data(), static_cast<pj_ssize_t>(size));
+    } else {
+        pjmedia_tp_cb_param param{};
+        param.pkt = packet.data.data();
+        param.size = static_cast<pj_ssize_t>(size);
+        param.src_addr = packet.hasSrc ? &packet.src : nullptr;
+        deliverRtp(&param);
+    }
+}
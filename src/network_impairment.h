@@ -0,0 +1,113 @@
+#pragma once
+
+#include "media_transport_adapter.h"
+#include <QString>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+/**
+ * Network conditions applied to the RTP/RTCP packets of a call.
+ * Parsed from a comma separated spec, e.g.
+ * "loss=2,burst=5/50,burstloss=80,jitter=40,reorder=1,dup=0.5,rate=64,dir=rx,seed=7"
+ * burst gives the Gilbert-Elliott good->bad and bad->good transition probabilities (%).
+ */
+struct ImpairmentProfile {
+    double lossPercent = 0;
+    double burstEnterPercent = 0;
+    double burstExitPercent = 100;
+    double burstLossPercent = 100;
+    int jitterMs = 0;
+    double reorderPercent = 0;
+    double duplicatePercent = 0;
+    int rateKbps = 0;
+    bool rx = true;
+    bool tx = true;
+    unsigned seed = 0;//0 picks a random seed
+
+    bool isEnabled() const {
+        return (rx || tx) && ((0 < lossPercent) || (0 < burstEnterPercent) || (0 < jitterMs) ||
+                              (0 < reorderPercent) || (0 < duplicatePercent) || (0 < rateKbps));
+    }
+    static ImpairmentProfile parse(const QString &spec);
+    QString toString() const;
+};
+
+/**
+ * Media transport adapter emulating a bad network, for local benchmarking.
+ * Delayed packets are kept in a per call queue and sent or delivered to the
+ * stream by a scheduler thread at their due time.
+ */
+class ImpairmentTransport : public MediaTransportAdapter
+{
+public:
+    static pjmedia_transport* create(const ImpairmentProfile &profile, pjmedia_transport *slave, bool ownsSlave);
+
+    //profile used for the calls created from now on
+    static void setCallProfile(const ImpairmentProfile &profile);
+    static ImpairmentProfile callProfile();
+
+protected:
+    pj_status_t sendRtp(const void *pkt, pj_size_t size) override;
+    pj_status_t sendRtcp(const void *pkt, pj_size_t size) override;
+    void receiveRtp(pjmedia_tp_cb_param *param) override;
+    void receiveRtcp(void *pkt, pj_ssize_t size) override;
+    void onDetach() override;
+
+private:
+    ImpairmentTransport(const ImpairmentProfile &profile, pjmedia_transport *slave, bool ownsSlave);
+    ~ImpairmentTransport() override;
+
+    enum { REORDER_DELAY_MS = 40, MAX_QUEUE_DELAY_MS = 500 };
+    enum Direction { RX = 0, TX = 1, DIRECTION_COUNT };
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Packet {
+        Clock::time_point due;
+        quint64 sequence = 0;
+        Direction direction = RX;
+        bool rtcp = false;
+        std::vector<char> data;
+        pj_sockaddr src{};
+        bool hasSrc = false;
+    };
+    struct Later {
+        bool operator()(const Packet &a, const Packet &b) const {
+            return (a.due != b.due) ? (a.due > b.due) : (a.sequence > b.sequence);
+        }
+    };
+    struct DirectionState {
+        bool burst = false;//Gilbert-Elliott bad state
+        Clock::time_point lastDue;//keeps jitter from reordering on its own
+        Clock::time_point linkFree;//bandwidth cap
+    };
+
+    //returns false when the packet must be handled inline
+    bool impair(Direction direction, bool rtcp, const void *pkt, size_t size, const pj_sockaddr *src);
+    bool isLost(DirectionState &state);
+    bool chance(double percent) {
+        return (0 < percent) && (std::uniform_real_distribution<double>(0, 100)(_random) < percent);
+    }
+    void scheduleLoop();
+    void dispatch(Packet &packet);
+
+    const ImpairmentProfile _profile;
+    std::mt19937 _random;
+    std::array<DirectionState, DIRECTION_COUNT> _state;
+    std::array<quint64, DIRECTION_COUNT> _dropped{};
+
+    std::mutex _mutex;
+    std::condition_variable _wakeUp;
+    std::vector<Packet> _pending;//heap ordered by due time
+    quint64 _sequence = 0;
+    bool _stopping = false;
+    std::atomic<bool> _detached{false};
+    std::mutex _deliveryMutex;//held while a delayed packet is handed to the stream
+    std::thread _scheduler;
+};
@@ -0,0 +1,150 @@
+#include "ogg_opus_writer.h"
+#include <QRandomGenerator>
+#include <QtEndian>
+#include <QDebug>
+#include <array>
+#include <opus/opus.h>
+
+bool OggOpusWriter::open(const QString &filePath, unsigned clockRate,
+                         unsigned channelCount, int preSkip)
+{
+    close();
+    _file.setFileName(filePath);
+    //buffering is done here, avoid a second copy in QFile
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+        qCritical() << "Cannot open" << filePath << _file.errorString();
+        return false;
+    }
+    _buffer.reserve(WRITE_BUFFER_SIZE + PAGE_TARGET_SIZE + MAX_LACING_VALUES * 256);
+    _serial = QRandomGenerator::global()->generate();
+    _sequence = 0;
+    _granule = 0;
+    _clockRate = clockRate;
+    _bytesWritten = 0;
+
+    //identification header, alone on the first page
+    std::array<char, 19> head{};
+    memcpy(head.data(), "OpusHead", 8);
+    head[8] = 1;//version
+    head[9] = static_cast<char>(channelCount);
+    qToLittleEndian<quint16>(static_cast<quint16>(preSkip), head.data() + 10);
+    qToLittleEndian<quint32>(clockRate, head.data() + 12);
+    qToLittleEndian<qint16>(0, head.data() + 16);//output gain
+    head[18] = 0;//mono or stereo mapping family
+    appendPacket(head.data(), static_cast<int>(head.size()));
+    flushPage(BOS);
+
+    //comment header, no user comments
+    const auto vendor = QByteArray(opus_get_version_string());
+    QByteArray tags("OpusTags");
+    tags.append(4, '\0');
+    qToLittleEndian<quint32>(static_cast<quint32>(vendor.size()), tags.data() + 8);
+    tags.append(vendor);
+    tags.append(4, '\0');//user comment count
+    appendPacket(tags.constData(), static_cast<int>(tags.size()));
+    flushPage(0);
+    return true;
+}
+
+bool OggOpusWriter::writePacket(const unsigned char *data, int size, int duration)
+{
+    if (!_file.isOpen()) {
+        return false;
+    }
+    //a packet must not be split across pages, Opus packets need at most 6 lacing values
+    if ((MAX_LACING_VALUES < static_cast<int>(_lacing.size()) + size / 255 + 1) ||
+            (PAGE_TARGET_SIZE <= _pageData.size())) {
+        flushPage(0);
+    }
+    appendPacket(reinterpret_cast<const char*>(data), size);
+    _granule += static_cast<qint64>(duration) * OPUS_RATE_HZ / _clockRate;
+    if (WRITE_BUFFER_SIZE <= _buffer.size()) {
+        return flushBuffer();
+    }
+    return true;
+}
+
+void OggOpusWriter::close()
+{
+    if (!_file.isOpen()) {
+        return;
+    }
+    flushPage(EOS);
+    flushBuffer();
+    _file.close();
+    qInfo() << "Closed" << _file.fileName() << _bytesWritten << "bytes";
+}
+
+void OggOpusWriter::appendPacket(const char *data, int size)
+{
+    _pageData.append(data, size);
+    while (255 <= size) {
+        _lacing.push_back(255);
+        size -= 255;
+    }
+    _lacing.push_back(static_cast<unsigned char>(size));
+}
+
+void OggOpusWriter::flushPage(int flags)
+{
+    //an empty EOS page is still needed to terminate the stream
+    if (_lacing.empty() && (0 == (flags & EOS))) {
+        return;
+    }
+    const int headerSize = 27 + static_cast<int>(_lacing.size());
+    QByteArray page(headerSize, '\0');
+    auto *header = page.data();
+    memcpy(header, "OggS", 4);
+    header[4] = 0;//version
+    header[5] = static_cast<char>(flags);
+    qToLittleEndian<qint64>(_granule, header + 6);//still zero for the header pages
+    qToLittleEndian<quint32>(_serial, header + 14);
+    qToLittleEndian<quint32>(_sequence++, header + 18);
+    header[26] = static_cast<char>(_lacing.size());
+    if (!_lacing.empty()) {
+        memcpy(header + 27, _lacing.data(), _lacing.size());
+    }
+    page.append(_pageData);
+    qToLittleEndian<quint32>(crc32(page), page.data() + 22);
+
+    _buffer.append(page);
+    _pageData.clear();
+    _lacing.clear();
+}
+
+bool OggOpusWriter::flushBuffer()
+{
+    if (_buffer.isEmpty()) {
+        return true;
+    }
+    const auto written = _file.write(_buffer);
+    if (written != _buffer.size()) {
+        qCritical() << "Cannot write" << _file.fileName() << _file.errorString();
+        _buffer.resize(0);
+        return false;
+    }
+    _bytesWritten += written;
+    _buffer.resize(0);//keeps the capacity
+    return true;
+}
+
+quint32 OggOpusWriter::crc32(const QByteArray &page)
+{
+    //Ogg uses the non reflected CRC-32 with polynomial 0x04c11db7
+    static const auto table = [] {
+        std::array<quint32, 256> t{};
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 r = i << 24;
+            for (int j = 0; j < 8; ++j) {
+                r = (0 != (r & 0x80000000U)) ? (r << 1) ^ 0x04c11db7U : (r << 1);
+            }
+            t[i] = r;
+        }
+        return t;
+    }();
+    quint32 crc = 0;
+    for (const auto byte: page) {
+        crc = (crc << 8) ^ table[((crc >> 24) ^ static_cast<quint8>(byte)) & 0xff];
+    }
+    return crc;
+}
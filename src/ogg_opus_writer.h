@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <vector>
+
+/**
+ * Minimal Ogg Opus (RFC 7845) muxer.
+ * Pages are assembled in memory and written to disk in large chunks, so the
+ * encoder thread issues only a few writes per minute of audio.
+ */
+class OggOpusWriter
+{
+public:
+    OggOpusWriter() = default;
+    ~OggOpusWriter() {
+        close();
+    }
+
+    bool open(const QString &filePath, unsigned clockRate, unsigned channelCount, int preSkip);
+    //duration is the number of samples per channel at the input clock rate
+    bool writePacket(const unsigned char *data, int size, int duration);
+    void close();
+    bool isOpen() const { return _file.isOpen(); }
+    qint64 bytesWritten() const { return _bytesWritten; }
+
+private:
+    Q_DISABLE_COPY_MOVE(OggOpusWriter)
+
+    enum { OPUS_RATE_HZ = 48000, MAX_LACING_VALUES = 255, PAGE_TARGET_SIZE = 4096,
+           WRITE_BUFFER_SIZE = 256 * 1024 };
+    enum PageFlags { CONTINUED = 0x01, BOS = 0x02, EOS = 0x04 };
+
+    void appendPacket(const char *data, int size);
+    void flushPage(int flags);
+    bool flushBuffer();
+    static quint32 crc32(const QByteArray &page);
+
+    QFile _file;
+    QByteArray _buffer;//pending pages, flushed to disk in WRITE_BUFFER_SIZE chunks
+    QByteArray _pageData;
+    std::vector<unsigned char> _lacing;
+    quint32 _serial = 0;
+    quint32 _sequence = 0;
+    qint64 _granule = 0;
+    unsigned _clockRate = 0;
+    qint64 _bytesWritten = 0;
+};
@@ -0,0 +1,371 @@
+#include "packet_capture.h"
+#include <QDateTime>
+#include <QDir>
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+enum : quint32 { SHB_TYPE = 0x0A0D0D0A, IDB_TYPE = 0x00000001, EPB_TYPE = 0x00000006,
+                 BYTE_ORDER_MAGIC = 0x1A2B3C4D };
+enum : quint16 { LINKTYPE_RAW = 101 };
+enum { EPB_HEADER_SIZE = 28, EPB_TRAILER_SIZE = 4, IPV4_HEADER_SIZE = 20, IPV6_HEADER_SIZE = 40,
+       UDP_HEADER_SIZE = 8, RTP_HEADER_SIZE = 12, UDP_PROTOCOL = 17, DEFAULT_TTL = 64 };
+
+quint16 ipv4Checksum(const uchar *header)
+{
+    quint32 sum = 0;
+    for (int i = 0; i < IPV4_HEADER_SIZE; i += 2) {
+        sum += qFromBigEndian<quint16>(header + i);
+    }
+    while (0 != (sum >> 16)) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return static_cast<quint16>(~sum);
+}
+
+void copyAddress(uchar *dst, const pj_sockaddr &addr, bool ipv6)
+{
+    if (ipv6) {
+        if (pj_AF_INET6() == addr.addr.sa_family) {
+            memcpy(dst, &addr.ipv6.sin6_addr, 16);
+        } else {
+            memset(dst, 0, 16);
+        }
+    } else if (pj_AF_INET() == addr.addr.sa_family) {
+        memcpy(dst, &addr.ipv4.sin_addr, 4);
+    } else {
+        memset(dst, 0, 4);
+    }
+}
+
+//ports are already in network byte order
+pj_uint16_t networkPort(const pj_sockaddr &addr)
+{
+    return (pj_AF_INET6() == addr.addr.sa_family) ? addr.ipv6.sin6_port : addr.ipv4.sin_port;
+}
+
+} // namespace
+
+class PacketCapture::CaptureTransport : public MediaTransportAdapter
+{
+public:
+    CaptureTransport(pjmedia_transport *slave, bool ownsSlave) :
+        MediaTransportAdapter("capture", slave, ownsSlave) {}
+
+protected:
+    pj_status_t sendRtp(const void *pkt, pj_size_t size) override {
+        auto &capture = PacketCapture::instance();
+        if (capture.capturesRtp()) {
+            capture.capture(localRtp(), remoteRtp(), pkt, size, rtpHeaderLength(pkt, size));
+        }
+        return MediaTransportAdapter::sendRtp(pkt, size);
+    }
+    pj_status_t sendRtcp(const void *pkt, pj_size_t size) override {
+        auto &capture = PacketCapture::instance();
+        if (capture.capturesRtp()) {
+            capture.capture(localRtcp(), remoteRtcp(), pkt, size, size);
+        }
+        return MediaTransportAdapter::sendRtcp(pkt, size);
+    }
+    void receiveRtp(pjmedia_tp_cb_param *param) override {
+        auto &capture = PacketCapture::instance();
+        if (capture.capturesRtp() && (0 < param->size)) {
+            const auto size = static_cast<size_t>(param->size);
+            capture.capture((nullptr != param->src_addr) ? *param->src_addr : remoteRtp(), localRtp(),
+                            param->pkt, size, rtpHeaderLength(param->pkt, size));
+        }
+        deliverRtp(param);
+    }
+    void receiveRtcp(void *pkt, pj_ssize_t size) override {
+        auto &capture = PacketCapture::instance();
+        if (capture.capturesRtp() && (0 < size)) {
+            capture.capture(remoteRtcp(), localRtcp(), pkt, static_cast<size_t>(size),
+                            static_cast<size_t>(size));
+        }
+        deliverRtcp(pkt, size);
+    }
+};
+
+PacketCapture& PacketCapture::instance()
+{
+    static PacketCapture capture;
+    return capture;
+}
+
+bool PacketCapture::start(const QString &dirPath, bool withRtp)
+{
+    _withRtp = withRtp;
+    if (isRunning()) {
+        return true;
+    }
+    if (!QDir().mkpath(dirPath)) {
+        qCritical() << "Cannot create capture folder" << dirPath;
+        return false;
+    }
+    _dirPath = dirPath;
+    if (!openFile()) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        _queue.resize(QUEUE_SIZE);
+        _queueHead = 0;
+        _queueTail = 0;
+        _dropped = 0;
+        _stopping = false;
+    }
+    _writerThread = std::thread(&PacketCapture::writeLoop, this);
+    _running = true;
+    qInfo() << "Packet capture started in" << dirPath << (withRtp ? "with RTP headers" : "SIP only");
+    return true;
+}
+
+void PacketCapture::stop()
+{
+    if (!isRunning()) {
+        return;
+    }
+    _running = false;
+    {
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        _stopping = true;
+    }
+    _wakeUp.notify_one();
+    if (_writerThread.joinable()) {
+        _writerThread.join();
+    }
+    _file.close();
+    {
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        if (0 < _dropped) {
+            qWarning() << "Packet capture dropped" << _dropped << "packets";
+        }
+        _queue.clear();
+        _queue.shrink_to_fit();
+    }
+    qInfo() << "Packet capture stopped";
+}
+
+size_t PacketCapture::rtpHeaderLength(const void *pkt, size_t size)
+{
+    if (RTP_HEADER_SIZE > size) {
+        return size;
+    }
+    const auto *data = static_cast<const uchar*>(pkt);
+    const size_t csrcCount = data[0] & 0x0f;
+    size_t length = RTP_HEADER_SIZE + 4 * csrcCount;
+    if ((0 != (data[0] & 0x10)) && (length + 4 <= size)) {
+        //header extension
+        length += 4 + 4 * static_cast<size_t>(qFromBigEndian<quint16>(data + length + 2));
+    }
+    return std::min(length, size);
+}
+
+void PacketCapture::capture(const pj_sockaddr &src, const pj_sockaddr &dst,
+                            const void *payload, size_t size, size_t snapLength)
+{
+    if (!isRunning()) {
+        return;
+    }
+    const bool ipv6 = (pj_AF_INET6() == src.addr.sa_family);
+    const size_t ipHeaderSize = ipv6 ? IPV6_HEADER_SIZE : IPV4_HEADER_SIZE;
+    const size_t stored = std::min(size, snapLength);
+    const size_t capturedLength = ipHeaderSize + UDP_HEADER_SIZE + stored;
+    const size_t originalLength = ipHeaderSize + UDP_HEADER_SIZE + size;
+    const size_t padding = (4 - (capturedLength & 3)) & 3;
+    const auto blockLength = static_cast<quint32>(EPB_HEADER_SIZE + capturedLength + padding + EPB_TRAILER_SIZE);
+
+    std::array<uchar, EPB_HEADER_SIZE + IPV6_HEADER_SIZE + UDP_HEADER_SIZE> header{};
+    auto *epb = header.data();
+    const auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    qToLittleEndian<quint32>(EPB_TYPE, epb);
+    qToLittleEndian<quint32>(blockLength, epb + 4);
+    qToLittleEndian<quint32>(0, epb + 8);//interface
+    qToLittleEndian<quint32>(static_cast<quint32>(static_cast<quint64>(now) >> 32), epb + 12);
+    qToLittleEndian<quint32>(static_cast<quint32>(now), epb + 16);
+    qToLittleEndian<quint32>(static_cast<quint32>(capturedLength), epb + 20);
+    qToLittleEndian<quint32>(static_cast<quint32>(originalLength), epb + 24);
+
+    auto *ip = epb + EPB_HEADER_SIZE;
+    const auto udpLength = static_cast<quint16>(std::min<size_t>(UDP_HEADER_SIZE + size, 0xffff));
+    if (ipv6) {
+        qToBigEndian<quint32>(0x60000000U, ip);
+        qToBigEndian<quint16>(udpLength, ip + 4);
+        ip[6] = UDP_PROTOCOL;
+        ip[7] = DEFAULT_TTL;
+        copyAddress(ip + 8, src, true);
+        copyAddress(ip + 24, dst, true);
+    } else {
+        ip[0] = 0x45;
+        qToBigEndian<quint16>(static_cast<quint16>(std::min<size_t>(originalLength, 0xffff)), ip + 2);
+        qToBigEndian<quint16>(0x4000, ip + 6);//don't fragment
+        ip[8] = DEFAULT_TTL;
+        ip[9] = UDP_PROTOCOL;
+        copyAddress(ip + 12, src, false);
+        copyAddress(ip + 16, dst, false);
+        qToBigEndian<quint16>(ipv4Checksum(ip), ip + 10);
+    }
+    auto *udp = ip + ipHeaderSize;
+    const auto srcPort = networkPort(src);
+    const auto dstPort = networkPort(dst);
+    memcpy(udp, &srcPort, 2);
+    memcpy(udp + 2, &dstPort, 2);
+    qToBigEndian<quint16>(udpLength, udp + 4);
+    //checksum left to zero, not verified by Wireshark by default
+
+    std::array<char, EPB_TRAILER_SIZE> trailer{};
+    qToLittleEndian<quint32>(blockLength, trailer.data());
+    push(reinterpret_cast<const char*>(header.data()), EPB_HEADER_SIZE + ipHeaderSize + UDP_HEADER_SIZE,
+         payload, stored, padding, trailer.data(), trailer.size());
+}
+
+bool PacketCapture::push(const char *header, size_t headerSize, const void *payload, size_t payloadSize,
+                         size_t padding, const char *trailer, size_t trailerSize)
+{
+    static const std::array<char, 4> zeros{};
+    const auto total = headerSize + payloadSize + padding + trailerSize;
+    std::lock_guard<std::mutex> lock(_queueMutex);
+    if (_queue.empty() || (_queue.size() - (_queueHead - _queueTail) < total)) {
+        ++_dropped;
+        return false;
+    }
+    auto append = [this](const char *data, size_t size) {
+        const auto start = _queueHead % _queue.size();
+        const auto first = std::min(size, _queue.size() - start);
+        memcpy(&_queue[start], data, first);
+        memcpy(&_queue[0], data + first, size - first);
+        _queueHead += size;
+    };
+    append(header, headerSize);
+    append(static_cast<const char*>(payload), payloadSize);
+    append(zeros.data(), padding);
+    append(trailer, trailerSize);
+    return true;
+}
+
+void PacketCapture::writeLoop()
+{
+    std::vector<char> chunk;
+    std::unique_lock<std::mutex> lock(_queueMutex);
+    while (true) {
+        _wakeUp.wait_for(lock, std::chrono::milliseconds(WRITER_PERIOD_MS), [this] { return _stopping; });
+        const auto available = _queueHead - _queueTail;
+        const bool stopping = _stopping;
+        if (0 < available) {
+            //copy whole blocks out, the file is written without holding the lock
+            chunk.resize(available);
+            const auto start = _queueTail % _queue.size();
+            const auto first = std::min(available, _queue.size() - start);
+            memcpy(chunk.data(), &_queue[start], first);
+            memcpy(chunk.data() + first, &_queue[0], available - first);
+            _queueTail += available;
+            lock.unlock();
+            if (_file.write(chunk.data(), static_cast<qint64>(chunk.size())) != static_cast<qint64>(chunk.size())) {
+                qWarning() << "Cannot write" << _file.fileName() << _file.errorString();
+            }
+            if (MAX_FILE_SIZE <= _file.size()) {
+                openFile();
+            }
+            lock.lock();
+        }
+        if (stopping) {
+            break;
+        }
+    }
+}
+
+bool PacketCapture::openFile()
+{
+    _file.close();
+    const auto fileName = QString("%1/capture_%2_%3.pcapng").arg(_dirPath,
+        QDateTime::currentDateTime().toString("MMMM_dd_yyyy-hh_mm_ss")).arg(_fileIndex++);
+    _file.setFileName(fileName);
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCritical() << "Cannot open" << fileName << _file.errorString();
+        return false;
+    }
+
+    //section header and a single raw IP interface
+    std::array<char, 28 + 20> blocks{};
+    auto *shb = blocks.data();
+    qToLittleEndian<quint32>(SHB_TYPE, shb);
+    qToLittleEndian<quint32>(28, shb + 4);
+    qToLittleEndian<quint32>(BYTE_ORDER_MAGIC, shb + 8);
+    qToLittleEndian<quint16>(1, shb + 12);//major version
+    qToLittleEndian<quint16>(0, shb + 14);
+    qToLittleEndian<qint64>(-1, shb + 16);//unknown section length
+    qToLittleEndian<quint32>(28, shb + 24);
+    auto *idb = shb + 28;
+    qToLittleEndian<quint32>(IDB_TYPE, idb);
+    qToLittleEndian<quint32>(20, idb + 4);
+    qToLittleEndian<quint16>(LINKTYPE_RAW, idb + 8);
+    qToLittleEndian<quint32>(0, idb + 12);//no snap length limit
+    qToLittleEndian<quint32>(20, idb + 16);
+    _file.write(blocks.data(), blocks.size());
+    removeOldFiles();
+    return true;
+}
+
+void PacketCapture::removeOldFiles()
+{
+    QDir dir(_dirPath);
+    const auto files = dir.entryInfoList({"capture_*.pcapng"}, QDir::Files, QDir::Time);
+    for (int i = MAX_FILE_COUNT; i < files.size(); ++i) {
+        QFile::remove(files.at(i).absoluteFilePath());
+    }
+}
+
+pj_bool_t PacketCapture::onRxMessage(pjsip_rx_data *rdata)
+{
+    auto &capture = instance();
+    if (capture.isRunning() && (nullptr != rdata->tp_info.transport)) {
+        const auto size = static_cast<size_t>(rdata->msg_info.len);
+        capture.capture(rdata->pkt_info.src_addr, rdata->tp_info.transport->local_addr,
+                        rdata->msg_info.msg_buf, size, size);
+    }
+    return PJ_FALSE;
+}
+
+pj_status_t PacketCapture::onTxMessage(pjsip_tx_data *tdata)
+{
+    auto &capture = instance();
+    if (capture.isRunning() && (nullptr != tdata->tp_info.transport) &&
+            (tdata->buf.cur > tdata->buf.start)) {
+        const auto size = static_cast<size_t>(tdata->buf.cur - tdata->buf.start);
+        capture.capture(tdata->tp_info.transport->local_addr, tdata->tp_info.dst_addr,
+                        tdata->buf.start, size, size);
+    }
+    return PJ_SUCCESS;
+}
+
+pj_status_t PacketCapture::registerSipModule()
+{
+    //same priority as the pjsua message logger, messages are already printed
+    static pjsip_module module = {
+        nullptr, nullptr,
+        { const_cast<char*>("mod-packet-capture"), 18 },
+        -1,
+        PJSIP_MOD_PRIORITY_TRANSPORT_LAYER - 1,
+        nullptr, nullptr, nullptr, nullptr,
+        &PacketCapture::onRxMessage,
+        &PacketCapture::onRxMessage,
+        &PacketCapture::onTxMessage,
+        &PacketCapture::onTxMessage,
+        nullptr
+    };
+    if (-1 != module.id) {
+        return PJ_SUCCESS;
+    }
+    return pjsip_endpt_register_module(pjsua_get_pjsip_endpt(), &module);
+}
+
+pjmedia_transport* PacketCapture::createMediaTransport(pjmedia_transport *baseTransport, bool ownsBase)
+{
+    return (new CaptureTransport(baseTransport, ownsBase))->transport();
+}
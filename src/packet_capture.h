@@ -0,0 +1,78 @@
+#pragma once
+
+#include "pjsua.h"
+#include "media_transport_adapter.h"
+#include <QFile>
+#include <QString>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Built-in SIP/RTP capture into rotating pcapng files.
+ * Packets are wrapped into synthetic IP/UDP headers (raw IP link type) so
+ * Wireshark decodes them, SIP over TCP/TLS is captured after decryption.
+ * Producers only copy a finished block into a bounded queue, a background
+ * thread writes the files. When stopped the hooks cost one atomic load.
+ */
+class PacketCapture
+{
+public:
+    static PacketCapture& instance();
+
+    bool start(const QString &dirPath, bool withRtp);
+    void stop();
+    bool isRunning() const { return _running.load(std::memory_order_relaxed); }
+    bool capturesRtp() const { return isRunning() && _withRtp.load(std::memory_order_relaxed); }
+
+    //snapLength limits the stored payload, the original length is always recorded
+    void capture(const pj_sockaddr &src, const pj_sockaddr &dst,
+                 const void *payload, size_t size, size_t snapLength);
+    static size_t rtpHeaderLength(const void *pkt, size_t size);
+
+    //must be called after pjsua_init()
+    static pj_status_t registerSipModule();
+    static pjmedia_transport* createMediaTransport(pjmedia_transport *baseTransport, bool ownsBase);
+
+private:
+    PacketCapture() = default;
+    ~PacketCapture() {
+        stop();
+    }
+    Q_DISABLE_COPY_MOVE(PacketCapture)
+
+    enum { QUEUE_SIZE = 4 * 1024 * 1024, MAX_FILE_SIZE = 16 * 1024 * 1024, MAX_FILE_COUNT = 5,
+           WRITER_PERIOD_MS = 200, MAX_HEADERS_SIZE = 64 };
+
+    class CaptureTransport;
+
+    static pj_bool_t onRxMessage(pjsip_rx_data *rdata);
+    static pj_status_t onTxMessage(pjsip_tx_data *tdata);
+
+    bool push(const char *header, size_t headerSize, const void *payload, size_t payloadSize,
+              size_t padding, const char *trailer, size_t trailerSize);
+    void writeLoop();
+    bool openFile();
+    void removeOldFiles();
+
+    std::atomic<bool> _running{false};
+    std::atomic<bool> _withRtp{false};
+
+    //bounded queue of finished pcapng blocks, filled by the pjsip and media threads
+    std::mutex _queueMutex;
+    std::vector<char> _queue;
+    size_t _queueHead = 0;
+    size_t _queueTail = 0;
+    size_t _dropped = 0;
+
+    std::thread _writerThread;
+    std::condition_variable _wakeUp;
+    bool _stopping = false;
+
+    //owned by the writer thread
+    QString _dirPath;
+    QFile _file;
+    int _fileIndex = 0;
+};
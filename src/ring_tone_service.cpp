@@ -0,0 +1,214 @@
+#include "ring_tone_service.h"
+#include <QFile>
+#include <QtEndian>
+#include <QDebug>
+#include <cstring>
+
+pj_status_t RingToneService::start(pjsua_call_id callId, const QString &filePath)
+{
+    if (isRinging(callId)) {
+        return PJ_EEXISTS;
+    }
+
+    auto &tone = _tones[filePath];
+    if (nullptr == tone.port) {
+        const auto status = load(filePath, tone);
+        if (PJ_SUCCESS != status) {
+            _tones.remove(filePath);
+            return status;
+        }
+    }
+
+    //the first ringing call rewinds the shared port and connects it to the sound device
+    if (0 == tone.refCount) {
+        auto status = pjmedia_mem_player_set_pos(tone.port, 0);
+        if (PJ_SUCCESS != status) {
+            return status;
+        }
+        status = pjsua_conf_connect(tone.confPort, 0);
+        if (PJ_SUCCESS != status) {
+            return status;
+        }
+    }
+    ++tone.refCount;
+    _ringingCalls[callId] = filePath;
+    qDebug() << "Ringing calls for" << filePath << tone.refCount;
+    return PJ_SUCCESS;
+}
+
+pj_status_t RingToneService::stop(pjsua_call_id callId)
+{
+    const auto it = _ringingCalls.find(callId);
+    if (it == _ringingCalls.end()) {
+        return PJ_ENOTFOUND;
+    }
+    const auto filePath = it->second;
+    _ringingCalls.erase(it);
+
+    const auto toneIt = _tones.find(filePath);
+    if ((toneIt == _tones.end()) || (0 >= toneIt->refCount)) {
+        return PJ_EBUG;
+    }
+    //the last ringing call disconnects the shared port, it stays loaded for the next call
+    if (0 == --toneIt->refCount) {
+        return pjsua_conf_disconnect(toneIt->confPort, 0);
+    }
+    return PJ_SUCCESS;
+}
+
+void RingToneService::release()
+{
+    for (auto &tone: _tones) {
+        unload(tone);
+    }
+    _tones.clear();
+    _ringingCalls.clear();
+}
+
+pj_status_t RingToneService::load(const QString &filePath, Tone &tone)
+{
+    unsigned clockRate = 0;
+    unsigned channelCount = 0;
+    if (!decodeWav(filePath, tone.samples, clockRate, channelCount)) {
+        return PJMEDIA_ENOTVALIDWAVE;
+    }
+
+    tone.pool = pjsua_pool_create("ringTone", POOL_SIZE, POOL_SIZE);
+    if (nullptr == tone.pool) {
+        return PJ_ENOMEM;
+    }
+    //convert once to the bridge format so the bridge does not resample every frame
+    unsigned samplesPerFrame = clockRate * FRAME_PTIME_MS / 1000 * channelCount;
+    pjsua_conf_port_info bridgeInfo{};
+    if ((PJ_SUCCESS == pjsua_conf_get_port_info(0, &bridgeInfo)) && (1 == channelCount) &&
+            resample(tone.pool, tone.samples, clockRate, bridgeInfo.clock_rate)) {
+        samplesPerFrame = bridgeInfo.samples_per_frame;
+    }
+    auto status = pjmedia_mem_player_create(tone.pool, tone.samples.constData(),
+                                            static_cast<pj_size_t>(tone.samples.size()),
+                                            clockRate, channelCount, samplesPerFrame,
+                                            BITS_PER_SAMPLE, 0, &tone.port);
+    if (PJ_SUCCESS != status) {
+        unload(tone);
+        return status;
+    }
+    status = pjsua_conf_add_port(tone.pool, tone.port, &tone.confPort);
+    if (PJ_SUCCESS != status) {
+        unload(tone);
+        return status;
+    }
+    qInfo() << "Loaded ring tone" << filePath << clockRate << "Hz," << channelCount << "channel(s)";
+    return PJ_SUCCESS;
+}
+
+void RingToneService::unload(Tone &tone)
+{
+    if (PJSUA_INVALID_ID != tone.confPort) {
+        pjsua_conf_remove_port(tone.confPort);
+        tone.confPort = PJSUA_INVALID_ID;
+    }
+    if (nullptr != tone.port) {
+        pjmedia_port_destroy(tone.port);
+        tone.port = nullptr;
+    }
+    if (nullptr != tone.pool) {
+        pj_pool_release(tone.pool);
+        tone.pool = nullptr;
+    }
+    tone.samples.clear();
+    tone.refCount = 0;
+}
+
+bool RingToneService::resample(pj_pool_t *pool, QByteArray &samples, unsigned &clockRate, unsigned targetRate)
+{
+    if (clockRate == targetRate) {
+        return true;
+    }
+    if ((0 != (clockRate % 100)) || (0 != (targetRate % 100))) {
+        //left to the bridge
+        return false;
+    }
+    const unsigned inFrame = clockRate * RESAMPLE_PTIME_MS / 1000;
+    const unsigned outFrame = targetRate * RESAMPLE_PTIME_MS / 1000;
+    pjmedia_resample *resampler = nullptr;
+    const auto status = pjmedia_resample_create(pool, PJ_TRUE, PJ_TRUE, 1, clockRate, targetRate,
+                                                inFrame, &resampler);
+    if (PJ_SUCCESS != status) {
+        return false;
+    }
+    const auto inCount = static_cast<size_t>(samples.size()) / sizeof(pj_int16_t);
+    const auto frameCount = (inCount + inFrame - 1) / inFrame;
+    //the last partial frame is padded with silence
+    QByteArray input(static_cast<qsizetype>(frameCount * inFrame * sizeof(pj_int16_t)), 0);
+    std::memcpy(input.data(), samples.constData(), static_cast<size_t>(samples.size()));
+    QByteArray output(static_cast<qsizetype>(frameCount * outFrame * sizeof(pj_int16_t)), Qt::Uninitialized);
+    const auto *in = reinterpret_cast<const pj_int16_t*>(input.constData());
+    auto *out = reinterpret_cast<pj_int16_t*>(output.data());
+    for (size_t i = 0; i < frameCount; ++i) {
+        pjmedia_resample_run(resampler, in + i * inFrame, out + i * outFrame);
+    }
+    pjmedia_resample_destroy(resampler);
+    samples = output;
+    clockRate = targetRate;
+    return true;
+}
+
+bool RingToneService::decodeWav(const QString &filePath, QByteArray &samples,
+                                unsigned &clockRate, unsigned &channelCount)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical() << "Cannot open" << filePath << file.errorString();
+        return false;
+    }
+    const auto content = file.readAll();
+    const auto *data = content.constData();
+    if ((12 > content.size()) || (0 != qstrncmp(data, "RIFF", 4)) ||
+            (0 != qstrncmp(data + 8, "WAVE", 4))) {
+        qCritical() << "Not a WAV file" << filePath;
+        return false;
+    }
+
+    //walk the RIFF chunks, only 16 bit PCM is supported
+    bool hasFormat = false;
+    qsizetype offset = 12;
+    while (offset + 8 <= content.size()) {
+        const auto chunkSize = static_cast<qsizetype>(qFromLittleEndian<quint32>(data + offset + 4));
+        const auto *chunk = data + offset + 8;
+        const auto available = qMin(chunkSize, content.size() - offset - 8);
+        if (0 == qstrncmp(data + offset, "fmt ", 4) && (16 <= available)) {
+            const auto format = qFromLittleEndian<quint16>(chunk);
+            channelCount = qFromLittleEndian<quint16>(chunk + 2);
+            clockRate = qFromLittleEndian<quint32>(chunk + 4);
+            const auto bitsPerSample = qFromLittleEndian<quint16>(chunk + 14);
+            if ((1 != format) || (BITS_PER_SAMPLE != bitsPerSample) ||
+                    (0 == clockRate) || (1 > channelCount) || (2 < channelCount)) {
+                qCritical() << "Unsupported WAV format" << filePath << format << bitsPerSample;
+                return false;
+            }
+            hasFormat = true;
+        } else if (0 == qstrncmp(data + offset, "data", 4) && hasFormat) {
+            samples = QByteArray(chunk, available);
+            break;
+        }
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+    if (samples.isEmpty()) {
+        qCritical() << "No audio data in" << filePath;
+        return false;
+    }
+
+    //the conference bridge is mono, down-mix once here instead of on every frame
+    if (2 == channelCount) {
+        const qsizetype frameCount = samples.size() / static_cast<qsizetype>(2 * sizeof(qint16));
+        QByteArray mono(frameCount * static_cast<qsizetype>(sizeof(qint16)), Qt::Uninitialized);
+        const auto *in = reinterpret_cast<const qint16*>(samples.constData());
+        auto *out = reinterpret_cast<qint16*>(mono.data());
+        for (qsizetype i = 0; i < frameCount; ++i) {
+            out[i] = static_cast<qint16>((static_cast<int>(in[2 * i]) + in[2 * i + 1]) / 2);
+        }
+        samples = mono;
+        channelCount = 1;
+    }
+    return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "pjsua.h"
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <unordered_map>
+
+/**
+ * Plays ring tones through one shared conference port per tone file.
+ * Each file is decoded once into memory, the port is connected to the sound
+ * device while at least one call is ringing with it.
+ */
+class RingToneService
+{
+public:
+    RingToneService() = default;
+    ~RingToneService() {
+        release();
+    }
+
+    pj_status_t start(pjsua_call_id callId, const QString &filePath);
+    pj_status_t stop(pjsua_call_id callId);
+    bool isRinging(pjsua_call_id callId) const {
+        return 0 != _ringingCalls.count(callId);
+    }
+    void release();
+
+private:
+    Q_DISABLE_COPY_MOVE(RingToneService)
+
+    enum { POOL_SIZE = 512, FRAME_PTIME_MS = 20, BITS_PER_SAMPLE = 16, RESAMPLE_PTIME_MS = 10 };
+
+    struct Tone {
+        pj_pool_t *pool = nullptr;
+        QByteArray samples;//PCM 16 bit, must outlive the memory player
+        pjmedia_port *port = nullptr;
+        pjsua_conf_port_id confPort = PJSUA_INVALID_ID;
+        int refCount = 0;
+    };
+
+    pj_status_t load(const QString &filePath, Tone &tone);
+    static void unload(Tone &tone);
+    static bool decodeWav(const QString &filePath, QByteArray &samples,
+                          unsigned &clockRate, unsigned &channelCount);
+    static bool resample(pj_pool_t *pool, QByteArray &samples, unsigned &clockRate, unsigned targetRate);
+
+    QHash<QString, Tone> _tones;//key is the tone file path
+    std::unordered_map<pjsua_call_id, QString> _ringingCalls;
+};
@@ -1,5 +1,8 @@
 #include "settings.h"
 #include "config.h"
+#include "event_loop_watchdog.h"
+#include "settings_store.h"
+#include <QJsonObject>
 #include <QSettings>
 #include <QVector>
 #include <QStandardPaths>
@@ -14,8 +17,42 @@
 #define XSTR(a) STR_HELPER(a)
 #define STR_HELPER(a) #a
 
-#define GET_SETTING(name) settings.value(XSTR(name), _ ## name)
-#define SET_SETTING(name) settings.setValue(XSTR(name), _ ## name)
+#define GET_SETTING(name) store.value(XSTR(name), _ ## name)
+#define SET_SETTING(name) store.setValue(XSTR(name), _ ## name)
+
+namespace {
+//bulk data of the versions before SettingsStore, read once to migrate it
+QJsonArray legacyArray(const QString &name, const QStringList &keys)
+{
+    QJsonArray array;
+    QSettings settings(ORG_NAME, APP_NAME);
+    const auto size = settings.beginReadArray(name);
+    for (int i = 0; i < size; ++i) {
+        settings.setArrayIndex(i);
+        QJsonObject item;
+        for (const auto &key: keys) {
+            item.insert(key, QJsonValue::fromVariant(settings.value(key)));
+        }
+        array.append(item);
+    }
+    settings.endArray();
+    return array;
+}
+
+QJsonArray documentArray(const QString &name, const QStringList &legacyKeys)
+{
+    auto &store = SettingsStore::instance();
+    QJsonArray array;
+    if (!store.document(name, array)) {
+        array = legacyArray(name, legacyKeys);
+        if (!array.isEmpty()) {
+            qInfo() << "Migrating" << array.size() << name << "entries";
+            store.setDocument(name, array);
+        }
+    }
+    return array;
+}
+}
 
 Settings::Settings(QObject *parent) : QObject (parent)
 {
@@ -60,6 +97,8 @@ void Settings::clear()
     setDialpadSoundVolume(DIALPAD_SOUND_VOLUME);
 
     setRecPath("");
+    setStereoRecording(STEREO_RECORDING);
+    setFlightRecorderSeconds(FLIGHT_RECORDER_SECONDS);
 
     //setStunServer("stun.zoiper.com");
     //setStunPort(3478);
@@ -71,8 +110,15 @@ void Settings::clear()
 
     setEnableSipLog(ENABLE_SIP_LOG);
     setEnableVad(ENABLE_VAD);
+    setMediaProfile(MEDIA_PROFILE);
+    setThreadScheduling(THREAD_SCHEDULING);
+    setAudioThreadCpus("");
+    setWorkerThreadCpus("");
     setTransportSourcePort(TRANSPORT_DEFAULT_PORT);
     setDisableTcpSwitch(DISABLE_TCP_SWITCH);
+    setPacketCapture(PACKET_CAPTURE);
+    setCaptureRtp(CAPTURE_RTP);
+    setNetworkImpairment("");
 
     setAllowSdpNatRewrite(ALLOW_SDP_NAT_REWRITE);
     setAllowContactAndViaRewrite(ALLOW_CONTACT_AND_VIA_REWRITE);
@@ -83,6 +129,7 @@ void Settings::clear()
 
 void Settings::uninstallClear()
 {
+    SettingsStore::instance().clear();
     QSettings settings(ORG_NAME, APP_NAME);
     settings.clear();
     const auto path = writablePath();
@@ -93,8 +140,7 @@ void Settings::uninstallClear()
 
 void Settings::load()
 {
-    QSettings settings(ORG_NAME, APP_NAME);
-    qDebug() << "Reading settings from" << settings.fileName();
+    const auto &store = SettingsStore::instance();
 
     setSipServer(GET_SETTING(sipServer).toString());
     setSipPort(GET_SETTING(sipPort).toInt());
@@ -119,6 +165,8 @@ void Settings::load()
     if (!QDir(_recPath).exists()) {
         QDir().mkpath(_recPath);
     }
+    setStereoRecording(GET_SETTING(stereoRecording).toBool());
+    setFlightRecorderSeconds(GET_SETTING(flightRecorderSeconds).toInt());
 
     //setStunServer(settings.value(STUN_SERVER, _stunServer).toString());
     //setStunPort(settings.value(STUN_PORT, _stunPort).toInt());
@@ -130,8 +178,15 @@ void Settings::load()
 
     setEnableSipLog(GET_SETTING(enableSipLog).toBool());
     setEnableVad(GET_SETTING(enableVad).toBool());
+    setMediaProfile(GET_SETTING(mediaProfile).toInt());
+    setThreadScheduling(GET_SETTING(threadScheduling).toInt());
+    setAudioThreadCpus(GET_SETTING(audioThreadCpus).toString());
+    setWorkerThreadCpus(GET_SETTING(workerThreadCpus).toString());
     setTransportSourcePort(GET_SETTING(transportSourcePort).toInt());
     setDisableTcpSwitch(GET_SETTING(disableTcpSwitch).toBool());
+    setPacketCapture(GET_SETTING(packetCapture).toBool());
+    setCaptureRtp(GET_SETTING(captureRtp).toBool());
+    setNetworkImpairment(GET_SETTING(networkImpairment).toString());
 
     setAllowSdpNatRewrite(GET_SETTING(allowSdpNatRewrite).toBool());
     setAllowContactAndViaRewrite(GET_SETTING(allowContactAndViaRewrite).toBool());
@@ -140,8 +195,9 @@ void Settings::load()
 
 void Settings::save()
 {
-    QSettings settings(ORG_NAME, APP_NAME);
-    qDebug() << "Save settings to" << settings.fileName();
+    const EventLoopWatchdog::Scope scope(Q_FUNC_INFO);
+    //only the changed values are written, in the background
+    auto &store = SettingsStore::instance();
 
     SET_SETTING(sipServer);
     SET_SETTING(sipPort);
@@ -158,6 +214,8 @@ void Settings::save()
     SET_SETTING(speakersVolume);
 
     SET_SETTING(recPath);
+    SET_SETTING(stereoRecording);
+    SET_SETTING(flightRecorderSeconds);
 
     //settings.setValue(STUN_SERVER, _stunServer);
     //settings.setValue(STUN_PORT, _stunPort);
@@ -169,8 +227,15 @@ void Settings::save()
 
     SET_SETTING(enableSipLog);
     SET_SETTING(enableVad);
+    SET_SETTING(mediaProfile);
+    SET_SETTING(threadScheduling);
+    SET_SETTING(audioThreadCpus);
+    SET_SETTING(workerThreadCpus);
     SET_SETTING(transportSourcePort);
     SET_SETTING(disableTcpSwitch);
+    SET_SETTING(packetCapture);
+    SET_SETTING(captureRtp);
+    SET_SETTING(networkImpairment);
 
     SET_SETTING(allowSdpNatRewrite);
     SET_SETTING(allowContactAndViaRewrite);
@@ -179,179 +244,168 @@ void Settings::save()
 
 AudioDevices::DeviceInfo Settings::inputAudioDeviceInfo()
 {
-    QSettings settings(ORG_NAME, APP_NAME);
-    return { settings.value(XSTR(inputAudioModelName)).toString(),
-             settings.value(XSTR(inputAudioModelIndex), PJMEDIA_AUD_INVALID_DEV).toInt() };
+    const auto &store = SettingsStore::instance();
+    return { store.value(XSTR(inputAudioModelName)).toString(),
+             store.value(XSTR(inputAudioModelIndex), PJMEDIA_AUD_INVALID_DEV).toInt() };
 }
 
 void Settings::saveInputAudioDeviceInfo(const AudioDevices::DeviceInfo &devInfo)
 {
-    QSettings settings(ORG_NAME, APP_NAME);
-    settings.setValue(XSTR(inputAudioModelName), devInfo.name);
-    settings.setValue(XSTR(inputAudioModelIndex), devInfo.index);
+    auto &store = SettingsStore::instance();
+    store.setValue(XSTR(inputAudioModelName), devInfo.name);
+    store.setValue(XSTR(inputAudioModelIndex), devInfo.index);
 }
 
 AudioDevices::DeviceInfo Settings::outputAudioDeviceInfo()
 {
-    QSettings settings(ORG_NAME, APP_NAME);
-    return { settings.value(XSTR(outputAudioModelName)).toString(),
-             settings.value(XSTR(outputAudioModelIndex), PJMEDIA_AUD_INVALID_DEV).toInt() };
+    const auto &store = SettingsStore::instance();
+    return { store.value(XSTR(outputAudioModelName)).toString(),
+             store.value(XSTR(outputAudioModelIndex), PJMEDIA_AUD_INVALID_DEV).toInt() };
 }
 
 void Settings::saveOutputAudioDeviceInfo(const AudioDevices::DeviceInfo &devInfo)
 {
-    QSettings settings(ORG_NAME, APP_NAME);
-    settings.setValue(XSTR(outputAudioModelName), devInfo.name);
-    settings.setValue(XSTR(outputAudioModelIndex), devInfo.index);
+    auto &store = SettingsStore::instance();
+    store.setValue(XSTR(outputAudioModelName), devInfo.name);
+    store.setValue(XSTR(outputAudioModelIndex), devInfo.index);
 }
 
 VideoDevices::DeviceInfo Settings::videoDeviceInfo()
 {
-    QSettings settings(ORG_NAME, APP_NAME);
-    return { settings.value(XSTR(videoModelName)).toString(),
-             settings.value(XSTR(videoModelIndex), PJMEDIA_VID_INVALID_DEV).toInt() };
+    const auto &store = SettingsStore::instance();
+    return { store.value(XSTR(videoModelName)).toString(),
+             store.value(XSTR(videoModelIndex), PJMEDIA_VID_INVALID_DEV).toInt() };
 }
 
 void Settings::saveVideoDeviceInfo(const VideoDevices::DeviceInfo &devInfo)
 {
-    QSettings settings(ORG_NAME, APP_NAME);
-    settings.setValue(XSTR(videoModelName), devInfo.name);
-    settings.setValue(XSTR(videoModelIndex), devInfo.index);
+    auto &store = SettingsStore::instance();
+    store.setValue(XSTR(videoModelName), devInfo.name);
+    store.setValue(XSTR(videoModelIndex), devInfo.index);
 }
 
 QVector<CallHistoryModel::CallHistoryInfo> Settings::callHistoryInfo()
 {
     QVector<CallHistoryModel::CallHistoryInfo> history;
-    QSettings settings(ORG_NAME, APP_NAME);
-    const auto size = settings.beginReadArray(XSTR(callHistory));
-    for (int i = 0; i < size; ++i) {
-        settings.setArrayIndex(i);
+    const auto array = documentArray(XSTR(callHistory), { XSTR(contactId), XSTR(userName), XSTR(phoneNumber),
+                                                          XSTR(dateTime), XSTR(callStatus) });
+    history.reserve(array.size());
+    for (const auto &value: array) {
+        const auto object = value.toObject();
         CallHistoryModel::CallHistoryInfo item;
-        item.contactId = settings.value(XSTR(contactId)).toInt();
-        item.userName = settings.value(XSTR(userName)).toString();
-        item.phoneNumber = settings.value(XSTR(phoneNumber)).toString();
-        item.dateTime = QDateTime::fromString(settings.value(XSTR(dateTime)).toString(),
-                                              CH_DATE_TIME_FORMAT);
-        item.callStatus = static_cast<CallHistoryModel::CallStatus>(settings.value(XSTR(callStatus)).toInt());
+        item.contactId = object.value(XSTR(contactId)).toVariant().toInt();
+        item.userName = object.value(XSTR(userName)).toString();
+        item.phoneNumber = object.value(XSTR(phoneNumber)).toString();
+        item.dateTime = QDateTime::fromString(object.value(XSTR(dateTime)).toString(), CH_DATE_TIME_FORMAT);
+        item.callStatus = static_cast<CallHistoryModel::CallStatus>(object.value(XSTR(callStatus)).toVariant().toInt());
         history.append(item);
     }
-    settings.endArray();
     return history;
 }
 
 void Settings::saveCallHistoryInfo(const QVector<CallHistoryModel::CallHistoryInfo> &historyInfo)
 {
-    QSettings settings(ORG_NAME, APP_NAME);
-    settings.beginWriteArray(XSTR(callHistory));
-    for (int i = 0; i < historyInfo.size(); ++i) {
-        settings.setArrayIndex(i);
-        settings.setValue(XSTR(contactId), historyInfo.at(i).contactId);
-        settings.setValue(XSTR(userName), historyInfo.at(i).userName);
-        settings.setValue(XSTR(phoneNumber), historyInfo.at(i).phoneNumber);
-        settings.setValue(XSTR(dateTime), historyInfo.at(i).dateTime.toString(CH_DATE_TIME_FORMAT));
-        settings.setValue(XSTR(callStatus), static_cast<int>(historyInfo.at(i).callStatus));
+    const EventLoopWatchdog::Scope scope(Q_FUNC_INFO);
+    QJsonArray array;
+    for (const auto &info: historyInfo) {
+        array.append(QJsonObject{{XSTR(contactId), info.contactId},
+                                 {XSTR(userName), info.userName},
+                                 {XSTR(phoneNumber), info.phoneNumber},
+                                 {XSTR(dateTime), info.dateTime.toString(CH_DATE_TIME_FORMAT)},
+                                 {XSTR(callStatus), static_cast<int>(info.callStatus)}});
     }
-    settings.endArray();
+    SettingsStore::instance().setDocument(XSTR(callHistory), array);
 }
 
 QVector<ContactsModel::ContactInfo> Settings::contactsInfo()
 {
     QVector<ContactsModel::ContactInfo> contacts;
-    QSettings settings(ORG_NAME, APP_NAME);
-    const auto size = settings.beginReadArray(XSTR(contactList));
-    for (int i = 0; i < size; ++i) {
-        settings.setArrayIndex(i);
+    const auto array = documentArray(XSTR(contactList), { XSTR(contactId), XSTR(firstName), XSTR(lastName),
+                                                          XSTR(contactEmail), XSTR(phoneNumber), XSTR(mobileNumber),
+                                                          XSTR(contactAddress), XSTR(contactState), XSTR(contactCity),
+                                                          XSTR(contactZip), XSTR(comment) });
+    contacts.reserve(array.size());
+    for (const auto &value: array) {
+        const auto object = value.toObject();
         ContactsModel::ContactInfo item;
-        item.id = settings.value(XSTR(contactId)).toInt();
-        item.firstName = settings.value(XSTR(firstName)).toString();
-        item.lastName = settings.value(XSTR(lastName)).toString();
-        item.email = settings.value(XSTR(contactEmail)).toString();
-        item.phoneNumber = settings.value(XSTR(phoneNumber)).toString();
-        item.mobileNumber = settings.value(XSTR(mobileNumber)).toString();
-        item.address = settings.value(XSTR(contactAddress)).toString();
-        item.state = settings.value(XSTR(contactState)).toString();
-        item.city = settings.value(XSTR(contactCity)).toString();
-        item.zip = settings.value(XSTR(contactZip)).toString();
-        item.comment = settings.value(XSTR(comment)).toString();
+        item.id = object.value(XSTR(contactId)).toVariant().toInt();
+        item.firstName = object.value(XSTR(firstName)).toString();
+        item.lastName = object.value(XSTR(lastName)).toString();
+        item.email = object.value(XSTR(contactEmail)).toString();
+        item.phoneNumber = object.value(XSTR(phoneNumber)).toString();
+        item.mobileNumber = object.value(XSTR(mobileNumber)).toString();
+        item.address = object.value(XSTR(contactAddress)).toString();
+        item.state = object.value(XSTR(contactState)).toString();
+        item.city = object.value(XSTR(contactCity)).toString();
+        item.zip = object.value(XSTR(contactZip)).toString();
+        item.comment = object.value(XSTR(comment)).toString();
         contacts.append(item);
     }
-    settings.endArray();
     return contacts;
 }
 
 void Settings::saveContactsInfo(const QVector<ContactsModel::ContactInfo> &contactsInfo)
 {
-    QSettings settings(ORG_NAME, APP_NAME);
-    settings.beginWriteArray(XSTR(contactList));
-    for (int i = 0; i < contactsInfo.size(); ++i) {
-        settings.setArrayIndex(i);
-        settings.setValue(XSTR(contactId), contactsInfo.at(i).id);
-        settings.setValue(XSTR(firstName), contactsInfo.at(i).firstName);
-        settings.setValue(XSTR(lastName), contactsInfo.at(i).lastName);
-        settings.setValue(XSTR(contactEmail), contactsInfo.at(i).email);
-        settings.setValue(XSTR(phoneNumber), contactsInfo.at(i).phoneNumber);
-        settings.setValue(XSTR(mobileNumber), contactsInfo.at(i).mobileNumber);
-        settings.setValue(XSTR(contactAddress), contactsInfo.at(i).address);
-        settings.setValue(XSTR(contactState), contactsInfo.at(i).state);
-        settings.setValue(XSTR(contactCity), contactsInfo.at(i).city);
-        settings.setValue(XSTR(contactZip), contactsInfo.at(i).zip);
-        settings.setValue(XSTR(comment), contactsInfo.at(i).comment);
+    const EventLoopWatchdog::Scope scope(Q_FUNC_INFO);
+    QJsonArray array;
+    for (const auto &info: contactsInfo) {
+        array.append(QJsonObject{{XSTR(contactId), info.id},
+                                 {XSTR(firstName), info.firstName},
+                                 {XSTR(lastName), info.lastName},
+                                 {XSTR(contactEmail), info.email},
+                                 {XSTR(phoneNumber), info.phoneNumber},
+                                 {XSTR(mobileNumber), info.mobileNumber},
+                                 {XSTR(contactAddress), info.address},
+                                 {XSTR(contactState), info.state},
+                                 {XSTR(contactCity), info.city},
+                                 {XSTR(contactZip), info.zip},
+                                 {XSTR(comment), info.comment}});
     }
-    settings.endArray();
+    SettingsStore::instance().setDocument(XSTR(contactList), array);
 }
 
-QList<GenericCodecs::CodecInfo> Settings::audioCodecInfo()
+namespace {
+QList<GenericCodecs::CodecInfo> loadCodecInfo(const QString &name, const QString &idKey, const QString &priorityKey)
 {
     QList<GenericCodecs::CodecInfo> codecInfo;
-    QSettings settings(ORG_NAME, APP_NAME);
-    const auto size = settings.beginReadArray(XSTR(audioCodecInfo));
-    for (int i = 0; i < size; ++i) {
-        settings.setArrayIndex(i);
+    const auto array = documentArray(name, { idKey, priorityKey });
+    for (const auto &value: array) {
+        const auto object = value.toObject();
         GenericCodecs::CodecInfo item;
-        item.codecId = settings.value(XSTR(audioCodecId)).toString();
-        item.priority = settings.value(XSTR(audioCodecPriority)).toInt();
+        item.codecId = object.value(idKey).toString();
+        item.priority = object.value(priorityKey).toVariant().toInt();
         codecInfo.append(item);
     }
-    settings.endArray();
     return codecInfo;
 }
 
-void Settings::saveAudioCodecInfo(const QList<GenericCodecs::CodecInfo> &codecInfo)
+void saveCodecInfo(const QString &name, const QString &idKey, const QString &priorityKey,
+                   const QList<GenericCodecs::CodecInfo> &codecInfo)
 {
-    QSettings settings(ORG_NAME, APP_NAME);
-    settings.beginWriteArray(XSTR(audioCodecInfo));
-    for (int i = 0; i < codecInfo.size(); ++i) {
-        settings.setArrayIndex(i);
-        settings.setValue(XSTR(audioCodecId), codecInfo.at(i).codecId);
-        settings.setValue(XSTR(audioCodecPriority), codecInfo.at(i).priority);
+    QJsonArray array;
+    for (const auto &info: codecInfo) {
+        array.append(QJsonObject{{idKey, info.codecId}, {priorityKey, info.priority}});
     }
-    settings.endArray();
+    SettingsStore::instance().setDocument(name, array);
+}
+}
+
+QList<GenericCodecs::CodecInfo> Settings::audioCodecInfo()
+{
+    return loadCodecInfo(XSTR(audioCodecInfo), XSTR(audioCodecId), XSTR(audioCodecPriority));
+}
+
+void Settings::saveAudioCodecInfo(const QList<GenericCodecs::CodecInfo> &codecInfo)
+{
+    saveCodecInfo(XSTR(audioCodecInfo), XSTR(audioCodecId), XSTR(audioCodecPriority), codecInfo);
 }
 
 QList<GenericCodecs::CodecInfo> Settings::videoCodecInfo()
 {
-    QList<GenericCodecs::CodecInfo> codecInfo;
-    QSettings settings(ORG_NAME, APP_NAME);
-    const auto size = settings.beginReadArray(XSTR(videoCodecInfo));
-    for (int i = 0; i < size; ++i) {
-        settings.setArrayIndex(i);
-        GenericCodecs::CodecInfo item;
-        item.codecId = settings.value(XSTR(videoCodecId)).toString();
-        item.priority = settings.value(XSTR(videoCodecPriority)).toInt();
-        codecInfo.append(item);
-    }
-    settings.endArray();
-    return codecInfo;
+    return loadCodecInfo(XSTR(videoCodecInfo), XSTR(videoCodecId), XSTR(videoCodecPriority));
 }
 
 void Settings::saveVideoCodecInfo(const QList<GenericCodecs::CodecInfo> &codecInfo)
 {
-    QSettings settings(ORG_NAME, APP_NAME);
-    settings.beginWriteArray(XSTR(videoCodecInfo));
-    for (int i = 0; i < codecInfo.size(); ++i) {
-        settings.setArrayIndex(i);
-        settings.setValue(XSTR(videoCodecId), codecInfo.at(i).codecId);
-        settings.setValue(XSTR(videoCodecPriority), codecInfo.at(i).priority);
-    }
-    settings.endArray();
+    saveCodecInfo(XSTR(videoCodecInfo), XSTR(videoCodecId), XSTR(videoCodecPriority), codecInfo);
 }
@@ -24,7 +24,8 @@ private:
     enum { SIP_PORT =  5060, PROXY_PORT = 5096,
            INVALID_INDEX = -1,
            INBOUND_RING_TONE_INDEX = 0, OUTBOUND_RING_TONE_INDEX = 1,
-           TRANSPORT_DEFAULT_PORT = 0 };
+           TRANSPORT_DEFAULT_PORT = 0, FLIGHT_RECORDER_SECONDS = 0, MEDIA_PROFILE = 0,
+           THREAD_SCHEDULING = 0 };
     static constexpr double DIALPAD_SOUND_VOLUME = 0.75;
     static constexpr double MICROPHONE_VOLUME = 1.0;
     static constexpr double SPEAKERS_VOLUME = 1.0;
@@ -32,6 +33,9 @@ private:
     static constexpr bool ENABLE_SIP_LOG = true;
     static constexpr bool ENABLE_VAD = true;
     static constexpr bool DISABLE_TCP_SWITCH = false;
+    static constexpr bool STEREO_RECORDING = false;
+    static constexpr bool PACKET_CAPTURE = false;
+    static constexpr bool CAPTURE_RTP = false;
 
     static constexpr bool ALLOW_SDP_NAT_REWRITE = true;
     static constexpr bool ALLOW_CONTACT_AND_VIA_REWRITE = true;
@@ -62,6 +66,9 @@ private:
     QML_WRITABLE_PROPERTY_FLOAT(qreal, dialpadSoundVolume, setDialpadSoundVolume, DIALPAD_SOUND_VOLUME)
 
     QML_WRITABLE_PROPERTY(QString, recPath, setRecPath, "")
+    QML_WRITABLE_PROPERTY_POD(bool, stereoRecording, setStereoRecording, STEREO_RECORDING)
+    //0 disables the in-memory flight recorder
+    QML_WRITABLE_PROPERTY_POD(int, flightRecorderSeconds, setFlightRecorderSeconds, FLIGHT_RECORDER_SECONDS)
 
     //QML_WRITABLE_PROPERTY(QString, stunServer, setStunServer, "stun.zoiper.com")
     //QML_WRITABLE_PROPERTY(int, stunPort, setStunPort, 3478)
@@ -72,8 +79,17 @@ private:
 
     QML_WRITABLE_PROPERTY_POD(bool, enableSipLog, setEnableSipLog, ENABLE_SIP_LOG)
     QML_WRITABLE_PROPERTY_POD(bool, enableVad, setEnableVad, ENABLE_VAD)
+    //MediaProfile::Id, applied when PJSUA starts
+    QML_WRITABLE_PROPERTY_POD(int, mediaProfile, setMediaProfile, MEDIA_PROFILE)
+    //MediaThreads::Scheduling and CPU lists like "2,3", applied when PJSUA starts
+    QML_WRITABLE_PROPERTY_POD(int, threadScheduling, setThreadScheduling, THREAD_SCHEDULING)
+    QML_WRITABLE_PROPERTY(QString, audioThreadCpus, setAudioThreadCpus, "")
+    QML_WRITABLE_PROPERTY(QString, workerThreadCpus, setWorkerThreadCpus, "")
     QML_WRITABLE_PROPERTY_POD(uint32_t, transportSourcePort, setTransportSourcePort, TRANSPORT_DEFAULT_PORT)
     QML_WRITABLE_PROPERTY_POD(bool, disableTcpSwitch, setDisableTcpSwitch, DISABLE_TCP_SWITCH)
+    QML_WRITABLE_PROPERTY_POD(bool, packetCapture, setPacketCapture, PACKET_CAPTURE)
+    QML_WRITABLE_PROPERTY_POD(bool, captureRtp, setCaptureRtp, CAPTURE_RTP)
+    QML_WRITABLE_PROPERTY(QString, networkImpairment, setNetworkImpairment, "")
 
     QML_WRITABLE_PROPERTY_POD(bool, allowSdpNatRewrite, setAllowSdpNatRewrite, ALLOW_SDP_NAT_REWRITE)
     QML_WRITABLE_PROPERTY_POD(bool, allowContactAndViaRewrite, setAllowContactAndViaRewrite, ALLOW_CONTACT_AND_VIA_REWRITE)
@@ -0,0 +1,212 @@
+#include "settings_store.h"
+#include "settings.h"
+#include "metrics.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QSettings>
+#include <QDebug>
+
+SettingsStore& SettingsStore::instance()
+{
+    static SettingsStore store;
+    return store;
+}
+
+SettingsStore::SettingsStore() : _documentDir(Settings::writablePath())
+{
+    QSettings settings(ORG_NAME, APP_NAME);
+    const auto keys = settings.allKeys();
+    for (const auto &key: keys) {
+        _values.insert(key, settings.value(key));
+    }
+    qInfo() << "Loaded" << _values.size() << "settings from" << settings.fileName();
+
+    _flushTimer.setSingleShot(true);
+    connect(&_flushTimer, &QTimer::timeout, this, &SettingsStore::flush);
+    if (nullptr != QCoreApplication::instance()) {
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, &SettingsStore::sync);
+    }
+    _writer = std::thread(&SettingsStore::writer, this);
+}
+
+SettingsStore::~SettingsStore()
+{
+    sync();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+    }
+    _wakeup.notify_all();
+    _writer.join();
+}
+
+QVariant SettingsStore::value(const QString &key, const QVariant &defaultValue) const
+{
+    return _values.value(key, defaultValue);
+}
+
+void SettingsStore::setValue(const QString &key, const QVariant &value)
+{
+    const auto it = _values.constFind(key);
+    if ((it != _values.constEnd()) && (*it == value)) {
+        return;
+    }
+    _values.insert(key, value);
+    _dirtyValues.insert(key);
+    scheduleFlush();
+}
+
+bool SettingsStore::document(const QString &name, QJsonArray &array)
+{
+    const auto it = _documents.find(name);
+    if (it != _documents.end()) {
+        array = it->second;
+        return true;
+    }
+    if (0 != _missingDocuments.count(name)) {
+        return false;
+    }
+    //read once, then served from memory
+    QFile file(documentPath(name));
+    if (!file.open(QIODevice::ReadOnly)) {
+        _missingDocuments.insert(name);
+        return false;
+    }
+    QJsonParseError error{};
+    const auto json = QJsonDocument::fromJson(file.readAll(), &error);
+    if (QJsonParseError::NoError != error.error) {
+        qCritical() << "Cannot parse" << file.fileName() << ":" << error.errorString();
+        _missingDocuments.insert(name);
+        return false;
+    }
+    array = json.array();
+    _documents[name] = array;
+    return true;
+}
+
+void SettingsStore::setDocument(const QString &name, const QJsonArray &array)
+{
+    _documents[name] = array;
+    _missingDocuments.erase(name);
+    _dirtyDocuments.insert(name);
+    scheduleFlush();
+}
+
+void SettingsStore::sync()
+{
+    flush();
+    std::unique_lock<std::mutex> lock(_mutex);
+    _wakeup.wait(lock, [this]() { return _batches.empty() && !_writing; });
+}
+
+void SettingsStore::clear()
+{
+    _flushTimer.stop();
+    _firstDirtyMs = -1;
+    _dirtyValues.clear();
+    _dirtyDocuments.clear();
+    {
+        //nothing written after the caller cleared the backends
+        std::unique_lock<std::mutex> lock(_mutex);
+        _batches.clear();
+        _wakeup.wait(lock, [this]() { return !_writing; });
+    }
+    _values.clear();
+    _documents.clear();
+    _missingDocuments.clear();
+}
+
+void SettingsStore::scheduleFlush()
+{
+    //debounced, but never postponed past the maximum delay
+    const auto nowMs = QDateTime::currentMSecsSinceEpoch();
+    if (0 > _firstDirtyMs) {
+        _firstDirtyMs = nowMs;
+    }
+    if (MAX_FLUSH_DELAY_MS <= nowMs - _firstDirtyMs) {
+        flush();
+        return;
+    }
+    _flushTimer.start(FLUSH_DELAY_MS);
+}
+
+void SettingsStore::flush()
+{
+    _flushTimer.stop();
+    _firstDirtyMs = -1;
+    if (_dirtyValues.empty() && _dirtyDocuments.empty()) {
+        return;
+    }
+    //copies of implicitly shared data, the writer never touches the cache
+    Batch batch;
+    for (const auto &key: _dirtyValues) {
+        batch.values.insert(key, _values.value(key));
+    }
+    for (const auto &name: _dirtyDocuments) {
+        batch.documents[name] = _documents[name];
+    }
+    _dirtyValues.clear();
+    _dirtyDocuments.clear();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _batches.push_back(std::move(batch));
+    }
+    _wakeup.notify_all();
+}
+
+void SettingsStore::writer()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+        _wakeup.wait(lock, [this]() { return _quit || !_batches.empty(); });
+        if (_batches.empty()) {
+            return;
+        }
+        const auto batch = std::move(_batches.front());
+        _batches.pop_front();
+        _writing = true;
+        lock.unlock();
+        write(batch);
+        lock.lock();
+        _writing = false;
+        _wakeup.notify_all();
+    }
+}
+
+void SettingsStore::write(const Batch &batch) const
+{
+    static auto &writes = Metrics::instance().counter("bcphone_settings_writes_total",
+                                                      "Background writes of the settings");
+    static auto &failures = Metrics::instance().counter("bcphone_settings_write_failures_total",
+                                                        "Settings documents that could not be written");
+    writes.add();
+    QSettings settings(ORG_NAME, APP_NAME);
+    for (auto it = batch.values.cbegin(); it != batch.values.cend(); ++it) {
+        settings.setValue(it.key(), it.value());
+    }
+    if (!batch.documents.empty()) {
+        //removed by a clear
+        QDir().mkpath(_documentDir);
+    }
+    for (const auto &[name, array]: batch.documents) {
+        QSaveFile file(documentPath(name));
+        if (!file.open(QIODevice::WriteOnly) ||
+                (-1 == file.write(QJsonDocument(array).toJson(QJsonDocument::Compact))) || !file.commit()) {
+            qCritical() << "Cannot write" << file.fileName() << ":" << file.errorString();
+            failures.add();
+            continue;
+        }
+        //the arrays of the older versions are not needed any more
+        settings.remove(name);
+    }
+    settings.sync();
+}
+
+QString SettingsStore::documentPath(const QString &name) const
+{
+    return _documentDir + "/" + name + ".json";
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QObject>
+#include <QJsonArray>
+#include <QTimer>
+#include <QVariantMap>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+/**
+ * Process-wide cache of the settings: loaded once, read from memory and
+ * written back in the background. Changed keys are marked dirty and flushed
+ * together once no change came for FLUSH_DELAY_MS (at most MAX_FLUSH_DELAY_MS
+ * after the first one), on a writer thread. The plain values stay in the
+ * platform backend (QSettings); the bulk data (call history, contacts, codecs)
+ * are JSON documents in the writable path, replaced atomically so a crash
+ * leaves either the old or the new file. Used from the GUI thread only, the
+ * pending changes are written on quit.
+ */
+class SettingsStore : public QObject
+{
+    Q_OBJECT
+public:
+    static SettingsStore& instance();
+    ~SettingsStore();
+
+    QVariant value(const QString &key, const QVariant &defaultValue = QVariant()) const;
+    void setValue(const QString &key, const QVariant &value);
+
+    //false when the document was never saved
+    bool document(const QString &name, QJsonArray &array);
+    void setDocument(const QString &name, const QJsonArray &array);
+
+    //writes the pending changes and waits for the writer
+    void sync();
+    //drops the cache and the pending changes, the backends are cleared by the caller
+    void clear();
+
+private:
+    SettingsStore();
+    Q_DISABLE_COPY_MOVE(SettingsStore)
+
+    enum { FLUSH_DELAY_MS = 500, MAX_FLUSH_DELAY_MS = 5000 };
+
+    struct Batch {
+        QVariantMap values;
+        std::map<QString, QJsonArray> documents;
+    };
+
+    void scheduleFlush();
+    void flush();
+    void writer();
+    void write(const Batch &batch) const;
+    QString documentPath(const QString &name) const;
+
+    QVariantMap _values;
+    std::map<QString, QJsonArray> _documents;
+    std::set<QString> _missingDocuments;
+    std::set<QString> _dirtyValues;
+    std::set<QString> _dirtyDocuments;
+    QString _documentDir;
+    QTimer _flushTimer;
+    qint64 _firstDirtyMs = -1;
+
+    std::thread _writer;
+    std::mutex _mutex;
+    std::condition_variable _wakeup;
+    std::deque<Batch> _batches;
+    bool _writing = false;
+    bool _quit = false;
+};
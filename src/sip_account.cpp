@@ -0,0 +1,72 @@
+#include "sip_account.h"
+#include "settings.h"
+#include <QObject>
+
+SipAccountConfig SipAccountConfig::fromSettings(const Settings *settings)
+{
+    SipAccountConfig config;
+    config.sipServer = settings->sipServer();
+    config.sipPort = settings->sipPort();
+    config.sipTransport = settings->sipTransport();
+    config.userName = settings->userName();
+    config.authUserName = settings->authUserName();
+    config.password = settings->password();
+    config.displayName = settings->displayName();
+    config.mediaTransport = settings->mediaTransport();
+    config.proxyEnabled = settings->proxyEnabled();
+    config.proxyServer = settings->proxyServer();
+    config.proxyPort = settings->proxyPort();
+    config.allowSdpNatRewrite = settings->allowSdpNatRewrite();
+    config.allowContactAndViaRewrite = settings->allowContactAndViaRewrite();
+    config.publishEnabled = settings->publishEnabled();
+    return config;
+}
+
+SipAccountConfig SipAccountConfig::fromVariantMap(const QVariantMap &map)
+{
+    SipAccountConfig config;
+    config.sipServer = map.value("sipServer", config.sipServer).toString();
+    config.sipPort = map.value("sipPort", config.sipPort).toInt();
+    config.sipTransport = map.value("sipTransport", config.sipTransport).toInt();
+    config.userName = map.value("userName", config.userName).toString();
+    config.authUserName = map.value("authUserName", config.authUserName).toString();
+    config.password = map.value("password", config.password).toString();
+    config.displayName = map.value("displayName", config.displayName).toString();
+    config.mediaTransport = map.value("mediaTransport", config.mediaTransport).toInt();
+    config.proxyEnabled = map.value("proxyEnabled", config.proxyEnabled).toBool();
+    config.proxyServer = map.value("proxyServer", config.proxyServer).toString();
+    config.proxyPort = map.value("proxyPort", config.proxyPort).toInt();
+    config.allowSdpNatRewrite = map.value("allowSdpNatRewrite", config.allowSdpNatRewrite).toBool();
+    config.allowContactAndViaRewrite = map.value("allowContactAndViaRewrite",
+                                                 config.allowContactAndViaRewrite).toBool();
+    config.publishEnabled = map.value("publishEnabled", config.publishEnabled).toBool();
+    return config;
+}
+
+QVariantMap SipAccountConfig::toVariantMap() const
+{
+    return {{"sipServer", sipServer}, {"sipPort", sipPort}, {"sipTransport", sipTransport},
+            {"userName", userName}, {"authUserName", authUserName}, {"displayName", displayName},
+            {"mediaTransport", mediaTransport}, {"proxyEnabled", proxyEnabled},
+            {"proxyServer", proxyServer}, {"proxyPort", proxyPort},
+            {"allowSdpNatRewrite", allowSdpNatRewrite},
+            {"allowContactAndViaRewrite", allowContactAndViaRewrite},
+            {"publishEnabled", publishEnabled}};
+}
+
+QString SipAccountConfig::validate() const
+{
+    if (sipServer.isEmpty()) {
+        return QObject::tr("Domain is empty");
+    }
+    if (userName.isEmpty()) {
+        return QObject::tr("Username is empty");
+    }
+    if (password.isEmpty()) {
+        return QObject::tr("Password is empty");
+    }
+    if ((Settings::SipTransport::Udp > sipTransport) || (Settings::SipTransport::Tls < sipTransport)) {
+        return QObject::tr("Invalid SIP transport %1").arg(sipTransport);
+    }
+    return {};
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QString>
+#include <QVariantMap>
+
+class Settings;
+
+/**
+ * Registration parameters of one SIP account. The first account comes from
+ * the settings, further accounts of the same engine (e.g. the members of a
+ * hunt group) are given as maps with the same keys as the settings.
+ */
+struct SipAccountConfig {
+    QString sipServer;
+    int sipPort = 5060;
+    int sipTransport = 0;//Settings::SipTransport
+    QString userName;
+    QString authUserName;//the user name when empty
+    QString password;
+    QString displayName;
+    int mediaTransport = 0;//Settings::MediaTransport
+    bool proxyEnabled = false;
+    QString proxyServer;
+    int proxyPort = 0;
+    bool allowSdpNatRewrite = true;
+    bool allowContactAndViaRewrite = true;
+    bool publishEnabled = true;
+
+    static SipAccountConfig fromSettings(const Settings *settings);
+    //missing keys keep the defaults above
+    static SipAccountConfig fromVariantMap(const QVariantMap &map);
+    //without the password
+    QVariantMap toVariantMap() const;
+    //empty when the account can be registered
+    QString validate() const;
+};
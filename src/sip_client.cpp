@@ -1,19 +1,33 @@
 #include "sip_client.h"
 #include "softphone.h"
+#include "packet_capture.h"
+#include "network_impairment.h"
+#include "media_profile.h"
+#include "media_threads.h"
+#include "tone_latency_port.h"
+#include "call_trace.h"
+#include "metrics.h"
+#include "event_loop_watchdog.h"
+#include "startup_profile.h"
+#include "monotonic_clock.h"
 #include <QDebug>
 #include <QFile>
 #include <QRegularExpression>
+#include <QSslSocket>
+#ifdef ENABLE_VIDEO
 #include <QWidget>
 #include <QWindow>
 #include <QDialog>
 #include <QVBoxLayout>
+#endif
+#include <algorithm>
 
 #define GET_INSTANCE(accId) auto ptr = pjsua_acc_get_user_data(accId);\
     if (nullptr == ptr) {\
         formatErrorMessage(tr("Cannot get SIP client instance for account ID %1").arg(accId));\
         return;\
     }\
-    auto instance = reinterpret_cast<SipClient*>(ptr);
+    auto instance = reinterpret_cast<SipClient::Account*>(ptr)->client;
 
 #define GET_INSTANCE_CID(callId) pjsua_call_info ci{};\
     const auto status = pjsua_call_get_info(callId, &ci);\
@@ -25,6 +39,61 @@
 
 #define PTR_TO_STR(ptr) (nullptr != ptr) ? SipClient::toString(*ptr) : QString()
 
+namespace {
+//registered once, then updated without locking from any thread
+Counter& callCounter(bool outgoing)
+{
+    static auto &outgoingCalls = Metrics::instance().counter("bcphone_calls_total", "Call attempts",
+                                                             "direction=\"outgoing\"");
+    static auto &incomingCalls = Metrics::instance().counter("bcphone_calls_total", "Call attempts",
+                                                             "direction=\"incoming\"");
+    return outgoing ? outgoingCalls : incomingCalls;
+}
+
+void countCallOutcome(const pjsua_call_info &callInfo)
+{
+    enum { ANSWERED, BUSY, NO_ANSWER, DECLINED, FAILED };
+    static Counter *const outcomes[] = {
+        &Metrics::instance().counter("bcphone_call_outcomes_total", "Ended calls by outcome", "outcome=\"answered\""),
+        &Metrics::instance().counter("bcphone_call_outcomes_total", "Ended calls by outcome", "outcome=\"busy\""),
+        &Metrics::instance().counter("bcphone_call_outcomes_total", "Ended calls by outcome", "outcome=\"no_answer\""),
+        &Metrics::instance().counter("bcphone_call_outcomes_total", "Ended calls by outcome", "outcome=\"declined\""),
+        &Metrics::instance().counter("bcphone_call_outcomes_total", "Ended calls by outcome", "outcome=\"failed\"")
+    };
+    //the connect duration runs from the confirmation
+    int outcome = FAILED;
+    if ((0 != callInfo.connect_duration.sec) || (0 != callInfo.connect_duration.msec)) {
+        outcome = ANSWERED;
+    } else {
+        switch (callInfo.last_status) {
+        case PJSIP_SC_BUSY_HERE:
+        case PJSIP_SC_BUSY_EVERYWHERE:
+            outcome = BUSY;
+            break;
+        case PJSIP_SC_REQUEST_TIMEOUT:
+        case PJSIP_SC_TEMPORARILY_UNAVAILABLE:
+        case PJSIP_SC_REQUEST_TERMINATED:
+            outcome = NO_ANSWER;
+            break;
+        case PJSIP_SC_DECLINE:
+            outcome = DECLINED;
+            break;
+        default:;
+        }
+    }
+    outcomes[outcome]->add();
+}
+
+Counter& messageCounter(bool delivered)
+{
+    static auto &deliveredMessages = Metrics::instance().counter("bcphone_messages_total", "Instant messages sent",
+                                                                 "result=\"delivered\"");
+    static auto &failedMessages = Metrics::instance().counter("bcphone_messages_total", "Instant messages sent",
+                                                              "result=\"failed\"");
+    return delivered ? deliveredMessages : failedMessages;
+}
+}
+
 SipClient* SipClient::create(Softphone *softphone)
 {
     if (nullptr == softphone) {
@@ -56,15 +125,31 @@ SipClient* SipClient::create(Softphone *softphone)
     instance->_callHistoryModel = QPointer(softphone->callHistoryModel());
     instance->_activeCallModel = QPointer(softphone->activeCallModel());
 
+    //packet capture can be toggled at runtime
+    connect(instance->_settings, &Settings::packetCaptureChanged, instance, &SipClient::updatePacketCapture);
+    connect(instance->_settings, &Settings::captureRtpChanged, instance, &SipClient::updatePacketCapture);
+    connect(instance->_settings, &Settings::networkImpairmentChanged, instance, &SipClient::updateNetworkImpairment);
+
     return instance;
 }
 
 SipClient::SipClient(QObject *parent) : QObject(parent)
 {
+    _callAccounts.fill(PJSUA_INVALID_ID);
     //setup tone generator
     _toneGenTimer.setInterval(TONE_GEN_TIMEOUT_MS);
     _toneGenTimer.setSingleShot(true);
-    connect(&_toneGenTimer, &QTimer::timeout, this, &SipClient::releaseToneGenerator);
+    connect(&_toneGenTimer, &QTimer::timeout, this, &SipClient::disconnectToneGenerator);
+    _rtcpStatsTimer.setInterval(RTCP_STATS_MS);
+    connect(&_rtcpStatsTimer, &QTimer::timeout, this, &SipClient::sampleRtcpStats);
+    _probeTimer.setInterval(LATENCY_PROBE_POLL_MS);
+    connect(&_probeTimer, &QTimer::timeout, this, &SipClient::pollLatencyProbe);
+    //PJSUA is restarted between profiles, never from within a call callback
+    connect(this, &SipClient::latencyProbeFinished, this, [this]() {
+        if (PJSUA_INVALID_ID != _benchmarkRestoreProfile) {
+            runNextBenchmarkProfile();
+        }
+    }, Qt::QueuedConnection);
     // connect private signals
     connect(this, &SipClient::registrationStatusReady, this, &SipClient::processRegistrationStatus);
     connect(this, &SipClient::incomingCallReady, this, &SipClient::processIncomingCall);
@@ -72,6 +157,7 @@ SipClient::SipClient(QObject *parent) : QObject(parent)
     connect(this, &SipClient::callMediaStateReady, this, &SipClient::processCallMediaState);
     connect(this, &SipClient::streamStatsReady, this, &SipClient::dumpStreamStats);
     connect(this, &SipClient::buddyStateReady, this, &SipClient::processBuddyState);
+    connect(this, &SipClient::pagerReady, this, &SipClient::processPager);
 }
 
 void SipClient::onRegState(pjsua_acc_id accId)
@@ -89,7 +175,7 @@ void SipClient::onRegState(pjsua_acc_id accId)
 
 void SipClient::onIncomingCall(pjsua_acc_id accId, pjsua_call_id callId, pjsip_rx_data *rdata)
 {
-    PJ_UNUSED_ARG(rdata);
+    CallTracer::instance().addMessage(callId, true, (nullptr != rdata) ? rdata->msg_info.msg : nullptr);
 
     GET_INSTANCE(accId)
 
@@ -107,22 +193,62 @@ void SipClient::onCallState(pjsua_call_id callId, pjsip_event *e)
     PJ_UNUSED_ARG(e);
 
     GET_INSTANCE_CID(callId)
+    //traced here, the queued event adds the latency of the GUI thread
+    if (PJSIP_INV_STATE_CONFIRMED == ci.state) {
+        CallTracer::instance().addInstant(callId, "confirmed");
+    } else if (PJSIP_INV_STATE_DISCONNECTED == ci.state) {
+        CallTracer::instance().finishCall(callId, ci.last_status);
+        countCallOutcome(ci);
+    }
     emit instance->callStateReady(callId, ci);
 }
 
+void SipClient::onCallTsxState(pjsua_call_id callId, pjsip_transaction *tsx, pjsip_event *e)
+{
+    PJ_UNUSED_ARG(tsx);
+
+    if ((nullptr == e) || (PJSIP_EVENT_TSX_STATE != e->type)) {
+        return;
+    }
+    //each message once, when sent or received
+    const auto &tsxState = e->body.tsx_state;
+    if ((PJSIP_EVENT_RX_MSG == tsxState.type) && (nullptr != tsxState.src.rdata)) {
+        CallTracer::instance().addMessage(callId, true, tsxState.src.rdata->msg_info.msg);
+    } else if ((PJSIP_EVENT_TX_MSG == tsxState.type) && (nullptr != tsxState.src.tdata)) {
+        CallTracer::instance().addMessage(callId, false, tsxState.src.tdata->msg);
+    }
+}
+
 void SipClient::onCallMediaState(pjsua_call_id callId)
 {
     GET_INSTANCE_CID(callId)
+    if (PJSUA_CALL_MEDIA_ACTIVE == ci.media_status) {
+        CallTracer::instance().addInstant(callId, "media active");
+    }
     emit instance->callMediaStateReady(callId, ci);
 }
 
-void SipClient::onStreamCreated(pjsua_call_id callId, pjmedia_stream *strm,
-                            unsigned stream_idx, pjmedia_port **p_port)
+void SipClient::onStreamCreated(pjsua_call_id callId, pjsua_on_stream_created_param *param)
 {
-    Q_UNUSED(strm)
-    Q_UNUSED(p_port)
-    qDebug() << "onStreamCreated" << callId << stream_idx;
+    qDebug() << "onStreamCreated" << callId << param->stream_idx;
     //dumpStreamStats(strm);
+    GET_INSTANCE_CID(callId)
+    //the probe measures the unmodified path
+    if (instance->_probeActive.load(std::memory_order_acquire)) {
+        return;
+    }
+    if (nullptr == instance->callVolume(callId)) {
+        return;
+    }
+    //the bridge talks to the wrapper, which applies the gains and meters the call
+    auto &volume = instance->_callVolumes[static_cast<size_t>(callId)];
+    auto *port = CallVolumePort::create(param->port, PJ_FALSE != param->destroy_port, &volume);
+    if (nullptr == port) {
+        qWarning() << "Cannot create volume port for call ID" << callId;
+        return;
+    }
+    param->port = port;
+    param->destroy_port = PJ_TRUE;
 }
 
 void SipClient::onStreamDestroyed(pjsua_call_id callId, pjmedia_stream *strm,
@@ -136,6 +262,8 @@ void SipClient::onStreamDestroyed(pjsua_call_id callId, pjmedia_stream *strm,
 	    instance->errorHandler(tr("Cannot get stream stats"), status);
 	    return;
     }
+    //last sample of the call, also for the calls shorter than the sampling period
+    recordRtcpStats(stat);
     emit instance->streamStatsReady(stat);
 }
 
@@ -149,14 +277,62 @@ void SipClient::onBuddyState(pjsua_buddy_id buddyId)
     if (nullptr == ptr) {
         formatErrorMessage(tr("Cannot get SIP client instance for buddy ID %1").arg(buddyId));
         return;
-    }\
-    auto instance = reinterpret_cast<SipClient*>(ptr);
+    }
+    auto instance = reinterpret_cast<SipClient::Account*>(ptr)->client;
     emit instance->buddyStateReady(buddyId);
 }
 
+pjmedia_transport* SipClient::onCreateMediaTransport(pjsua_call_id callId, unsigned mediaIdx,
+                                                    pjmedia_transport *baseTp, unsigned flags)
+{
+    PJ_UNUSED_ARG(callId);
+    PJ_UNUSED_ARG(mediaIdx);
+    //always stacked so capture can be toggled during a call
+    auto *transport = PacketCapture::createMediaTransport(baseTp, 0 != (flags & PJSUA_MED_TP_CLOSE_MEMBER));
+    //impairment above capture, the capture shows the packets as on the wire
+    const auto profile = ImpairmentTransport::callProfile();
+    if (profile.isEnabled()) {
+        transport = ImpairmentTransport::create(profile, transport, true);
+    }
+    return transport;
+}
+
+void SipClient::onStreamPrecreate(pjsua_call_id callId, pjsua_on_stream_precreate_param *param)
+{
+    if (PJMEDIA_TYPE_AUDIO != param->stream_info.type) {
+        return;
+    }
+    GET_INSTANCE_CID(callId)
+    //only the loopback legs exist while a probe runs
+    if (!instance->_probeActive.load(std::memory_order_acquire)) {
+        return;
+    }
+    const auto &config = instance->_probeConfig;
+    auto &info = param->stream_info.info.aud;
+    if (0 <= config.jbInitMs) {
+        info.jb_init = config.jbInitMs;
+    }
+    if (0 <= config.jbMinPreMs) {
+        info.jb_min_pre = config.jbMinPreMs;
+    }
+    if (0 <= config.jbMaxPreMs) {
+        info.jb_max_pre = config.jbMaxPreMs;
+    }
+    if (0 <= config.jbMaxMs) {
+        info.jb_max = config.jbMaxMs;
+    }
+    if ((0 < config.ptimeMs) && (nullptr != info.param) && (0 < info.param->info.frm_ptime)) {
+        const auto framesPerPacket = std::max(1, config.ptimeMs / info.param->info.frm_ptime);
+        info.param->setting.frm_per_pkt = static_cast<pj_uint8_t>(framesPerPacket);
+    }
+}
+
 void SipClient::onPager(pjsua_call_id callId, const pj_str_t *from, const pj_str_t *to,
-	     const pj_str_t *contact, const pj_str_t *mimeType, const pj_str_t *body)
+	     const pj_str_t *contact, const pj_str_t *mimeType, const pj_str_t *body,
+	     pjsip_rx_data *rdata, pjsua_acc_id accId)
 {
+	PJ_UNUSED_ARG(rdata);
+
 	const auto src{PTR_TO_STR(from)};
 	const auto dst{PTR_TO_STR(to)};
 	const auto dstOrig{PTR_TO_STR(contact)};
@@ -167,7 +343,10 @@ void SipClient::onPager(pjsua_call_id callId, const pj_str_t *from, const pj_str
 		", to" << dst <<
 		", contact" << dstOrig <<
 		", mimeType" << contentType <<
-		", body" << msg;
+		", body" << msg <<
+		", account ID" << accId;
+	GET_INSTANCE(accId)
+	emit instance->pagerReady(accId, src, msg);
 }
 
 void SipClient::onPagerStatus(pjsua_call_id callId, const pj_str_t *to, const pj_str_t *body,
@@ -185,6 +364,7 @@ void SipClient::onPagerStatus(pjsua_call_id callId, const pj_str_t *to, const pj
 		", body" << msg <<
 		", status" << statusMessage.data() <<
 		", reason" << motive;
+	messageCounter(2 == status / 100).add();
 }
 
 void SipClient::onTyping(pjsua_call_id callId, const pj_str_t *from, const pj_str_t *to,
@@ -223,7 +403,9 @@ bool SipClient::init()
     }
 
     //init PJSUA
+    unsigned sipWorkerCount = 0;//run by the app when they need tuning
     {
+        const StartupProfile::Phase phase("pjsuaInit");
         pjsua_config cfg{};
         pjsua_config_default(&cfg);
         cfg.nat_type_in_sdp = 2;
@@ -232,10 +414,13 @@ bool SipClient::init()
         cfg.cb.on_incoming_call = &onIncomingCall;
         cfg.cb.on_call_media_state = &onCallMediaState;
         cfg.cb.on_call_state = &onCallState;
-        cfg.cb.on_stream_created = &onStreamCreated;
+        cfg.cb.on_call_tsx_state = &onCallTsxState;
+        cfg.cb.on_stream_created2 = &onStreamCreated;
         cfg.cb.on_stream_destroyed = &onStreamDestroyed;
         cfg.cb.on_buddy_state = &onBuddyState;
-	cfg.cb.on_pager = &onPager;
+        cfg.cb.on_create_media_transport = &onCreateMediaTransport;
+        cfg.cb.on_stream_precreate = &onStreamPrecreate;
+	cfg.cb.on_pager2 = &onPager;
 	cfg.cb.on_pager_status = &onPagerStatus;
 	cfg.cb.on_typing = &onTyping;
 
@@ -276,6 +461,13 @@ bool SipClient::init()
                 PJMEDIA_ECHO_USE_NOISE_SUPPRESSOR |
                 PJMEDIA_ECHO_AGGRESSIVENESS_DEFAULT;
         media_cfg.no_vad = _settings->enableVad() ? PJ_FALSE : PJ_TRUE;
+        MediaProfile::get(_settings->mediaProfile()).apply(media_cfg);
+
+        //the audio and media threads tune themselves, the SIP workers are started below
+        if (updateMediaThreads()) {
+            sipWorkerCount = cfg.thread_cnt;
+            cfg.thread_cnt = 0;
+        }
 
         status = pjsua_init(&cfg, &log_cfg, &media_cfg);
         if (PJ_SUCCESS != status) {
@@ -284,40 +476,38 @@ bool SipClient::init()
         }
     }
 
-    auto addTransport = [this](pjsip_transport_type_e type) {
-        pjsua_transport_config cfg;
-        pjsua_transport_config_default(&cfg);
-        cfg.port = _settings->transportSourcePort();
-        const auto status = pjsua_transport_create(type, &cfg, nullptr);
+    status = PacketCapture::registerSipModule();
+    if (PJ_SUCCESS != status) {
+        errorHandler(tr("Cannot register packet capture"), status);
+    }
+    updatePacketCapture();
+    updateNetworkImpairment();
+
+    //the SIP transports are created with the first account using them, see sharedTransport
+
+    //start PJSUA
+    {
+        const StartupProfile::Phase phase("pjsuaStart");
+        status = pjsua_start();
         if (PJ_SUCCESS != status) {
-            errorHandler(tr("Error creating transport"), status);
+            errorHandler(tr("Cannot start PJSUA"), status);
             return false;
         }
-        return true;
-    };
-    std::array<pjsip_transport_type_e, 3> transports{PJSIP_TRANSPORT_UDP, PJSIP_TRANSPORT_TCP, PJSIP_TRANSPORT_TLS};
-    for (const auto transp: transports) {
-        if (!addTransport(transp)) {
+        if ((0 < sipWorkerCount) && !startSipWorkers(sipWorkerCount)) {
             return false;
         }
+        disableAudio();
+        initToneGenerator();
     }
-
-    //start PJSUA
-    status = pjsua_start();
-    if (PJ_SUCCESS != status) {
-        errorHandler(tr("Cannot start PJSUA"), status);
-        return false;
+    {
+        const StartupProfile::Phase phase("audioDevices");
+        initAudioDevicesList();
     }
-
-    disableAudio();
-
-    initAudioDevicesList();
-    listAudioCodecs();
-
-#ifdef ENABLE_VIDEO
-    initVideoDevicesList();
-    listVideoCodecs();
-#endif
+    {
+        const StartupProfile::Phase phase("audioCodecs");
+        listAudioCodecs();
+    }
+    //the video devices and codecs are listed on first use, see initVideo
 
     disableTcpSwitch();
 
@@ -330,8 +520,32 @@ void SipClient::release()
     const auto state = pjsua_get_state();
     if (PJSUA_STATE_RUNNING == state) {
         hangupAll();
-        releaseRingTonePlayers();
+        _ringTones.release();
+        releaseToneGenerator();
+        _mixer.reset();
+        if (_fileAudio) {
+            _fileAudio->release();
+        }
+        _recorders.clear();//finalize the files still being written
+        _flightRecorders.clear();
+        _probeTimer.stop();
+        _probeActive = false;
+        _latencyProbe.reset();
+        _probeRuns.clear();
+        _probeCaller = PJSUA_INVALID_ID;
+        _probeCallee = PJSUA_INVALID_ID;
+        _probeAccId = PJSUA_INVALID_ID;
+        _transportIds.fill(PJSUA_INVALID_ID);
+#ifdef ENABLE_VIDEO
+        _videoInitialized = false;
+#endif
+        PacketCapture::instance().stop();
         unregisterAccount();
+        for (const auto accId: accountIds()) {
+            deleteAccount(accId);
+        }
+        logMediaThreads();
+        stopSipWorkers();
         pjsua_stop_worker_threads();
         pj_status_t status = pjsua_destroy();
         if (PJ_SUCCESS != status) {
@@ -339,56 +553,127 @@ void SipClient::release()
         } else {
             qDebug() << "PJSUA successfully destroyed";
         }
+        _accounts.clear();//user data of the accounts PJSUA failed to remove
+        _campaignCalls.fill(false);
     }
 }
 
 bool SipClient::registerAccount()
 {
-    const auto state = pjsua_get_state();
-    if (PJSUA_STATE_RUNNING != state) {
-        errorHandler(tr("PJSUA library not started (%1)").arg(state));
+    //unregister previous account if needed
+    unregisterAccount();
+
+    auto config = SipAccountConfig::fromSettings(_settings);
+    if (config.authUserName.isEmpty() && !config.userName.isEmpty()) {
+        config.authUserName = config.userName;
+        _settings->setAuthUserName(config.userName);
+    }
+    //shares the transports created at init
+    _accId = createAccount(config, false);
+    if (PJSUA_INVALID_ID == _accId) {
         return false;
     }
+    //first status once the default account is known, so that it is reported as such
+    onRegState(_accId);
+    return true;
+}
 
-    const auto& domain = _settings->sipServer();
-    if (domain.isEmpty()) {
-        errorHandler(tr("Domain is empty"));
-        return false;
+pjsua_acc_id SipClient::addAccount(const SipAccountConfig &config)
+{
+    const auto accId = createAccount(config, true);
+    if (PJSUA_INVALID_ID != accId) {
+        onRegState(accId);
+    }
+    return accId;
+}
+
+bool SipClient::removeAccount(pjsua_acc_id accId)
+{
+    if (_accId == accId) {
+        return unregisterAccount();
     }
-    const auto destPort = QString::number(_settings->sipPort());
-    const auto& username = _settings->userName();
-    if (username.isEmpty()) {
-        errorHandler(tr("Username is empty"));
+    if ((_probeAccId == accId) || (0 == _accounts.count(accId))) {
+        errorHandler(tr("Unknown account ID %1").arg(accId));
         return false;
     }
-    auto authUsername = _settings->authUserName();
-    if (authUsername.isEmpty()) {
-        authUsername = username;
-        _settings->setAuthUserName(username);
+    return deleteAccount(accId);
+}
+
+QList<pjsua_acc_id> SipClient::accountIds() const
+{
+    QList<pjsua_acc_id> ids;
+    for (const auto &[accId, account]: _accounts) {
+        if (_probeAccId != accId) {
+            ids.append(accId);
+        }
     }
-    const auto& password = _settings->password();
-    if (password.isEmpty()) {
-        errorHandler(tr("Password is empty"));
-        return false;
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+QVariantMap SipClient::accountInfo(pjsua_acc_id accId) const
+{
+    const auto it = _accounts.find(accId);
+    if ((it == _accounts.end()) || (_probeAccId == accId)) {
+        return {};
     }
-    const auto sipTransport = SipClient::sipTransport(_settings->sipTransport());
+    const auto &account = *it->second;
+    auto info = account.config.toVariantMap();
+    info["accountId"] = account.id;
+    info["default"] = (_accId == account.id);
+    info["registered"] = (RegistrationStatus::Registered == account.status);
+    info["statusText"] = account.statusText;
+    return info;
+}
 
-    //unregister previous account if needed
-    unregisterAccount();
+SipClient::Account* SipClient::findAccount(pjsua_acc_id accId) const
+{
+    const auto it = _accounts.find((PJSUA_INVALID_ID == accId) ? _accId : accId);
+    return (it == _accounts.end()) ? nullptr : it->second.get();
+}
+
+SipClient::Account* SipClient::attachAccount(pjsua_acc_id accId)
+{
+    auto account = std::make_unique<Account>();
+    account->client = this;
+    account->id = accId;
+    //local accounts do not register, setting the user data after adding is safe
+    const auto status = pjsua_acc_set_user_data(accId, account.get());
+    if (PJ_SUCCESS != status) {
+        errorHandler(tr("Error setting user data for account"), status);
+        return nullptr;
+    }
+    auto *ptr = account.get();
+    _accounts[accId] = std::move(account);
+    return ptr;
+}
 
-    _serverDomain = domain + ":" + destPort + sipTransport;
+pjsua_acc_id SipClient::createAccount(const SipAccountConfig &config, bool ownTransport)
+{
+    const auto state = pjsua_get_state();
+    if (PJSUA_STATE_RUNNING != state) {
+        errorHandler(tr("PJSUA library not started (%1)").arg(state));
+        return PJSUA_INVALID_ID;
+    }
+    const auto error = config.validate();
+    if (!error.isEmpty()) {
+        errorHandler(error);
+        return PJSUA_INVALID_ID;
+    }
+    const auto& authUsername = config.authUserName.isEmpty() ? config.userName : config.authUserName;
+    const auto sipTransport = SipClient::sipTransport(config.sipTransport);
+    const auto serverDomain = config.sipServer + ":" + QString::number(config.sipPort) + sipTransport;
 
     pjsua_acc_config cfg{};
     pjsua_acc_config_default(&cfg);
-    auto id{"sip:" + username + "@" + _serverDomain};
-    const auto& displayName = _settings->displayName();
-    if (!displayName.isEmpty()) {
-	id = "\"" + displayName + "\" <" + id + ">";
+    auto id{"sip:" + config.userName + "@" + serverDomain};
+    if (!config.displayName.isEmpty()) {
+	id = "\"" + config.displayName + "\" <" + id + ">";
     }
     qInfo() << "ID URI" << id;
     auto tmpId = id.toStdString();
     pj_cstr(&cfg.id, tmpId.c_str());
-    QString regUri = "sip:" + _serverDomain;
+    QString regUri = "sip:" + serverDomain;
     qInfo() << "Reg URI" << regUri;
     auto tmpRegUri = regUri.toStdString();
     pj_cstr(&cfg.reg_uri, tmpRegUri.c_str());
@@ -398,28 +683,28 @@ bool SipClient::registerAccount()
     auto tmpUsername = authUsername.toStdString();
     pj_cstr(&cfg.cred_info[0].username, tmpUsername.c_str());
     cfg.cred_info[0].data_type = PJSIP_CRED_DATA_PLAIN_PASSWD;
-    auto tmpPassword = password.toStdString();
+    auto tmpPassword = config.password.toStdString();
     pj_cstr(&cfg.cred_info[0].data, tmpPassword.c_str());
 
-    const bool srtpEnabled = Settings::MediaTransport::Srtp == _settings->mediaTransport();
+    const bool srtpEnabled = Settings::MediaTransport::Srtp == config.mediaTransport;
     cfg.use_srtp = srtpEnabled ? PJMEDIA_SRTP_MANDATORY : PJMEDIA_SRTP_DISABLED;
     pjsua_srtp_opt_default(&cfg.srtp_opt);
     cfg.srtp_opt.keying[0] = PJMEDIA_SRTP_KEYING_SDES;//TODO: check box
-    const bool tlsEnabled = Settings::SipTransport::Tls == _settings->sipTransport();
+    const bool tlsEnabled = Settings::SipTransport::Tls == config.sipTransport;
     cfg.srtp_secure_signaling = tlsEnabled ? 1 : 0;
 
     std::string proxyUri;
-    if (_settings->proxyEnabled()) {
-        auto proxyServer = "sip:" + _settings->proxyServer();
-        if (0 < _settings->proxyPort()) {
-            proxyServer += ":" + QString::number(_settings->proxyPort());
+    if (config.proxyEnabled) {
+        auto proxyServer = "sip:" + config.proxyServer;
+        if (0 < config.proxyPort) {
+            proxyServer += ":" + QString::number(config.proxyPort);
         }
         proxyServer += sipTransport;
 	proxyUri = proxyServer.toStdString();
 	const auto status{verifySipUri(proxyUri.c_str())};
 	if (PJ_SUCCESS != status) {
 		errorHandler(tr("Invalid outbound proxy URL"), status);
-		return false;
+		return PJSUA_INVALID_ID;
 	}
 	qInfo() << "Outbound proxy URI" << proxyServer;
 	pj_cstr(&cfg.proxy[cfg.proxy_cnt++], proxyUri.c_str());
@@ -431,26 +716,119 @@ bool SipClient::registerAccount()
     cfg.vid_in_auto_show = PJ_FALSE;
     cfg.vid_out_auto_transmit = PJ_FALSE;
 
-    cfg.allow_sdp_nat_rewrite = _settings->allowSdpNatRewrite() ? PJ_TRUE : PJ_FALSE;
-    cfg.allow_contact_rewrite = _settings->allowContactAndViaRewrite() ? PJ_TRUE : PJ_FALSE;
+    cfg.allow_sdp_nat_rewrite = config.allowSdpNatRewrite ? PJ_TRUE : PJ_FALSE;
+    cfg.allow_contact_rewrite = config.allowContactAndViaRewrite ? PJ_TRUE : PJ_FALSE;
     cfg.allow_via_rewrite = cfg.allow_contact_rewrite;
-    cfg.publish_enabled = _settings->publishEnabled() ? PJ_TRUE : PJ_FALSE;
+    cfg.publish_enabled = config.publishEnabled ? PJ_TRUE : PJ_FALSE;
+
+    //an ephemeral local port, the account keeps its own connection and NAT binding
+    pjsua_transport_id transportId = PJSUA_INVALID_ID;
+    if (ownTransport) {
+        static const std::array<pjsip_transport_type_e, 3> types{PJSIP_TRANSPORT_UDP, PJSIP_TRANSPORT_TCP,
+                                                                 PJSIP_TRANSPORT_TLS};
+        pjsua_transport_config transportCfg;
+        pjsua_transport_config_default(&transportCfg);
+        const auto status = pjsua_transport_create(types.at(static_cast<size_t>(config.sipTransport)),
+                                                   &transportCfg, &transportId);
+        if (PJ_SUCCESS != status) {
+            errorHandler(tr("Error creating transport"), status);
+            return PJSUA_INVALID_ID;
+        }
+        cfg.transport_id = transportId;
+    } else if (PJSUA_INVALID_ID == sharedTransport(config.sipTransport)) {
+        return PJSUA_INVALID_ID;
+    }
 
-    auto status = pjsua_acc_add(&cfg, PJ_TRUE, &_accId);
+    //set before adding, registration starts right away and its callbacks need the client
+    auto account = std::make_unique<Account>();
+    account->client = this;
+    account->transportId = transportId;
+    account->serverDomain = serverDomain;
+    account->config = config;
+    account->config.password.clear();//only needed by PJSUA
+    cfg.user_data = account.get();
+
+    pjsua_acc_id accId = PJSUA_INVALID_ID;
+    const auto status = pjsua_acc_add(&cfg, ownTransport ? PJ_FALSE : PJ_TRUE, &accId);
     if (PJ_SUCCESS != status) {
         errorHandler("Error adding account", status);
-        return false;
+        if (PJSUA_INVALID_ID != transportId) {
+            pjsua_transport_close(transportId, PJ_FALSE);
+        }
+        return PJSUA_INVALID_ID;
     }
+    account->id = accId;
+    _accounts[accId] = std::move(account);
+
+    qInfo() << "Registration started for account ID" << accId;
+    return accId;
+}
 
-    status = pjsua_acc_set_user_data(_accId, this);
+pjsua_transport_id SipClient::sharedTransport(int sipTransport)
+{
+    if ((Settings::SipTransport::Udp > sipTransport) || (Settings::SipTransport::Tls < sipTransport)) {
+        errorHandler(tr("Invalid SIP transport %1").arg(sipTransport));
+        return PJSUA_INVALID_ID;
+    }
+    auto &transportId = _transportIds.at(static_cast<size_t>(sipTransport));
+    if (PJSUA_INVALID_ID != transportId) {
+        return transportId;
+    }
+    //requests too large for UDP switch to TCP unless disabled
+    if ((Settings::SipTransport::Udp == sipTransport) && !_settings->disableTcpSwitch() &&
+            (PJSUA_INVALID_ID == sharedTransport(Settings::SipTransport::Tcp))) {
+        return PJSUA_INVALID_ID;
+    }
+    if (Settings::SipTransport::Tls == sipTransport) {
+        qInfo() << "SSL backend version:" << QSslSocket::sslLibraryVersionString();
+    }
+    static const std::array<pjsip_transport_type_e, 3> types{PJSIP_TRANSPORT_UDP, PJSIP_TRANSPORT_TCP,
+                                                             PJSIP_TRANSPORT_TLS};
+    const StartupProfile::Phase phase("sipTransport");
+    pjsua_transport_config cfg;
+    pjsua_transport_config_default(&cfg);
+    cfg.port = _settings->transportSourcePort();
+    const auto status = pjsua_transport_create(types.at(static_cast<size_t>(sipTransport)), &cfg, &transportId);
     if (PJ_SUCCESS != status) {
-        errorHandler("Error setting user data for account", status);
-        unregisterAccount();
-        return false;
+        errorHandler(tr("Error creating transport"), status);
+        transportId = PJSUA_INVALID_ID;
+        return PJSUA_INVALID_ID;
     }
+    qInfo() << "Created SIP transport" << sipTransport << "ID" << transportId;
+    return transportId;
+}
 
-    qInfo() << "Registration started";
-    onRegState(_accId);
+bool SipClient::deleteAccount(pjsua_acc_id accId)
+{
+    const auto it = _accounts.find(accId);
+    if (it == _accounts.end()) {
+        return true;
+    }
+    //the buddies keep a pointer to the account
+    for (const auto buddyId : it->second->buddies) {
+        const auto status = pjsua_buddy_del(buddyId);
+        if (PJ_SUCCESS != status) {
+            errorHandler(tr("Cannot del buddy"), status);
+        }
+    }
+    it->second->buddies.clear();
+    auto status = pjsua_acc_del(accId);
+    if (PJ_SUCCESS != status) {
+        errorHandler("Error removing account", status);
+        return false;
+    }
+    if (PJSUA_INVALID_ID != it->second->transportId) {
+        status = pjsua_transport_close(it->second->transportId, PJ_FALSE);
+        if (PJ_SUCCESS != status) {
+            errorHandler(tr("Cannot close account transport"), status);
+        }
+    }
+    //no callback can reach the account any more
+    const bool isLocal = it->second->serverDomain.isEmpty();
+    _accounts.erase(it);
+    if (!isLocal) {
+        emit accountRegistrationChanged(accId, RegistrationStatus::Unregistered, tr("Not Registered"));
+    }
     return true;
 }
 
@@ -467,51 +845,105 @@ void SipClient::manuallyRegister()
     }
 }
 
-bool SipClient::makeCall(const QString &userId)
+bool SipClient::makeCall(const QString &userId, pjsua_acc_id accId)
+{
+    qDebug() << "makeCall" << userId << accId;
+
+    const auto callId = placeCall(userId, accId, false);
+    if (PJSUA_INVALID_ID == callId) {
+        return false;
+    }
+
+    if (nullptr != _callHistoryModel) {
+        const auto &userName = _callHistoryModel->userName(userId);
+        _activeCallModel->addCall(callId, userName, userId);
+        _callHistoryModel->addContact(callId, userName, userId,
+                                      CallHistoryModel::CallStatus::OUTGOING);
+    } else {
+        qWarning() << "Call history model is null";
+    }
+    const auto ringToneNs = monotonicNs();
+    startPlayingRingTone(callId, false);
+    CallTracer::instance().addSpan(callId, "ringTone", ringToneNs);
+    return true;
+}
+
+pjsua_call_id SipClient::makeCampaignCall(const QString &userId, pjsua_acc_id accId, bool &temporary)
 {
-    qDebug() << "makeCall" << userId;
+    temporary = false;
+    const auto *account = findAccount(accId);
+    if ((nullptr != account) && (RegistrationStatus::Registered != account->status)) {
+        //still registering or reconnecting
+        temporary = true;
+        return PJSUA_INVALID_ID;
+    }
+    pj_status_t status = PJ_SUCCESS;
+    const auto callId = placeCall(userId, accId, true, &status);
+    temporary = (PJ_ETOOMANY == status);
+    if (PJSUA_INVALID_ID != callId) {
+        _campaignCalls[static_cast<size_t>(callId)] = true;
+    }
+    return callId;
+}
 
+pjsua_call_id SipClient::placeCall(const QString &userId, pjsua_acc_id accId, bool campaign,
+                                   pj_status_t *makeCallStatus)
+{
     if (userId.isEmpty()) {
 
-        return false;
+        return PJSUA_INVALID_ID;
+    }
+    const auto *account = findAccount(accId);
+    if (nullptr == account) {
+        errorHandler(tr("No registered account"));
+        return PJSUA_INVALID_ID;
     }
 
+    auto &tracer = CallTracer::instance();
+    tracer.beginSetup();
+    auto beginNs = monotonicNs();
     std::string uriBuffer;
     pj_str_t uriStr{};
-    if (!callUri(&uriStr, userId, uriBuffer)) {
-        return false;
+    if (!callUri(&uriStr, userId, uriBuffer, account->id)) {
+        return PJSUA_INVALID_ID;
     }
+    tracer.addSetupSpan("callUri", beginNs);
 
-    //open audio device only when needed
-    enableAudio();
+    //open audio device only when needed, campaigns open it once: it takes about 1 sec
+    if (!campaign || !pjsua_snd_is_active()) {
+        beginNs = monotonicNs();
+        enableAudio();
+        tracer.addSetupSpan("enableAudio", beginNs);
+    }
 
 #ifdef ENABLE_VIDEO
+    if (!campaign) {
+        initVideo();
+    }
     pjsua_call_setting callSetting{};
     pjsua_call_setting_default(&callSetting);
-    callSetting.vid_cnt = 1;
+    callSetting.vid_cnt = campaign ? 0 : 1;
     pjsua_call_setting *callSettingPtr{&callSetting};
 #else
     constexpr pjsua_call_setting *callSettingPtr{nullptr};
 #endif
 
     pjsua_call_id callId{PJSUA_INVALID_ID};
-    const auto status{pjsua_call_make_call(_accId, &uriStr, callSettingPtr,
+    beginNs = monotonicNs();
+    const auto status{pjsua_call_make_call(account->id, &uriStr, callSettingPtr,
 					    nullptr, nullptr, &callId)};
+    if (nullptr != makeCallStatus) {
+        *makeCallStatus = status;
+    }
     if (PJ_SUCCESS != status) {
         errorHandler("Cannot make call", status);
-        return false;
-    }
-
-    if (nullptr != _callHistoryModel) {
-        const auto &userName = _callHistoryModel->userName(userId);
-        _activeCallModel->addCall(callId, userName, userId);
-        _callHistoryModel->addContact(callId, userName, userId,
-                                      CallHistoryModel::CallStatus::OUTGOING);
-    } else {
-        qWarning() << "Call history model is null";
+        return PJSUA_INVALID_ID;
     }
-    startPlayingRingTone(callId, false);
-    return true;
+    tracer.addSetupSpan("makeCall", beginNs);
+    tracer.attachSetup(callId);
+    callCounter(true).add();
+    _callAccounts[static_cast<size_t>(callId)] = account->id;
+    return callId;
 }
 
 bool SipClient::sendDtmf(const QString &dtmf)
@@ -541,6 +973,7 @@ bool SipClient::answer(int callId, int statusCode)
     }
 
 #ifdef ENABLE_VIDEO
+    initVideo();
     pjsua_call_setting callSetting{};
     pjsua_call_setting_default(&callSetting);
     callSetting.vid_cnt = 1;
@@ -616,7 +1049,7 @@ bool SipClient::unsupervisedTransfer(const QString& phoneNumber, const QString&
 
     std::string uriBuffer;
     pj_str_t uriStr{};
-    if (!callUri(&uriStr, phoneNumber, uriBuffer)) {
+    if (!callUri(&uriStr, phoneNumber, uriBuffer, callAccount(currentCallId))) {
         return false;
     }
     const auto status = pjsua_call_xfer(currentCallId, &uriStr, nullptr);
@@ -668,10 +1101,13 @@ bool SipClient::playDigit(const QString& digit)
         return false;
     }
 
-    initToneGenerator();
-
-    if (nullptr == _toneGenPool) {
-        qCritical() << "Generator pool is NULL";
+    if (nullptr == _toneGenMediaPort) {
+        qCritical() << "Tone generator is NULL";
+        return false;
+    }
+    //the generator is only disconnected when idle, reconnecting it is cheap
+    const bool firstDigit = !_toneGenConnected;
+    if (firstDigit && !connectToneGenerator()) {
         return false;
     }
 
@@ -680,6 +1116,7 @@ bool SipClient::playDigit(const QString& digit)
     toneDigit.on_msec = TONE_GEN_ON_MS;
     toneDigit.off_msec = TONE_GEN_OFF_MS;
     toneDigit.volume = 0;
+    ToneLatencyPort::keyPressed(_toneLatencyPort, firstDigit);
     const auto status = pjmedia_tonegen_play_digits(_toneGenMediaPort, 1, &toneDigit, 0);
     if (PJ_SUCCESS != status) {
         errorHandler(tr("Play digit"), status);
@@ -699,11 +1136,13 @@ bool SipClient::mute(bool start, int callId)
         qCritical() << "Cannot get conference slot of call ID" << callId;
         return false;
     }
+    //in a conference the microphone only feeds the mixer
+    const auto sinkPort = (_mixer && _mixer->contains(callId)) ? _mixer->localPort() : callConfPort;
     pj_status_t status = PJ_SUCCESS;
     if (start) {
-        status = pjsua_conf_disconnect(0, callConfPort);
+        status = pjsua_conf_disconnect(0, sinkPort);
     } else {
-        status = pjsua_conf_connect(0, callConfPort);
+        status = pjsua_conf_connect(0, sinkPort);
     }
     if (PJ_SUCCESS != status) {
         const QString msg = start ? tr("Cannot mute call") : tr("Cannot unmute call");
@@ -721,36 +1160,70 @@ bool SipClient::setupConferenceCall(pjsua_call_id callId)
         qDebug() << "Nothing to do" << callCount;
         return true;
     }
-    pjsua_conf_port_id confPortId = pjsua_call_get_conf_port(callId);
-    if (PJSUA_INVALID_ID == confPortId) {
+    if (PJSUA_INVALID_ID == pjsua_call_get_conf_port(callId)) {
         errorHandler(tr("Cannot get current call conf port"));
         return false;
     }
-    const QVector<int> confCalls = _activeCallModel->confirmedCallsId();
-    for (auto otherCallId: confCalls) {
-        if (callId == otherCallId) {
-            continue;
-        }
-        const pjsua_conf_port_id otherCallConfPort = pjsua_call_get_conf_port(otherCallId);
-        if (PJSUA_INVALID_ID == otherCallConfPort) {
-            qWarning() << "Cannot get conference slot of call ID" << otherCallId;
-            continue;
-        }
-        auto status = pjsua_conf_connect(confPortId, otherCallConfPort);
+    if (!_mixer) {
+        _mixer = std::make_unique<ConferenceMixer>();
+        const auto status = _mixer->create();
         if (PJ_SUCCESS != status) {
-            errorHandler(tr("Cannot connect current conf slot to other"), status);
+            errorHandler(tr("Cannot create conference mixer"), status);
+            _mixer.reset();
             return false;
         }
-        status = pjsua_conf_connect(otherCallConfPort, confPortId);
+    }
+    //every party joins the single mixer, no call is connected to another
+    QVector<int> confCalls = _activeCallModel->confirmedCallsId();
+    if (!confCalls.contains(callId)) {
+        confCalls.append(callId);
+    }
+    for (auto confCallId: confCalls) {
+        const pjsua_conf_port_id confPort = pjsua_call_get_conf_port(confCallId);
+        if (PJSUA_INVALID_ID == confPort) {
+            qWarning() << "Cannot get conference slot of call ID" << confCallId;
+            continue;
+        }
+        const auto status = _mixer->addCall(confCallId, confPort);
         if (PJ_SUCCESS != status) {
-            errorHandler(tr("Cannot connect other conf slot to current"), status);
+            errorHandler(tr("Cannot add call to conference"), status);
             return false;
         }
     }
-    qDebug() << "Conference call: confirmed calls" << confCalls.size();
+    qDebug() << "Conference call: mixed calls" << _mixer->callCount();
     return true;
 }
 
+void SipClient::leaveConference(pjsua_call_id callId)
+{
+    if (!_mixer || !_mixer->contains(callId)) {
+        return;
+    }
+    _mixer->removeCall(callId);
+    if (1 < _mixer->callCount()) {
+        logMixerStats();
+        return;
+    }
+    //back to a plain call, no mixing delay
+    logMixerStats();
+    for (const auto otherCallId: _mixer->calls()) {
+        _mixer->removeCall(otherCallId);
+        const auto confPort = pjsua_call_get_conf_port(otherCallId);
+        if (PJSUA_INVALID_ID != confPort) {
+            connectCallToSoundDevices(confPort);
+        }
+    }
+    _mixer.reset();
+}
+
+void SipClient::logMixerStats() const
+{
+    const auto stats = _mixer->stats();
+    const double meanUs = (0 < stats.frames) ? stats.totalNs / 1000.0 / stats.frames : 0;
+    qInfo() << "Conference mixer:" << stats.participants << "participants," << stats.frames
+            << "frames, mixing cost per frame (mean, max)" << meanUs << stats.maxNs / 1000.0 << "us";
+}
+
 QString SipClient::formatErrorMessage(const QString &title, pj_status_t status)
 {
     QString fullMsg{title};
@@ -766,13 +1239,10 @@ QString SipClient::formatErrorMessage(const QString &title, pj_status_t status)
 bool SipClient::unregisterAccount()
 {
     if (PJSUA_INVALID_ID != _accId) {
-        auto status = pjsua_acc_del(_accId);
-        if (PJ_SUCCESS != status) {
-            errorHandler("Error removing account", status);
+        if (!deleteAccount(_accId)) {
             return false;
         }
         _accId = PJSUA_INVALID_ID;
-	_serverDomain.clear();
 	emit registrationStatusChanged(RegistrationStatus::Unregistered, tr("Not Registered"));
         qDebug() << "Account unregistered";
     } else {
@@ -791,6 +1261,13 @@ bool SipClient::disableAudio()
     return true;
 }
 
+void SipClient::setFileAudio(const QString &playFile, const QString &recordDir)
+{
+    _fileAudio = std::make_unique<FileAudio>(playFile, recordDir);
+    qInfo() << "File audio: play" << playFile << ", record to" << recordDir;
+    disableAudio();
+}
+
 void SipClient::initAudioDevicesList()
 {
     //refresh device list (needed when device changed notification is received)
@@ -852,33 +1329,26 @@ void SipClient::listAudioCodecs()
 	std::array<pjsua_codec_info, MAX_CODECS> codecInfo;
 	auto codecCount = static_cast<unsigned int>(codecInfo.size());
 
-	//read first default priorities
-	pj_status_t status = pjsua_enum_codecs(codecInfo.data(), &codecCount);
+	//default priorities
+	const pj_status_t status = pjsua_enum_codecs(codecInfo.data(), &codecCount);
 	if (PJ_SUCCESS != status) {
 		errorHandler(tr("Cannot enum audio codecs"), status);
 		return;
 	}
-	QHash<QString,int> defaultPrio;
-	for (unsigned int n = 0; n < codecCount; ++n) {
-		const auto id = toString(codecInfo[n].codec_id);
-		setAudioCodecPriority(id, codecInfo[n].priority);
-		defaultPrio[id] = codecInfo[n].priority;
-	}
 
-	_audioCodecs->init();//init first codecs
+	_audioCodecs->init();//restores the saved priorities into PJSUA
 
-	//get again codecs
-	status = pjsua_enum_codecs(codecInfo.data(), &codecCount);
-	if (PJ_SUCCESS != status) {
-		errorHandler(tr("Cannot enum audio codecs"), status);
-		return;
+	//the saved priorities override the defaults, no need to enumerate again
+	QHash<QString,int> savedPrio;
+	for (const auto &ci: _audioCodecs->codecInfo()) {
+		savedPrio[ci.codecId] = ci.priority;
 	}
 	qInfo() << "Audio codecs:" << codecCount;
 	QList<AudioCodecs::CodecInfo> audioCodecsInfo;
 	for (unsigned int n = 0; n < codecCount; ++n) {
 		const auto id = toString(codecInfo[n].codec_id);
-		const auto priority = codecInfo[n].priority;
-		const auto defaultPriority = defaultPrio.contains(id) ? defaultPrio[id] : -1;
+		const auto defaultPriority = static_cast<int>(codecInfo[n].priority);
+		const auto priority = savedPrio.value(id, defaultPriority);
 		qInfo() << id << priority;
 		audioCodecsInfo.append({ id, id, priority, 0 < priority, defaultPriority });
 	}
@@ -902,11 +1372,22 @@ bool SipClient::setAudioCodecPriority(const QString &codecId, int priority)
 }
 
 #ifdef ENABLE_VIDEO
-void SipClient::initVideoDevicesList()
+void SipClient::initVideo()
 {
-    auto status = pjmedia_vid_dev_refresh();
-    if (PJ_SUCCESS != status) {
-        errorHandler(tr("Cannot refresh video device list"), status);
+    if (_videoInitialized || (PJSUA_STATE_RUNNING != pjsua_get_state())) {
+        return;
+    }
+    _videoInitialized = true;
+    const StartupProfile::Phase phase("video");
+    initVideoDevicesList();
+    listVideoCodecs();
+}
+
+void SipClient::initVideoDevicesList()
+{
+    auto status = pjmedia_vid_dev_refresh();
+    if (PJ_SUCCESS != status) {
+        errorHandler(tr("Cannot refresh video device list"), status);
     }
     const auto dev_count = static_cast<pjmedia_vid_dev_index>(pjmedia_vid_dev_count());
     QVector<VideoDevices::DeviceInfo> videoDevices;
@@ -955,35 +1436,29 @@ void SipClient::listVideoCodecs()
 {
     std::array<pjsua_codec_info, MAX_CODECS> codecInfo;
     unsigned int codecCount = static_cast<unsigned int>(codecInfo.size());
-    auto status = pjsua_vid_enum_codecs(codecInfo.data(), &codecCount);
+    const auto status = pjsua_vid_enum_codecs(codecInfo.data(), &codecCount);
     if (PJ_SUCCESS != status) {
         errorHandler(tr("Cannot enum video codecs"), status);
         return;
     }
-    qInfo() << "Video codecs:" << codecCount;
-    QHash<QString,int> defaultPrio;
     for (unsigned int n = 0; n < codecCount; ++n) {
-        const QString id = QString::fromUtf8(codecInfo[n].codec_id.ptr,
-                                             static_cast<int>(codecInfo[n].codec_id.slen));
-        qInfo() << id << codecInfo[n].priority;
-        defaultPrio[id] = codecInfo[n].priority;
-        setVideoCodecBitrate(id, DEFAULT_BITRATE_KBPS * 1000);
+        setVideoCodecBitrate(toString(codecInfo[n].codec_id), DEFAULT_BITRATE_KBPS * 1000);
     }
 
-    _videoCodecs->init();//init first codecs
+    _videoCodecs->init();//restores the saved priorities into PJSUA
 
-    //get again codecs
-    status = pjsua_vid_enum_codecs(codecInfo.data(), &codecCount);
-    if (PJ_SUCCESS != status) {
-        errorHandler(tr("Cannot enum video codecs"), status);
-        return;
+    //the saved priorities override the defaults, no need to enumerate again
+    QHash<QString,int> savedPrio;
+    for (const auto &ci: _videoCodecs->codecInfo()) {
+        savedPrio[ci.codecId] = ci.priority;
     }
     qInfo() << "Video codecs:" << codecCount;
     QList<VideoCodecs::CodecInfo> videoCodecsInfo;
     for (unsigned int n = 0; n < codecCount; ++n) {
         const auto id = toString(codecInfo[n].codec_id);
-        const auto priority = codecInfo[n].priority;
-        const auto defaultPriority = defaultPrio.contains(id) ? defaultPrio[id] : -1;
+        const auto defaultPriority = static_cast<int>(codecInfo[n].priority);
+        const auto priority = savedPrio.value(id, defaultPriority);
+        qInfo() << id << priority;
         videoCodecsInfo.append({ id, id, priority, false, defaultPriority });
     }
     _videoCodecs->setCodecsInfo(videoCodecsInfo);
@@ -1044,18 +1519,19 @@ QString SipClient::sipTransport(int type)
     return out;
 }
 
-bool SipClient::callUri(pj_str_t *uri, const QString &userId, std::string &uriBuffer)
+bool SipClient::callUri(pj_str_t *uri, const QString &userId, std::string &uriBuffer, pjsua_acc_id accId)
 {
     if (nullptr == uri) {
 	errorHandler(tr("Invalid output"), PJ_SUCCESS);
 	return false;
     }
-    if (_serverDomain.isEmpty()) {
+    const auto *account = findAccount(accId);
+    if ((nullptr == account) || account->serverDomain.isEmpty()) {
 	errorHandler(tr("No SIP server"), PJ_SUCCESS);
         return false;
     }
 
-    const auto sipUri{"sip:" + userId + "@" + _serverDomain};
+    const auto sipUri{"sip:" + userId + "@" + account->serverDomain};
 
     uriBuffer = sipUri.toStdString();
     const char *uriPtr = uriBuffer.c_str();
@@ -1085,6 +1561,10 @@ pjsua_conf_port_id SipClient::callConfPort(pjsua_call_id callId)
 
 bool SipClient::enableAudio()
 {
+    if (_fileAudio) {
+        //no sound devices, the null device clocks the bridge
+        return disableAudio();
+    }
     const auto captureDevInfo = _inputAudioDevices->deviceInfo();
     if (!captureDevInfo.isValid()) {
         const auto msg = QString("Invalid input audio device index %1").arg(captureDevInfo.toString());
@@ -1117,10 +1597,10 @@ void SipClient::hangupAll()
     pjsua_call_hangup_all();
 }
 
-bool SipClient::initRingTonePlayer(pjsua_call_id id, bool incoming)
+bool SipClient::startPlayingRingTone(pjsua_call_id id, bool incoming)
 {
-    if (0 != _playerId.count(id)) {
-        qCritical() << "Call" << id << "already has a player associated with it";
+    if (_ringTones.isRinging(id)) {
+        qCritical() << "Call" << id << "already has a ring tone associated with it";
         return false;
     }
 
@@ -1130,80 +1610,28 @@ bool SipClient::initRingTonePlayer(pjsua_call_id id, bool incoming)
         qWarning() << "Ring tone file does not exist";
         return false;
     }
-    qInfo() << "Init ringtone player" << soundFileStr;
-
-    const auto tmpSoundFile = soundFileStr.toStdString();
-    pj_str_t soundFile{};
-    pj_cstr(&soundFile, tmpSoundFile.c_str());
-
-    pjsua_player_id playerId = PJSUA_INVALID_ID;
-    const auto status = pjsua_player_create(&soundFile, 0, &playerId);
-    if (PJ_SUCCESS != status) {
-        errorHandler("Cannot create player", status);
-        return false;
-    }
-    _playerId[id] = playerId;
-    return true;
-}
 
-bool SipClient::startPlayingRingTone(pjsua_call_id id, bool incoming)
-{
-    if (!initRingTonePlayer(id, incoming)) {
-        qDebug() << "Cannot start playing ringtone for call" << id;
-        return false;
-    }
-    if (0 == _playerId.count(id)) {
-        qCritical() << "Cannot find a player ID for call" << id;
-        return false;
-    }
-    const auto playerId = _playerId.at(id);
-    pj_status_t status = pjsua_conf_connect(pjsua_player_get_conf_port(playerId), 0);
+    //all calls ringing with the same tone share one conference port
+    const auto status = _ringTones.start(id, soundFileStr);
     if (PJ_SUCCESS != status) {
         errorHandler("Cannot play ring tone to output device", status);
         return false;
     }
-    qInfo() << "Start playing ringtone";
+    qInfo() << "Start playing ringtone" << soundFileStr;
     return true;
 }
 
 void SipClient::stopPlayingRingTone(pjsua_call_id id)
 {
-    if (0 == _playerId.count(id)) {
-        //qWarning() << "Cannot find player ID for call" << id;
+    if (!_ringTones.isRinging(id)) {
         return;
     }
-    const auto playerId = _playerId.at(id);
-    auto status = pjsua_conf_disconnect(pjsua_player_get_conf_port(playerId), 0);
+    const auto status = _ringTones.stop(id);
     if (PJ_SUCCESS != status) {
         errorHandler("Cannot stop playing ring tone to output device", status);
         return;
     }
     qInfo() << "Stop playing ringtone";
-    releaseRingTonePlayer(id);
-}
-
-bool SipClient::releaseRingTonePlayer(pjsua_call_id id)
-{
-    if (0 == _playerId.count(id)) {
-        qCritical() << "Cannot find a player ID for call" << id;
-        return false;
-    }
-    const auto playerId = _playerId.at(id);
-    const auto status = pjsua_player_destroy(playerId);
-    if (PJ_SUCCESS != status) {
-        errorHandler("Cannot destroy ringtone player", status);
-        return false;
-    }
-    _playerId.erase(id);
-    qInfo() << "Release ringtone player";
-    return true;
-}
-
-void SipClient::releaseRingTonePlayers()
-{
-    for(const auto &it: _playerId) {
-        releaseRingTonePlayer(it.first);
-    }
 }
 
 bool SipClient::initToneGenerator()
@@ -1211,26 +1639,48 @@ bool SipClient::initToneGenerator()
     if (nullptr != _toneGenPool) {
         return true;//nothing to do
     }
+    //run the generator at the bridge clock rate to avoid resampling its frames
+    pjsua_conf_port_info bridgeInfo{};
+    auto status = pjsua_conf_get_port_info(0, &bridgeInfo);
+    if (PJ_SUCCESS != status) {
+        errorHandler(tr("Cannot get conference bridge info"), status);
+        return false;
+    }
     _toneGenPool = pjsua_pool_create("toneGen", PJSUA_POOL_SIZE, PJSUA_POOL_SIZE);
     if (nullptr == _toneGenPool) {
         errorHandler(tr("Cannot allocate pool for tone generator"));
         return false;
     }
-    enableAudio();
-    auto status = pjmedia_tonegen_create(_toneGenPool, TONE_GEN_CLOCK_RATE_HZ,
-                                         TONE_GEN_CHANNEL_COUNT,
-                                         TONE_GEN_SAMPLES_PER_FRAME,
-                                         TONE_GEN_BITS_PER_SAMPLE, 0, &_toneGenMediaPort);
+    const auto channelCount = (0 < bridgeInfo.channel_count) ? bridgeInfo.channel_count : TONE_GEN_CHANNEL_COUNT;
+    status = pjmedia_tonegen_create(_toneGenPool, bridgeInfo.clock_rate,
+                                    TONE_GEN_CHANNEL_COUNT,
+                                    bridgeInfo.samples_per_frame / channelCount,
+                                    TONE_GEN_BITS_PER_SAMPLE, 0, &_toneGenMediaPort);
     if (PJ_SUCCESS != status) {
         errorHandler(tr("Tone generator create"), status);
+        releaseToneGenerator();
         return false;
     }
-    status = pjsua_conf_add_port(_toneGenPool, _toneGenMediaPort, &_toneGenConfPort);
+    //measures the keypress to tone latency, the plain generator is used without it
+    _toneLatencyPort = ToneLatencyPort::create(_toneGenMediaPort);
+    status = pjsua_conf_add_port(_toneGenPool, (nullptr != _toneLatencyPort) ? _toneLatencyPort : _toneGenMediaPort,
+                                 &_toneGenConfPort);
     if (PJ_SUCCESS != status) {
         errorHandler(tr("Tone generator add port"), status);
+        releaseToneGenerator();
         return false;
     }
-    status = pjsua_conf_adjust_rx_level(_toneGenConfPort, _settings->dialpadSoundVolume());
+    qInfo() << "Init tone generator" << bridgeInfo.clock_rate << "Hz";
+    return true;
+}
+
+bool SipClient::connectToneGenerator()
+{
+    //open audio device only when needed, calls already have it open
+    if (_activeCallModel->isEmpty()) {
+        enableAudio();
+    }
+    auto status = pjsua_conf_adjust_rx_level(_toneGenConfPort, _settings->dialpadSoundVolume());
     if (PJ_SUCCESS != status) {
         errorHandler(tr("Tone generator adjust rx level"), status);
         return false;
@@ -1240,18 +1690,36 @@ bool SipClient::initToneGenerator()
         errorHandler(tr("Tone generator conf connect"), status);
         return false;
     }
-    qInfo() << "Init tone generator";
+    _toneGenConnected = true;
     return true;
 }
 
-void SipClient::releaseToneGenerator()
+void SipClient::disconnectToneGenerator()
 {
+    if (!_toneGenConnected) {
+        return;
+    }
     if ((nullptr != _toneGenMediaPort) && pjmedia_tonegen_is_busy(_toneGenMediaPort)) {
         qDebug() << "Tone gen is busy";
+        _toneGenTimer.start();
         return;
     }
-    if (PJSUA_INVALID_ID != _toneGenConfPort) {
+    const auto status = pjsua_conf_disconnect(_toneGenConfPort, 0);
+    if (PJ_SUCCESS != status) {
+        errorHandler(tr("Tone generator conf disconnect"), status);
+    }
+    _toneGenConnected = false;
+    if (_activeCallModel->isEmpty()) {
         disableAudio();
+    }
+    qDebug() << "Tone generator muted";
+}
+
+void SipClient::releaseToneGenerator()
+{
+    _toneGenTimer.stop();
+    _toneGenConnected = false;
+    if (PJSUA_INVALID_ID != _toneGenConfPort) {
         const auto status = pjsua_conf_remove_port(_toneGenConfPort);
         if (PJ_SUCCESS != status) {
             errorHandler(tr("Tone generator conf remove"), status);
@@ -1259,10 +1727,13 @@ void SipClient::releaseToneGenerator()
         _toneGenConfPort = PJSUA_INVALID_ID;
     }
     if (nullptr != _toneGenMediaPort) {
-        const auto status = pjmedia_port_destroy(_toneGenMediaPort);
+        //the latency port destroys the generator with itself
+        const auto status = pjmedia_port_destroy((nullptr != _toneLatencyPort) ? _toneLatencyPort :
+                                                                                  _toneGenMediaPort);
         if (PJ_SUCCESS != status) {
             errorHandler(tr("Tone generator port destroy"), status);
         }
+        _toneLatencyPort = nullptr;
         _toneGenMediaPort = nullptr;
     }
     if (nullptr != _toneGenPool) {
@@ -1278,8 +1749,7 @@ bool SipClient::createRecorder(pjsua_call_id callId)
         qCritical() << "Invalid call ID";
         return false;
     }
-    if ((0 != _recorderId.count(callId)) &&
-            (PJSUA_INVALID_ID != _recorderId.at(callId))) {
+    if (0 != _recorders.count(callId)) {
         qWarning() << "Recorded already created for call ID " << callId;
         return false;
     }
@@ -1287,18 +1757,16 @@ bool SipClient::createRecorder(pjsua_call_id callId)
     //generate recording file name
     const auto curDateTime = QDateTime::currentDateTime();
     const QString recFileName = _settings->recPath() + "/" +
-            curDateTime.toString("MMMM_dd_yyyy-hh_mm_ss") + ".wav";
-    pj_str_t recordFile{};
-    pj_cstr(&recordFile, recFileName.toUtf8().data());
+            curDateTime.toString("MMMM_dd_yyyy-hh_mm_ss") + ".opus";
 
-    //create recorder
-    pjsua_recorder_id recId = PJSUA_INVALID_ID;
-    const auto status = pjsua_recorder_create(&recordFile, 0, nullptr, 0, 0, &recId);
+    //create recorder, encoding and file writes run on its own thread
+    auto recorder = std::make_unique<CallRecorder>();
+    const auto status = recorder->create(recFileName, _settings->stereoRecording());
     if (PJ_SUCCESS != status) {
         errorHandler(tr("Cannot create recorder"), status);
         return false;
     }
-    _recorderId[callId] = recId;
+    _recorders[callId] = std::move(recorder);
     qDebug() << "Created recorder " << recFileName;
     return true;
 }
@@ -1309,25 +1777,22 @@ bool SipClient::startRecording(pjsua_call_id callId)
         return false;
     }
     //start recording
-    const pjsua_conf_port_id callConfPort = pjsua_call_get_conf_port(callId);
-    if (PJSUA_INVALID_ID == callConfPort) {
-        releaseRecorder(callId);
-        qCritical() << "Cannot get call conf port";
-        return false;
-    }
-    const auto recConfPort = pjsua_recorder_get_conf_port(_recorderId.at(callId));
+    const auto &recorder = _recorders.at(callId);
+    const auto recConfPort = recorder->confPort(recorder->splitChannels() ?
+                                                    CallRecorder::REMOTE : CallRecorder::LOCAL);
     if (PJSUA_INVALID_ID == recConfPort) {
         releaseRecorder(callId);
         errorHandler(tr("Cannot get recorder conf port"));
         return false;
     }
-    const auto status = pjsua_conf_connect(callConfPort, recConfPort);
+    const auto status = tapCall(callId, recConfPort, recorder->splitChannels() ?
+                                    recorder->confPort(CallRecorder::LOCAL) : PJSUA_INVALID_ID);
     if (PJ_SUCCESS != status) {
         releaseRecorder(callId);
         errorHandler(tr("Cannot start recording"), status);
         return false;
     }
-    qDebug() << "Recording started for call ID " << callId;
+    qDebug() << "Recording started for call ID " << callId << (recorder->splitChannels() ? "(stereo)" : "");
     return true;
 }
 
@@ -1337,8 +1802,7 @@ bool SipClient::stopRecording(pjsua_call_id callId)
         qCritical() << "Invalid call ID";
         return false;
     }
-    if ((0 == _recorderId.count(callId)) ||
-            (PJSUA_INVALID_ID == _recorderId.at(callId))) {
+    if (0 == _recorders.count(callId)) {
         qWarning() << "Invalid recorder ID";
         return true;
     }
@@ -1351,7 +1815,9 @@ bool SipClient::stopRecording(pjsua_call_id callId)
             errorHandler(tr("Cannot get call conf port"));
             return false;
         }
-        const auto recConfPort = pjsua_recorder_get_conf_port(_recorderId.at(callId));
+        const auto &recorder = _recorders.at(callId);
+        const auto recConfPort = recorder->confPort(recorder->splitChannels() ?
+                                                        CallRecorder::REMOTE : CallRecorder::LOCAL);
         if (PJSUA_INVALID_ID == recConfPort) {
             releaseRecorder(callId);
             errorHandler(tr("Cannot get recorder conf port"));
@@ -1370,23 +1836,501 @@ bool SipClient::stopRecording(pjsua_call_id callId)
 
 bool SipClient::releaseRecorder(pjsua_call_id callId)
 {
-    if ((0 == _recorderId.count(callId)) ||
-            (PJSUA_INVALID_ID == _recorderId.at(callId))) {
+    const auto it = _recorders.find(callId);
+    if (it == _recorders.end()) {
         qWarning() << "Invalid recorder ID";
         return true;
     }
-    const auto status = pjsua_recorder_destroy(_recorderId.at(callId));
+    //waits for the encoder to drain and flushes the file
+    it->second->release();
+    _recorders.erase(it);
+    qDebug() << "Recorder has been released";
+    return true;
+}
+
+pj_status_t SipClient::tapCall(pjsua_call_id callId, pjsua_conf_port_id remotePort,
+                               pjsua_conf_port_id localPort)
+{
+    const auto callConfPort = pjsua_call_get_conf_port(callId);
+    if (PJSUA_INVALID_ID == callConfPort) {
+        qCritical() << "Cannot get call conf port";
+        return PJ_EINVALIDOP;
+    }
+    auto status = pjsua_conf_connect(callConfPort, remotePort);
+    if ((PJ_SUCCESS == status) && (PJSUA_INVALID_ID != localPort)) {
+        //the microphone is tapped directly from the sound device, before any mixing
+        status = pjsua_conf_connect(0, localPort);
+    }
+    return status;
+}
+
+bool SipClient::startFlightRecorder(pjsua_call_id callId)
+{
+    const auto durationSec = _settings->flightRecorderSeconds();
+    if ((0 >= durationSec) || (0 != _flightRecorders.count(callId))) {
+        return false;
+    }
+    auto recorder = std::make_unique<FlightRecorder>();
+    auto status = recorder->create(durationSec);
+    if (PJ_SUCCESS == status) {
+        status = tapCall(callId, recorder->confPort(FlightRecorder::REMOTE),
+                         recorder->confPort(FlightRecorder::LOCAL));
+    }
     if (PJ_SUCCESS != status) {
-        errorHandler(tr("Cannot destroy recorder"), status);
+        errorHandler(tr("Cannot start flight recorder"), status);
         return false;
     }
-    _recorderId.erase(callId);
-    qDebug() << "Recorder has been released";
+    _flightRecorders[callId] = std::move(recorder);
+    qDebug() << "Flight recorder started for call ID" << callId;
+    return true;
+}
+
+void SipClient::releaseFlightRecorder(pjsua_call_id callId)
+{
+    if (0 == _flightRecorders.erase(callId)) {
+        return;
+    }
+    qDebug() << "Flight recorder released for call ID" << callId;
+}
+
+void SipClient::startRtcpSampling(pjsua_call_id callId)
+{
+    if ((0 > callId) || (PJSUA_MAX_CALLS <= callId)) {
+        return;
+    }
+    _rtcpSampledCalls[static_cast<size_t>(callId)] = true;
+    if (!_rtcpStatsTimer.isActive()) {
+        _rtcpStatsTimer.start();
+    }
+}
+
+void SipClient::stopRtcpSampling(pjsua_call_id callId)
+{
+    if ((0 > callId) || (PJSUA_MAX_CALLS <= callId)) {
+        return;
+    }
+    _rtcpSampledCalls[static_cast<size_t>(callId)] = false;
+    if (std::none_of(_rtcpSampledCalls.cbegin(), _rtcpSampledCalls.cend(), [](bool sampled) { return sampled; })) {
+        _rtcpStatsTimer.stop();
+    }
+}
+
+void SipClient::sampleRtcpStats()
+{
+    for (pjsua_call_id callId = 0; callId < PJSUA_MAX_CALLS; ++callId) {
+        if (!_rtcpSampledCalls[static_cast<size_t>(callId)]) {
+            continue;
+        }
+        pjsua_stream_stat stat{};
+        if (!audioStreamStat(callId, stat)) {
+            continue;
+        }
+        recordRtcpStats(stat.rtcp);
+        const auto it = _flightRecorders.find(callId);
+        if (it != _flightRecorders.end()) {
+            it->second->addRtcpSample(stat.rtcp);
+        }
+    }
+}
+
+void SipClient::recordRtcpStats(const pjmedia_rtcp_stat &stat)
+{
+    static auto &jitter = Metrics::instance().histogram("bcphone_rtcp_jitter_seconds",
+                                                        "Receive jitter of the audio streams, sampled every second");
+    static auto &rtt = Metrics::instance().histogram("bcphone_rtcp_rtt_seconds",
+                                                     "Round-trip time of the audio streams, sampled every second");
+    //microseconds, valid once a report arrived
+    if (0 < stat.rx.jitter.n) {
+        jitter.record(stat.rx.jitter.last);
+    }
+    if (0 < stat.rtt.n) {
+        rtt.record(stat.rtt.last);
+    }
+}
+
+bool SipClient::audioStreamStat(pjsua_call_id callId, pjsua_stream_stat &stat)
+{
+    pjsua_call_info callInfo{};
+    if (PJ_SUCCESS != pjsua_call_get_info(callId, &callInfo)) {
+        return false;
+    }
+    for (unsigned medIdx = 0; medIdx < callInfo.media_cnt; ++medIdx) {
+        if (PJMEDIA_TYPE_AUDIO == callInfo.media[medIdx].type) {
+            return PJ_SUCCESS == pjsua_call_get_stream_stat(callId, medIdx, &stat);
+        }
+    }
+    return false;
+}
+
+bool SipClient::dumpFlightRecorder(int callId)
+{
+    const auto it = _flightRecorders.find(static_cast<pjsua_call_id>(callId));
+    if (it == _flightRecorders.end()) {
+        qWarning() << "No flight recorder for call ID" << callId;
+        return false;
+    }
+    const QString basePath = _settings->recPath() + "/flight_" +
+            QDateTime::currentDateTime().toString("MMMM_dd_yyyy-hh_mm_ss");
+    if (!it->second->dump(basePath)) {
+        errorHandler(tr("Cannot dump flight recorder"));
+        return false;
+    }
+    return true;
+}
+
+void SipClient::updatePacketCapture()
+{
+    auto &capture = PacketCapture::instance();
+    if (_settings->packetCapture()) {
+        if (!capture.start(_settings->recPath() + "/captures", _settings->captureRtp())) {
+            errorHandler(tr("Cannot start packet capture"));
+        }
+    } else {
+        capture.stop();
+    }
+}
+
+void SipClient::updateNetworkImpairment()
+{
+    //the environment wins so benchmarks do not depend on the stored settings
+    auto spec = qEnvironmentVariable("BCPHONE_IMPAIRMENT");
+    if (spec.isEmpty()) {
+        spec = _settings->networkImpairment();
+    }
+    const auto profile = ImpairmentProfile::parse(spec);
+    ImpairmentTransport::setCallProfile(profile);
+    if (profile.isEnabled()) {
+        qInfo() << "Network impairment for new calls" << profile.toString();
+    }
+}
+
+bool SipClient::updateMediaThreads()
+{
+    MediaThreads::Config config;
+    config.audioCpus = MediaThreads::parseCpus(_settings->audioThreadCpus());
+    config.workerCpus = MediaThreads::parseCpus(_settings->workerThreadCpus());
+    config.scheduling = _settings->threadScheduling();
+    MediaThreads::configure(config);
+    return !config.workerCpus.isEmpty() || (MediaThreads::Default != config.scheduling);
+}
+
+int SipClient::sipWorkerThread(void *arg)
+{
+    auto *instance = static_cast<SipClient*>(arg);
+    MediaThreads::tuneCurrentThread(MediaThreads::Role::Worker);
+    //same loop as the pjsua worker threads
+    while (!instance->_sipWorkersQuit.load(std::memory_order_relaxed)) {
+        pjsua_handle_events(SIP_WORKER_POLL_MS);
+    }
+    return 0;
+}
+
+bool SipClient::startSipWorkers(unsigned count)
+{
+    _sipWorkerPool = pjsua_pool_create("sipWorkers", PJSUA_POOL_SIZE, PJSUA_POOL_SIZE);
+    if (nullptr == _sipWorkerPool) {
+        errorHandler(tr("Cannot create SIP worker threads"), PJ_ENOMEM);
+        return false;
+    }
+    _sipWorkersQuit = false;
+    for (unsigned i = 0; i < count; ++i) {
+        pj_thread_t *thread = nullptr;
+        const auto status = pj_thread_create(_sipWorkerPool, "sipWorker%p", &SipClient::sipWorkerThread, this,
+                                             0, 0, &thread);
+        if (PJ_SUCCESS != status) {
+            errorHandler(tr("Cannot create SIP worker threads"), status);
+            stopSipWorkers();
+            return false;
+        }
+        _sipWorkers.push_back(thread);
+    }
+    qInfo() << "Started" << count << "SIP worker threads";
+    return true;
+}
+
+void SipClient::stopSipWorkers()
+{
+    _sipWorkersQuit = true;
+    for (auto *thread: _sipWorkers) {
+        pj_thread_join(thread);
+        pj_thread_destroy(thread);
+    }
+    _sipWorkers.clear();
+    if (nullptr != _sipWorkerPool) {
+        pj_pool_release(_sipWorkerPool);
+        _sipWorkerPool = nullptr;
+    }
+}
+
+void SipClient::logMediaThreads() const
+{
+    const auto reports = MediaThreads::report();
+    for (const auto &report: reports) {
+        qInfo() << "Media thread" << MediaThreads::toString(report);
+    }
+}
+
+bool SipClient::startLatencyProbe(const QString &spec)
+{
+    const auto state = pjsua_get_state();
+    if (PJSUA_STATE_RUNNING != state) {
+        errorHandler(tr("PJSUA library not started (%1)").arg(state));
+        return false;
+    }
+    if (_probeActive || (0 < pjsua_call_get_count())) {
+        errorHandler(tr("Latency probe needs an idle phone"));
+        return false;
+    }
+    if (PJSUA_INVALID_ID == _probeAccId) {
+        const auto transportId = sharedTransport(Settings::SipTransport::Udp);
+        if (PJSUA_INVALID_ID == transportId) {
+            return false;
+        }
+        auto status = pjsua_acc_add_local(transportId, PJ_FALSE, &_probeAccId);
+        if (PJ_SUCCESS != status) {
+            errorHandler(tr("Cannot create latency probe account"), status);
+            return false;
+        }
+        if (nullptr == attachAccount(_probeAccId)) {
+            pjsua_acc_del(_probeAccId);
+            _probeAccId = PJSUA_INVALID_ID;
+            return false;
+        }
+    }
+
+    //priorities are changed per run and restored at the end
+    std::array<pjsua_codec_info, MAX_CODECS> codecs{};
+    unsigned count = codecs.size();
+    _codecPriorities.clear();
+    if (PJ_SUCCESS == pjsua_enum_codecs(codecs.data(), &count)) {
+        for (unsigned i = 0; i < count; ++i) {
+            _codecPriorities.emplace_back(toString(codecs[i].codec_id).toLatin1(), codecs[i].priority);
+        }
+    }
+
+    _probeRuns = LatencyProbeConfig::parseList(spec);
+    qInfo() << "Starting latency probe," << _probeRuns.size() << "run(s)";
+    runNextLatencyProbe();
     return true;
 }
 
+void SipClient::runNextLatencyProbe()
+{
+    _probeActive = false;
+    restoreCodecPriorities();
+    if (_probeRuns.isEmpty()) {
+        if (PJSUA_INVALID_ID != _probeAccId) {
+            deleteAccount(_probeAccId);
+            _probeAccId = PJSUA_INVALID_ID;
+        }
+        qInfo() << "Latency probe finished";
+        emit latencyProbeFinished();
+        return;
+    }
+
+    _probeConfig = _probeRuns.takeFirst();
+    if (!_probeConfig.codec.isEmpty()) {
+        const auto codecId = _probeConfig.codec.toStdString();
+        pj_str_t id = pj_str(const_cast<char*>(codecId.c_str()));
+        const auto status = pjsua_codec_set_priority(&id, PJMEDIA_CODEC_PRIO_HIGHEST);
+        if (PJ_SUCCESS != status) {
+            errorHandler(tr("Cannot select codec %1 for latency probe").arg(_probeConfig.codec), status);
+        }
+    }
+
+    _latencyProbe = std::make_unique<LatencyProbe>();
+    auto status = _latencyProbe->create(_probeConfig.markerCount);
+    if (PJ_SUCCESS != status) {
+        errorHandler(tr("Cannot create latency probe"), status);
+        _latencyProbe.reset();
+        _probeRuns.clear();
+        runNextLatencyProbe();
+        return;
+    }
+
+    pjsua_transport_info transportInfo{};
+    status = pjsua_transport_get_info(_transportIds.at(Settings::SipTransport::Udp), &transportInfo);
+    if (PJ_SUCCESS != status) {
+        errorHandler(tr("Cannot get transport info"), status);
+        _latencyProbe.reset();
+        _probeRuns.clear();
+        runNextLatencyProbe();
+        return;
+    }
+    const auto uri = QString("sip:%1@127.0.0.1:%2").arg(LATENCY_PROBE_USER)
+            .arg(transportInfo.local_name.port).toStdString();
+    pj_str_t uriStr = pj_str(const_cast<char*>(uri.c_str()));
+
+    _probeConnected = false;
+    _probeActive = true;
+    status = pjsua_call_make_call(_probeAccId, &uriStr, nullptr, nullptr, nullptr, &_probeCaller);
+    if (PJ_SUCCESS != status) {
+        errorHandler(tr("Cannot make latency probe call"), status);
+        _probeCaller = PJSUA_INVALID_ID;
+        _latencyProbe.reset();
+        _probeRuns.clear();
+        runNextLatencyProbe();
+        return;
+    }
+    _probeElapsed.start();
+    _probeCpuStartUs = LatencyProbe::processCpuTimeUs();
+    _probeTimer.start();
+    qInfo() << "Latency probe run" << _probeConfig.toString();
+}
+
+void SipClient::connectLatencyProbe()
+{
+    if (!_latencyProbe || _probeConnected) {
+        return;
+    }
+    const auto callerPort = callConfPort(_probeCaller);
+    const auto calleePort = callConfPort(_probeCallee);
+    if ((PJSUA_INVALID_ID == callerPort) || (PJSUA_INVALID_ID == calleePort)) {
+        //wait for the other leg
+        return;
+    }
+    //one direction only: generator -> caller -> network -> callee -> detector
+    auto status = pjsua_conf_connect(_latencyProbe->generatorPort(), callerPort);
+    if (PJ_SUCCESS == status) {
+        status = pjsua_conf_connect(calleePort, _latencyProbe->detectorPort());
+    }
+    if (PJ_SUCCESS != status) {
+        errorHandler(tr("Cannot connect latency probe"), status);
+        finishLatencyProbeRun();
+        return;
+    }
+    _probeConnected = true;
+}
+
+void SipClient::pollLatencyProbe()
+{
+    if (!_latencyProbe) {
+        _probeTimer.stop();
+        return;
+    }
+    const auto timeoutMs = LatencyProbe::durationMs(_probeConfig.markerCount) + 2 * LATENCY_PROBE_POLL_MS;
+    if (_latencyProbe->finished() || (timeoutMs < _probeElapsed.elapsed())) {
+        finishLatencyProbeRun();
+    }
+}
+
+void SipClient::finishLatencyProbeRun()
+{
+    _probeTimer.stop();
+    if (_latencyProbe) {
+        reportLatencyProbe(_latencyProbe->result());
+        _latencyProbe.reset();
+    }
+    //the next run starts when both legs are gone
+    for (const auto callId: {_probeCaller, _probeCallee}) {
+        if (PJSUA_INVALID_ID != callId) {
+            pjsua_call_hangup(callId, 0, nullptr, nullptr);
+        }
+    }
+}
+
+void SipClient::reportLatencyProbe(const LatencyProbe::Result &result)
+{
+    //both legs encode and decode, a real call is one leg
+    const auto elapsedUs = 1000 * std::max<qint64>(1, _probeElapsed.elapsed());
+    const double cpuPerCall = 100.0 * (LatencyProbe::processCpuTimeUs() - _probeCpuStartUs) / elapsedUs / 2;
+    const char *profile = MediaProfile::get(_settings->mediaProfile()).name;
+    qInfo() << "Latency probe" << _probeConfig.toString() << ", media profile" << profile << ": detected"
+            << result.detected << "of" << result.markers << "markers, latency (min, p50, p90, p99, max) ="
+            << result.minMs << result.p50Ms << result.p90Ms << result.p99Ms << result.maxMs
+            << "ms, CPU per call" << cpuPerCall << "%";
+    logMediaThreads();
+
+    const auto &recPath = _settings->recPath();
+    if (recPath.isEmpty()) {
+        return;
+    }
+    QFile file(recPath + "/latency_probe.csv");
+    const bool newFile = !file.exists();
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        qWarning() << "Cannot open" << file.fileName();
+        return;
+    }
+    if (newFile) {
+        file.write("media_profile,config,impairment,markers,detected,min_ms,p50_ms,p90_ms,p99_ms,max_ms,"
+                   "cpu_per_call_pct\n");
+    }
+    const auto impairment = ImpairmentTransport::callProfile();
+    const auto line = QString("%1,\"%2\",\"%3\",%4,%5,%6,%7,%8,%9,%10,%11\n").arg(profile, _probeConfig.toString(),
+            impairment.isEnabled() ? impairment.toString() : QString("none"))
+            .arg(result.markers).arg(result.detected)
+            .arg(result.minMs, 0, 'f', 2).arg(result.p50Ms, 0, 'f', 2).arg(result.p90Ms, 0, 'f', 2)
+            .arg(result.p99Ms, 0, 'f', 2).arg(result.maxMs, 0, 'f', 2).arg(cpuPerCall, 0, 'f', 2);
+    file.write(line.toUtf8());
+}
+
+bool SipClient::startMediaBenchmark(int markerCount)
+{
+    if ((PJSUA_INVALID_ID != _benchmarkRestoreProfile) || _probeActive || (0 < pjsua_call_get_count())) {
+        errorHandler(tr("Media benchmark needs an idle phone"));
+        return false;
+    }
+    //each profile restarts PJSUA, only the default account is registered again
+    const bool extraAccounts = std::any_of(_accounts.cbegin(), _accounts.cend(), [this](const auto &it) {
+        return (_accId != it.first) && (_probeAccId != it.first);
+    });
+    if (extraAccounts) {
+        errorHandler(tr("Media benchmark needs the additional accounts to be removed"));
+        return false;
+    }
+    _benchmarkRestoreProfile = _settings->mediaProfile();
+    _benchmarkMarkers = markerCount;
+    _benchmarkProfiles.clear();
+    for (int id = 0; id < MediaProfile::PROFILE_COUNT; ++id) {
+        _benchmarkProfiles.append(id);
+    }
+    qInfo() << "Starting media benchmark," << _benchmarkProfiles.size() << "profiles";
+    runNextBenchmarkProfile();
+    return true;
+}
+
+void SipClient::runNextBenchmarkProfile()
+{
+    const bool done = _benchmarkProfiles.isEmpty();
+    _settings->setMediaProfile(done ? _benchmarkRestoreProfile : _benchmarkProfiles.takeFirst());
+    if (done) {
+        _benchmarkRestoreProfile = PJSUA_INVALID_ID;
+    }
+
+    //the media configuration is only read by pjsua_init()
+    release();
+    if (!init()) {
+        if (!done) {
+            _settings->setMediaProfile(_benchmarkRestoreProfile);
+        }
+        _benchmarkProfiles.clear();
+        _benchmarkRestoreProfile = PJSUA_INVALID_ID;
+        return;
+    }
+    if (done) {
+        qInfo() << "Media benchmark finished";
+        if (_settings->canRegister()) {
+            registerAccount();
+        }
+        return;
+    }
+    if (!startLatencyProbe(QString("count=%1").arg(_benchmarkMarkers))) {
+        _benchmarkProfiles.clear();
+        runNextBenchmarkProfile();
+    }
+}
+
+void SipClient::restoreCodecPriorities()
+{
+    for (const auto &codec: _codecPriorities) {
+        pj_str_t id = pj_str(const_cast<char*>(codec.first.constData()));
+        pjsua_codec_set_priority(&id, codec.second);
+    }
+}
+
 void SipClient::processRegistrationStatus(pjsua_acc_info accInfo)
 {
+    const EventLoopWatchdog::Scope scope(Q_FUNC_INFO);
     auto registrationStatus{RegistrationStatus::Unregistered};
     switch (accInfo.status) {
     case PJSIP_SC_OK:
@@ -1407,15 +2351,52 @@ void SipClient::processRegistrationStatus(pjsua_acc_info accInfo)
     default:;
     }
     const auto statusText = SipClient::toString(accInfo.status_text) + QString(" (%1)").arg(accInfo.status);
-    qDebug() << "Reg status" << statusText;
-    emit registrationStatusChanged(registrationStatus, statusText);
+    qDebug() << "Reg status" << accInfo.id << statusText;
+    static auto &registrations = Metrics::instance().counter("bcphone_registrations_total",
+                                                             "Registration attempts", "result=\"success\"");
+    static auto &failedRegistrations = Metrics::instance().counter("bcphone_registrations_total",
+                                                                   "Registration attempts", "result=\"failure\"");
+    static auto &registeredAccounts = Metrics::instance().gauge("bcphone_registered_accounts",
+                                                                "Accounts currently registered");
+    if (2 == accInfo.status / 100) {
+        registrations.add();
+    } else if (PJSIP_SC_MULTIPLE_CHOICES <= accInfo.status) {
+        failedRegistrations.add();
+    }
+    auto *account = findAccount(accInfo.id);
+    if (nullptr == account) {
+        //removed in the meantime
+        return;
+    }
+    account->status = registrationStatus;
+    account->statusText = statusText;
+    registeredAccounts.set(std::count_if(_accounts.cbegin(), _accounts.cend(), [](const auto &it) {
+        return RegistrationStatus::Registered == it.second->status;
+    }));
+    emit accountRegistrationChanged(accInfo.id, registrationStatus, statusText);
+    if (_accId == accInfo.id) {
+        emit registrationStatusChanged(registrationStatus, statusText);
+    }
 }
 
 void SipClient::processIncomingCall(pjsua_call_id callId, pjsua_call_info callInfo)
 {
+    const EventLoopWatchdog::Scope scope(Q_FUNC_INFO);
     QString remoteInfo = toString(callInfo.remote_info);
-    qDebug() << "Incoming call from" << remoteInfo;
+    qDebug() << "Incoming call from" << remoteInfo << "on account ID" << callInfo.acc_id;
+    _callAccounts[static_cast<size_t>(callId)] = callInfo.acc_id;
+
+    if (_probeActive && toString(callInfo.local_info).contains(LATENCY_PROBE_USER)) {
+        //loopback leg of the latency probe, never shown to the user
+        _probeCallee = callId;
+        const auto status = pjsua_call_answer(callId, PJSIP_SC_OK, nullptr, nullptr);
+        if (PJ_SUCCESS != status) {
+            errorHandler(tr("Cannot answer latency probe call"), status);
+        }
+        return;
+    }
 
+    callCounter(false).add();
     answer(callId, PJSIP_SC_RINGING);
 
     QString userName;
@@ -1426,10 +2407,43 @@ void SipClient::processIncomingCall(pjsua_call_id callId, pjsua_call_info callIn
 
 void SipClient::processCallState(pjsua_call_id callId, pjsua_call_info callInfo)
 {
+    const EventLoopWatchdog::Scope scope(Q_FUNC_INFO);
     const QString stateText = toString(callInfo.state_text);
     const QString lastStatusText = toString(callInfo.last_status_text);
     qDebug() << "Call" << callId << ", state =" << stateText << "(" << callInfo.last_status << ")"
              << lastStatusText;
+    _callAccounts[static_cast<size_t>(callId)] = callInfo.acc_id;
+
+    if (isLatencyProbeCall(callId)) {
+        if (PJSIP_INV_STATE_DISCONNECTED == callInfo.state) {
+            (_probeCaller == callId ? _probeCaller : _probeCallee) = PJSUA_INVALID_ID;
+            if (_latencyProbe) {
+                //the call ended before the run completed
+                finishLatencyProbeRun();
+            }
+            if ((PJSUA_INVALID_ID == _probeCaller) && (PJSUA_INVALID_ID == _probeCallee)) {
+                runNextLatencyProbe();
+            }
+        }
+        return;
+    }
+
+    if (_campaignCalls[static_cast<size_t>(callId)]) {
+        //never shown to the user, the campaign keeps its own results
+        if (PJSIP_INV_STATE_CONFIRMED == callInfo.state) {
+            //audio is connected once the media is active
+            startRtcpSampling(callId);
+            emit campaignCallConfirmed(callId);
+        } else if (PJSIP_INV_STATE_DISCONNECTED == callInfo.state) {
+            _campaignCalls[static_cast<size_t>(callId)] = false;
+            stopRtcpSampling(callId);
+            if (_fileAudio) {
+                _fileAudio->releaseCall(callId);
+            }
+            emit campaignCallEnded(callId, callInfo.last_status);
+        }
+        return;
+    }
 
     if ((PJSIP_SC_BAD_REQUEST <= callInfo.last_status) &&
 	    (PJSIP_SC_REQUEST_TERMINATED != callInfo.last_status) &&
@@ -1456,10 +2470,19 @@ void SipClient::processCallState(pjsua_call_id callId, pjsua_call_info callInfo)
     case PJSIP_INV_STATE_CONNECTING:
         break;
     case PJSIP_INV_STATE_CONFIRMED:
-	connectCallToSoundDevices(callInfo.conf_slot);
+	connectCallAudio(callId, callInfo.conf_slot);
+        startRtcpSampling(callId);
+        startFlightRecorder(callId);
         emit confirmed(callId);
         break;
     case PJSIP_INV_STATE_DISCONNECTED:
+        leaveConference(callId);
+        if (_fileAudio) {
+            _fileAudio->releaseCall(callId);
+        }
+        stopRtcpSampling(callId);
+        releaseFlightRecorder(callId);
+        logMediaThreads();
         emit disconnected(callId);
         break;
     default:
@@ -1469,8 +2492,25 @@ void SipClient::processCallState(pjsua_call_id callId, pjsua_call_info callInfo)
 
 void SipClient::processCallMediaState(pjsua_call_id callId, pjsua_call_info callInfo)
 {
+    const EventLoopWatchdog::Scope scope(Q_FUNC_INFO);
     qDebug() << "Media state changed for call" << callId << ":" << SipClient::toString(callInfo.last_status_text)
 	     << callInfo.last_status;
+    if (isLatencyProbeCall(callId)) {
+        if (PJSUA_CALL_MEDIA_ACTIVE == callInfo.media_status) {
+            connectLatencyProbe();
+        }
+        return;
+    }
+    if (_campaignCalls[static_cast<size_t>(callId)]) {
+        //nobody listens to the campaign calls, never mixed into the sound devices
+        if (_fileAudio && (PJSUA_CALL_MEDIA_ACTIVE == callInfo.media_status)) {
+            const auto status = _fileAudio->connectCall(callId, callInfo.conf_slot);
+            if (PJ_SUCCESS != status) {
+                errorHandler(tr("Cannot connect call to audio files"), status);
+            }
+        }
+        return;
+    }
     if (PJSUA_CALL_MEDIA_ACTIVE == callInfo.media_status) {
 	qInfo() << "Media active" << callInfo.media_cnt;
 	bool hasVideo{};
@@ -1481,7 +2521,7 @@ void SipClient::processCallMediaState(pjsua_call_id callId, pjsua_call_info call
                 if (PJ_SUCCESS == status) {
                     if (PJMEDIA_TYPE_AUDIO == streamInfo.type) {
                         GET_INSTANCE_CID(callId)
-			instance->connectCallToSoundDevices(callInfo.conf_slot);
+			instance->connectCallAudio(callId, callInfo.conf_slot);
                         const auto &fmt = streamInfo.info.aud.fmt;
                         qInfo() << "Audio codec info: encoding" << toString(fmt.encoding_name)
                                 << ", clock rate" << fmt.clock_rate << "Hz, channel count"
@@ -1505,8 +2545,17 @@ void SipClient::processCallMediaState(pjsua_call_id callId, pjsua_call_info call
 #endif
     } else if ((PJSUA_CALL_MEDIA_LOCAL_HOLD != callInfo.media_status) &&
 	       (PJSUA_CALL_MEDIA_REMOTE_HOLD != callInfo.media_status)) {
-        qWarning() << "Connection lost";
-        emit registrationStatusChanged(RegistrationStatus::Unregistered, tr("Connection lost"));
+        qWarning() << "Connection lost on account ID" << callInfo.acc_id;
+        auto *account = findAccount(callInfo.acc_id);
+        if ((nullptr != account) && (account->id == callInfo.acc_id) && !account->serverDomain.isEmpty()) {
+            //only the account of the call is affected
+            account->status = RegistrationStatus::Unregistered;
+            account->statusText = tr("Connection lost");
+            emit accountRegistrationChanged(account->id, account->status, account->statusText);
+            if (_accId == account->id) {
+                emit registrationStatusChanged(account->status, account->statusText);
+            }
+        }
         emit errorMessage(tr("You need an active Internet connection to make calls."));
     }
 }
@@ -1523,12 +2572,28 @@ void SipClient::dumpStreamStats(pjmedia_rtcp_stat stat)
     };
     showStreamStat("RX stat:", stat.rx);
     showStreamStat("TX stat:", stat.tx);
+    static auto &receivedPackets = Metrics::instance().counter("bcphone_rtp_received_packets_total",
+                                                               "RTP packets received by the ended streams");
+    static auto &lostPackets = Metrics::instance().counter("bcphone_rtp_lost_packets_total",
+                                                           "RTP packets lost by the ended streams");
+    receivedPackets.add(stat.rx.pkt);
+    lostPackets.add(stat.rx.loss);
     qInfo() << "RTT (min, mean, max) =" << stat.rtt.min << stat.rtt.mean
             << stat.rtt.max << "ms";
 }
 
+void SipClient::processPager(pjsua_acc_id accId, const QString &from, const QString &text)
+{
+    if (nullptr == findAccount(accId)) {
+        //removed in the meantime
+        return;
+    }
+    emit messageReceived(accId, from, text);
+}
+
 void SipClient::processBuddyState(pjsua_buddy_id buddyId)
 {
+    const EventLoopWatchdog::Scope scope(Q_FUNC_INFO);
     pjsua_buddy_info info{};
     const auto status = pjsua_buddy_get_info(buddyId, &info);
     if (PJ_SUCCESS != status) {
@@ -1581,14 +2646,33 @@ void SipClient::extractUserNameAndId(QString& userName, QString& userId, const Q
     }
 }
 
+void SipClient::connectCallAudio(pjsua_call_id callId, pjsua_conf_port_id confPortId)
+{
+    //ajust volume level
+    setMicrophoneVolume(callId);
+    setSpeakersVolume(callId);
+
+    if (_mixer && _mixer->contains(callId)) {
+        const auto status = _mixer->attachCall(callId, confPortId);
+        if (PJ_SUCCESS != status) {
+            errorHandler(tr("Cannot connect call to conference"), status);
+        }
+        return;
+    }
+    if (_fileAudio) {
+        const auto status = _fileAudio->connectCall(callId, confPortId);
+        if (PJ_SUCCESS != status) {
+            errorHandler(tr("Cannot connect call to audio files"), status);
+        }
+        return;
+    }
+    connectCallToSoundDevices(confPortId);
+}
+
 void SipClient::connectCallToSoundDevices(pjsua_conf_port_id confPortId)
 {
     qDebug() << "Connect call conf port" << confPortId << "to sound devices";
 
-    //ajust volume level
-    setMicrophoneVolume(confPortId);
-    setSpeakersVolume(confPortId);
-
     auto status{pjsua_conf_connect(confPortId, 0)};
     if (PJ_SUCCESS != status) {
         errorHandler("Cannot connect conf slot to playback slot", status);
@@ -1602,37 +2686,31 @@ void SipClient::connectCallToSoundDevices(pjsua_conf_port_id confPortId)
 
 bool SipClient::setMicrophoneVolume(pjsua_call_id callId, bool mute)
 {
-    const auto confSlot = SipClient::callConfPort(callId);
-    if (PJSUA_INVALID_ID == confSlot) {
+    const auto *volume = callVolume(callId);
+    if (nullptr == volume) {
+        qDebug() << "No active call";
         return false;
     }
 
-    //microphone volume
+    //microphone volume, applied by the call volume port from the next frame
     const float microphoneLevel = mute ? 0.0 : _settings->microphoneVolume();
     qInfo() << "Mic level" << microphoneLevel;
-    const auto status = pjsua_conf_adjust_tx_level(confSlot, microphoneLevel);
-    if (PJ_SUCCESS != status) {
-	errorHandler("Cannot adjust tx level", status);
-        return false;
-    }
+    _callVolumes[static_cast<size_t>(callId)].microphoneGain.store(microphoneLevel, std::memory_order_relaxed);
     return true;
 }
 
 bool SipClient::setSpeakersVolume(pjsua_call_id callId, bool mute)
 {
-    const auto confSlot = SipClient::callConfPort(callId);
-    if (PJSUA_INVALID_ID == confSlot) {
+    const auto *volume = callVolume(callId);
+    if (nullptr == volume) {
+        qDebug() << "No active call";
         return false;
     }
 
     //speakers volume
     const float speakersLevel = mute ? 0.0 : _settings->speakersVolume();
     qInfo() << "Speakers level" << speakersLevel;
-    const pj_status_t status = pjsua_conf_adjust_rx_level(confSlot, speakersLevel);
-    if (PJ_SUCCESS != status) {
-	errorHandler("Cannot adjust rx level", status);
-        return false;
-    }
+    _callVolumes[static_cast<size_t>(callId)].speakersGain.store(speakersLevel, std::memory_order_relaxed);
     return true;
 }
 
@@ -1804,7 +2882,7 @@ void SipClient::setVideoWindowSize(pj_bool_t isNative, pjsua_vid_win_id wid, int
 }
 #endif
 
-int SipClient::addBuddy(const QString &userId)
+int SipClient::addBuddy(const QString &userId, pjsua_acc_id accId)
 {
     if (PJSUA_MAX_BUDDIES <= pjsua_get_buddy_count()) {
         errorHandler(tr("Maximum number of buddies exceeded"));
@@ -1812,30 +2890,28 @@ int SipClient::addBuddy(const QString &userId)
     }
     pjsua_buddy_config buddyCfg{};
     pjsua_buddy_config_default(&buddyCfg);
+    auto *account = findAccount(accId);
     std::string uriBuffer;
-    const bool rc = callUri(&buddyCfg.uri, userId, uriBuffer);
+    const bool rc = callUri(&buddyCfg.uri, userId, uriBuffer, accId);
     if (!rc) {
         errorHandler(tr("Cannot buddy URI"));
         return PJSUA_INVALID_ID;
     }
     pjsua_buddy_id buddyId = PJSUA_INVALID_ID;
     buddyCfg.subscribe = PJ_TRUE;
-    buddyCfg.user_data = nullptr;
+    //the owning account, the URI is in its domain so PJSUA subscribes from it
+    buddyCfg.user_data = account;
     auto status = pjsua_buddy_add(&buddyCfg, &buddyId);
     if (PJ_SUCCESS != status) {
         errorHandler(tr("Cannot add buddy"), status);
         return PJSUA_INVALID_ID;
     }
-    status = pjsua_buddy_set_user_data(buddyId, this);
-    if (PJ_SUCCESS != status) {
-        errorHandler(tr("Cannot set buddy user data"), status);
-    }
-    //must update the presence after setting the user data
+    account->buddies.insert(buddyId);
     status = pjsua_buddy_update_pres(buddyId);
     if (PJ_SUCCESS != status) {
 	errorHandler(tr("Cannot update buddy presence"), status);
     }
-    qDebug() << "Added buddy" << userId << buddyId;
+    qDebug() << "Added buddy" << userId << buddyId << "on account ID" << account->id;
     return buddyId;
 }
 
@@ -1846,13 +2922,17 @@ bool SipClient::removeBuddy(int buddyId)
         errorHandler(tr("Cannot del buddy"), status);
         return false;
     }
+    for (auto &it : _accounts) {
+        it.second->buddies.erase(buddyId);
+    }
     return true;
 }
 
-bool SipClient::sendText(const QString& userId, const QString& txt)
+bool SipClient::sendText(const QString& userId, const QString& txt, pjsua_acc_id accId)
 {
-	qDebug() << "sendText" << userId;
-	if (PJSUA_INVALID_ID == _accId) {
+	qDebug() << "sendText" << userId << accId;
+	const auto *account = findAccount(accId);
+	if (nullptr == account) {
 		errorHandler(tr("No registered account"), PJ_SUCCESS);
 		return false;
 	}
@@ -1867,25 +2947,27 @@ bool SipClient::sendText(const QString& userId, const QString& txt)
 
 	std::string uriBuffer;
 	pj_str_t uriStr{};
-	if (!callUri(&uriStr, userId, uriBuffer)) {
+	if (!callUri(&uriStr, userId, uriBuffer, account->id)) {
 		return false;
 	}
 
 	const auto msg{txt.toStdString()};
 	pj_str_t content{};
 	pj_cstr(&content, msg.c_str());
-	const auto status{pjsua_im_send(_accId, &uriStr, nullptr, &content, nullptr, &_accId)};
+	const auto status{pjsua_im_send(account->id, &uriStr, nullptr, &content, nullptr, nullptr)};
 	if (PJ_SUCCESS != status) {
 		errorHandler("Cannot send text", status);
+		messageCounter(false).add();
 		return false;
 	}
 	return true;
 }
 
-bool SipClient::sendTyping(const QString& userId, bool isTyping)
+bool SipClient::sendTyping(const QString& userId, bool isTyping, pjsua_acc_id accId)
 {
 	qDebug() << "sendTyping" << userId << isTyping;
-	if (PJSUA_INVALID_ID == _accId) {
+	const auto *account = findAccount(accId);
+	if (nullptr == account) {
 		qCritical() << "No registered account";
 		return false;
 	}
@@ -1896,10 +2978,10 @@ bool SipClient::sendTyping(const QString& userId, bool isTyping)
 
 	std::string uriBuffer;
 	pj_str_t uriStr{};
-	if (!callUri(&uriStr, userId, uriBuffer)) {
+	if (!callUri(&uriStr, userId, uriBuffer, account->id)) {
 		return false;
 	}
-	const auto status{pjsua_im_typing(_accId, &uriStr, isTyping ? PJ_TRUE : PJ_FALSE, nullptr)};
+	const auto status{pjsua_im_typing(account->id, &uriStr, isTyping ? PJ_TRUE : PJ_FALSE, nullptr)};
 	if (PJ_SUCCESS != status) {
 		errorHandler("Cannot send typing", status);
 		return false;
@@ -1,8 +1,20 @@
 #pragma once
 
 #include "pjsua.h"
+#include "ring_tone_service.h"
+#include "call_recorder.h"
+#include "flight_recorder.h"
+#include "latency_probe.h"
+#include "conference_mixer.h"
+#include "call_volume_port.h"
+#include "file_audio.h"
+#include "sip_account.h"
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QPointer>
+#include <array>
+#include <atomic>
+#include <set>
 #include <unordered_map>
 
 class Softphone;
@@ -30,11 +42,28 @@ public:
     bool init();
     void release();
 
+    //the default account, from the settings
     bool registerAccount();
     void manuallyRegister();
     bool unregisterAccount();
+    pjsua_acc_id defaultAccount() const { return _accId; }
+
+    //further accounts served by the same engine, each on its own SIP transport
+    pjsua_acc_id addAccount(const SipAccountConfig &config);
+    bool removeAccount(pjsua_acc_id accId);
+    QList<pjsua_acc_id> accountIds() const;
+    //configuration and registration state, empty for an unknown account
+    QVariantMap accountInfo(pjsua_acc_id accId) const;
+    //account of a current or just disconnected call
+    pjsua_acc_id callAccount(pjsua_call_id callId) const {
+        return ((0 <= callId) && (PJSUA_MAX_CALLS > callId)) ? _callAccounts[static_cast<size_t>(callId)] : PJSUA_INVALID_ID;
+    }
 
-    bool makeCall(const QString &userId);
+    //an invalid account ID selects the default account
+    bool makeCall(const QString &userId, pjsua_acc_id accId = PJSUA_INVALID_ID);
+    //automated calls of a Campaign: no models, no ring tone, reported by the campaign signals
+    //temporary is set when the number can be dialed again later: no free call, account not registered
+    pjsua_call_id makeCampaignCall(const QString &userId, pjsua_acc_id accId, bool &temporary);
     bool sendDtmf(const QString &dtmf);
 
     bool answer(int callId, int statusCode = PJSIP_SC_OK);
@@ -57,38 +86,65 @@ public:
         return start ? startRecording(cid) : stopRecording(cid);
     }
 
+    bool dumpFlightRecorder(int callId);
+    //RTCP statistics of the audio stream of the call
+    static bool audioStreamStat(pjsua_call_id callId, pjsua_stream_stat &stat);
+
+    //runs are separated by ';', see LatencyProbeConfig
+    bool startLatencyProbe(const QString &spec);
+    //restarts PJSUA with each media profile and runs the latency probe
+    bool startMediaBenchmark(int markerCount);
+
     bool setupConferenceCall(pjsua_call_id callId);
 
     bool enableAudio();
     bool disableAudio();
+    //headless engines, see FileAudio
+    void setFileAudio(const QString &playFile, const QString &recordDir);
     bool setAudioCodecPriority(const QString &codecId, int priority);
     void initAudioDevicesList();
 
     bool setMicrophoneVolume(pjsua_call_id callId, bool mute = false);
     bool setSpeakersVolume(pjsua_call_id callId, bool mute = false);
+    //gains and meters of the call, null for an invalid call ID
+    const CallVolume* callVolume(pjsua_call_id callId) const {
+        return ((0 <= callId) && (PJSUA_MAX_CALLS > callId)) ? &_callVolumes[static_cast<size_t>(callId)] : nullptr;
+    }
 
     bool startPlayingRingTone(pjsua_call_id id, bool incoming);
     void stopPlayingRingTone(pjsua_call_id id);
 
+    //feeds the bcphone_rtcp_jitter_seconds and bcphone_rtcp_rtt_seconds histograms, any thread
+    static void recordRtcpStats(const pjmedia_rtcp_stat &stat);
+
 #ifdef ENABLE_VIDEO
     bool setVideoCodecPriority(const QString &codecId, int priority);
     void releaseVideoWindow();
+    //lists the video devices and codecs once, off the startup path
+    void initVideo();
 #endif
 
-    int addBuddy(const QString &userId);
+    int addBuddy(const QString &userId, pjsua_acc_id accId = PJSUA_INVALID_ID);
     bool removeBuddy(int buddyId);
 
-    bool sendText(const QString& userId, const QString& txt);
-    bool sendTyping(const QString& userId, bool isTyping);
+    bool sendText(const QString& userId, const QString& txt, pjsua_acc_id accId = PJSUA_INVALID_ID);
+    bool sendTyping(const QString& userId, bool isTyping, pjsua_acc_id accId = PJSUA_INVALID_ID);
 
 signals:
     void errorMessage(const QString& msg);
+    //default account only
     void registrationStatusChanged(RegistrationStatus registrationStatus, const QString& registrationStatusText);
+    void accountRegistrationChanged(int accId, RegistrationStatus registrationStatus,
+                                    const QString& registrationStatusText);
+    void messageReceived(int accId, const QString& from, const QString& text);
     void incoming(int callId, const QString& userName, const QString& userId);
     void calling(int callId, const QString& userName, const QString& userId);
     void confirmed(int callId);
     void disconnected(int callId);
     void buddyStatusChanged(int buddyId, const QString& status);
+    //calls placed by makeCampaignCall, the status code is the last SIP response
+    void campaignCallConfirmed(int callId);
+    void campaignCallEnded(int callId, int statusCode);
     // private signals
     void registrationStatusReady(pjsua_acc_info accInfo);
     void incomingCallReady(pjsua_call_id callId, pjsua_call_info callInfo);
@@ -96,6 +152,8 @@ signals:
     void callMediaStateReady(pjsua_call_id callId, pjsua_call_info callInfo);
     void streamStatsReady(pjmedia_rtcp_stat stat);
     void buddyStateReady(pjsua_buddy_id buddyId);
+    void pagerReady(pjsua_acc_id accId, const QString& from, const QString& text);
+    void latencyProbeFinished();
 
 private:
     SipClient(QObject *parent);
@@ -104,23 +162,29 @@ private:
     enum { MAX_CODECS = 32, MAX_PRIORITY = 255, DEFAULT_BITRATE_KBPS = 256,
 	   DEFAULT_LOG_LEVEL = 6, DEFAULT_CONSOLE_LOG_LEVEL = 6,
            MAX_ERROR_MSG_SIZE = 1024, SIP_URI_SIZE = 900,
-           PJSUA_POOL_SIZE = 512, TONE_GEN_CLOCK_RATE_HZ = 8000,
-           TONE_GEN_CHANNEL_COUNT = 1, TONE_GEN_SAMPLES_PER_FRAME = 64,
-           TONE_GEN_BITS_PER_SAMPLE = 16,
-           TONE_GEN_ON_MS = 160, TONE_GEN_OFF_MS = 50, TONE_GEN_TIMEOUT_MS = 5000 };
+           PJSUA_POOL_SIZE = 512,
+           TONE_GEN_CHANNEL_COUNT = 1, TONE_GEN_BITS_PER_SAMPLE = 16,
+           TONE_GEN_ON_MS = 160, TONE_GEN_OFF_MS = 50, TONE_GEN_TIMEOUT_MS = 5000,
+           RTCP_STATS_MS = 1000, LATENCY_PROBE_POLL_MS = 500,
+           SIP_WORKER_POLL_MS = 10 };
+    static constexpr char LATENCY_PROBE_USER[] = "latency-probe";
 
     static void onRegState(pjsua_acc_id accId);
     static void onIncomingCall(pjsua_acc_id accId, pjsua_call_id callId, pjsip_rx_data *rdata);
     static void onCallState(pjsua_call_id callId, pjsip_event *e);
+    static void onCallTsxState(pjsua_call_id callId, pjsip_transaction *tsx, pjsip_event *e);
     static void onCallMediaState(pjsua_call_id callId);
-    static void onStreamCreated(pjsua_call_id callId, pjmedia_stream *strm,
-                                unsigned streamIdx, pjmedia_port **pPort);
+    static void onStreamCreated(pjsua_call_id callId, pjsua_on_stream_created_param *param);
     static void onStreamDestroyed(pjsua_call_id callId, pjmedia_stream *strm,
                                   unsigned streamIdx);
     static void onBuddyState(pjsua_buddy_id buddyId);
+    static pjmedia_transport* onCreateMediaTransport(pjsua_call_id callId, unsigned mediaIdx,
+                                                     pjmedia_transport *baseTp, unsigned flags);
+    static void onStreamPrecreate(pjsua_call_id callId, pjsua_on_stream_precreate_param *param);
 
     static void onPager(pjsua_call_id callId, const pj_str_t *from, const pj_str_t *to,
-			const pj_str_t *contact, const pj_str_t *mimeType, const pj_str_t *body);
+			const pj_str_t *contact, const pj_str_t *mimeType, const pj_str_t *body,
+			pjsip_rx_data *rdata, pjsua_acc_id accId);
     static void onPagerStatus(pjsua_call_id callId, const pj_str_t *to, const pj_str_t *body,
 			void *user_data, pjsip_status_code status, const pj_str_t *reason);
     static void onTyping(pjsua_call_id callId, const pj_str_t *from, const pj_str_t *to,
@@ -128,7 +192,30 @@ private:
 
     static void pjsuaLogCallback(int level, const char *data, int len);
 
-    bool callUri(pj_str_t *uri, const QString &userId, std::string &uriBuffer);
+    //the user data of each PJSUA account, resolves the client and the account in callbacks
+    struct Account {
+        SipClient *client = nullptr;
+        pjsua_acc_id id = PJSUA_INVALID_ID;
+        pjsua_transport_id transportId = PJSUA_INVALID_ID;//own transport, closed with the account
+        QString serverDomain;//empty for local accounts
+        SipAccountConfig config;
+        RegistrationStatus status = RegistrationStatus::Unregistered;
+        QString statusText;
+        std::set<pjsua_buddy_id> buddies;//deleted with the account
+    };
+    //an invalid account ID selects the default account
+    Account* findAccount(pjsua_acc_id accId) const;
+    Account* attachAccount(pjsua_acc_id accId);
+    pjsua_acc_id createAccount(const SipAccountConfig &config, bool ownTransport);
+    //created on first use, shared by the accounts without their own transport
+    pjsua_transport_id sharedTransport(int sipTransport);
+    bool deleteAccount(pjsua_acc_id accId);
+    void processPager(pjsua_acc_id accId, const QString &from, const QString &text);
+
+    pjsua_call_id placeCall(const QString &userId, pjsua_acc_id accId, bool campaign,
+                            pj_status_t *makeCallStatus = nullptr);
+    bool callUri(pj_str_t *uri, const QString &userId, std::string &uriBuffer,
+                 pjsua_acc_id accId = PJSUA_INVALID_ID);
     void processRegistrationStatus(pjsua_acc_info accInfo);
     void processIncomingCall(pjsua_call_id callId, pjsua_call_info callInfo);
     void processCallState(pjsua_call_id callId, pjsua_call_info callInfo);
@@ -166,19 +253,50 @@ private:
 
     static pjsua_conf_port_id callConfPort(pjsua_call_id callId);
 
-    bool initRingTonePlayer(pjsua_call_id id, bool incoming);
-    bool releaseRingTonePlayer(pjsua_call_id id);
-    void releaseRingTonePlayers();
-
     bool initToneGenerator();
+    bool connectToneGenerator();
+    void disconnectToneGenerator();
     void releaseToneGenerator();
 
     bool createRecorder(pjsua_call_id callId);
     bool startRecording(pjsua_call_id callId);
     bool stopRecording(pjsua_call_id callId);
     bool releaseRecorder(pjsua_call_id callId);
+    pj_status_t tapCall(pjsua_call_id callId, pjsua_conf_port_id remotePort,
+                        pjsua_conf_port_id localPort);
+
+    bool startFlightRecorder(pjsua_call_id callId);
+    void releaseFlightRecorder(pjsua_call_id callId);
+    //confirmed calls, flight recorder or not
+    void startRtcpSampling(pjsua_call_id callId);
+    void stopRtcpSampling(pjsua_call_id callId);
+    void sampleRtcpStats();
+
+    void updatePacketCapture();
+    void updateNetworkImpairment();
+    //true when the SIP worker threads need tuning
+    bool updateMediaThreads();
+    static int sipWorkerThread(void *arg);
+    bool startSipWorkers(unsigned count);
+    void stopSipWorkers();
+    void logMediaThreads() const;
+
+    bool isLatencyProbeCall(pjsua_call_id callId) const {
+        return (PJSUA_INVALID_ID != callId) && ((_probeCaller == callId) || (_probeCallee == callId));
+    }
+    void runNextLatencyProbe();
+    void connectLatencyProbe();
+    void pollLatencyProbe();
+    void finishLatencyProbeRun();
+    void reportLatencyProbe(const LatencyProbe::Result &result);
+    void restoreCodecPriorities();
+    void runNextBenchmarkProfile();
 
     void connectCallToSoundDevices(pjsua_conf_port_id confPortId);
+    //to the conference mixer when the call is part of a conference
+    void connectCallAudio(pjsua_call_id callId, pjsua_conf_port_id confPortId);
+    void leaveConference(pjsua_call_id callId);
+    void logMixerStats() const;
 
 #ifdef ENABLE_VIDEO
     void manageVideo(bool enable);
@@ -198,18 +316,52 @@ private:
     QPointer<CallHistoryModel> _callHistoryModel;
     QPointer<ActiveCallModel> _activeCallModel;
 
-    QString _serverDomain;
-    pjsua_acc_id _accId = PJSUA_INVALID_ID;
-    std::unordered_map<pjsua_call_id, pjsua_player_id> _playerId;
-    std::unordered_map<pjsua_call_id, pjsua_recorder_id> _recorderId;
+    pjsua_acc_id _accId = PJSUA_INVALID_ID;//default account
+    std::unordered_map<pjsua_acc_id, std::unique_ptr<Account>> _accounts;
+    std::array<pjsua_acc_id, PJSUA_MAX_CALLS> _callAccounts;//indexed by call ID
+    std::array<bool, PJSUA_MAX_CALLS> _campaignCalls{};//indexed by call ID
+    RingToneService _ringTones;
+    std::unordered_map<pjsua_call_id, std::unique_ptr<CallRecorder>> _recorders;
+    std::unordered_map<pjsua_call_id, std::unique_ptr<FlightRecorder>> _flightRecorders;
+    std::array<bool, PJSUA_MAX_CALLS> _rtcpSampledCalls{};//indexed by call ID
+    QTimer _rtcpStatsTimer;//samples the RTCP statistics of the confirmed calls
+    std::unique_ptr<ConferenceMixer> _mixer;
+    std::array<CallVolume, PJSUA_MAX_CALLS> _callVolumes;//indexed by call ID
+    std::unique_ptr<FileAudio> _fileAudio;//replaces the sound devices when set
+
+    //pjsua gives no access to its worker threads, they are run here when tuned
+    pj_pool_t *_sipWorkerPool = nullptr;
+    std::vector<pj_thread_t*> _sipWorkers;
+    std::atomic<bool> _sipWorkersQuit{false};
+
+    std::array<pjsua_transport_id, 3> _transportIds{PJSUA_INVALID_ID, PJSUA_INVALID_ID,
+                                                    PJSUA_INVALID_ID};//by Settings::SipTransport
+    pjsua_acc_id _probeAccId = PJSUA_INVALID_ID;//local account for loopback calls
+    pjsua_call_id _probeCaller = PJSUA_INVALID_ID;
+    pjsua_call_id _probeCallee = PJSUA_INVALID_ID;
+    std::unique_ptr<LatencyProbe> _latencyProbe;
+    bool _probeConnected = false;
+    std::atomic<bool> _probeActive{false};//read by onStreamPrecreate
+    LatencyProbeConfig _probeConfig;//stable while _probeActive is set
+    QList<LatencyProbeConfig> _probeRuns;
+    std::vector<std::pair<QByteArray, pj_uint8_t>> _codecPriorities;
+    QTimer _probeTimer;
+    QElapsedTimer _probeElapsed;
+    qint64 _probeCpuStartUs = 0;
+    QList<int> _benchmarkProfiles;
+    int _benchmarkRestoreProfile = PJSUA_INVALID_ID;//valid while a benchmark runs
+    int _benchmarkMarkers = 0;
 
     pj_pool_t* _toneGenPool = nullptr;
     pjmedia_port* _toneGenMediaPort = nullptr;
+    pjmedia_port* _toneLatencyPort = nullptr;//added to the bridge instead of the generator, owns it
     pjsua_conf_port_id _toneGenConfPort = PJSUA_INVALID_ID;
-    QTimer _toneGenTimer;
+    bool _toneGenConnected = false;
+    QTimer _toneGenTimer;//mutes the tone generator when idle
 
 #ifdef ENABLE_VIDEO
     QPointer<QWidget> _previewWindow;
     QPointer<QWidget> _videoWindow;
+    bool _videoInitialized = false;
 #endif
 };
@@ -1,6 +1,9 @@
 #include "softphone.h"
 #include "sip_client.h"
-#include <QApplication>
+#include "campaign.h"
+#include "call_trace.h"
+#include "startup_profile.h"
+#include <QCoreApplication>
 #include <QDebug>
 #include <QFile>
 #include <QFileInfo>
@@ -8,22 +11,13 @@
 #include <QQmlEngine>
 #include <QRegularExpression>
 #include <QThread>
-#include <QStyle>
-#include <QSslSocket>
-#include <QWidget>
-#include <QWindow>
-#include <QDialog>
-#include <QVBoxLayout>
-#include <QNetworkAccessManager>
-#include <QSslSocket>
+#include <QTimeZone>
 
 Softphone::Softphone()
 {
     setObjectName("softphone");
     qmlRegisterType<Softphone>("Softphone", 1, 0, "Softphone");
 
-    printSslBackendVersion();
-
     _inputAudioDevices->setSettings(_settings);
     _outputAudioDevices->setSettings(_settings);
     _videoDevices->setSettings(_settings);
@@ -80,6 +74,18 @@ Softphone::Softphone()
     connect(_settings, &Settings::speakersVolumeChanged, this,
             &Softphone::onSpeakersVolumeChanged);
 
+    //level meters refreshed at display rate
+    _levelMeterTimer.setInterval(LEVEL_METER_INTERVAL_MS);
+    connect(&_levelMeterTimer, &QTimer::timeout, this, &Softphone::updateLevelMeters);
+    connect(this, &Softphone::confirmedCallChanged, this, [this]() {
+        if (_confirmedCall) {
+            _levelMeterTimer.start();
+        } else {
+            _levelMeterTimer.stop();
+            updateLevelMeters();
+        }
+    });
+
     //connection with audio codecs
     connect(_audioCodecs, &AudioCodecs::codecPriorityChanged,
             _audioCodecs, [this](const QString &codecId, int newPriority, int oldPriority) {
@@ -112,6 +118,16 @@ Softphone::Softphone()
 
     //ringtones init
     _ringTonesModel->initDefaultRingTones();
+
+    //formatted dates are cached by the models, refresh them on locale, time zone or day change
+    _timeZoneId = QTimeZone::systemTimeZoneId();
+    _formatDate = QDate::currentDate();
+    _dayTimer.setSingleShot(true);
+    connect(&_dayTimer, &QTimer::timeout, this, &Softphone::refreshDateTimeText);
+    scheduleDayRefresh();
+    if (nullptr != QCoreApplication::instance()) {
+        QCoreApplication::instance()->installEventFilter(this);
+    }
 }
 
 bool Softphone::start()
@@ -126,6 +142,13 @@ bool Softphone::start()
     connect(_sipClient, &SipClient::incoming, this, &Softphone::onIncoming);
     connect(_sipClient, &SipClient::disconnected, this, &Softphone::onDisconnected);
     connect(_sipClient, &SipClient::errorMessage, this, &Softphone::errorDialog);
+    connect(_sipClient, &SipClient::buddyStatusChanged, this, &Softphone::buddyStatusChanged);
+    connect(_sipClient, &SipClient::messageReceived, this, &Softphone::messageReceived);
+    connect(_sipClient, &SipClient::accountRegistrationChanged, this,
+        [this](int accountId, SipClient::RegistrationStatus registrationStatus, const QString &text) {
+            emit accountRegistrationChanged(accountId, SipClient::RegistrationStatus::Registered == registrationStatus,
+                                            text);
+        });
     connect(_sipClient, &SipClient::registrationStatusChanged, this,
         [this](SipClient::RegistrationStatus registrationStatus,
                const QString& registrationStatusText) {
@@ -140,6 +163,7 @@ bool Softphone::start()
                 break;
             case SipClient::RegistrationStatus::Registered:
                 setSipRegistrationStatus(SipRegistrationStatus::Registered);
+                StartupProfile::instance().milestone("registered");
                 if (_isRegisterRequested) {
 		    setLoggedOut(false);//make sure we are in the correct state
                     raiseWindow(); // show dialpad
@@ -151,8 +175,12 @@ bool Softphone::start()
 			_settings->save();
 		    }
 		    if (nullptr != _presenceModel) {
-			_presenceModel->load();
+			_presenceModel->load();//subscribes in batches
 		    }
+#ifdef ENABLE_VIDEO
+		    //once the registration is done, not to delay it
+		    QTimer::singleShot(0, _sipClient, &SipClient::initVideo);
+#endif
 		}
                 break;
             default:;
@@ -162,9 +190,14 @@ bool Softphone::start()
     connect(_activeCallModel, &ActiveCallModel::unholdCall, _sipClient, &SipClient::unhold);
     _presenceModel->setSipClient(_sipClient);
 
-    auto rc{_sipClient->init() && _settings->canRegister()};
+    bool rc = false;
+    {
+        const StartupProfile::Phase phase("sipInit");
+        rc = _sipClient->init() && _settings->canRegister();
+    }
     if (rc) {
         qInfo() << "Autologin";
+        const StartupProfile::Phase phase("registerAccount");
         rc = _sipClient->registerAccount();
     } else {
         qWarning() << "Cannot register";
@@ -174,16 +207,21 @@ bool Softphone::start()
     }
 
     connect(this, &Softphone::audioDevicesChanged, _sipClient, &SipClient::initAudioDevicesList);
+
+    _campaign = new Campaign(_sipClient, _callHistoryModel, this);
+    connect(_campaign, &Campaign::progressChanged, this, &Softphone::campaignProgressChanged);
+    connect(_campaign, &Campaign::finished, this, &Softphone::campaignFinished);
     return true;
 }
 
-void Softphone::printSslBackendVersion()
+bool Softphone::setFileAudio(const QString &playFile, const QString &recordDir)
 {
-	// Initialize the network module
-	QNetworkAccessManager manager;
-
-	// Display the SSL backend version
-	qInfo() << "SSL backend version:" << QSslSocket::sslLibraryVersionString();
+    if (nullptr == _sipClient) {
+        qCritical() << "SIP client not started";
+        return false;
+    }
+    _sipClient->setFileAudio(playFile, recordDir);
+    return true;
 }
 
 void Softphone::onConfirmed(int callId)
@@ -201,12 +239,14 @@ void Softphone::onConfirmed(int callId)
         _sipClient->setupConferenceCall(callId);
         _activeCallModel->update();
     }
+    emit callStateChanged(callId, "confirmed", {}, _sipClient->callAccount(callId));
 }
 
 void Softphone::onCalling(int callId, const QString &userName, const QString &userId)
 {
     _activeCallModel->addCall(callId, userName, userId);
     _callHistoryModel->updateContact(callId, userName, userId);
+    emit callStateChanged(callId, "calling", userId, _sipClient->callAccount(callId));
 }
 
 void Softphone::onIncoming(int callId, const QString &userName, const QString &userId)
@@ -226,6 +266,7 @@ void Softphone::onIncoming(int callId, const QString &userName, const QString &u
                   userId,
                   userName,
                   _activeCallModel->isConference());
+    emit callStateChanged(callId, "incoming", userId, _sipClient->callAccount(callId));
 }
 
 void Softphone::onDisconnected(int callId)
@@ -242,6 +283,7 @@ void Softphone::onDisconnected(int callId)
     _callHistoryModel->updateCallStatus(callId,
                                         CallHistoryModel::CallStatus::REJECTED,
                                         false);
+    _callHistoryModel->removeCall(callId);
 
     setDialedText(_activeCallModel->currentPhoneNumber());
     if (0 == _activeCallModel->callCount()) {
@@ -255,6 +297,7 @@ void Softphone::onDisconnected(int callId)
 #endif
 
     emit disconnected(callId);
+    emit callStateChanged(callId, "disconnected", {}, _sipClient->callAccount(callId));
 }
 
 bool Softphone::registerAccount()
@@ -267,9 +310,9 @@ bool Softphone::unregisterAccount()
     return _sipClient->unregisterAccount();
 }
 
-bool Softphone::makeCall(const QString &userId)
+bool Softphone::makeCall(const QString &userId, int accountId)
 {
-    const auto rc = _sipClient->makeCall(userId);
+    const auto rc = _sipClient->makeCall(userId, accountId);
     if (rc) {
         setActiveCall(true);
     } else {
@@ -337,6 +380,103 @@ bool Softphone::rec(bool value, int callId)
     return _sipClient->record(value, callId);
 }
 
+bool Softphone::dumpFlightRecorder()
+{
+    return _sipClient->dumpFlightRecorder(_activeCallModel->currentCallId());
+}
+
+bool Softphone::runLatencyProbe(const QString &spec)
+{
+    return _sipClient->startLatencyProbe(spec);
+}
+
+bool Softphone::runMediaBenchmark(int markerCount)
+{
+    return _sipClient->startMediaBenchmark(markerCount);
+}
+
+QVariantMap Softphone::callStats(int callId) const
+{
+    QVariantMap stats;
+    pjsua_stream_stat stat{};
+    if (!SipClient::audioStreamStat(callId, stat)) {
+        return stats;
+    }
+    //jitter and RTT are in microseconds
+    stats["rxPackets"] = stat.rtcp.rx.pkt;
+    stats["rxLost"] = stat.rtcp.rx.loss;
+    stats["rxJitterMs"] = stat.rtcp.rx.jitter.mean / 1000.0;
+    stats["txPackets"] = stat.rtcp.tx.pkt;
+    stats["txLost"] = stat.rtcp.tx.loss;
+    stats["rttMs"] = stat.rtcp.rtt.mean / 1000.0;
+    const auto *volume = _sipClient->callVolume(callId);
+    if (nullptr != volume) {
+        stats["microphoneLevel"] = volume->microphoneRms.load(std::memory_order_relaxed);
+        stats["speakersLevel"] = volume->speakersRms.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+bool Softphone::writeCallTrace(const QString &filePath) const
+{
+    return CallTracer::instance().writeChromeTrace(filePath);
+}
+
+QVariantMap Softphone::callSetupStats() const
+{
+    return CallTracer::instance().setupStats();
+}
+
+QVariantMap Softphone::startupReport() const
+{
+    return StartupProfile::instance().report();
+}
+
+void Softphone::beginPageLoad()
+{
+    _pageLoadMemory = StartupProfile::residentMemoryBytes();
+    _pageLoadNs = monotonicNs();
+}
+
+void Softphone::endPageLoad(const QString &page)
+{
+    StartupProfile::instance().addPage(page, _pageLoadNs, _pageLoadMemory);
+}
+
+int Softphone::addAccount(const QVariantMap &config)
+{
+    return _sipClient->addAccount(SipAccountConfig::fromVariantMap(config));
+}
+
+bool Softphone::removeAccount(int accountId)
+{
+    return _sipClient->removeAccount(accountId);
+}
+
+QVariantList Softphone::accounts() const
+{
+    QVariantList list;
+    for (const auto accountId: _sipClient->accountIds()) {
+        list.append(_sipClient->accountInfo(accountId));
+    }
+    return list;
+}
+
+bool Softphone::startCampaign(const QString &filePath, const QString &spec)
+{
+    return _campaign->start(filePath, CampaignConfig::parse(spec));
+}
+
+void Softphone::stopCampaign()
+{
+    _campaign->stop();
+}
+
+QVariantMap Softphone::campaignProgress() const
+{
+    return _campaign->progress();
+}
+
 bool Softphone::disableAudio(bool force)
 {
     Q_UNUSED(force)
@@ -371,6 +511,43 @@ void Softphone::raiseWindow()
     }
 }
 
+bool Softphone::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == QCoreApplication::instance()) {
+        switch (event->type()) {
+        case QEvent::LocaleChange:
+            refreshDateTimeText();
+            break;
+        case QEvent::ApplicationStateChange:
+            //there is no time zone change notification, check when the user comes back
+            if ((QTimeZone::systemTimeZoneId() != _timeZoneId) || (QDate::currentDate() != _formatDate)) {
+                _timeZoneId = QTimeZone::systemTimeZoneId();
+                refreshDateTimeText();
+            }
+            break;
+        default:;
+        }
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void Softphone::refreshDateTimeText()
+{
+    qDebug() << "Refresh formatted dates";
+    _formatDate = QDate::currentDate();
+    _callHistoryModel->refreshDateTimeText();
+    _messagesModel->messagesModel()->refreshDateTimeText();
+    scheduleDayRefresh();
+}
+
+void Softphone::scheduleDayRefresh()
+{
+    //"Today" and "Yesterday" headers move at midnight, a second later to be on the new day
+    const auto now = QDateTime::currentDateTime();
+    const QDateTime midnight(now.date().addDays(1), QTime(0, 0, 1));
+    _dayTimer.start(static_cast<int>(now.msecsTo(midnight)));
+}
+
 void Softphone::onMicrophoneVolumeChanged()
 {
     qDebug() << "onMicrophoneVolumeChanged";
@@ -385,12 +562,29 @@ void Softphone::onSpeakersVolumeChanged()
     _sipClient->setSpeakersVolume(currentCallId);
 }
 
+void Softphone::updateLevelMeters()
+{
+    const auto *volume = _confirmedCall ? _sipClient->callVolume(_activeCallModel->currentCallId()) : nullptr;
+    if (nullptr == volume) {
+        setMicrophoneLevel(0);
+        setMicrophonePeak(0);
+        setSpeakersLevel(0);
+        setSpeakersPeak(0);
+        return;
+    }
+    //written by the conference thread, a torn pair only shows for one refresh
+    setMicrophoneLevel(volume->microphoneRms.load(std::memory_order_relaxed));
+    setMicrophonePeak(volume->microphonePeak.load(std::memory_order_relaxed));
+    setSpeakersLevel(volume->speakersRms.load(std::memory_order_relaxed));
+    setSpeakersPeak(volume->speakersPeak.load(std::memory_order_relaxed));
+}
+
 bool Softphone::playDigit(const QString& digit)
 {
     return _sipClient->playDigit(digit);
 }
 
-bool Softphone::sendText(const QString& userId, const QString& txt)
+bool Softphone::sendText(const QString& userId, const QString& txt, int accountId)
 {
-    return _sipClient->sendText(userId, txt);
+    return _sipClient->sendText(userId, txt, accountId);
 }
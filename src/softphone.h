@@ -15,8 +15,10 @@
 #include <QTimer>
 #include <QString>
 #include <QMap>
+#include <QVariantMap>
 
 class SipClient;
+class Campaign;
 
 class Softphone : public QObject {
 	Q_OBJECT
@@ -44,6 +46,12 @@ private:
     QML_WRITABLE_PROPERTY_POD(bool, record, setRecord, false)
     QML_WRITABLE_PROPERTY_POD(bool, holdCall, setHoldCall, false)
 
+    //RMS and peak of the current call, full scale is 1
+    QML_READABLE_PROPERTY_POD(qreal, microphoneLevel, setMicrophoneLevel, 0)
+    QML_READABLE_PROPERTY_POD(qreal, microphonePeak, setMicrophonePeak, 0)
+    QML_READABLE_PROPERTY_POD(qreal, speakersLevel, setSpeakersLevel, 0)
+    QML_READABLE_PROPERTY_POD(qreal, speakersPeak, setSpeakersPeak, 0)
+
     QML_READABLE_PROPERTY_POD(bool, hasVideo, setHasVideo, false)
     QML_WRITABLE_PROPERTY_POD(bool, enableVideo, setEnableVideo, false)
 
@@ -81,10 +89,13 @@ public:
 
     bool start();
     void setMainForm(QObject *mainForm) { _mainForm = mainForm; }
+    //headless engine, after start: WAV files instead of the sound devices
+    bool setFileAudio(const QString &playFile, const QString &recordDir);
 
     Q_INVOKABLE bool registerAccount();
     Q_INVOKABLE bool unregisterAccount();
-    Q_INVOKABLE bool makeCall(const QString &userId);
+    //an invalid account ID selects the account of the settings
+    Q_INVOKABLE bool makeCall(const QString &userId, int accountId = PJSUA_INVALID_ID);
     Q_INVOKABLE bool answer(int callId);
     Q_INVOKABLE bool hangup(int callId);
     Q_INVOKABLE void hangupAll();
@@ -95,13 +106,37 @@ public:
     Q_INVOKABLE bool sendDtmf(const QString &dtmf);
     Q_INVOKABLE void manuallyRegister();
     Q_INVOKABLE bool playDigit(const QString& digit);
-    Q_INVOKABLE bool sendText(const QString& userId, const QString& txt);
+    Q_INVOKABLE bool sendText(const QString& userId, const QString& txt, int accountId = PJSUA_INVALID_ID);
+    Q_INVOKABLE bool dumpFlightRecorder();
+    Q_INVOKABLE bool runLatencyProbe(const QString &spec);
+    Q_INVOKABLE bool runMediaBenchmark(int markerCount);
+    //RTCP statistics and levels of a call, empty when the call has no audio
+    Q_INVOKABLE QVariantMap callStats(int callId) const;
+    //call setup spans and SIP messages of the last calls, Chrome trace-event JSON
+    Q_INVOKABLE bool writeCallTrace(const QString &filePath) const;
+    Q_INVOKABLE QVariantMap callSetupStats() const;
+    //startup phases and milestones, see StartupProfile
+    Q_INVOKABLE QVariantMap startupReport() const;
+    //around the creation of a QML page, for its time and memory cost
+    Q_INVOKABLE void beginPageLoad();
+    Q_INVOKABLE void endPageLoad(const QString &page);
+    //further accounts next to the one of the settings, see SipAccountConfig for the keys
+    Q_INVOKABLE int addAccount(const QVariantMap &config);
+    Q_INVOKABLE bool removeAccount(int accountId);
+    Q_INVOKABLE QVariantList accounts() const;
+    //automated dialing of a CSV list of numbers, see CampaignConfig for the spec
+    Q_INVOKABLE bool startCampaign(const QString &filePath, const QString &spec = QString());
+    Q_INVOKABLE void stopCampaign();
+    Q_INVOKABLE QVariantMap campaignProgress() const;
 
     bool hold(bool value, int callId);
     bool mute(bool value, int callId);
     bool rec(bool value, int callId);
     QString convertNumber(const QString &num);
 
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 signals:
     void phoneStateChanged();
     void audioDevicesChanged();
@@ -111,11 +146,17 @@ signals:
                   const QString &userName,
                   bool isConf);
     void disconnected(int callId);
+    //"calling", "incoming", "confirmed" or "disconnected", the user ID only for new calls
+    void callStateChanged(int callId, const QString &state, const QString &userId, int accountId);
+    void buddyStatusChanged(int buddyId, const QString &status);
+    void accountRegistrationChanged(int accountId, bool registered, const QString &text);
+    void messageReceived(int accountId, const QString &from, const QString &text);
+    void campaignProgressChanged();
+    void campaignFinished();
 
 private:
     Q_DISABLE_COPY_MOVE(Softphone)
 
-    static void printSslBackendVersion();
     void onConfirmed(int callId);
     void onCalling(int callId, const QString &userName, const QString &userId);
     void onIncoming(int callId, const QString &userName, const QString &userId);
@@ -123,8 +164,11 @@ private:
 
     void onMicrophoneVolumeChanged();
     void onSpeakersVolumeChanged();
+    void updateLevelMeters();
 
     void raiseWindow();
+    void refreshDateTimeText();
+    void scheduleDayRefresh();
 
     bool disableAudio(bool force = false);
 
@@ -133,7 +177,11 @@ private:
         setDialogMessage(msg);
     }
 
+    enum { LEVEL_METER_INTERVAL_MS = 16 };
+
     SipClient *_sipClient{nullptr};
+    Campaign *_campaign{nullptr};
+    QTimer _levelMeterTimer;//polls the meters of the media thread while a call is confirmed
     QObject *_mainForm{nullptr};
     QHash<pjsua_call_id, pjsua_player_id> _playerId;
     QHash<pjsua_call_id, pjsua_recorder_id> _recId;
@@ -141,4 +189,9 @@ private:
     bool _manualHangup{false};
     bool _audioEnabled{false};
     bool _isFirstRegistration{true};
+    QByteArray _timeZoneId;
+    QDate _formatDate;//day the "Today" header refers to
+    QTimer _dayTimer;
+    qint64 _pageLoadNs{0};
+    qint64 _pageLoadMemory{0};
 };
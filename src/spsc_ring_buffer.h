@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+/**
+ * Lock-free single producer, single consumer ring buffer.
+ * The producer is the media (conference bridge) thread, it never blocks:
+ * when the ring is full the new samples are dropped and counted.
+ */
+template<typename T>
+class SpscRingBuffer
+{
+public:
+    explicit SpscRingBuffer(size_t minCapacity) {
+        size_t capacity = 1;
+        while (capacity < minCapacity) {
+            capacity <<= 1;
+        }
+        _buffer.resize(capacity);
+        _mask = capacity - 1;
+    }
+
+    size_t capacity() const { return _buffer.size(); }
+
+    //producer side
+    bool push(const T *data, size_t count) {
+        const auto head = _head.load(std::memory_order_relaxed);
+        const auto tail = _tail.load(std::memory_order_acquire);
+        if (capacity() - (head - tail) < count) {
+            _dropped.fetch_add(count, std::memory_order_relaxed);
+            return false;
+        }
+        const auto start = head & _mask;
+        const auto first = std::min(count, capacity() - start);
+        std::memcpy(&_buffer[start], data, first * sizeof(T));
+        std::memcpy(&_buffer[0], data + first, (count - first) * sizeof(T));
+        _head.store(head + count, std::memory_order_release);
+        return true;
+    }
+
+    //consumer side
+    size_t available() const {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_relaxed);
+    }
+    size_t pop(T *data, size_t count) {
+        const auto tail = _tail.load(std::memory_order_relaxed);
+        const auto head = _head.load(std::memory_order_acquire);
+        count = std::min(count, head - tail);
+        const auto start = tail & _mask;
+        const auto first = std::min(count, capacity() - start);
+        std::memcpy(data, &_buffer[start], first * sizeof(T));
+        std::memcpy(data + first, &_buffer[0], (count - first) * sizeof(T));
+        _tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<T> _buffer;
+    size_t _mask = 0;
+    alignas(64) std::atomic<size_t> _head{0};//written by the producer
+    alignas(64) std::atomic<size_t> _tail{0};//written by the consumer
+    std::atomic<size_t> _dropped{0};
+};
+
@@ -0,0 +1,141 @@
+#include "startup_profile.h"
+#include "metrics.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_MACOS)
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#endif
+
+StartupProfile& StartupProfile::instance()
+{
+    static StartupProfile profile;
+    return profile;
+}
+
+StartupProfile::StartupProfile() : _originNs(monotonicNs())
+{
+}
+
+void StartupProfile::start()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _originNs = monotonicNs();
+    _events.clear();
+    _logged = false;
+}
+
+void StartupProfile::addPhase(const char *name, qint64 beginNs)
+{
+    const auto durationNs = monotonicNs() - beginNs;
+    Metrics::instance().gauge("bcphone_startup_phase_seconds", "Duration of the startup phases",
+                              QByteArray("phase=\"") + name + '"').set(durationNs / 1e9);
+    std::lock_guard<std::mutex> lock(_mutex);
+    _events.push_back({ name, beginNs, durationNs });
+}
+
+void StartupProfile::milestone(const char *name)
+{
+    const auto timeNs = monotonicNs();
+    bool logReport = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const auto &event: _events) {
+            if ((0 > event.durationNs) && (event.name == name)) {
+                return;
+            }
+        }
+        _events.push_back({ name, timeNs, -1 });
+        Metrics::instance().gauge("bcphone_startup_milestone_seconds", "Time from the start to the startup milestones",
+                                  QByteArray("milestone=\"") + name + '"').set((timeNs - _originNs) / 1e9);
+        //the registration ends the critical path of the startup
+        logReport = !_logged && (0 == qstrcmp("registered", name));
+        _logged = _logged || logReport;
+    }
+    if (logReport) {
+        log();
+    }
+}
+
+void StartupProfile::addPage(const QString &name, qint64 beginNs, qint64 memoryBeforeBytes)
+{
+    const auto durationNs = monotonicNs() - beginNs;
+    const auto memoryBytes = residentMemoryBytes() - memoryBeforeBytes;
+    const auto labels = "page=\"" + QFileInfo(name).baseName().toUtf8() + '"';
+    Metrics::instance().gauge("bcphone_qml_page_load_seconds", "Creation time of the QML pages", labels)
+            .set(durationNs / 1e9);
+    Metrics::instance().gauge("bcphone_qml_page_memory_bytes", "Resident memory added by the creation of the QML pages",
+                              labels).set(static_cast<double>(memoryBytes));
+    qInfo() << "Page" << name << "created in" << durationNs / 1000000 << "ms, memory" << memoryBytes / 1024 << "KiB";
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pages.push_back({ name, durationNs, memoryBytes });
+}
+
+QVariantMap StartupProfile::report() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    QVariantList phases;
+    QVariantMap milestones;
+    for (const auto &event: _events) {
+        const auto startMs = (event.beginNs - _originNs) / 1e6;
+        if (0 > event.durationNs) {
+            milestones[QString::fromLatin1(event.name)] = startMs;
+        } else {
+            phases.append(QVariantMap{{"name", QString::fromLatin1(event.name)}, {"startMs", startMs},
+                                      {"durationMs", event.durationNs / 1e6}});
+        }
+    }
+    QVariantList pages;
+    for (const auto &page: _pages) {
+        pages.append(QVariantMap{{"name", page.name}, {"durationMs", page.durationNs / 1e6},
+                                 {"memoryKb", page.memoryBytes / 1024}});
+    }
+    return {{"phases", phases}, {"milestones", milestones}, {"pages", pages}};
+}
+
+void StartupProfile::log() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    qInfo() << "Startup report:";
+    for (const auto &event: _events) {
+        const auto startMs = (event.beginNs - _originNs) / 1000000;
+        if (0 > event.durationNs) {
+            qInfo().nospace() << "  " << startMs << " ms: " << event.name;
+        } else {
+            qInfo().nospace() << "  " << startMs << " ms: " << event.name << " took "
+                              << event.durationNs / 1000000 << " ms";
+        }
+    }
+}
+
+qint64 StartupProfile::residentMemoryBytes()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<qint64>(counters.WorkingSetSize);
+    }
+    return 0;
+#elif defined(Q_OS_MACOS)
+    mach_task_basic_info info{};
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (KERN_SUCCESS == task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                                  reinterpret_cast<task_info_t>(&info), &count)) {
+        return static_cast<qint64>(info.resident_size);
+    }
+    return 0;
+#else
+    //second field of statm, in pages
+    QFile file("/proc/self/statm");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    const auto fields = file.readAll().split(' ');
+    return (1 < fields.size()) ? fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
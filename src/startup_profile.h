@@ -0,0 +1,68 @@
+#pragma once
+
+#include "monotonic_clock.h"
+#include <QByteArray>
+#include <QVariantMap>
+#include <mutex>
+#include <vector>
+
+/**
+ * Startup timing report: the phases of the launch (application, models, SIP
+ * stack, QML, ...) and the milestones reached (registered, first frame) from
+ * the start of main, on a monotonic clock. Each phase is exported as
+ * bcphone_startup_phase_seconds{phase}; the report is logged once the first
+ * account is registered. The QML pages created on first use are reported
+ * with their creation time and the resident memory they added.
+ */
+class StartupProfile
+{
+public:
+    static StartupProfile& instance();
+
+    //times the enclosing block as a startup phase, the name must be static
+    class Phase {
+    public:
+        explicit Phase(const char *name) : _name(name), _beginNs(monotonicNs()) {}
+        ~Phase() { instance().addPhase(_name, _beginNs); }
+    private:
+        Q_DISABLE_COPY_MOVE(Phase)
+        const char *_name = nullptr;
+        qint64 _beginNs = 0;
+    };
+
+    //the origin of the report, first thing in main
+    void start();
+    void addPhase(const char *name, qint64 beginNs);
+    //only the first occurrence of a milestone is kept
+    void milestone(const char *name);
+    void addPage(const QString &name, qint64 beginNs, qint64 memoryBeforeBytes);
+    //phases with their start and duration, milestones, in ms, pages
+    QVariantMap report() const;
+
+    //resident set size of the process, 0 when unknown
+    static qint64 residentMemoryBytes();
+
+private:
+    StartupProfile();
+    Q_DISABLE_COPY_MOVE(StartupProfile)
+
+    struct Event {
+        QByteArray name;
+        qint64 beginNs = 0;
+        qint64 durationNs = -1;//milestone
+    };
+
+    struct Page {
+        QString name;
+        qint64 durationNs = 0;
+        qint64 memoryBytes = 0;
+    };
+
+    void log() const;
+
+    mutable std::mutex _mutex;
+    qint64 _originNs = 0;
+    std::vector<Event> _events;
+    std::vector<Page> _pages;
+    bool _logged = false;
+};
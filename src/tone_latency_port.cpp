@@ -0,0 +1,86 @@
+#include "tone_latency_port.h"
+#include "monotonic_clock.h"
+#include "metrics.h"
+#include <QDebug>
+#include <algorithm>
+#include <new>
+
+namespace {
+//registered once, then recorded from the conference thread
+HdrHistogram& keypressLatency(bool firstDigit)
+{
+    static auto &first = Metrics::instance().histogram("bcphone_keypress_tone_latency_seconds",
+                                                       "Time from a dialpad keypress to its first tone frame",
+                                                       "digit=\"first\"");
+    static auto &subsequent = Metrics::instance().histogram("bcphone_keypress_tone_latency_seconds",
+                                                            "Time from a dialpad keypress to its first tone frame",
+                                                            "digit=\"subsequent\"");
+    return firstDigit ? first : subsequent;
+}
+}
+
+pjmedia_port* ToneLatencyPort::create(pjmedia_port *tonePort)
+{
+    const auto *format = pjmedia_format_get_audio_format_detail(&tonePort->info.fmt, PJ_TRUE);
+    if ((nullptr == format) || (BITS_PER_SAMPLE != format->bits_per_sample)) {
+        qWarning() << "Unsupported tone format for latency measurement";
+        return nullptr;
+    }
+    auto *pool = pjsua_pool_create("toneLatency", POOL_SIZE, POOL_SIZE);
+    if (nullptr == pool) {
+        return nullptr;
+    }
+    //constructed in place, the atomics need their constructor
+    auto *port = new (pj_pool_zalloc(pool, sizeof(Port))) Port();
+    port->pool = pool;
+    port->tone = tonePort;
+    port->pressNs.store(-1, std::memory_order_relaxed);
+
+    pj_str_t name = pj_str(const_cast<char*>("toneLatency"));
+    pjmedia_port_info_init(&port->base.info, &name, PJMEDIA_SIGNATURE('B', 'C', 'T', 'L'),
+                           format->clock_rate, format->channel_count, BITS_PER_SAMPLE,
+                           PJMEDIA_PIA_SPF(&tonePort->info));
+    port->base.get_frame = &ToneLatencyPort::getFrame;
+    port->base.on_destroy = &ToneLatencyPort::onDestroy;
+    return &port->base;
+}
+
+void ToneLatencyPort::keyPressed(pjmedia_port *port, bool firstDigit)
+{
+    if (nullptr == port) {
+        return;
+    }
+    auto *latencyPort = reinterpret_cast<Port*>(port);
+    latencyPort->firstDigit.store(firstDigit, std::memory_order_relaxed);
+    latencyPort->pressNs.store(monotonicNs(), std::memory_order_release);
+}
+
+pj_status_t ToneLatencyPort::getFrame(pjmedia_port *port, pjmedia_frame *frame)
+{
+    auto *latencyPort = reinterpret_cast<Port*>(port);
+    const auto status = pjmedia_port_get_frame(latencyPort->tone, frame);
+    if ((PJ_SUCCESS != status) || (PJMEDIA_FRAME_TYPE_AUDIO != frame->type) ||
+            (0 > latencyPort->pressNs.load(std::memory_order_relaxed))) {
+        return status;
+    }
+    const auto *samples = static_cast<const pj_int16_t*>(frame->buf);
+    const auto count = frame->size / sizeof(pj_int16_t);
+    if (std::all_of(samples, samples + count, [](pj_int16_t sample) { return 0 == sample; })) {
+        return status;
+    }
+    //a newer keypress may have come in the meantime, its time is used
+    const auto pressNs = latencyPort->pressNs.exchange(-1, std::memory_order_acquire);
+    if (0 <= pressNs) {
+        keypressLatency(latencyPort->firstDigit.load(std::memory_order_relaxed))
+                .record((monotonicNs() - pressNs) / 1000);
+    }
+    return status;
+}
+
+pj_status_t ToneLatencyPort::onDestroy(pjmedia_port *port)
+{
+    auto *latencyPort = reinterpret_cast<Port*>(port);
+    pjmedia_port_destroy(latencyPort->tone);
+    pj_pool_release(latencyPort->pool);
+    return PJ_SUCCESS;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "pjsua.h"
+#include <QtGlobal>
+#include <atomic>
+
+/**
+ * Keypress to tone latency of the dialpad. Wraps the port of the tone
+ * generator, the conference bridge pulls its frames through the wrapper.
+ * A keypress stores its time, the first non-silent frame pulled afterwards
+ * records the elapsed time in a histogram labelled by digit: "first" when
+ * the generator had to be connected again, "subsequent" when it was still
+ * connected from the previous digit.
+ */
+class ToneLatencyPort
+{
+public:
+    //the wrapper destroys the tone port with itself
+    static pjmedia_port* create(pjmedia_port *tonePort);
+    //GUI thread, right before the digit is queued to the tone generator
+    static void keyPressed(pjmedia_port *port, bool firstDigit);
+
+private:
+    ToneLatencyPort() = delete;
+
+    enum { POOL_SIZE = 512, BITS_PER_SAMPLE = 16 };
+
+    struct Port {
+        pjmedia_port base;
+        pj_pool_t *pool;
+        pjmedia_port *tone;
+        std::atomic<qint64> pressNs;//negative once recorded
+        std::atomic<bool> firstDigit;
+    };
+
+    static pj_status_t getFrame(pjmedia_port *port, pjmedia_frame *frame);
+    static pj_status_t onDestroy(pjmedia_port *port);
+};
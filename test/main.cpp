@@ -1,8 +1,24 @@
 #include "sip_client.h"
 #include "softphone.h"
+#include "metrics.h"
+#include "audio_kernels.h"
+#include "spsc_ring_buffer.h"
+#include "ogg_opus_writer.h"
+#include "campaign.h"
+#include "network_impairment.h"
+#include "models/call_history_model.h"
+#include "models/messages_model.h"
+#include "models/messages_proxy_model.h"
+#include <QApplication>
 #include <QSignalSpy>
 #include <QTest>
 #include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <vector>
 
 class TestSipClient: public QObject
 {
@@ -106,5 +122,565 @@ void TestSipClient::testMakeCall()
     createClient(1, true);
 }
 
-QTEST_MAIN(TestSipClient)
+//no SIP server needed
+class TestComponents: public QObject
+{
+    Q_OBJECT
+private slots:
+    void testHistogramBuckets();
+    void testPrometheusText();
+    void testRtcpStatsHistograms();
+    void testAudioKernelsGain();
+    void testAudioKernelsMix();
+    void testRingBufferWrapAround();
+    void testOggOpusPages();
+    void testCampaignConfig();
+    void testCampaignCsv();
+    void testImpairmentProfile();
+    void testLiveCallRows();
+    void testMessagesFilterRefine();
+    void testMessagesFilterSort();
+};
+
+void TestComponents::testHistogramBuckets()
+{
+    //every bucket starts at its own lowest value
+    for (int i = 0; i < HdrHistogram::BUCKET_COUNT; ++i) {
+        QCOMPARE(HdrHistogram::bucketIndex(HdrHistogram::bucketLowest(i)), i);
+    }
+    //and ends right before the next one
+    for (int i = 0; i < HdrHistogram::BUCKET_COUNT - 1; ++i) {
+        const auto next = HdrHistogram::bucketLowest(i + 1);
+        QVERIFY(HdrHistogram::bucketLowest(i) < next);
+        QCOMPARE(HdrHistogram::bucketIndex(next - 1), i);
+    }
+    //exact below 64, then 32 sub-buckets per power of two
+    QCOMPARE(HdrHistogram::bucketIndex(63), 63);
+    QCOMPARE(HdrHistogram::bucketLowest(HdrHistogram::bucketIndex(100)), 100ULL);
+    QCOMPARE(HdrHistogram::bucketLowest(HdrHistogram::bucketIndex(502)), 496ULL);
+    QCOMPARE(HdrHistogram::bucketIndex(~0ULL), static_cast<int>(HdrHistogram::BUCKET_COUNT) - 1);
+}
+
+void TestComponents::testPrometheusText()
+{
+    //microseconds exported in seconds
+    auto &histogram = Metrics::instance().histogram("bcphone_test_seconds", "Test histogram", "kind=\"test\"");
+    histogram.record(100);
+    //496..503 straddles the 0.0005 bound, only counted from the next one
+    histogram.record(502);
+    histogram.record(2000);
+    QCOMPARE(histogram.count(), 3ULL);
+    QCOMPARE(histogram.countAtMost(0.0005), 1ULL);
+    QCOMPARE(histogram.countAtMost(0.001), 2ULL);
+
+    Metrics::instance().counter("bcphone_test_total", "Test counter").add(2);
+    const auto text = Metrics::instance().prometheusText();
+    QVERIFY(text.contains("# HELP bcphone_test_total Test counter\n# TYPE bcphone_test_total counter\n"
+                          "bcphone_test_total 2\n"));
+    QVERIFY(text.contains("# TYPE bcphone_test_seconds histogram\n"));
+    QVERIFY(text.contains("bcphone_test_seconds_bucket{kind=\"test\",le=\"0.0005\"} 1\n"));
+    QVERIFY(text.contains("bcphone_test_seconds_bucket{kind=\"test\",le=\"0.001\"} 2\n"));
+    QVERIFY(text.contains("bcphone_test_seconds_bucket{kind=\"test\",le=\"0.0025\"} 3\n"));
+    QVERIFY(text.contains("bcphone_test_seconds_bucket{kind=\"test\",le=\"+Inf\"} 3\n"));
+    QVERIFY(text.contains("bcphone_test_seconds_sum{kind=\"test\"} 0.002602\n"));
+    QVERIFY(text.contains("bcphone_test_seconds_count{kind=\"test\"} 3\n"));
+}
+
+void TestComponents::testRtcpStatsHistograms()
+{
+    //fed from the stream statistics alone, the flight recorder is off by default
+    auto &jitter = Metrics::instance().histogram("bcphone_rtcp_jitter_seconds",
+                                                 "Receive jitter of the audio streams, sampled every second");
+    auto &rtt = Metrics::instance().histogram("bcphone_rtcp_rtt_seconds",
+                                              "Round-trip time of the audio streams, sampled every second");
+    const auto jitterCount = jitter.count();
+    const auto rttCount = rtt.count();
+
+    //no report received yet, nothing recorded
+    pjmedia_rtcp_stat stat{};
+    SipClient::recordRtcpStats(stat);
+    QCOMPARE(jitter.count(), jitterCount);
+    QCOMPARE(rtt.count(), rttCount);
+
+    stat.rx.jitter.n = 1;
+    stat.rx.jitter.last = 20000;
+    stat.rtt.n = 1;
+    stat.rtt.last = 80000;
+    SipClient::recordRtcpStats(stat);
+    QCOMPARE(jitter.count(), jitterCount + 1);
+    QCOMPARE(rtt.count(), rttCount + 1);
+    QVERIFY(Metrics::instance().prometheusText().contains("bcphone_rtcp_rtt_seconds_bucket{le=\"0.1\"}"));
+}
+
+namespace {
+//the samples a vector loop must reproduce: full scale, -32768, zero and random values
+std::vector<int16_t> testSamples(size_t count)
+{
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<int> distribution(INT16_MIN, INT16_MAX);
+    std::vector<int16_t> samples(count);
+    for (size_t i = 0; i < count; ++i) {
+        switch (i % 5) {
+        case 0:
+            samples[i] = INT16_MIN;
+            break;
+        case 1:
+            samples[i] = INT16_MAX;
+            break;
+        case 2:
+            samples[i] = 0;
+            break;
+        default:
+            samples[i] = static_cast<int16_t>(distribution(generator));
+        }
+    }
+    return samples;
+}
+}
+
+void TestComponents::testAudioKernelsGain()
+{
+    using namespace AudioKernels;
+    QCOMPARE(fixedGain(1), GAIN_UNITY);
+    QCOMPARE(fixedGain(0), 0);
+    QCOMPARE(fixedGain(-1), 0);
+    QCOMPARE(fixedGain(100), static_cast<int32_t>(INT16_MAX));
+
+    //lengths covering the AVX2, SSE2 or NEON loops and the scalar tail
+    const int32_t gains[] = { 0, fixedGain(0.5f), GAIN_UNITY, fixedGain(1.5f), INT16_MAX };
+    for (size_t count = 0; count <= 67; ++count) {
+        for (const auto gain: gains) {
+            auto samples = testSamples(count);
+            std::vector<int16_t> expected(count);
+            Level expectedLevel;
+            for (size_t i = 0; i < count; ++i) {
+                const int32_t value = (samples[i] * gain + (1 << (GAIN_SHIFT - 1))) >> GAIN_SHIFT;
+                expected[i] = static_cast<int16_t>(std::clamp<int32_t>(value, INT16_MIN, INT16_MAX));
+                const int32_t magnitude = std::min<int32_t>(std::abs(static_cast<int32_t>(expected[i])), INT16_MAX);
+                expectedLevel.peak = std::max(expectedLevel.peak, magnitude);
+                expectedLevel.sumSquares += static_cast<uint64_t>(magnitude) * magnitude;
+            }
+            const auto level = applyGain(samples.data(), count, gain);
+            QVERIFY2(samples == expected, qPrintable(QString("count %1, gain %2").arg(count).arg(gain)));
+            QCOMPARE(level.peak, expectedLevel.peak);
+            QCOMPARE(level.sumSquares, expectedLevel.sumSquares);
+        }
+    }
+}
+
+void TestComponents::testAudioKernelsMix()
+{
+    using namespace AudioKernels;
+    for (size_t count = 0; count <= 35; ++count) {
+        const auto first = testSamples(count);
+        auto second = testSamples(count);
+        std::reverse(second.begin(), second.end());
+
+        std::vector<int32_t> acc(count, 0);
+        accumulate(acc.data(), first.data(), count);
+        accumulate(acc.data(), second.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            QCOMPARE(acc[i], static_cast<int32_t>(first[i]) + second[i]);
+        }
+
+        //the sum of both saturates, removing one party gives back the other
+        std::vector<int16_t> out(count);
+        mixMinus(out.data(), acc.data(), nullptr, count);
+        for (size_t i = 0; i < count; ++i) {
+            QCOMPARE(out[i], static_cast<int16_t>(std::clamp<int32_t>(acc[i], INT16_MIN, INT16_MAX)));
+        }
+        mixMinus(out.data(), acc.data(), first.data(), count);
+        QVERIFY(out == second);
+    }
+}
+
+void TestComponents::testRingBufferWrapAround()
+{
+    SpscRingBuffer<int16_t> ring(5);
+    QCOMPARE(ring.capacity(), size_t(8));
+
+    //blocks of 3 start at every offset of the ring, so copies are split at the end
+    std::vector<int16_t> out(8);
+    int16_t next = 0;
+    int16_t expected = 0;
+    for (int round = 0; round < 20; ++round) {
+        const int16_t block[3] = { next, static_cast<int16_t>(next + 1), static_cast<int16_t>(next + 2) };
+        QVERIFY(ring.push(block, 3));
+        next += 3;
+        QCOMPARE(ring.available(), size_t(3));
+        QCOMPARE(ring.pop(out.data(), out.size()), size_t(3));
+        for (int i = 0; i < 3; ++i) {
+            QCOMPARE(out[static_cast<size_t>(i)], expected++);
+        }
+    }
+
+    //full: the new samples are dropped whole, nothing already queued is overwritten
+    const std::vector<int16_t> fill{ 1, 2, 3, 4, 5, 6 };
+    QVERIFY(ring.push(fill.data(), fill.size()));
+    QVERIFY(!ring.push(fill.data(), 3));
+    QCOMPARE(ring.dropped(), size_t(3));
+    QVERIFY(ring.push(fill.data(), 2));
+    QCOMPARE(ring.available(), size_t(8));
+    QCOMPARE(ring.pop(out.data(), out.size()), size_t(8));
+    QCOMPARE(out, (std::vector<int16_t>{ 1, 2, 3, 4, 5, 6, 1, 2 }));
+    QCOMPARE(ring.pop(out.data(), out.size()), size_t(0));
+}
+
+void TestComponents::testOggOpusPages()
+{
+    enum { CLOCK_RATE = 16000, FRAME_SAMPLES = 320, PACKET_COUNT = 150 };
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto filePath = dir.filePath("test.opus");
+
+    //packet i is filled with byte i, every tenth one needs several lacing values
+    QList<QByteArray> packets;
+    OggOpusWriter writer;
+    QVERIFY(writer.open(filePath, CLOCK_RATE, 1, 312));
+    for (int i = 0; i < PACKET_COUNT; ++i) {
+        packets.append(QByteArray((0 == i % 10) ? 600 : 100, static_cast<char>(i)));
+        QVERIFY(writer.writePacket(reinterpret_cast<const unsigned char*>(packets.last().constData()),
+                                   static_cast<int>(packets.last().size()), FRAME_SAMPLES));
+    }
+    writer.close();
+
+    QFile file(filePath);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const auto data = file.readAll();
+    QCOMPARE(data.size(), writer.bytesWritten());
+
+    //non reflected CRC-32, polynomial 0x04c11db7, computed with the CRC field zeroed
+    const auto crc32 = [](QByteArray page) {
+        std::fill(page.begin() + 22, page.begin() + 26, '\0');
+        quint32 crc = 0;
+        for (const auto byte: std::as_const(page)) {
+            crc ^= static_cast<quint32>(static_cast<quint8>(byte)) << 24;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (0 != (crc & 0x80000000U)) ? (crc << 1) ^ 0x04c11db7U : (crc << 1);
+            }
+        }
+        return crc;
+    };
+
+    QList<QByteArray> readPackets;
+    QByteArray packet;
+    qint64 offset = 0;
+    quint32 sequence = 0;
+    quint32 serial = 0;
+    int flags = 0;
+    while (offset < data.size()) {
+        QVERIFY(offset + 27 <= data.size());
+        const auto *header = data.constData() + offset;
+        QCOMPARE(QByteArray(header, 4), QByteArray("OggS"));
+        flags = header[5];
+        const auto granule = qFromLittleEndian<qint64>(header + 6);
+        if (0 == sequence) {
+            serial = qFromLittleEndian<quint32>(header + 14);
+            QCOMPARE(flags, 0x02);//BOS
+        }
+        QCOMPARE(qFromLittleEndian<quint32>(header + 14), serial);
+        QCOMPARE(qFromLittleEndian<quint32>(header + 18), sequence);
+        const int segmentCount = static_cast<quint8>(header[26]);
+        qint64 bodySize = 0;
+        for (int i = 0; i < segmentCount; ++i) {
+            bodySize += static_cast<quint8>(header[27 + i]);
+        }
+        const auto pageSize = 27 + segmentCount + bodySize;
+        QVERIFY(offset + pageSize <= data.size());
+        const auto page = data.mid(offset, pageSize);
+        QCOMPARE(qFromLittleEndian<quint32>(header + 22), crc32(page));
+
+        //packets never continue on the next page
+        qint64 position = 27 + segmentCount;
+        for (int i = 0; i < segmentCount; ++i) {
+            const int size = static_cast<quint8>(header[27 + i]);
+            packet.append(page.mid(position, size));
+            position += size;
+            if (255 > size) {
+                readPackets.append(packet);
+                packet.clear();
+            }
+        }
+        QVERIFY(packet.isEmpty());
+
+        //the granule counts the 48 kHz samples of the packets completed so far, the headers excluded
+        const auto audioPackets = std::max<qint64>(0, readPackets.size() - 2);
+        QCOMPARE(granule, audioPackets * FRAME_SAMPLES * 48000 / CLOCK_RATE);
+        offset += pageSize;
+        ++sequence;
+    }
+    QCOMPARE(flags, 0x04);//EOS
+    QVERIFY(3 < sequence);
+
+    QCOMPARE(static_cast<int>(readPackets.size()), PACKET_COUNT + 2);
+    QVERIFY(readPackets.at(0).startsWith("OpusHead"));
+    QCOMPARE(qFromLittleEndian<quint16>(readPackets.at(0).constData() + 10), quint16(312));
+    QCOMPARE(qFromLittleEndian<quint32>(readPackets.at(0).constData() + 12), quint32(CLOCK_RATE));
+    QVERIFY(readPackets.at(1).startsWith("OpusTags"));
+    for (int i = 0; i < PACKET_COUNT; ++i) {
+        QCOMPARE(readPackets.at(i + 2), packets.at(i));
+    }
+}
+
+void TestComponents::testCampaignConfig()
+{
+    const CampaignConfig defaults;
+    auto config = CampaignConfig::parse("");
+    QCOMPARE(config.toString(), defaults.toString());
+
+    config = CampaignConfig::parse("concurrency=10, CPS=2.5,predictive=1,maxratio=4,ring=20,talk=15,"
+                                   "attempts=5,busyretry=60,noanswerretry=120,account=2");
+    QCOMPARE(config.concurrency, 10);
+    QCOMPARE(config.callsPerSecond, 2.5);
+    QVERIFY(config.predictive);
+    QCOMPARE(config.maxRatio, 4.0);
+    QCOMPARE(config.ringTimeoutSec, 20);
+    QCOMPARE(config.talkTimeSec, 15);
+    QCOMPARE(config.maxAttempts, 5);
+    QCOMPARE(config.busyRetrySec, 60);
+    QCOMPARE(config.noAnswerRetrySec, 120);
+    QCOMPARE(config.accountId, 2);
+    //the text form parses back to the same config
+    QCOMPARE(CampaignConfig::parse(config.toString()).toString(), config.toString());
+
+    //out of range values are clamped, malformed and unknown items ignored
+    config = CampaignConfig::parse("concurrency=0,cps=0,maxratio=0.5,ring=-1,talk=-1,attempts=0,"
+                                   "busyretry=-5,noanswerretry=-5,bogus,unknown=3,ring=10=2");
+    QCOMPARE(config.concurrency, 1);
+    QCOMPARE(config.callsPerSecond, 0.01);
+    QCOMPARE(config.maxRatio, 1.0);
+    QCOMPARE(config.ringTimeoutSec, 1);
+    QCOMPARE(config.talkTimeSec, 0);
+    QCOMPARE(config.maxAttempts, 1);
+    QCOMPARE(config.busyRetrySec, 0);
+    QCOMPARE(config.noAnswerRetrySec, 0);
+    QCOMPARE(config.accountId, defaults.accountId);
+}
+
+void TestComponents::testCampaignCsv()
+{
+    //a list line with a quoted name, the spaces around the fields are trimmed by the loader
+    QCOMPARE(Campaign::parseCsvLine("5551234, \"Doe, John\""), (QStringList{ "5551234", "Doe, John" }));
+    QCOMPARE(Campaign::parseCsvLine("5551234,Jane"), (QStringList{ "5551234", "Jane" }));
+    QCOMPARE(Campaign::parseCsvLine("5551234"), (QStringList{ "5551234" }));
+    QCOMPARE(Campaign::parseCsvLine("5551234,"), (QStringList{ "5551234", "" }));
+
+    //a result row keeps its six columns whatever the name
+    const QStringList fields{ "2026-10-19T10:00:00.000", "5551234", "Doe, John \"JD\"", "1", "answered", "200" };
+    const auto line = Campaign::formatCsvLine(fields);
+    QCOMPARE(line, QString("2026-10-19T10:00:00.000,5551234,\"Doe, John \"\"JD\"\"\",1,answered,200"));
+    QCOMPARE(Campaign::parseCsvLine(line), fields);
+    QCOMPARE(Campaign::formatCsvLine({ "5551234", "Jane" }), QString("5551234,Jane"));
+}
+
+void TestComponents::testImpairmentProfile()
+{
+    auto profile = ImpairmentProfile::parse("");
+    QVERIFY(!profile.isEnabled());
+    QVERIFY(profile.rx && profile.tx);
+
+    profile = ImpairmentProfile::parse("loss=2,burst=5/50,burstloss=80,jitter=40,reorder=1,dup=0.5,"
+                                       "rate=64,dir=rx,seed=7");
+    QCOMPARE(profile.lossPercent, 2.0);
+    QCOMPARE(profile.burstEnterPercent, 5.0);
+    QCOMPARE(profile.burstExitPercent, 50.0);
+    QCOMPARE(profile.burstLossPercent, 80.0);
+    QCOMPARE(profile.jitterMs, 40);
+    QCOMPARE(profile.reorderPercent, 1.0);
+    QCOMPARE(profile.duplicatePercent, 0.5);
+    QCOMPARE(profile.rateKbps, 64);
+    QVERIFY(profile.rx && !profile.tx);
+    QCOMPARE(profile.seed, 7U);
+    QVERIFY(profile.isEnabled());
+    //the seed is not part of the text form
+    QCOMPARE(ImpairmentProfile::parse(profile.toString()).toString(), profile.toString());
+
+    //the exit probability defaults to 100%, one burst packet at a time
+    profile = ImpairmentProfile::parse("burst=10,dir=tx");
+    QCOMPARE(profile.burstEnterPercent, 10.0);
+    QCOMPARE(profile.burstExitPercent, 100.0);
+    QVERIFY(!profile.rx && profile.tx);
+    QVERIFY(profile.isEnabled());
+
+    //no direction left, nothing to impair
+    profile = ImpairmentProfile::parse("loss=5,dir=none,bogus,unknown=1");
+    QCOMPARE(profile.lossPercent, 5.0);
+    QVERIFY(!profile.rx && !profile.tx);
+    QVERIFY(!profile.isEnabled());
+}
+
+void TestComponents::testLiveCallRows()
+{
+    CallHistoryModel model;
+    model.clear();
+    const auto rowOf = [&model](const QString &userName) {
+        for (int row = 0; row < model.rowCount(); ++row) {
+            if (userName == model.userName(row)) {
+                return row;
+            }
+        }
+        return -1;
+    };
+
+    //the newest call is on top, the rows of the calls in progress move down
+    model.addContact(1, "", "1001", CallHistoryModel::CallStatus::OUTGOING);
+    model.addContact(2, "", "1002", CallHistoryModel::CallStatus::INCOMING);
+    model.updateContact(1, "first", "1001");
+    model.updateContact(2, "second", "1002");
+    QCOMPARE(rowOf("second"), 0);
+    QCOMPARE(rowOf("first"), 1);
+
+    //a batch of finished calls, newer than the calls in progress
+    QVector<CallHistoryModel::CallHistoryInfo> calls;
+    for (int i = 0; i < 3; ++i) {
+        CallHistoryModel::CallHistoryInfo info(QString("batch %1").arg(i), QString::number(2000 + i));
+        info.dateTime = QDateTime::currentDateTime().addSecs(3600 * (i + 1));
+        calls.append(info);
+    }
+    model.addCalls(calls);
+    QCOMPARE(model.rowCount(), 5);
+    model.updateContact(1, "first again", "");
+    model.updateContact(2, "second again", "");
+    QCOMPARE(rowOf("second again"), 3);
+    QCOMPARE(rowOf("first again"), 4);
+
+    //deleting a row finds the calls in progress again, the deleted one is forgotten
+    model.deleteContact(rowOf("second again"));
+    QCOMPARE(model.rowCount(), 4);
+    model.updateContact(2, "deleted", "");
+    QCOMPARE(rowOf("deleted"), -1);
+    model.updateContact(1, "first after delete", "");
+    QCOMPARE(rowOf("first after delete"), 3);
+
+    //reloaded and sorted again, the call in progress still updates its own row
+    model.onContactsReady();
+    QCOMPARE(model.rowCount(), 4);
+    model.updateContact(1, "first reloaded", "");
+    QCOMPARE(rowOf("first reloaded"), 3);
+    QCOMPARE(model.phoneNumber(3), QString("1001"));
+    QCOMPARE(rowOf("batch 0"), 2);
+    model.updateContact(2, "deleted again", "");
+    QCOMPARE(rowOf("deleted again"), -1);
+
+    //pushed out of the history by a large batch
+    calls.clear();
+    for (int i = 0; i < 100; ++i) {
+        CallHistoryModel::CallHistoryInfo info(QString("large %1").arg(i), QString::number(3000 + i));
+        info.dateTime = QDateTime::currentDateTime().addSecs(7200 + i);
+        calls.append(info);
+    }
+    model.addCalls(calls);
+    QCOMPARE(model.rowCount(), 100);
+    model.updateContact(1, "gone", "");
+    QCOMPARE(rowOf("gone"), -1);
+
+    model.clear();
+}
+
+void TestComponents::testMessagesFilterRefine()
+{
+    MessagesProxyModel proxy;
+    const auto acceptedRows = [&proxy]() {
+        QList<int> rows;
+        for (int row = 0; row < proxy.rowCount(); ++row) {
+            rows.append(proxy.mapToSource(proxy.index(row, 0)).row());
+        }
+        std::sort(rows.begin(), rows.end());
+        return rows;
+    };
+    //matched on the source and destination extensions
+    proxy.appendOutgoing("alice", "bob", "1");
+    proxy.appendOutgoing("alice", "bobby", "2");
+    proxy.appendOutgoing("carol", "bob", "3");
+    proxy.appendOutgoing("dave", "eve", "4");
+    QCOMPARE(acceptedRows(), (QList<int>{ 0, 1, 2, 3 }));
+
+    //a growing query only looks at the rows accepted by the previous one
+    proxy.setFilterFixedString("b");
+    QCOMPARE(acceptedRows(), (QList<int>{ 0, 1, 2 }));
+    proxy.setFilterFixedString("bo");
+    QCOMPARE(acceptedRows(), (QList<int>{ 0, 1, 2 }));
+    proxy.setFilterFixedString("bobb");
+    QCOMPARE(acceptedRows(), (QList<int>{ 1 }));
+
+    //a shorter or different query starts again from all rows
+    proxy.setFilterFixedString("bo");
+    QCOMPARE(acceptedRows(), (QList<int>{ 0, 1, 2 }));
+    proxy.setFilterFixedString("BOB");
+    QCOMPARE(acceptedRows(), (QList<int>{ 0, 1, 2 }));
+
+    //a new row is matched too and the next refinement still sees it
+    proxy.appendOutgoing("xavier", "bob", "5");
+    QCOMPARE(acceptedRows(), (QList<int>{ 0, 1, 2, 4 }));
+    proxy.setFilterFixedString("bobb");
+    QCOMPARE(acceptedRows(), (QList<int>{ 1 }));
+
+    proxy.setFilterFixedString("e");
+    QCOMPARE(acceptedRows(), (QList<int>{ 0, 1, 3, 4 }));
+    proxy.setFilterFixedString("ev");
+    QCOMPARE(acceptedRows(), (QList<int>{ 3 }));
+    proxy.setFilterFixedString("");
+    QCOMPARE(acceptedRows(), (QList<int>{ 0, 1, 2, 3, 4 }));
+}
+
+void TestComponents::testMessagesFilterSort()
+{
+    MessagesProxyModel proxy;
+    auto *model = proxy.messagesModel();
+    const auto append = [model](const QString &srcExtension, const QString &dstExtension, int secs) {
+        MessagesModel::Message msg;
+        msg.timestamp = QDateTime::currentDateTime().addSecs(secs);
+        msg.srcAdditionalInfo.extension = srcExtension;
+        msg.dstAdditionalInfo.extension = dstExtension;
+        model->append(msg);
+    };
+    const auto acceptedKeys = [&proxy, model]() {
+        QStringList keys;
+        for (int row = 0; row < proxy.rowCount(); ++row) {
+            keys.append(model->filterKey(proxy.mapToSource(proxy.index(row, 0)).row()));
+        }
+        keys.sort();
+        return keys;
+    };
+    append("alice", "bob", 3);
+    append("carol", "dave", 1);
+    append("bobby", "eve", 2);
+
+    proxy.setFilterFixedString("b");
+    QCOMPARE(acceptedKeys(), (QStringList{ "alicebob", "bobbyeve" }));
+    proxy.setFilterFixedString("bo");
+    QCOMPARE(acceptedKeys(), (QStringList{ "alicebob", "bobbyeve" }));
+
+    //the rows move while the query is active, the results follow the messages
+    model->sortTimestamp();
+    QCOMPARE(model->filterKey(0), QString("caroldave"));
+    QCOMPARE(acceptedKeys(), (QStringList{ "alicebob", "bobbyeve" }));
+
+    //and the next keystroke still refines them
+    proxy.setFilterFixedString("bob");
+    QCOMPARE(acceptedKeys(), (QStringList{ "alicebob", "bobbyeve" }));
+    proxy.setFilterFixedString("bobb");
+    QCOMPARE(acceptedKeys(), (QStringList{ "bobbyeve" }));
+
+    //a message appended during a query is matched and kept by the next one
+    append("robert", "bobby", 4);
+    QCOMPARE(acceptedKeys(), (QStringList{ "bobbyeve", "robertbobby" }));
+    proxy.setFilterFixedString("bobby");
+    QCOMPARE(acceptedKeys(), (QStringList{ "bobbyeve", "robertbobby" }));
+}
+
+int main(int argc, char *argv[])
+{
+    //the settings documents written by the models go to a throwaway home
+    QTemporaryDir home;
+    qputenv("HOME", home.path().toLocal8Bit());
+    QApplication app(argc, argv);
+    int rc = 0;
+    TestComponents components;
+    rc |= QTest::qExec(&components, argc, argv);
+    TestSipClient sipClient;
+    rc |= QTest::qExec(&sipClient, argc, argv);
+    return rc;
+}
+
 #include "main.moc"
@@ -0,0 +1,21 @@
+#!/bin/bash
+
+set -e
+
+CUR_DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" >/dev/null 2>&1 && pwd )"
+INSTALL_DIR=$CUR_DIR/../pjproject-linux-install
+BCG729_DIR=$CUR_DIR/../bcg729-install
+APP_DIR=$CUR_DIR/../bcphone
+
+make clean && make distclean || true
+rm -rf $INSTALL_DIR/*
+
+cp $APP_DIR/tools/config_site_linux.h pjlib/include/pj/config_site.h
+
+#static libraries linked into the engine library, hence PIC
+CFLAGS="-fPIC -O2" ./configure --prefix $INSTALL_DIR --enable-epoll --disable-video --disable-sound \
+    --disable-ffmpeg --disable-libwebrtc --disable-v4l2 --disable-sdl --disable-openh264 \
+    --with-bcg729=$BCG729_DIR
+
+make dep && make
+make install
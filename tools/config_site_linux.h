@@ -0,0 +1,14 @@
+#define PJ_IOQUEUE_IMP PJ_IOQUEUE_IMP_EPOLL
+#define PJ_IOQUEUE_MAX_HANDLES 4096
+#define PJSUA_MAX_CALLS 256
+#define PJSUA_MAX_CONF_PORTS (2 * PJSUA_MAX_CALLS + 16)
+#define PJMEDIA_HAS_VIDEO 0
+#define PJMEDIA_AUDIO_DEV_HAS_PORTAUDIO 0
+#define PJMEDIA_AUDIO_DEV_HAS_ALSA 0
+#define PJMEDIA_AUDIO_DEV_HAS_NULL_AUDIO 1
+#define PJMEDIA_HAS_OPUS_CODEC 1
+#define PJMEDIA_HAS_BCG729 1
+#define PJ_HAS_SSL_SOCK 1
+#define PJ_HAS_LIMITS_H 1
+
+#include "config_site_sample.h"